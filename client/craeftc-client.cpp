@@ -0,0 +1,81 @@
+/**
+ * @file craeftc-client.cpp
+ *
+ * @brief A stand-in for `craeftc` which has a `craeftc --server` do the
+ *        work.
+ *
+ * Usage is exactly that of `craeftc`, with the socket of the server in the
+ * environment variable `CRAEFTC_SOCKET`.  The client is small and links
+ * nothing of LLVM's, so it starts up quickly.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ServerProtocol.hh"
+
+int main(int argc, char **argv) {
+    const char *path = getenv("CRAEFTC_SOCKET");
+    if (!path) {
+        std::cerr << "craeftc-client: set CRAEFTC_SOCKET to the socket of a "
+                     "craeftc --server" << std::endl;
+        return 2;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (sockaddr *)&addr, sizeof addr)) {
+        std::cerr << "craeftc-client: cannot connect to " << path << ": "
+                  << strerror(errno) << std::endl;
+        return 2;
+    }
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof cwd)) {
+        std::cerr << "craeftc-client: cannot find the working directory: "
+                  << strerror(errno) << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    int status;
+    if (!Craeft::send_request(sock, cwd, args)
+     || !Craeft::receive_status(sock, status)) {
+        std::cerr << "craeftc-client: the server did not finish the compile"
+                  << std::endl;
+        return 2;
+    }
+
+    return status;
+}
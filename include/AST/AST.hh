@@ -22,7 +22,16 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "AST/Arena.hh"
 #include "Error.hh"
+#include "Symbol.hh"
 
 namespace Craeft {
 
@@ -30,12 +39,24 @@ namespace AST {
 
 /**
  * @brief Nodes in the abstract syntax tree.
+ *
+ * Nodes are allocated from the current `Arena` (see AST/Arena.hh); one must
+ * be active whenever a node is created with `new`.
  */
 class ASTNode {
 public:
     explicit ASTNode(SourcePos pos): _pos(pos) {}
     virtual ~ASTNode() {}
 
+    static void *operator new(size_t size) {
+        Arena *arena = Arena::current();
+        assert(arena && "AST node allocated outside of an arena");
+        return arena->allocate(size, alignof(std::max_align_t));
+    }
+
+    /* The memory belongs to the arena. */
+    static void operator delete(void *) {}
+
     /**
      * The only thing all AST nodes have in common is a location in the
      * source.
@@ -46,5 +67,33 @@ private:
     SourcePos _pos;
 };
 
+/**
+ * @brief A hint attached to the code after it, such as `@unroll(4)` or
+ *        `@vectorize(width=8)`.
+ *
+ * The parser only checks the syntax; which annotations mean anything is up to
+ * the code generator.
+ */
+struct Annotation {
+    Symbol name;
+
+    /**
+     * @brief The integer arguments in order, each with its name, or the
+     *        empty symbol if it was given positionally.  A name alone
+     *        stands for `name=1`.
+     */
+    std::vector<std::pair<Symbol, int64_t> > args;
+
+    SourcePos pos;
+
+    Annotation(Symbol name, SourcePos pos): name(name), pos(pos) {}
+};
+
+/**
+ * @brief Print a representation of a list of annotations to the given stream.
+ */
+void print_annotations(const std::vector<Annotation> &annotations,
+                       std::ostream &out);
+
 }
 }
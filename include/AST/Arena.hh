@@ -0,0 +1,121 @@
+/**
+ * @file AST/Arena.hh
+ *
+ * @brief Bump allocation for AST nodes.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "llvm/Support/Allocator.h"
+
+namespace Craeft {
+
+namespace AST {
+
+/**
+ * @brief A bump allocator that AST nodes are carved out of.
+ *
+ * Nodes allocated in an arena are never freed individually; all of their
+ * memory is released at once when the arena is destroyed.  Their destructors
+ * still run as usual, so members that own other resources are cleaned up.
+ *
+ * Arenas are handled through `shared_ptr`s, so that anything holding on to
+ * part of a tree (see `ArenaDeleter`) keeps the memory under it alive.
+ */
+class Arena: public std::enable_shared_from_this<Arena> {
+public:
+    Arena(void): nallocations(0) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align) {
+        ++nallocations;
+        return allocator.Allocate(size, llvm::Align(align));
+    }
+
+    /**
+     * @brief Get the number of allocations (i.e., nodes) made in this arena.
+     */
+    size_t allocations(void) const {
+        return nallocations;
+    }
+
+    /**
+     * @brief Get the total number of bytes handed out by this arena.
+     */
+    size_t bytes_allocated(void) const {
+        return allocator.getBytesAllocated();
+    }
+
+    /**
+     * @brief Get the arena nodes are currently allocated from on this
+     *        thread, or null if none.
+     */
+    static Arena *current(void);
+
+private:
+    llvm::BumpPtrAllocator allocator;
+    size_t nallocations;
+};
+
+/**
+ * @brief RAII guard making an arena current on this thread.
+ *
+ * Scopes may nest; the previous arena is restored on destruction.
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &arena);
+    ~ArenaScope(void);
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    Arena *saved;
+};
+
+/**
+ * @brief Deleter for (the roots of) arena-allocated trees.
+ *
+ * Destroys the tree, then drops its reference to the arena, freeing the
+ * arena's memory if nothing else is using it.
+ */
+struct ArenaDeleter {
+    std::shared_ptr<Arena> arena;
+
+    template<typename T>
+    void operator()(T *node) const { delete node; }
+};
+
+/**
+ * @brief Owning pointer to the root of an arena-allocated tree.
+ */
+template<typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDeleter>;
+
+}
+
+}
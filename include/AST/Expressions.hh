@@ -32,6 +32,7 @@
 
 #include "AST/AST.hh"
 #include "AST/Types.hh"
+#include "Token.hh"
 
 namespace Craeft {
 
@@ -53,6 +54,7 @@ public:
         Reference,
         Dereference,
         FieldAccess,
+        Index,
         Binop,
         FunctionCall,
         TemplateFunctionCall,
@@ -77,7 +79,8 @@ public:
     static bool classof(const Expression *e) {
         return e->kind() == ExpressionKind::Variable
             || e->kind() == ExpressionKind::Dereference
-            || e->kind() == ExpressionKind::FieldAccess;
+            || e->kind() == ExpressionKind::FieldAccess
+            || e->kind() == ExpressionKind::Index;
     }
 
     LValue(ExpressionKind kind, SourcePos pos): Expression(kind, pos) {}
@@ -159,15 +162,15 @@ private:
 
 class Variable: public LValue {
 public:
-    Variable(const std::string &name, SourcePos pos)
+    Variable(Symbol name, SourcePos pos)
         : LValue(ExpressionKind::Variable, pos),
           _name(name) {}
 
-    const std::string &name(void) const { return _name; }
+    Symbol name(void) const { return _name; }
 
     LVALUE_CLASS(Variable);
 private:
-    std::string _name;
+    Symbol _name;
 };
 
 /**
@@ -210,7 +213,7 @@ private:
  */
 class Binop: public Expression {
 public:
-    Binop(const std::string &op,
+    Binop(Tok::Op op,
           std::unique_ptr<Expression> lhs,
           std::unique_ptr<Expression> rhs,
           SourcePos pos)
@@ -219,7 +222,7 @@ public:
           _lhs(std::move(lhs)),
           _rhs(std::move(rhs)) {}
 
-    const std::string &op(void) const { return _op; }
+    Tok::Op op(void) const { return _op; }
 
     const Expression &lhs(void) const { return *_lhs; }
     const Expression &rhs(void) const { return *_rhs; }
@@ -240,34 +243,43 @@ public:
 
     EXPRESSION_CLASS(Binop);
 private:
-    std::string _op;
+    Tok::Op _op;
     std::unique_ptr<Expression> _lhs;
     std::unique_ptr<Expression> _rhs;
 };
 
 class FunctionCall: public Expression {
 public:
-    FunctionCall(const std::string &fname,
+    FunctionCall(Symbol fname,
                  std::vector<std::unique_ptr<Expression>> args,
-                 SourcePos pos)
+                 SourcePos pos,
+                 bool awaited = false)
         : Expression(ExpressionKind::FunctionCall, pos),
           _fname(fname),
-          _args(std::move(args)) {}
+          _args(std::move(args)),
+          _awaited(awaited) {}
 
-    const std::string &fname(void) const { return _fname; }
+    Symbol fname(void) const { return _fname; }
     const std::vector<std::unique_ptr<Expression>> &args(void) const {
         return _args;
     }
 
+    /**
+     * @brief Whether the call is `await`ed: run to completion, giving the
+     *        result of the `async fn` rather than its handle.
+     */
+    bool awaited(void) const { return _awaited; }
+
     EXPRESSION_CLASS(FunctionCall);
 private:
-    std::string _fname;
+    Symbol _fname;
     std::vector<std::unique_ptr<Expression>> _args;
+    bool _awaited;
 };
 
 class TemplateFunctionCall: public Expression {
 public:
-    TemplateFunctionCall(const std::string &fname,
+    TemplateFunctionCall(Symbol fname,
                          std::vector<std::unique_ptr<Type>> type_args,
                          std::vector<std::unique_ptr<Expression>> value_args,
                          SourcePos pos)
@@ -276,7 +288,7 @@ public:
           _type_args(std::move(type_args)),
           _value_args(std::move(value_args)) {}
 
-    const std::string &fname(void) const { return _fname; }
+    Symbol fname(void) const { return _fname; }
 
     const std::vector<std::unique_ptr<Expression>> &value_args(void) const {
         return _value_args;
@@ -288,7 +300,7 @@ public:
 
     EXPRESSION_CLASS(TemplateFunctionCall);
 private:
-    std::string _fname;
+    Symbol _fname;
     std::vector<std::unique_ptr<Type>> _type_args;
     std::vector<std::unique_ptr<Expression>> _value_args;
 };
@@ -320,19 +332,40 @@ private:
 class FieldAccess: public LValue {
 public:
     FieldAccess(std::unique_ptr<Expression> structure,
-                const std::string &field,
+                Symbol field,
                 SourcePos pos)
         : LValue(ExpressionKind::FieldAccess, pos),
           _structure(std::move(structure)),
           _field(field) {}
 
     const Expression &structure(void) const { return *_structure; }
-    const std::string &field(void) const { return _field; }
+    Symbol field(void) const { return _field; }
 
     LVALUE_CLASS(FieldAccess);
 private:
     std::unique_ptr<Expression> _structure;
-    std::string _field;
+    Symbol _field;
+};
+
+/**
+ * @brief Accesses to array elements (`a[i]`).
+ */
+class Index: public LValue {
+public:
+    Index(std::unique_ptr<Expression> array,
+          std::unique_ptr<Expression> index,
+          SourcePos pos)
+        : LValue(ExpressionKind::Index, pos),
+          _array(std::move(array)),
+          _index(std::move(index)) {}
+
+    const Expression &array(void) const { return *_array; }
+    const Expression &index(void) const { return *_index; }
+
+    LVALUE_CLASS(Index);
+private:
+    std::unique_ptr<Expression> _array;
+    std::unique_ptr<Expression> _index;
 };
 
 #undef EXPRESSION_CLASS
@@ -361,6 +394,7 @@ public:
             HANDLE(Reference);
             HANDLE(Dereference);
             HANDLE(FieldAccess);
+            HANDLE(Index);
             HANDLE(Binop);
             HANDLE(FunctionCall);
             HANDLE(TemplateFunctionCall);
@@ -377,6 +411,7 @@ private:
     virtual Result operator()(const Reference &) = 0;
     virtual Result operator()(const Dereference &) = 0;
     virtual Result operator()(const FieldAccess &) = 0;
+    virtual Result operator()(const Index &) = 0;
     virtual Result operator()(const Binop &) = 0;
     virtual Result operator()(const FunctionCall &) = 0;
     virtual Result operator()(const TemplateFunctionCall &) = 0;
@@ -409,6 +444,7 @@ public:
             HANDLE(Reference);
             HANDLE(Dereference);
             HANDLE(FieldAccess);
+            HANDLE(Index);
             HANDLE(Binop);
             HANDLE(FunctionCall);
             HANDLE(TemplateFunctionCall);
@@ -426,6 +462,7 @@ private:
     virtual Result operator()(std::unique_ptr<Reference>) = 0;
     virtual Result operator()(std::unique_ptr<Dereference>) = 0;
     virtual Result operator()(std::unique_ptr<FieldAccess>) = 0;
+    virtual Result operator()(std::unique_ptr<Index>) = 0;
     virtual Result operator()(std::unique_ptr<Binop>) = 0;
     virtual Result operator()(std::unique_ptr<FunctionCall>) = 0;
     virtual Result operator()(std::unique_ptr<TemplateFunctionCall>) = 0;
@@ -447,6 +484,7 @@ public:
             HANDLE(Variable);
             HANDLE(Dereference);
             HANDLE(FieldAccess);
+            HANDLE(Index);
 #undef HANDLE
             default:
                 assert(false);
@@ -457,6 +495,7 @@ private:
     virtual Result operator()(const Variable &) = 0;
     virtual Result operator()(const Dereference &) = 0;
     virtual Result operator()(const FieldAccess &) = 0;
+    virtual Result operator()(const Index &) = 0;
 };
 
 /**
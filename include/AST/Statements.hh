@@ -51,7 +51,9 @@ public:
         Assignment,
         Declaration,
         CompoundDeclaration,
-        IfStatement
+        IfStatement,
+        WhileLoop,
+        ForLoop
     };
 
     StatementKind kind(void) const { return _kind; }
@@ -86,18 +88,26 @@ private:
 };
 
 /**
- * @brief Return statement with a value (as opposed to a void return).
+ * @brief Return statement with a value (as opposed to a void return), or a
+ *        `become` statement: a return of a call made as a guaranteed tail
+ *        call.
  */
 class Return: public Statement {
 public:
-    Return(std::unique_ptr<Expression> retval, SourcePos pos)
-        : Statement(StatementKind::Return, pos), _retval(std::move(retval)) {}
+    Return(std::unique_ptr<Expression> retval, SourcePos pos,
+           bool is_tail=false)
+        : Statement(StatementKind::Return, pos), _retval(std::move(retval)),
+          _is_tail(is_tail) {}
 
     const Expression &retval(void) const { return *_retval; }
 
+    /** @brief Whether this is a `become`. */
+    bool is_tail(void) const { return _is_tail; }
+
     STATEMENT_CLASS(Return);
 private:
     std::unique_ptr<Expression> _retval;
+    bool _is_tail;
 };
 
 /**
@@ -110,25 +120,30 @@ public:
 };
 
 /**
- * @brief Variable declaration.
+ * @brief Variable declaration, optionally zeroing it (`Header h = {};`).
  */
 class Declaration: public Statement {
 public:
     Declaration(std::unique_ptr<Type> type,
                 const AST::Variable &name,
-                SourcePos pos)
+                SourcePos pos,
+                bool zeroed=false)
         : Statement(StatementKind::Declaration, pos),
           _type(std::move(type)),
-          _name(name) {}
+          _name(name),
+          _zeroed(zeroed) {}
 
     const Type &type(void) const { return *_type; }
 
     const Variable &name(void) const { return _name; }
 
+    bool zeroed(void) const { return _zeroed; }
+
     STATEMENT_CLASS(Declaration);
 private:
     std::unique_ptr<Type> _type;
     Variable _name;
+    bool _zeroed;
 };
 
 /**
@@ -209,6 +224,83 @@ private:
 
 };
 
+/**
+ * @brief A `while` loop.
+ */
+class WhileLoop: public Statement {
+public:
+    WhileLoop(std::unique_ptr<Expression> condition,
+              std::vector<std::unique_ptr<Statement>> body,
+              std::vector<Annotation> annotations,
+              SourcePos pos)
+        : Statement(StatementKind::WhileLoop, pos),
+          _condition(std::move(condition)),
+          _body(std::move(body)),
+          _annotations(std::move(annotations)) {}
+
+    const Expression &condition(void) const { return *_condition; }
+
+    const std::vector<std::unique_ptr<Statement>> &body(void) const {
+        return _body;
+    }
+
+    const std::vector<Annotation> &annotations(void) const {
+        return _annotations;
+    }
+
+    STATEMENT_CLASS(WhileLoop);
+private:
+    std::unique_ptr<Expression> _condition;
+    std::vector<std::unique_ptr<Statement>> _body;
+    std::vector<Annotation> _annotations;
+};
+
+/**
+ * @brief A `for init; condition; step { ... }` loop.
+ *
+ * The initializer and step may be missing; the initializer's variables are
+ * scoped to the loop.
+ */
+class ForLoop: public Statement {
+public:
+    ForLoop(std::unique_ptr<Statement> init,
+            std::unique_ptr<Expression> condition,
+            std::unique_ptr<Statement> step,
+            std::vector<std::unique_ptr<Statement>> body,
+            std::vector<Annotation> annotations,
+            SourcePos pos)
+        : Statement(StatementKind::ForLoop, pos),
+          _init(std::move(init)),
+          _condition(std::move(condition)),
+          _step(std::move(step)),
+          _body(std::move(body)),
+          _annotations(std::move(annotations)) {}
+
+    /** @brief The initializer, or null if there is none. */
+    const Statement *init(void) const { return _init.get(); }
+
+    const Expression &condition(void) const { return *_condition; }
+
+    /** @brief The step, or null if there is none. */
+    const Statement *step(void) const { return _step.get(); }
+
+    const std::vector<std::unique_ptr<Statement>> &body(void) const {
+        return _body;
+    }
+
+    const std::vector<Annotation> &annotations(void) const {
+        return _annotations;
+    }
+
+    STATEMENT_CLASS(ForLoop);
+private:
+    std::unique_ptr<Statement> _init;
+    std::unique_ptr<Expression> _condition;
+    std::unique_ptr<Statement> _step;
+    std::vector<std::unique_ptr<Statement>> _body;
+    std::vector<Annotation> _annotations;
+};
+
 #undef STATEMENT_CLASS
 
 /**
@@ -232,6 +324,8 @@ public:
             HANDLE(Declaration);
             HANDLE(CompoundDeclaration);
             HANDLE(IfStatement);
+            HANDLE(WhileLoop);
+            HANDLE(ForLoop);
 #undef HANDLE
         }
     }
@@ -243,6 +337,8 @@ private:
     virtual Result operator()(const Declaration &) = 0;
     virtual Result operator()(const CompoundDeclaration &) = 0;
     virtual Result operator()(const IfStatement &) = 0;
+    virtual Result operator()(const WhileLoop &) = 0;
+    virtual Result operator()(const ForLoop &) = 0;
 };
 
 /**
@@ -49,7 +49,11 @@ public:
         TemplateStructDeclaration,
         FunctionDeclaration,
         FunctionDefinition,
-        TemplateFunctionDefinition
+        TemplateFunctionDefinition,
+        ConstDefinition,
+        ConstFunctionDefinition,
+        GlobalDefinition,
+        Import
     };
 
     ToplevelKind kind(void) const { return _kind; }
@@ -72,14 +76,14 @@ private:
  */
 class TypeDeclaration: public Toplevel {
 public:
-    TypeDeclaration(const std::string &name, SourcePos pos)
+    TypeDeclaration(Symbol name, SourcePos pos)
         : Toplevel(ToplevelKind::TypeDeclaration, pos), _name(name) {}
 
-    const std::string &name(void) const { return _name; }
+    Symbol name(void) const { return _name; }
 
     TOPLEVEL_CLASS(TypeDeclaration);
 private:
-    std::string _name;
+    Symbol _name;
 };
 
 /**
@@ -87,22 +91,42 @@ private:
  */
 class StructDeclaration: public Toplevel {
 public:
-    StructDeclaration(const std::string &name,
+    StructDeclaration(Symbol name,
                       std::vector<std::unique_ptr<Declaration>> members,
+                      std::vector<std::vector<Annotation>> member_annotations,
+                      std::vector<Annotation> annotations,
                       SourcePos pos)
         : Toplevel(ToplevelKind::StructDeclaration, pos),
           _name(name),
-          _members(std::move(members)) {}
+          _members(std::move(members)),
+          _member_annotations(std::move(member_annotations)),
+          _annotations(std::move(annotations)) {}
 
-    const std::string &name(void) const { return _name; }
+    Symbol name(void) const { return _name; }
     const std::vector<std::unique_ptr<Declaration>> &members(void) const {
         return _members;
     }
 
+    /**
+     * @brief The annotations on each member, in the same order as
+     *        `members()`.
+     */
+    const std::vector<std::vector<Annotation>> &
+    member_annotations(void) const {
+        return _member_annotations;
+    }
+
+    /** @brief The annotations on the struct as a whole. */
+    const std::vector<Annotation> &annotations(void) const {
+        return _annotations;
+    }
+
     TOPLEVEL_CLASS(StructDeclaration);
 private:
-    std::string _name;
+    Symbol _name;
     std::vector<std::unique_ptr<Declaration>> _members;
+    std::vector<std::vector<Annotation>> _member_annotations;
+    std::vector<Annotation> _annotations;
 };
 
 /**
@@ -111,20 +135,23 @@ private:
 class TemplateStructDeclaration: public Toplevel {
 public:
     TemplateStructDeclaration(
-            const std::string &name,
-            const std::vector<std::string> &argnames,
+            Symbol name,
+            const std::vector<Symbol> &argnames,
             std::vector<std::unique_ptr<Declaration>> members,
+            std::vector<std::vector<Annotation>> member_annotations,
+            std::vector<Annotation> annotations,
             SourcePos pos)
         : Toplevel(ToplevelKind::TemplateStructDeclaration, pos),
           _argnames(argnames),
-          _decl(name, std::move(members), pos) {}
+          _decl(name, std::move(members), std::move(member_annotations),
+                std::move(annotations), pos) {}
 
     const class StructDeclaration &decl(void) const { return _decl; }
-    const std::vector<std::string> &argnames(void) const { return _argnames; }
+    const std::vector<Symbol> &argnames(void) const { return _argnames; }
 
     TOPLEVEL_CLASS(TemplateStructDeclaration);
 private:
-    std::vector<std::string> _argnames;
+    std::vector<Symbol> _argnames;
     class StructDeclaration _decl;
 };
 
@@ -133,26 +160,40 @@ private:
  */
 class FunctionDeclaration: public Toplevel {
 public:
-    FunctionDeclaration(const std::string &name,
+    FunctionDeclaration(Symbol name,
                         std::vector<std::unique_ptr<Declaration>> args,
                         std::unique_ptr<Type> ret_type,
-                        SourcePos pos)
+                        std::vector<Annotation> annotations,
+                        SourcePos pos,
+                        bool is_async = false)
         : Toplevel(ToplevelKind::FunctionDeclaration, pos),
           _name(name),
           _args(std::move(args)),
-          _ret_type(std::move(ret_type)) {}
+          _ret_type(std::move(ret_type)),
+          _annotations(std::move(annotations)),
+          _is_async(is_async) {}
 
-    const std::string &name(void) const { return _name; }
+    Symbol name(void) const { return _name; }
     const std::vector<std::unique_ptr<Declaration>> &args(void) const {
         return _args;
     }
     const Type &ret_type(void) const { return *_ret_type; }
+    const std::vector<Annotation> &annotations(void) const {
+        return _annotations;
+    }
+
+    /**
+     * @brief Whether this is an `async fn`, called as a coroutine.
+     */
+    bool is_async(void) const { return _is_async; }
 
     TOPLEVEL_CLASS(FunctionDeclaration);
 private:
-    std::string _name;
+    Symbol _name;
     std::vector<std::unique_ptr<Declaration>> _args;
     std::unique_ptr<Type> _ret_type;
+    std::vector<Annotation> _annotations;
+    bool _is_async;
 };
 
 class FunctionDefinition: public Toplevel {
@@ -184,21 +225,126 @@ class TemplateFunctionDefinition: public Toplevel {
 public:
     TemplateFunctionDefinition(
             std::unique_ptr<class FunctionDeclaration> signature,
-            const std::vector<std::string> &argnames,
+            const std::vector<Symbol> &argnames,
             std::vector<std::unique_ptr<Statement>> block,
             SourcePos pos)
         : Toplevel(ToplevelKind::TemplateFunctionDefinition, pos),
+          /* Instantiations of the template can outlive this node, so the
+           * definition keeps its arena alive. */
           _def(new class FunctionDefinition(std::move(signature),
-                                            std::move(block), pos)),
+                                            std::move(block), pos),
+               ArenaDeleter { Arena::current()->shared_from_this() }),
           _argnames(argnames) {}
 
     std::shared_ptr<class FunctionDefinition> def(void) const { return _def; }
-    const std::vector<std::string> &argnames(void) const { return _argnames; }
+    const std::vector<Symbol> &argnames(void) const { return _argnames; }
 
     TOPLEVEL_CLASS(TemplateFunctionDefinition);
 private:
     std::shared_ptr<class FunctionDefinition> _def;
-    std::vector<std::string> _argnames;
+    std::vector<Symbol> _argnames;
+};
+
+/**
+ * @brief Definition of a compile-time constant (`const U64 n = 16;`).
+ */
+class ConstDefinition: public Toplevel {
+public:
+    ConstDefinition(std::unique_ptr<CompoundDeclaration> decl, SourcePos pos)
+        : Toplevel(ToplevelKind::ConstDefinition, pos),
+          _decl(std::move(decl)) {}
+
+    const CompoundDeclaration &decl(void) const { return *_decl; }
+
+    TOPLEVEL_CLASS(ConstDefinition);
+private:
+    std::unique_ptr<CompoundDeclaration> _decl;
+};
+
+/**
+ * @brief Definition of a function which may be evaluated at compile time
+ *        (`const fn`).
+ */
+class ConstFunctionDefinition: public Toplevel {
+public:
+    ConstFunctionDefinition(
+            std::unique_ptr<class FunctionDeclaration> signature,
+            std::vector<std::unique_ptr<Statement>> block,
+            SourcePos pos)
+        : Toplevel(ToplevelKind::ConstFunctionDefinition, pos),
+          /* As for templates: later top-level forms may evaluate calls to
+           * the function after this node is gone. */
+          _def(new class FunctionDefinition(std::move(signature),
+                                            std::move(block), pos),
+               ArenaDeleter { Arena::current()->shared_from_this() }) {}
+
+    std::shared_ptr<class FunctionDefinition> def(void) const { return _def; }
+
+    TOPLEVEL_CLASS(ConstFunctionDefinition);
+private:
+    std::shared_ptr<class FunctionDefinition> _def;
+};
+
+/**
+ * @brief Definition of a global variable (`U64 count = 0;`), which may be
+ *        `thread_local`.
+ */
+class GlobalDefinition: public Toplevel {
+public:
+    /**
+     * @param decl A `Declaration`, for a zero-initialized variable, or a
+     *             `CompoundDeclaration` with a constant initializer.
+     */
+    GlobalDefinition(std::unique_ptr<Statement> decl, bool is_thread_local,
+                     SourcePos pos)
+        : Toplevel(ToplevelKind::GlobalDefinition, pos),
+          _decl(std::move(decl)), _is_thread_local(is_thread_local) {}
+
+    const Statement &decl(void) const { return *_decl; }
+
+    const Type &type(void) const {
+        if (auto *cd = llvm::dyn_cast<CompoundDeclaration>(_decl.get())) {
+            return cd->type();
+        }
+        return llvm::cast<Declaration>(*_decl).type();
+    }
+
+    const Variable &name(void) const {
+        if (auto *cd = llvm::dyn_cast<CompoundDeclaration>(_decl.get())) {
+            return cd->name();
+        }
+        return llvm::cast<Declaration>(*_decl).name();
+    }
+
+    /** @brief The initializer, or null if there is none. */
+    const Expression *initializer(void) const {
+        auto *cd = llvm::dyn_cast<CompoundDeclaration>(_decl.get());
+        return cd ? &cd->rhs() : nullptr;
+    }
+
+    bool is_thread_local(void) const { return _is_thread_local; }
+
+    TOPLEVEL_CLASS(GlobalDefinition);
+private:
+    std::unique_ptr<Statement> _decl;
+    bool _is_thread_local;
+};
+
+/**
+ * @brief An `import` of a precompiled interface (see Interface.hh), whose
+ *        declarations are loaded as they are first used.
+ */
+class Import: public Toplevel {
+public:
+    Import(const std::string &path, SourcePos pos)
+        : Toplevel(ToplevelKind::Import, pos), _path(path) {}
+
+    /** @brief The real path of the interface file. */
+    const std::string &path(void) const { return _path; }
+
+    TOPLEVEL_CLASS(Import);
+private:
+    std::string _path;
 };
 
 #undef TOPLEVEL_CLASS
@@ -223,6 +369,10 @@ public:
             HANDLE(FunctionDeclaration);
             HANDLE(FunctionDefinition);
             HANDLE(TemplateFunctionDefinition);
+            HANDLE(ConstDefinition);
+            HANDLE(ConstFunctionDefinition);
+            HANDLE(GlobalDefinition);
+            HANDLE(Import);
         }
 #undef HANDLE
     }
@@ -234,6 +384,10 @@ private:
     virtual Result operator()(const FunctionDeclaration &) = 0;
     virtual Result operator()(const FunctionDefinition &) = 0;
     virtual Result operator()(const TemplateFunctionDefinition &) = 0;
+    virtual Result operator()(const ConstDefinition &) = 0;
+    virtual Result operator()(const ConstFunctionDefinition &) = 0;
+    virtual Result operator()(const GlobalDefinition &) = 0;
+    virtual Result operator()(const Import &) = 0;
 };
 
 /**
@@ -47,7 +47,10 @@ public:
         NamedType,
         Void,
         TemplatedType,
-        Pointer
+        Pointer,
+        Vector,
+        Array,
+        IntegerArg
     };
 
     TypeKind kind(void) const { return _kind; }
@@ -71,14 +74,14 @@ private:
  */
 class NamedType: public Type {
 public:
-    const std::string& name(void) const { return _name; }
-    NamedType(const std::string &name, SourcePos pos)
+    Symbol name(void) const { return _name; }
+    NamedType(Symbol name, SourcePos pos)
         : Type(TypeKind::NamedType, pos), _name(name) {}
 
     TYPE_CLASS(NamedType);
 
 private:
-    std::string _name;
+    Symbol _name;
 };
 
 /**
@@ -95,11 +98,11 @@ public:
  */
 class TemplatedType: public Type {
 public:
-    const std::string &name(void) const { return _name; }
+    Symbol name(void) const { return _name; }
     const std::vector<std::unique_ptr<Type>> &args(void) const {
         return _args;
     }
-    TemplatedType(const std::string &name,
+    TemplatedType(Symbol name,
                   std::vector<std::unique_ptr<Type>> &&args,
                   SourcePos pos)
         : Type(TypeKind::TemplatedType, pos),
@@ -107,23 +110,95 @@ public:
           _args(std::move(args)) {}
     TYPE_CLASS(TemplatedType);
 private:
-    std::string _name;
+    Symbol _name;
     std::vector<std::unique_ptr<Type>> _args;
 };
 
 /**
- * @brief A pointer type.
+ * @brief A pointer type, possibly `restrict`-qualified.
  */
 class Pointer: public Type {
 public:
     const Type &pointed(void) const { return *_pointed; }
+    bool restrict(void) const { return _restrict; }
 
-    Pointer(std::unique_ptr<Type> pointed, SourcePos pos)
-        : Type(TypeKind::Pointer, pos), _pointed(std::move(pointed)) {}
+    Pointer(std::unique_ptr<Type> pointed, bool restrict, SourcePos pos)
+        : Type(TypeKind::Pointer, pos), _pointed(std::move(pointed)),
+          _restrict(restrict) {}
 
     TYPE_CLASS(Pointer);
 private:
     std::unique_ptr<Type> _pointed;
+    bool _restrict;
+};
+
+/**
+ * @brief A SIMD vector type, written `Vector<:Element, lanes:>`.
+ */
+class Vector: public Type {
+public:
+    const Type &element(void) const { return *_element; }
+    uint64_t lanes(void) const { return _lanes; }
+
+    Vector(std::unique_ptr<Type> element, uint64_t lanes, SourcePos pos)
+        : Type(TypeKind::Vector, pos),
+          _element(std::move(element)),
+          _lanes(lanes) {}
+
+    TYPE_CLASS(Vector);
+private:
+    std::unique_ptr<Type> _element;
+    uint64_t _lanes;
+};
+
+/**
+ * @brief An integer in place of a type: an array's length, or a template
+ *        argument for an integer parameter.
+ *
+ * Written as a literal, or as the name of a constant or of an integer
+ * template parameter.
+ */
+class IntegerArg: public Type {
+public:
+    /** @brief Whether this is a literal, rather than a name. */
+    bool is_literal(void) const { return _name == Symbol(); }
+
+    /** @brief The literal's value. */
+    uint64_t value(void) const { return _value; }
+
+    /** @brief The name, if not a literal. */
+    Symbol name(void) const { return _name; }
+
+    IntegerArg(uint64_t value, SourcePos pos)
+        : Type(TypeKind::IntegerArg, pos), _value(value) {}
+
+    IntegerArg(Symbol name, SourcePos pos)
+        : Type(TypeKind::IntegerArg, pos), _value(0), _name(name) {}
+
+    TYPE_CLASS(IntegerArg);
+private:
+    uint64_t _value;
+    Symbol _name;
+};
+
+/**
+ * @brief A fixed-length array type, written `Array<:Element, length:>`.
+ */
+class Array: public Type {
+public:
+    const Type &element(void) const { return *_element; }
+    const AST::IntegerArg &length(void) const { return *_length; }
+
+    Array(std::unique_ptr<Type> element,
+          std::unique_ptr<AST::IntegerArg> length, SourcePos pos)
+        : Type(TypeKind::Array, pos),
+          _element(std::move(element)),
+          _length(std::move(length)) {}
+
+    TYPE_CLASS(Array);
+private:
+    std::unique_ptr<Type> _element;
+    std::unique_ptr<AST::IntegerArg> _length;
 };
 
 #undef TYPE_CLASS
@@ -146,6 +221,9 @@ public:
             HANDLE(Void);
             HANDLE(TemplatedType);
             HANDLE(Pointer);
+            HANDLE(Vector);
+            HANDLE(Array);
+            HANDLE(IntegerArg);
 #undef HANDLE
         }
     }
@@ -155,6 +233,9 @@ private:
     virtual Result operator()(const Void &) = 0;
     virtual Result operator()(const TemplatedType &) = 0;
     virtual Result operator()(const Pointer &) = 0;
+    virtual Result operator()(const Vector &) = 0;
+    virtual Result operator()(const Array &) = 0;
+    virtual Result operator()(const IntegerArg &) = 0;
 };
 
 /**
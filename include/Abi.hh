@@ -0,0 +1,171 @@
+/**
+ * @file Abi.hh
+ *
+ * @brief Lowering function signatures to the target's calling convention.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+
+#include "Type.hh"
+
+namespace Craeft {
+
+/**
+ * @brief How one argument or result of a function is passed.
+ */
+struct AbiValue {
+    enum Kind {
+        /**
+         * @brief As its LLVM type, which the backend already passes as C
+         *        would.
+         */
+        Direct,
+
+        /**
+         * @brief Reinterpreted as `parts`, laid out as in an LLVM struct of
+         *        them.  Each part of an argument is its own parameter; the
+         *        parts of a result are returned together.
+         */
+        Coerced,
+
+        /**
+         * @brief In memory: an argument by a pointer to a copy, a result by
+         *        a pointer (`sret`) to where the caller wants it.
+         */
+        Indirect
+    };
+
+    Kind kind = Direct;
+
+    /** @brief The types a `Coerced` value is passed as. */
+    std::vector<llvm::Type *> parts;
+
+    /**
+     * @brief For an `Indirect` argument, whether the pointer is `byval`, so
+     *        the copy is made in the argument area rather than by the
+     *        caller.
+     */
+    bool byval = false;
+
+    /** @brief The alignment of an `Indirect` value's memory. */
+    unsigned align = 0;
+};
+
+/**
+ * @brief A function signature as the target's C calling convention passes
+ *        it.
+ */
+struct FunctionAbi {
+    /** @brief The LLVM type of the function. */
+    llvm::FunctionType *type;
+
+    AbiValue result;
+
+    std::vector<AbiValue> args;
+
+    /**
+     * @brief The index of each argument's first LLVM parameter.  An
+     *        `Indirect` result takes the first parameter of all.
+     */
+    std::vector<unsigned> params;
+};
+
+/**
+ * @brief Works out how functions pass structs and arrays, so they can be
+ *        called from C and call it.
+ *
+ * LLVM passes first-class aggregates however is convenient for it, which is
+ * neither what C compilers do nor cheap for big ones.  Where the target is
+ * known, signatures are rewritten as Clang would: big aggregates by pointer,
+ * small ones in the registers C puts them in.  Elsewhere functions keep
+ * their plain LLVM types.
+ *
+ * Known are x86-64 (System V and Windows) and AArch64.
+ */
+class AbiLowering {
+public:
+    AbiLowering(llvm::Module &module, LlvmTypeCache &types);
+
+    /**
+     * @brief Get the lowering of a function type.  The reference stays
+     *        valid as long as this object.
+     */
+    const FunctionAbi &get(const Function<> &f);
+
+private:
+    enum class Convention { None, SysV, Win64, AArch64 };
+
+    FunctionAbi lower(const Function<> &f);
+
+    /**
+     * @brief Registers left for arguments, on targets which pass an
+     *        aggregate in memory once it no longer fits.
+     */
+    struct Registers {
+        unsigned integer;
+        unsigned sse;
+    };
+
+    AbiValue sysv(const Type &t, bool result, Registers &left);
+    AbiValue win64(const Type &t, bool result);
+    AbiValue aarch64(const Type &t, bool result);
+
+    /**
+     * @brief Pass a value by pointer, as an argument (`byval` if so) or as
+     *        the result.
+     */
+    AbiValue indirect(const Type &t, bool byval, unsigned min_align=1);
+
+    /**
+     * @brief A scalar in an aggregate, by its offset in it.
+     */
+    struct Leaf {
+        uint64_t offset;
+        llvm::Type *type;
+    };
+
+    /**
+     * @brief Find the scalars of a type, at `offset` into an outer one.
+     *
+     * @return Whether every scalar is aligned, as C assumes.
+     */
+    bool leaves(const Type &t, uint64_t offset, std::vector<Leaf> &out);
+
+    uint64_t size_of(const Type &t);
+
+    llvm::Module &module;
+    LlvmTypeCache &types;
+
+    std::unordered_map<Type, FunctionAbi> cache;
+};
+
+/**
+ * @brief Get whether a type is a struct or array.
+ */
+bool is_aggregate(const Type &t);
+
+}
@@ -71,6 +71,10 @@ public:
     /**
      * @brief Add a conditional jump to the provided blocks.
      *
+     * If the condition is the result of `likely` or `unlikely` (an
+     * `llvm.expect`), the jump branches on the value expected and is weighted
+     * towards the expected side.
+     *
      * This is a terminating instruction.
      */
     void cond_jump(Value cond, Block then_b, Block else_b);
@@ -0,0 +1,139 @@
+/**
+ * @file Codegen/Cache.hh
+ *
+ * @brief An on-disk cache of generated code, for incremental compilation.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Parser.hh"
+#include "Target.hh"
+#include "Translator.hh"
+
+namespace Craeft {
+
+namespace Codegen {
+
+/**
+ * @brief A directory of the optimized bitcode for individual function
+ *        definitions and template instantiations.
+ *
+ * Entries are keyed by a hash of everything that goes into their code: the
+ * compiler, the target, the optimization level and arithmetic options, the
+ * interfaces of every top-level node in the module (struct layouts, function
+ * signatures and templates) and, for function definitions, the tokens of the
+ * definition itself.  So changing a function's body only invalidates that function,
+ * while changing a declaration invalidates the whole module.
+ *
+ * The cache is safe to share between concurrent compilations: entries are
+ * written to temporary files and renamed into place.
+ */
+class BuildCache {
+public:
+    /**
+     * @param dir The cache directory.  Created if it does not exist.
+     * @param compiler Identifies the compiler build, so that upgrading it
+     *                 invalidates the cache.
+     * @param target The (resolved) target being compiled for.
+     * @param opt_level As for `ModuleGen::optimize`.
+     * @param size_level As for `ModuleGen::optimize`.
+     * @param thin_lto As for `ModuleGen::optimize`.
+     * @param profile Identifies the profile the code is optimized with, if
+     *                any.
+     * @param fast_math The module's fast-math flags.
+     * @param wrapping_overflow Whether signed arithmetic wraps around.
+     */
+    BuildCache(std::string dir, const std::string &compiler,
+               const TargetSpec &target, int opt_level, int size_level,
+               bool thin_lto=false, const std::string &profile="",
+               const FastMath &fast_math=FastMath(),
+               bool wrapping_overflow=false);
+
+    /**
+     * @brief Set the fingerprints of the module's top-level nodes, in source
+     *        order.  Must be called before getting any keys.
+     */
+    void set_toplevels(const std::vector<ToplevelFingerprint> &toplevels);
+
+    /**
+     * @brief Get the key for the function defined by the given top-level
+     *        node.
+     *
+     * @param idx The index of the node in the list given to
+     *            `set_toplevels`.
+     */
+    std::string function_key(size_t idx) const;
+
+    /**
+     * @brief Get the key for the template instantiation with the given
+     *        mangled name.
+     */
+    std::string instance_key(const std::string &mangled) const;
+
+    /**
+     * @brief Check whether there is an entry for the given key.
+     */
+    bool contains(const std::string &key) const;
+
+    /**
+     * @brief Read the entry for the given key.
+     *
+     * @return Whether there was one.
+     */
+    bool load(const std::string &key, std::string &bitcode) const;
+
+    /**
+     * @brief Write the entry for the given key.
+     *
+     * Failing to write is not an error; the entry is just not cached.
+     */
+    void store(const std::string &key, const std::string &bitcode) const;
+
+private:
+    std::string path(const std::string &key) const;
+
+    /**
+     * @brief Get the key for an entry, given what distinguishes it from the
+     *        other entries for this module.
+     */
+    std::string key(const std::string &kind, llvm::ArrayRef<uint8_t>) const;
+
+    std::string dir;
+
+    /**
+     * @brief The compiler, target and optimization level.
+     */
+    std::string config;
+
+    /**
+     * @brief A digest of everything every entry for this module depends on.
+     */
+    Fingerprint context;
+
+    std::vector<ToplevelFingerprint> toplevels;
+};
+
+}
+
+}
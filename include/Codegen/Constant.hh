@@ -0,0 +1,127 @@
+/**
+ * @file Codegen/Constant.hh
+ *
+ * @brief Evaluating AST expressions at compile time.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "AST/Expressions.hh"
+#include "AST/Toplevel.hh"
+#include "Scope.hh"
+#include "Translator.hh"
+#include "Value.hh"
+
+namespace Craeft {
+
+namespace Codegen {
+
+/**
+ * @brief Get whether a value is a compile-time constant: an integer or
+ *        floating-point constant.
+ */
+bool is_constant(const Value &val);
+
+/**
+ * @brief Evaluation of expressions at compile time.
+ *
+ * Only literals, constants, arithmetic, comparisons, casts and calls to
+ * `const fn`s may be evaluated; anything else raises an Error.  The
+ * Translator's operators do the arithmetic, so constants are typed exactly as
+ * the same expressions would be at run time; given constant operands, the IR
+ * builder folds them rather than emitting instructions.
+ */
+class ConstantGen: public AST::ExpressionVisitor<Value> {
+public:
+    ConstantGen(Translator &translator)
+        : ConstantGen(translator, _own_steps, 0) {}
+
+    /**
+     * @brief Evaluate a call to a `const fn`.
+     *
+     * The body may declare and assign variables, and use `if`, loops and
+     * `return`, but everything it evaluates must be constant.
+     */
+    Value call(const AST::FunctionDefinition &fd,
+               const std::vector<Value> &args, SourcePos pos);
+
+private:
+    friend class ConstantStatementGen;
+
+    ConstantGen(Translator &translator, size_t &steps, unsigned depth)
+        : _translator(translator), _own_steps(0), _steps(steps),
+          _depth(depth) {}
+
+    Value operator()(const AST::IntLiteral &) override;
+    Value operator()(const AST::UIntLiteral &) override;
+    Value operator()(const AST::FloatLiteral &) override;
+    Value operator()(const AST::StringLiteral &) override;
+    Value operator()(const AST::Variable &) override;
+    Value operator()(const AST::Reference &) override;
+    Value operator()(const AST::Dereference &) override;
+    Value operator()(const AST::FieldAccess &) override;
+    Value operator()(const AST::Index &) override;
+    Value operator()(const AST::Binop &) override;
+    Value operator()(const AST::FunctionCall &) override;
+    Value operator()(const AST::TemplateFunctionCall &) override;
+    Value operator()(const AST::Cast &) override;
+
+    /** @brief A variable of the `const fn` being evaluated. */
+    struct Local {
+        Type type;
+        /** @brief None until the variable is first assigned. */
+        boost::optional<Value> value;
+    };
+
+    void push_scope(void);
+    void pop_scope(void);
+    void declare(Symbol name, const Type &t);
+    void assign(Symbol name, Value val, SourcePos pos);
+
+    /**
+     * @brief Count a statement against the limit on how much work
+     *        evaluation may do.
+     */
+    void step(SourcePos pos);
+
+    Translator &_translator;
+
+    /** @brief The locals in scope, as indices into `_locals`. */
+    Scope<size_t> _names;
+    std::vector<Local> _locals;
+    /** @brief The size of `_locals` when each scope was entered. */
+    std::vector<size_t> _marks;
+
+    size_t _own_steps;
+    /** @brief Statements executed so far, across all nested calls. */
+    size_t &_steps;
+    /** @brief The number of `const fn` calls this one is nested in. */
+    unsigned _depth;
+};
+
+}
+
+}
@@ -24,9 +24,10 @@
 
 #pragma once
 
-#include "llvm/Support/Host.h"
-
 #include "AST/Toplevel.hh"
+#include "Codegen/Cache.hh"
+#include "Target.hh"
+#include "Translator.hh"
 
 namespace Craeft {
 
@@ -39,8 +40,12 @@ class ModuleGenImpl;
  */
 class ModuleGen {
 public:
-    ModuleGen(std::string name, std::string filename,
-                  std::string triple=llvm::sys::getDefaultTargetTriple());
+    /**
+     * @param sources The table of the compilation's source files.  Must
+     *                outlive the code generator.
+     */
+    ModuleGen(std::string name, std::string filename, SourceManager &sources,
+              TargetSpec target=TargetSpec());
 
     // You need explicitly declared destructors for PImpl classes...
     ~ModuleGen();
@@ -50,6 +55,32 @@ public:
      */
     void codegen(const AST::Toplevel &);
 
+    /**
+     * @brief Generate code for a whole module, generating and optimizing
+     *        function bodies on several threads.
+     *
+     * Each thread works on its own LLVM context, declaring everything in the
+     * module but only generating bodies for its share of the function
+     * definitions.  The results are then linked into this module.  Since the
+     * bodies are simplified as they are generated, and the whole module is
+     * optimized after linking, so there is no need to call `optimize`
+     * afterwards.
+     *
+     * @param nodes Every top-level node in the module, in source order.
+     * @param nthreads The number of threads to use.
+     * @param opt_level As for `optimize`.
+     * @param size_level As for `optimize`.
+     * @param cache If not null, reuse the code for function definitions and
+     *              template instantiations cached there, and cache the code
+     *              for any which have to be generated.
+     * @param thin_lto As for `optimize`.
+     *
+     * @throws Error The first error in the module, in source order.
+     */
+    void codegen_parallel(const std::vector<const AST::Toplevel *> &nodes,
+                          int nthreads, int opt_level, int size_level=0,
+                          BuildCache *cache=nullptr, bool thin_lto=false);
+
     /**
      * @brief Emit LLVM IR to the given output stream.
      */
@@ -71,6 +102,22 @@ public:
      */
     void emit_asm(int fd);
 
+    /**
+     * @brief Emit LLVM bitcode, with the summary ThinLTO needs to import
+     *        functions from it into other modules.
+     *
+     * @param fd A file descriptor to an open, writable file.  Will not be
+     *           closed upon completion.
+     */
+    void emit_bc(int fd);
+
+    /**
+     * @brief Emit several artifacts at once, running the backend only once;
+     *        see `Translator::emit`.
+     */
+    void emit(const std::vector<Artifact> &artifacts,
+              const ArtifactSink &sink);
+
     /**
      * @brief Verify the generated module.
      *
@@ -78,13 +125,109 @@ public:
      */
     void validate(std::ostream &out);
 
+    /**
+     * @brief Instrument or annotate the module with a profile when it is
+     *        optimized (see `Translator::set_profile`).
+     *
+     * Must be called before generating any code.  With a profile, `optimize`
+     * must be called even at -O0.
+     */
+    void set_profile(const ProfileOptions &profile);
+
+    /**
+     * @brief Generate debug information (see `Translator::set_debug_level`).
+     *
+     * Must be called before generating any code.
+     */
+    void set_debug_level(DebugLevel level);
+
+    /**
+     * @brief Relax floating-point arithmetic (see
+     *        `Translator::set_fast_math`).  Functions annotated `@fastmath`
+     *        or `@nofastmath` choose for themselves.
+     *
+     * Must be called before generating any code.
+     */
+    void set_fast_math(const FastMath &flags);
+
+    /**
+     * @brief Make signed arithmetic wrap around on overflow (see
+     *        `Translator::set_wrapping_overflow`).
+     *
+     * Must be called before generating any code.
+     */
+    void set_wrapping_overflow(void);
+
+    /**
+     * @brief Record optimization remarks, to be emitted as
+     *        `Artifact::Remarks` (see `Translator::set_remarks`).
+     *
+     * Must be called before generating any code.
+     */
+    void set_remarks(const std::string &passes);
+
+    /**
+     * @brief Emit machine code as quickly as possible (see
+     *        `Translator::set_fast_backend`).
+     */
+    void set_fast_backend(void);
+
+    /**
+     * @brief Split the backend across threads (see
+     *        `Translator::set_backend_threads`).
+     */
+    void set_backend_threads(unsigned n);
+
+    /**
+     * @brief Record the interface of the module as code is generated for
+     *        it, for `Artifact::Interface`.  Must be called before any code
+     *        is generated.
+     */
+    void record_interface(void);
+
     /**
      * @brief Optimize the module.
      *
-     * @param level The degree of optimization.  Currently 0 is no
-     *              optimization, and >=1 is all optimizations.
+     * -O1 runs a short list of cheap function passes; -O2 and up run LLVM's
+     * standard pipelines, including inlining, vectorization and whole-module
+     * optimizations.
+     *
+     * @param level The degree of optimization, from 0 (none) to 3.
+     * @param size_level 0 to optimize for speed, 1 to prefer smaller code
+     *                   (as for `-Os`), 2 to minimize code size (`-Oz`).
+     * @param thin_lto Whether the module will be optimized again by ThinLTO
+     *                 at link time, in which case only the passes worth
+     *                 running before importing functions from other
+     *                 modules are run.
+     */
+    void optimize(int level, int size_level=0, bool thin_lto=false);
+
+    /**
+     * @brief Count the functions and instructions generated so far.
+     */
+    ModuleCounts counts(void);
+
+    /**
+     * @brief Just-in-time compile the module and call a function in it.
+     *
+     * Functions are compiled the first time they are called, so those which
+     * never are are never compiled.  Symbols the module doesn't define (e.g.
+     * from the C library) are looked up in the compiler's own process.
+     * Consumes the module, so this must be the last thing done with it.
+     *
+     * @param entry The name of the function to call.  It must take no
+     *              arguments, or an `I32` count and a `U8 **` array of
+     *              arguments (as C's `main` does), and return an integer or
+     *              nothing.
+     * @param args The arguments to pass; the first is conventionally the
+     *             program name.
+     *
+     * @return What the function returned, or 0 if it returns nothing.
+     *
+     * @throws Error If there is no suitable entry function or the module
+     *               can't be compiled.
      */
-    void optimize(int level);
+    int run(const std::string &entry, const std::vector<std::string> &args);
 
 private:
     std::unique_ptr<ModuleGenImpl> pimpl;
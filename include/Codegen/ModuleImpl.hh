@@ -25,6 +25,7 @@
 #pragma once
 
 #include <memory>
+#include <set>
 
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/Function.h"
@@ -36,7 +37,9 @@
 #include "llvm/Target/TargetMachine.h"
 
 #include "AST/Toplevel.hh"
+#include "Codegen/Cache.hh"
 #include "Environment.hh"
+#include "Interface.hh"
 #include "Translator.hh"
 
 namespace Craeft {
@@ -50,13 +53,49 @@ namespace Codegen {
  */
 class ModuleGenImpl: public AST::ToplevelVisitor<void> {
 public:
-    ModuleGenImpl(std::string name, std::string triple, std::string fname);
+    ModuleGenImpl(std::string name, TargetSpec target, std::string fname,
+                  SourceManager &sources);
+
+    /**
+     * @brief Declare everything the given node defines, without generating
+     *        code for function bodies.
+     */
+    void declare(const AST::Toplevel &);
+
+    /**
+     * @param use_cached Whether to use what is already in the cache, or only
+     *                   to fill it.
+     */
+    void codegen_parallel(const std::vector<const AST::Toplevel *> &nodes,
+                          int nthreads, int opt_level, int size_level,
+                          BuildCache *cache, bool thin_lto,
+                          bool use_cached=true);
+
     void validate(std::ostream &);
-    void optimize(int opt_level);
+    void set_profile(const ProfileOptions &profile);
+    void set_debug_level(DebugLevel level);
+    void set_fast_math(const FastMath &flags);
+    void set_wrapping_overflow(void);
+    void set_remarks(const std::string &passes);
+    void set_fast_backend(void);
+    void set_backend_threads(unsigned n);
+    void record_interface(void);
+
+    /**
+     * @brief Add what the given node declares to the module's interface, if
+     *        it is being recorded.
+     */
+    void record(const AST::Toplevel &);
+    void optimize(int opt_level, int size_level, bool thin_lto);
+    ModuleCounts counts(void);
+    int run(const std::string &entry, const std::vector<std::string> &args);
 
     void emit_ir(std::ostream &);
     void emit_obj(int fd);
     void emit_asm(int fd);
+    void emit_bc(int fd);
+    void emit(const std::vector<Artifact> &artifacts,
+              const ArtifactSink &sink);
 
     std::vector< std::pair< std::vector<Type>, TemplateValue> >
          codegen_function_with_name(
@@ -71,10 +110,84 @@ private:
     void operator()(const AST::FunctionDeclaration &) override;
     void operator()(const AST::FunctionDefinition &) override;
     void operator()(const AST::TemplateFunctionDefinition &) override;
+    void operator()(const AST::ConstDefinition &) override;
+    void operator()(const AST::ConstFunctionDefinition &) override;
+    void operator()(const AST::GlobalDefinition &) override;
+    void operator()(const AST::Import &) override;
+
+    std::string _name;
+    TargetSpec _target;
+    std::string _fname;
+    SourceManager &_sources;
 
     Translator _translator;
 
+    ProfileOptions _profile;
+
+    DebugLevel _debug_level = DebugLevel::None;
+
+    FastMath _fast_math;
+    bool _wrapping_overflow = false;
+
+    bool _remarks_enabled = false;
+    std::string _remarks_passes;
+
+    bool _fast_backend = false;
+    unsigned _backend_threads = 1;
+
+    /**
+     * @brief Remarks recorded by the threads of `codegen_parallel`, which
+     *        are emitted along with the module's own.
+     */
+    std::string _remarks;
+
+    /**
+     * @brief The mangled names of the template instantiations generated so
+     *        far.
+     */
+    std::vector<std::string> _instances;
+
+    /** @brief The names of the `@private` functions defined so far. */
+    std::vector<std::string> _private;
+
+    /** @brief The module's interface, if it is being recorded. */
+    std::unique_ptr<InterfaceWriter> _interface;
+
+    /**
+     * @brief The interfaces imported so far, directly or by other
+     *        interfaces, in the order they are searched.
+     */
+    std::vector<std::unique_ptr<Interface> > _interfaces;
+    std::set<std::string> _interface_paths;
+
+    /**
+     * @brief Whether each name has been looked for in the interfaces since
+     *        the last was imported, by symbol ID.
+     */
+    std::vector<bool> _resolved;
+
     /* Utilities. */
+
+    /**
+     * @brief Define the given global, or with `define` false only declare
+     *        it.
+     */
+    void global(const AST::GlobalDefinition &, bool define);
+
+    /**
+     * @brief Import an interface and the interfaces it imports, unless it
+     *        was already imported.
+     */
+    void import_interface(const std::string &path, SourcePos pos);
+
+    /**
+     * @brief Declare a name from the imported interfaces, the first time it
+     *        is looked up and not found.
+     *
+     * @return Whether it was declared.
+     */
+    bool resolve(Symbol name);
+
     Function<> type_of_ast_decl(const AST::FunctionDeclaration &fd);
 };
 
@@ -38,6 +38,12 @@ class StatementGen: public AST::StatementVisitor<void> {
 public:
     StatementGen(Translator &translator): _translator(translator) {}
 
+    /**
+     * @brief Generate code for a statement, attributing it to the
+     *        statement's position in the debug information.
+     */
+    void generate(const AST::Statement &stmt);
+
 private:
     // Visitors of different AST statement types.
     void operator()(const AST::ExpressionStatement &);
@@ -47,6 +53,8 @@ private:
     void operator()(const AST::Declaration &);
     void operator()(const AST::CompoundDeclaration &);
     void operator()(const AST::IfStatement &);
+    void operator()(const AST::WhileLoop &);
+    void operator()(const AST::ForLoop &);
 
     Translator &_translator;
 };
@@ -45,6 +45,9 @@ private:
     Type operator()(const AST::Void &) override;
     Type operator()(const AST::Pointer &) override;
     Type operator()(const AST::TemplatedType &) override;
+    Type operator()(const AST::Vector &) override;
+    Type operator()(const AST::Array &) override;
+    Type operator()(const AST::IntegerArg &) override;
 
     Translator &translator;
 };
@@ -54,7 +57,7 @@ private:
  */
 class TemplateTypeGen: public AST::TypeVisitor<TemplateType> {
 public:
-    TemplateTypeGen(Translator &translator, std::vector<std::string> args)
+    TemplateTypeGen(Translator &translator, std::vector<Symbol> args)
         : translator(translator), args(args) {}
 
     ~TemplateTypeGen(void) override {}
@@ -64,9 +67,12 @@ private:
     TemplateType operator()(const AST::Void &) override;
     TemplateType operator()(const AST::Pointer &) override;
     TemplateType operator()(const AST::TemplatedType &) override;
+    TemplateType operator()(const AST::Vector &) override;
+    TemplateType operator()(const AST::Array &) override;
+    TemplateType operator()(const AST::IntegerArg &) override;
 
     Translator &translator;
-    std::vector<std::string> args;
+    std::vector<Symbol> args;
 };
 
 }
@@ -47,10 +47,17 @@ private:
     Value operator()(const AST::Variable &) override;
     Value operator()(const AST::Dereference &) override;
     Value operator()(const AST::FieldAccess &) override;
+    Value operator()(const AST::Index &) override;
 
     Translator &_translator;
 };
 
+/**
+ * @brief Apply the binary operator `op` (other than `=`) to two values.
+ */
+Value apply_binop(Translator &translator, Tok::Op op,
+                  Value lhs, Value rhs, SourcePos pos);
+
 /**
  * @brief Codegen for r-values: return the value of the given AST r-value.
  */
@@ -68,6 +75,7 @@ private:
     Value operator()(const AST::Reference &) override;
     Value operator()(const AST::Dereference &) override;
     Value operator()(const AST::FieldAccess &) override;
+    Value operator()(const AST::Index &) override;
     Value operator()(const AST::Binop &) override;
     Value operator()(const AST::FunctionCall &) override;
     Value operator()(const AST::TemplateFunctionCall &) override;
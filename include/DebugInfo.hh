@@ -0,0 +1,152 @@
+/**
+ * @file DebugInfo.hh
+ *
+ * @brief Generating DWARF debug information for a module.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "Error.hh"
+#include "SourceManager.hh"
+#include "Symbol.hh"
+#include "Translator.hh"
+#include "Type.hh"
+
+namespace Craeft {
+
+/**
+ * @brief Debug information for one module: a compile unit for its source
+ *        file, with a subprogram for each function defined in it or in the
+ *        files it imports.
+ *
+ * Positions are attributed to the function being generated, without
+ * lexical blocks; nested scopes in Craeft don't outlive their function, so
+ * debuggers lose little by it.
+ */
+class DebugInfoGen {
+public:
+    /**
+     * @param fname The source file, or "-" for standard input.
+     * @param sources The table positions are resolved in.
+     */
+    DebugInfoGen(llvm::Module &module, LlvmTypeCache &types,
+                 DebugLevel level, const std::string &fname,
+                 SourceManager &sources);
+
+    /**
+     * @brief Describe a function and make it the scope of the locations
+     *        that follow.
+     */
+    void start_function(llvm::Function *f, const Function<> &type,
+                        SourcePos pos);
+
+    /**
+     * @brief Get the location of a position in the current function.
+     */
+    llvm::DebugLoc location(SourcePos pos);
+
+    /**
+     * @brief Describe a variable, or with `arg` nonzero the argument at that
+     *        position (from 1), stored at the given address.
+     *
+     * Only done for full debug information.
+     *
+     * @param loc Where the variable is declared, or null for the start of
+     *            the function.
+     */
+    void declare_variable(Symbol name, const Type &t, llvm::Value *addr,
+                          unsigned arg, llvm::DebugLoc loc);
+
+    /**
+     * @brief Describe a global variable defined in the module.
+     *
+     * Only done for full debug information.
+     */
+    void declare_global(Symbol name, const Type &t,
+                        llvm::GlobalVariable *global, SourcePos pos);
+
+    /**
+     * @brief Finish the current function.
+     *
+     * Instructions emitted without a location, such as block terminators
+     * and the prologue, are given the location of the code before them.
+     */
+    void end_function(void);
+
+    /**
+     * @brief Finish the debug information.  Must be done before the module
+     *        is verified or written; nothing may be added afterwards.
+     */
+    void finalize(void);
+
+private:
+    /**
+     * @brief Describe a type, for full debug information.
+     */
+    llvm::DIType *get_type(const Type &t);
+
+    llvm::DISubroutineType *get_function_type(const Function<> &t);
+
+    /**
+     * @brief Get the file a position is in: the compile unit's own, or one
+     *        it imports.
+     */
+    llvm::DIFile *get_file(SourcePos pos);
+
+    llvm::Module &module;
+    LlvmTypeCache &types;
+    DebugLevel level;
+    llvm::DIBuilder builder;
+    /** @brief The source file, as given to the constructor. */
+    std::string fname;
+    SourceManager &sources;
+    llvm::DIFile *file;
+    llvm::DICompileUnit *unit;
+
+    /** @brief The imported files described so far, by name. */
+    std::unordered_map<std::string, llvm::DIFile *> imports;
+
+    /** @brief The function being generated, if any. */
+    llvm::Function *function = nullptr;
+    llvm::DISubprogram *subprogram = nullptr;
+
+    std::unordered_map<Type, llvm::DIType *> type_cache;
+
+    bool finalized = false;
+};
+
+/**
+ * @brief Merge the compile units of modules generated separately for the
+ *        same file and linked together into the first, so that the file is
+ *        described once.
+ */
+void merge_compile_units(llvm::Module &module);
+
+}
@@ -0,0 +1,216 @@
+/**
+ * @file Driver.hh
+ *
+ * @brief Compiling source files to the requested outputs.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Codegen/Module.hh"
+#include "SourceManager.hh"
+#include "Target.hh"
+
+namespace Craeft {
+
+/**
+ * @brief How to compile each file.
+ */
+struct DriverOptions {
+    /** @brief The (resolved) target to generate code for. */
+    TargetSpec target;
+
+    /** @brief As for `ModuleGen::optimize`. */
+    int opt_level = 0;
+
+    /** @brief As for `ModuleGen::optimize`. */
+    int size_level = 0;
+
+    /**
+     * @brief The number of threads to use: on a single file, to generate its
+     *        function bodies; on several, to compile that many at once.
+     */
+    int jobs = 1;
+
+    /**
+     * @brief Whether the modules will be optimized again by ThinLTO at link
+     *        time (see `ModuleGen::optimize`).
+     */
+    bool thin_lto = false;
+
+    /** @brief The directory of the code cache, or empty for none. */
+    std::string cache_dir;
+
+    /** @brief Identifies the compiler build, for the cache. */
+    std::string compiler_id;
+
+    /**
+     * @brief Profile-guided optimization.  Nothing is cached while
+     *        instrumenting.
+     */
+    ProfileOptions profile;
+
+    /**
+     * @brief How much debug information to generate.  Nothing is cached
+     *        with any, since it records where each function is in the file.
+     */
+    DebugLevel debug_level = DebugLevel::None;
+
+    /**
+     * @brief The fast-math flags of functions which don't choose their own.
+     */
+    FastMath fast_math;
+
+    /**
+     * @brief Whether signed integer arithmetic wraps around on overflow,
+     *        rather than being assumed not to overflow.
+     */
+    bool wrapping_overflow = false;
+
+    /**
+     * @brief Whether to record optimization remarks, for the `remarks`
+     *        outputs.  Implies at least `DebugLevel::Locations`.
+     */
+    bool remarks = false;
+
+    /**
+     * @brief A regular expression matching the passes to record remarks
+     *        from, or empty for all.
+     */
+    std::string remarks_passes;
+
+    /**
+     * @brief Whether to record the modules' interfaces, for the `interface`
+     *        outputs.
+     */
+    bool interface = false;
+
+    /**
+     * @brief Where to look for imported files, after the directory of the
+     *        importing file.
+     */
+    std::vector<std::string> import_dirs;
+
+    /**
+     * @brief Whether to compile as quickly as possible: without verifying
+     *        the IR, and with the fastest backend.  Only for -O0.
+     */
+    bool fast_compile = false;
+
+    /**
+     * @brief Whether to also run the backend on `jobs` threads, on parts of
+     *        the module.
+     */
+    bool split_codegen = false;
+};
+
+/**
+ * @brief The files to write the code for one input to.  Empty paths are not
+ *        written.
+ */
+struct Outputs {
+    std::string obj;
+    std::string assembly;
+    std::string ir;
+    /** @brief Bitcode, with a ThinLTO summary. */
+    std::string bc;
+    /** @brief Optimization remarks, as YAML. */
+    std::string remarks;
+    /** @brief The interface, for other files to import (see Interface.hh). */
+    std::string interface;
+};
+
+/**
+ * @brief Compiles source files with fixed options.
+ *
+ * Each file is compiled into its own module, on its own LLVM context, so
+ * several files can be compiled at once.
+ */
+class Driver {
+public:
+    explicit Driver(DriverOptions options);
+
+    /**
+     * @brief Parse, generate code for and optimize a file.
+     *
+     * @param in_file The file to compile.
+     * @param sources The table to read the file and its imports into.  It
+     *                belongs to this compilation alone, and must outlive
+     *                the module, since its errors refer to it.
+     * @param jobs The number of threads to generate code on.
+     * @param diagnostics Stream to which to print errors.
+     *
+     * @return The optimized module, or null if there were errors.
+     */
+    std::unique_ptr<Codegen::ModuleGen> compile(const std::string &in_file,
+                                                SourceManager &sources,
+                                                int jobs,
+                                                std::ostream &diagnostics);
+
+    /**
+     * @brief Write a compiled module to the given outputs.
+     *
+     * @param sources The table the module was compiled with.
+     *
+     * @return Whether every output could be written.
+     */
+    bool emit(Codegen::ModuleGen &module, SourceManager &sources,
+              const Outputs &outputs, std::ostream &diagnostics);
+
+    /**
+     * @brief Compile each file and write it to the corresponding outputs.
+     *
+     * With more than one file, up to `jobs` files are compiled at once, each
+     * on a single thread.  Each file's diagnostics are collected, and printed
+     * in the order the files were given once all are done.  Every file is
+     * compiled even if some have errors.
+     *
+     * @return Whether every file compiled and was written successfully.
+     */
+    bool compile_all(const std::vector<std::string> &in_files,
+                     const std::vector<Outputs> &outputs,
+                     std::ostream &diagnostics);
+
+    /**
+     * @brief Run the ThinLTO backends on bitcode files, `jobs` at a time,
+     *        writing each one's object file (see `thin_link`).
+     *
+     * Only the `obj` outputs are written.
+     */
+    bool link_all(const std::vector<std::string> &in_files,
+                  const std::vector<Outputs> &outputs,
+                  std::ostream &diagnostics);
+
+private:
+    bool compile_one(const std::string &in_file, const Outputs &outputs,
+                     int jobs, std::ostream &diagnostics);
+
+    DriverOptions options;
+
+    /** @brief A digest of the profile in use, for the cache. */
+    std::string profile_id;
+};
+
+}
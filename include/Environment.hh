@@ -29,6 +29,7 @@
 #pragma once
 
 #include <cctype>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -42,6 +43,7 @@
 #include "Error.hh"
 #include "Type.hh"
 #include "Scope.hh"
+#include "Symbol.hh"
 #include "Value.hh"
 #include "VariantUtils.hh"
 
@@ -85,7 +87,7 @@ struct TemplateValue {
      * @brief Create a new `Variable` based on the given instruction.
      */
     TemplateValue(std::shared_ptr<AST::FunctionDefinition> ast,
-                  std::vector<std::string> arg_names,
+                  std::vector<Symbol> arg_names,
                   TemplateFunction ty)
           : fd(ast), ty(ty), arg_names(arg_names) {} 
 
@@ -98,7 +100,7 @@ struct TemplateValue {
 
     TemplateFunction ty;
 
-    std::vector<std::string> arg_names;
+    std::vector<Symbol> arg_names;
 };
 
 class Environment {
@@ -121,7 +123,14 @@ public:
     /**
      * @brief Get whether the given name is bound in any scope.
      */
-    bool bound(const std::string &name) const;
+    bool bound(Symbol name) const;
+
+    /**
+     * @brief Get whether the given name is bound to a function template.
+     */
+    bool template_func_bound(Symbol name) const {
+        return present(templatefunc_map, name);
+    }
 
     /**
      * @brief Find the given name in the map.
@@ -130,18 +139,31 @@ public:
      *
      * @param name Must be a valid identifier.
      */
-    Variable lookup_identifier(const std::string &name, SourcePos pos) const;
+    Variable lookup_identifier(Symbol name, SourcePos pos) const;
 
-    Variable add_identifier(std::string name, Value val);
+    Variable add_identifier(Symbol name, Value val);
 
-    void add_type(std::string name, Type t);
+    void add_type(Symbol name, Type t);
+
+    void add_template_type(Symbol name, TemplateStruct t) {
+        bind(template_map, name, t);
+    }
+
+    void add_template_func(Symbol name, TemplateValue v) {
+        bind(templatefunc_map, name, v);
+    }
 
-    void add_template_type(std::string name, TemplateStruct t) {
-        template_map.bind(name, t);
+    void add_const_func(Symbol name,
+                        std::shared_ptr<AST::FunctionDefinition> fd) {
+        bind(constfunc_map, name, fd);
     }
 
-    void add_template_func(std::string name, TemplateValue v) {
-        templatefunc_map.bind(name, v);
+    /**
+     * @brief Find the `const fn` of the given name, or null if there is none.
+     */
+    std::shared_ptr<AST::FunctionDefinition> lookup_const_func(
+            Symbol name) const {
+        return present(constfunc_map, name) ? constfunc_map[name] : nullptr;
     }
 
     /**
@@ -149,19 +171,70 @@ public:
      *
      * @param tname Must be a valid type name.
      */
-    const Type &lookup_type(const std::string &tname, SourcePos pos) const;
+    const Type &lookup_type(Symbol tname, SourcePos pos) const;
 
-    const TemplateStruct &lookup_template(const std::string &tname,
+    const TemplateStruct &lookup_template(Symbol tname,
                                           SourcePos pos) const;
 
-    const TemplateValue &lookup_template_func(const std::string &func_name,
+    const TemplateValue &lookup_template_func(Symbol func_name,
                                               SourcePos pos) const;
 
+    /**
+     * @brief Set the function called with names which are not bound, to
+     *        bind them if it can, before giving up on them.
+     *
+     * It returns whether it bound anything.  Whatever it binds goes in the
+     * outermost scope, as if it had been bound before the code looking it
+     * up, so the resolver is only asked about each name once.
+     */
+    void set_resolver(std::function<bool(Symbol)> resolver) {
+        this->resolver = std::move(resolver);
+    }
+
 private:
+    /**
+     * @brief Get whether the name is bound in the given map, asking the
+     *        resolver for it if not.
+     */
+    template<typename T>
+    bool present(const Scope<T> &map, Symbol name) const {
+        return map.present(name) || (resolve(name) && map.present(name));
+    }
+
+    /**
+     * @brief Bind a name in the given map: in the current scope, or in the
+     *        outermost if the resolver is binding it.
+     */
+    template<typename T>
+    void bind(Scope<T> &map, Symbol name, const T &value) {
+        if (resolving && map.depth() == resolving) {
+            map.bind_outermost(name, value);
+        } else {
+            map.bind(name, value);
+        }
+    }
+
+    /**
+     * @brief Ask the resolver to bind a name.
+     *
+     * @return Whether it bound anything.
+     */
+    bool resolve(Symbol name) const;
+
+    std::function<bool(Symbol)> resolver;
+
+    /**
+     * @brief The depth of the scopes the resolver was called at, while it
+     *        is running, or 0.  Scopes it pushes itself (say, to evaluate a
+     *        constant) are bound in as usual.
+     */
+    mutable size_t resolving = 0;
+
     Scope<Variable> ident_map;
     Scope<Type> type_map;
     Scope<TemplateStruct> template_map;
     Scope<TemplateValue> templatefunc_map;
+    Scope<std::shared_ptr<AST::FunctionDefinition> > constfunc_map;
 };
 
 }
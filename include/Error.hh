@@ -29,22 +29,27 @@
 
 namespace Craeft {
 
+class SourceManager;
+
 /**
  * @brief Represent a position in a source file.
  *
- * Must be small (32 bits) because it is used to annotate all AST nodes, and
- * they get passed around a lot.  Intended to allow for pretty and informative
- * error messages.
+ * Must be small (64 bits) because it is used to annotate all tokens and AST
+ * nodes, and they get passed around a lot.  The file name, line and column
+ * are only worked out when an error is emitted (see SourceManager.hh).
  */
 struct SourcePos {
-    uint16_t charno;
-    uint16_t lineno;
-    std::shared_ptr<std::string> fname;
+    /**
+     * @brief The file's index in the compilation's SourceManager, or 0 for
+     *        none.
+     */
+    uint32_t file;
+    /** @brief The offset from the start of the file, in bytes. */
+    uint32_t offset;
+
+    SourcePos(void): file(0), offset(0) {}
 
-    SourcePos(uint16_t charno,
-              uint16_t lineno,
-              std::shared_ptr<std::string> fname):
-        charno(charno), lineno(lineno), fname(fname) {}
+    SourcePos(uint32_t file, uint32_t offset): file(file), offset(offset) {}
 };
 
 /**
@@ -65,9 +70,10 @@ public:
     Error(std::string header, std::string message, SourcePos pos);
 
     /**
-     * @brief Print the error to the given stream.
+     * @brief Print the error to the given stream, resolving its position in
+     *        the table of the compilation it came from.
      */
-    void emit(std::ostream &);
+    void emit(std::ostream &, SourceManager &);
 private:
     std::string header;
     std::string msg;
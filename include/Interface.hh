@@ -0,0 +1,209 @@
+/**
+ * @file Interface.hh
+ *
+ * @brief Precompiled module interfaces: what other modules need to use one,
+ *        in a file they can `import` without parsing it.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "AST/Arena.hh"
+#include "AST/Toplevel.hh"
+#include "Error.hh"
+#include "Lexer.hh"
+#include "SourceManager.hh"
+#include "Symbol.hh"
+
+namespace Craeft {
+
+/**
+ * @brief The extension of interface files, by which `import` tells them
+ *        from source files.
+ */
+extern const char *const INTERFACE_EXTENSION;
+
+/**
+ * @brief Builds the interface of a module from its top-level nodes.
+ *
+ * The interface holds one entry for each name the module declares: structs,
+ * templates, constants and `const fn`s whole, functions by their signatures
+ * and globals as declarations.  `@private` functions are left out, as are
+ * later declarations of a name already in the interface.
+ *
+ * The file starts with a fixed-size header, then tables of the source files
+ * positions refer to and of the interfaces the module imports, then the
+ * entries sorted by name, so a name can be found by binary search in the
+ * mapped file.  Each entry's tree is stored as a stream of tags and LEB128
+ * numbers, with names as offsets into a shared string table at the end.
+ */
+class InterfaceWriter {
+public:
+    /**
+     * @param sources The table the added nodes' positions are in.
+     */
+    InterfaceWriter(SourceManager &sources);
+
+    /**
+     * @brief Add what a node declares, if anything.  Nodes must be added in
+     *        source order.
+     */
+    void add(const AST::Toplevel &);
+
+    /**
+     * @brief Get the contents of the interface file.
+     */
+    std::string finish(void) const;
+
+private:
+    void write_type(const AST::Type &);
+    void write_expression(const AST::Expression &);
+    void write_statement(const AST::Statement &);
+    void write_block(const std::vector<std::unique_ptr<AST::Statement> > &);
+    void write_annotations(const std::vector<AST::Annotation> &);
+    void write_signature(const AST::FunctionDeclaration &);
+    void write_struct(const AST::StructDeclaration &);
+
+    void write_number(uint64_t);
+    void write_signed(int64_t);
+    void write_string(const std::string &);
+    void write_symbol(Symbol);
+    void write_pos(SourcePos);
+
+    /**
+     * @brief Get the offset of a string in the string table, adding it if
+     *        it is not there yet.
+     */
+    uint32_t intern(const std::string &);
+
+    SourceManager &sources;
+
+    struct Entry {
+        uint32_t name;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    /** @brief The entries, in the order they were added. */
+    std::vector<Entry> entries;
+
+    /** @brief The names of the entries. */
+    std::set<Symbol> names;
+
+    /** @brief The trees of the entries, one after another. */
+    std::string data;
+
+    /** @brief The string table. */
+    std::string strings;
+    std::map<std::string, uint32_t> string_offsets;
+
+    /** @brief The string offsets of the source files, by interface index. */
+    std::vector<uint32_t> files;
+    /** @brief The interface index of each source file, by its own. */
+    std::map<uint32_t, uint32_t> file_indices;
+
+    /** @brief The string offsets of the imported interfaces' paths. */
+    std::vector<uint32_t> imports;
+};
+
+/**
+ * @brief An interface file, mapped into memory, from which entries are read
+ *        as they are asked for.
+ *
+ * Not safe to use from several threads at once; each code generator opens
+ * its own.
+ */
+class Interface {
+public:
+    /**
+     * @brief Open and check an interface file.
+     *
+     * @param pos Where it is imported, for errors.
+     * @param sources Where to add the source files its positions refer to.
+     *                Must outlive the interface.
+     *
+     * @throws Error If it can't be read or is not an interface file.
+     */
+    Interface(const std::string &path, SourcePos pos,
+              SourceManager &sources);
+
+    /**
+     * @brief Get the real paths of the interfaces the module imported.
+     */
+    std::vector<std::string> imports(void) const;
+
+    /**
+     * @brief Read the entry for a name.
+     *
+     * @return The node declaring it, or null if there is none or it was
+     *         already read.  The node lives as long as the interface.
+     */
+    const AST::Toplevel *load(Symbol name);
+
+    /**
+     * @brief Get a digest of the file and every interface it imports, for
+     *        the build cache.
+     */
+    Fingerprint fingerprint(void) const;
+
+private:
+    class Reader;
+
+    uint32_t read_u32(size_t offset) const;
+    llvm::StringRef string_at(uint32_t offset) const;
+
+    [[noreturn]] void corrupt(void) const;
+
+    std::string path;
+    SourcePos pos;
+    SourceManager &sources;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+    uint32_t nentries;
+    uint32_t nfiles;
+    uint32_t nimports;
+    size_t entries_start;
+    size_t data_start;
+    size_t strings_start;
+    size_t strings_end;
+
+    /** @brief Whether each entry has been read. */
+    std::vector<bool> loaded;
+
+    /**
+     * @brief The index in `sources` of each source file, or 0 if no
+     *        position in it has been read yet.
+     */
+    std::vector<uint32_t> file_ids;
+
+    std::shared_ptr<AST::Arena> arena;
+    std::vector<AST::ArenaPtr<AST::Toplevel> > nodes;
+};
+
+}
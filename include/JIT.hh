@@ -0,0 +1,56 @@
+/**
+ * @file JIT.hh
+ *
+ * @brief Running generated code in-process.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "Error.hh"
+#include "Target.hh"
+
+namespace Craeft {
+
+/**
+ * @brief Lazily just-in-time compile a module, and call a function in it.
+ *
+ * See `Codegen::ModuleGen::run`.
+ *
+ * @param module The module to run.
+ * @param context The context `module` lives in, which is handed to the JIT
+ *                along with it.
+ * @param target What the module was generated for; must be the host
+ *               architecture.
+ * @param pos Where to report errors.
+ */
+int run_jit(std::unique_ptr<llvm::Module> module,
+            std::unique_ptr<llvm::LLVMContext> context,
+            const TargetSpec &target, const std::string &entry,
+            const std::vector<std::string> &args, SourcePos pos);
+
+}
@@ -0,0 +1,58 @@
+/**
+ * @file LTO.hh
+ *
+ * @brief Optimizing bitcode modules together with ThinLTO.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Target.hh"
+
+namespace Craeft {
+
+/**
+ * @brief Run the ThinLTO backends on bitcode files with ThinLTO summaries,
+ *        writing an object file for each.
+ *
+ * Each module imports the functions worth inlining from the others, and is
+ * then optimized and compiled on its own, up to `jobs` at a time.  Since
+ * the objects may be linked with other code, nothing they define is
+ * internalized.
+ *
+ * @param in_files The bitcode files, e.g. from `ModuleGen::emit_bc` or
+ *                 `clang -flto=thin -c`.
+ * @param objects Where to write the object file for each input.
+ * @param target The (resolved) target to compile for.
+ * @param opt_level The optimization level, from 0 to 3.
+ * @param diagnostics Stream to which to print errors.
+ *
+ * @return Whether every object was written.
+ */
+bool thin_link(const std::vector<std::string> &in_files,
+               const std::vector<std::string> &objects,
+               const TargetSpec &target, int opt_level, int jobs,
+               std::ostream &diagnostics);
+
+}
@@ -24,24 +24,60 @@
 
 #pragma once
 
+#include <deque>
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <memory>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #include "Error.hh"
+#include "SourceManager.hh"
 #include "Token.hh"
 
 namespace Craeft {
 
+/**
+ * @brief A digest of a run of tokens.
+ */
+typedef llvm::MD5::MD5Result Fingerprint;
+
+/**
+ * @brief Lexer over a contiguous source buffer.
+ *
+ * Regular files are mapped (or, for small files, read) into memory in one go
+ * and scanned with pointer arithmetic.  Anything that can't be mapped--stdin
+ * (given as "-"), pipes, FIFOs--is read through a stream in large blocks, and
+ * each block is scanned the same way.
+ */
 class Lexer {
 public:
+    /**
+     * @brief Create a new lexer, tokenizing the given file.
+     *
+     * @param fname The name of the file to tokenize, or "-" for stdin.
+     * @param sources The table to add the file to.
+     */
+    Lexer(const std::string &fname, SourceManager &sources);
+
     /**
      * @brief Create a new lexer, tokenizing the given input stream.
      *
-     * @param fname The name of the file to tokenize.
+     * @param in The stream to read from.  Must outlive the lexer.
+     * @param fname The name to report in source positions.
+     * @param sources The table to add the input to.
+     */
+    Lexer(std::istream &in, const std::string &fname,
+          SourceManager &sources);
+
+    /**
+     * @brief Report the number of tokens lexed to the active time report.
      */
-    Lexer(const std::string &fname);
+    ~Lexer(void);
 
     /**
      * @brief Get the position the lexer is currently at.
@@ -53,6 +89,13 @@ public:
      */
     const Tok::Token &get_tok(void) const;
 
+    /**
+     * @brief Return the token after the last lexed token, without shifting.
+     *
+     * The token is only lexed once; a subsequent `shift` just moves to it.
+     */
+    const Tok::Token &peek(void);
+
     /**
      * @brief Return whether the lexer has reached the end of the stream.
      */
@@ -63,16 +106,192 @@ public:
      */
     void shift(void);
 
+    /**
+     * @brief Start a fingerprint of the tokens shifted past from here on,
+     *        starting with the current one.
+     */
+    void start_fingerprint(void);
+
+    /**
+     * @brief Get the fingerprint of the tokens shifted past since the last
+     *        `start_fingerprint`.
+     */
+    Fingerprint fingerprint(void) const;
+
 private:
-    char c;
+    /**
+     * @brief A token, along with the offset of its first character.
+     */
+    struct Lexeme {
+        Tok::Token tok;
+        uint32_t offset;
+        bool eof;
+    };
+
+    /**
+     * @brief Lex the next token from the input into the given slot.
+     */
+    void lex(Lexeme &out);
+
+    /**
+     * @brief The current character, or -1 at the end of the input.
+     */
+    int c;
+
+    /**
+     * @brief Advance to the next character.
+     */
     void get(void);
-    boost::variant<double, uint64_t> lex_number(void);
-    std::string lex_string(void);
 
-    bool eof;
-    std::unique_ptr<Tok::Token> tok;
-    SourcePos pos;
-    std::ifstream stream;
+    /**
+     * @brief Get the offset of the current character in the file.
+     */
+    uint32_t char_offset(void) const;
+
+    /**
+     * @brief Get the position of the current character.
+     */
+    SourcePos char_pos(void) const;
+
+    /**
+     * @brief Read the next block of a stream into the window.
+     *
+     * @return Whether any more input was available.  Always false in buffer
+     *         mode.
+     */
+    bool refill(void);
+
+    /**
+     * @brief Skip a run of whitespace, updating the position in bulk.
+     */
+    void skip_whitespace(void);
+
+    /**
+     * @brief Consume the identifier-like word beginning at the current
+     *        character.
+     *
+     * @return The text of the word.  Points into the source buffer where
+     *         possible, and into `scratch` where the word straddles stream
+     *         blocks; either way it is invalidated by the next call.
+     */
+    llvm::StringRef lex_word(void);
+
+    /**
+     * @brief Consume a run of decimal digits, accumulating their value.
+     */
+    uint64_t lex_digits(void);
+
+    /**
+     * @brief Lex a number into the given token.
+     */
+    void lex_number(Tok::Token &out);
+
+    /**
+     * @brief Consume a string literal, returning its raw contents.
+     *
+     * The current character should be the opening quote; on return it is the
+     * closing quote.
+     */
+    llvm::StringRef lex_string(void);
+
+    /** @brief The current token. */
+    Lexeme current;
+
+    /** @brief The lookahead token, valid if `has_next`. */
+    Lexeme next;
+    bool has_next;
+
+    SourceManager &sources;
+
+    /** @brief The file's index in `sources`. */
+    uint32_t file;
+
+    /**
+     * @brief The unconsumed part of the current window.
+     *
+     * In buffer mode the window is the whole file; in stream mode it is the
+     * most recently read block.
+     */
+    const char *cur;
+    const char *end;
+
+    /** @brief The start of the current window, and its offset in the file. */
+    const char *window;
+    size_t window_offset;
+
+    /**
+     * @brief The mapped file in buffer mode, otherwise null.  Shared with
+     *        `sources`, for printing errors.
+     */
+    std::shared_ptr<llvm::MemoryBuffer> buffer;
+
+    /** @brief The stream read from in stream mode, otherwise null. */
+    std::istream *stream;
+    std::unique_ptr<std::istream> owned_stream;
+    std::vector<char> block;
+
+    /** @brief The fingerprint being accumulated, if any. */
+    std::unique_ptr<llvm::MD5> digest;
+
+    /** @brief The number of tokens lexed so far. */
+    size_t ntokens = 0;
+
+    /** @brief Storage for words that straddle stream blocks. */
+    std::string scratch;
+
+    /**
+     * @brief Storage for the contents of string literals in stream mode,
+     *        which can't point into the (reused) blocks.
+     */
+    std::deque<std::string> literals;
+};
+
+/**
+ * @brief A stack of lexers, for files that pull in others with `import`.
+ *
+ * Tokens come from the file on top until it runs out, and then from the one
+ * that imported it, from just after the import.
+ */
+class LexerStack {
+public:
+    /**
+     * @brief Start with just the given file.
+     *
+     * @param sources The table to add each file to.  Must outlive the stack.
+     */
+    LexerStack(const std::string &fname, SourceManager &sources);
+
+    /**
+     * @brief Start lexing another file, before the rest of the current one.
+     */
+    void push(const std::string &fname);
+
+    /**
+     * @brief Go back to the importing file if the current one has run out.
+     *
+     * @return Whether there was such a file.
+     */
+    bool pop_finished(void);
+
+    /**
+     * @brief Get the name of the file currently being lexed.
+     */
+    const std::string &fname(void) const;
+
+    /* The rest are as for `Lexer`, on the current file. */
+
+    SourcePos get_pos(void) const;
+    const Tok::Token &get_tok(void) const;
+    const Tok::Token &peek(void);
+    bool at_eof() const;
+    void shift(void);
+    void start_fingerprint(void);
+    Fingerprint fingerprint(void) const;
+
+private:
+    SourceManager &sources;
+    std::vector<std::unique_ptr<Lexer> > lexers;
+    std::vector<std::string> fnames;
 };
 
 }
@@ -26,45 +26,83 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "AST/Arena.hh"
 #include "AST/Toplevel.hh"
+#include "Lexer.hh"
 
 namespace Craeft {
 
 class ParserImpl;
 
+/**
+ * @brief Fingerprints of the tokens a top-level node was parsed from.
+ */
+struct ToplevelFingerprint {
+    /** @brief Of the whole node. */
+    Fingerprint whole;
+
+    /**
+     * @brief Of what the node makes visible to the rest of the module: just
+     *        the signature of a function definition, and otherwise the whole
+     *        node.
+     */
+    Fingerprint interface;
+};
+
 class Parser {
 public:
     /**
      * @brief Create a new Parser, parsing from the given file.
      *
      * @param fname The filename to open and parse from.
+     * @param sources The table to add it and its imports to.  Must outlive
+     *                the parser.
+     * @param import_dirs Where to look for the files it imports, after its
+     *                    own directory.
      */
-    Parser(const std::string &fname);
+    Parser(const std::string &fname, SourceManager &sources,
+           const std::vector<std::string> &import_dirs = {});
 
     /* Explicitly declared because PImpl. */
     ~Parser();
 
     /**
      * @brief Parse the next expression from the stream.
+     *
+     * Each tree returned is allocated in its own arena, freed along with the
+     * tree.
      */
-    std::unique_ptr<AST::Expression> parse_expression(void);
+    AST::ArenaPtr<AST::Expression> parse_expression(void);
 
     /**
      * @brief Parse the next statement from the stream.
      */
-    std::unique_ptr<AST::Statement> parse_statement(void);
+    AST::ArenaPtr<AST::Statement> parse_statement(void);
 
     /**
      * @brief Parse the next top-level AST node from the stream.
      */
-    std::unique_ptr<AST::Toplevel> parse_toplevel(void);
+    AST::ArenaPtr<AST::Toplevel> parse_toplevel(void);
 
     /**
      * @brief Return whether the parser has reached the end of the stream.
      */
     bool at_eof(void);
 
+    /**
+     * @brief Start or stop fingerprinting top-level nodes as they are parsed.
+     */
+    void set_fingerprinting(bool enabled);
+
+    /**
+     * @brief Get the fingerprint of the last top-level node parsed.
+     *
+     * Only valid if fingerprinting was enabled while it was parsed.
+     */
+    const ToplevelFingerprint &last_fingerprint(void) const;
+
 private:
     std::unique_ptr<ParserImpl> pimpl;
 };
@@ -24,10 +24,15 @@
 
 #pragma once
 
-#include <map>
+#include <deque>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "AST/Toplevel.hh"
 #include "Lexer.hh"
+#include "Parser.hh"
 
 namespace Craeft {
 
@@ -38,7 +43,8 @@ namespace Craeft {
  */
 class ParserImpl {
 public:
-    ParserImpl(const std::string &fname);
+    ParserImpl(const std::string &fname, SourceManager &sources,
+               const std::vector<std::string> &import_dirs);
 
     /**
      * @brief Parse the next expression from the lexer.
@@ -52,7 +58,18 @@ public:
      */
     std::unique_ptr<AST::Statement> parse_statement(void);
     std::unique_ptr<AST::Toplevel> parse_toplevel(void);
-    bool at_eof(void) const;
+    bool at_eof(void);
+
+    /**
+     * @brief Whether to fingerprint top-level nodes.
+     */
+    bool fingerprinting = false;
+
+    /**
+     * @brief The fingerprint of the last top-level node parsed, if
+     *        `fingerprinting`.
+     */
+    ToplevelFingerprint fingerprint;
 
     /*************************************************************************
      * AST-handling utilities.
@@ -66,14 +83,21 @@ public:
 private:
     /**
      * @brief Parse a variable or a function call.
+     *
+     * @param awaited Whether the form follows `await`, and so must be a call.
      */
-    std::unique_ptr<AST::Expression> parse_variable(void);
+    std::unique_ptr<AST::Expression> parse_variable(bool awaited = false);
 
     /**
      * @brief Parse a unary operator invocation.
      */
     std::unique_ptr<AST::Expression> parse_unary(void);
 
+    /**
+     * @brief Parse an `await` of a function call.
+     */
+    std::unique_ptr<AST::Expression> parse_await(void);
+
     /**
      * @brief Parse a series of binops, given the first one.
      */
@@ -123,21 +147,101 @@ private:
     std::unique_ptr<AST::IfStatement> parse_if_statement(void);
 
     /**
-     * @brief Parse a return statement.
+     * @brief Parse a `while` or `for` loop, with any annotations.
+     */
+    std::unique_ptr<AST::Statement> parse_loop(void);
+
+    /**
+     * @brief Parse a series of annotations (`@name` or `@name(args)`).
+     */
+    std::vector<AST::Annotation> parse_annotations(void);
+
+    /**
+     * @brief Parse a return or become statement.
      */
     std::unique_ptr<AST::Statement> parse_return(void);
     
     std::unique_ptr<AST::TypeDeclaration> parse_type_declaration(void);
 
-    std::unique_ptr<AST::Toplevel> parse_struct_declaration(void);
+    /**
+     * @brief Parse a struct declaration, after any annotations on it.
+     */
+    std::unique_ptr<AST::Toplevel> parse_struct_declaration(
+            std::vector<AST::Annotation> annotations);
+
+    /**
+     * @brief Parse a function declaration or definition, after any
+     *        annotations on it.
+     */
+    std::unique_ptr<AST::Toplevel> parse_function(
+            std::vector<AST::Annotation> annotations, bool is_const = false,
+            bool is_async = false);
+
+    /**
+     * @brief Parse an `async fn` declaration or definition, after any
+     *        annotations on it.
+     */
+    std::unique_ptr<AST::Toplevel> parse_async(
+            std::vector<AST::Annotation> annotations);
 
-    std::unique_ptr<AST::Toplevel> parse_function(void);
+    /**
+     * @brief Parse a constant or `const fn` definition, after any
+     *        annotations on it.
+     */
+    std::unique_ptr<AST::Toplevel> parse_const(
+            std::vector<AST::Annotation> annotations);
+
+    /**
+     * @brief Parse a global variable definition, with any `thread_local`.
+     */
+    std::unique_ptr<AST::Toplevel> parse_global(void);
+
+    /**
+     * @brief Handle any `import`s at the current token, and move back to
+     *        the importing file at the end of an imported one.
+     *
+     * Imports are only allowed between top-level nodes.
+     */
+    void skip_imports(void);
+
+    /**
+     * @brief Parse an `import` and start lexing the file it names, or queue
+     *        it in `interfaces` if it is an interface, unless it was already
+     *        imported.
+     */
+    void parse_import(void);
+
+    /**
+     * @brief Find an imported file: relative to the importing file, then in
+     *        each of `import_dirs`, then in the standard library.
+     *
+     * @return The real path of the file.
+     */
+    std::string resolve_import(const std::string &name, SourcePos pos) const;
 
     std::vector<std::unique_ptr<AST::Expression>> parse_expr_list(void);
 
-    std::vector<std::unique_ptr<AST::Type>> parse_type_list(void);
+    /**
+     * @brief Parse the arguments of a template: types, and integers for
+     *        its integer parameters.
+     */
+    std::vector<std::unique_ptr<AST::Type>> parse_template_args(void);
 
-    std::vector<std::unique_ptr<AST::Declaration>> parse_declarations(void);
+    /**
+     * @brief Parse an integer in place of a type, if there is one: a
+     *        literal or a name.
+     *
+     * @return The integer, or null if the current token is neither.
+     */
+    std::unique_ptr<AST::IntegerArg> parse_integer_arg(void);
+
+    /**
+     * @brief Parse a block of struct members, each possibly annotated.
+     *
+     * @param annotations Filled with the annotations on each member.
+     */
+    std::vector<std::unique_ptr<AST::Declaration>> parse_declarations(
+            std::vector<std::vector<AST::Annotation>> &annotations);
 
     std::vector<std::unique_ptr<AST::Statement>> parse_block(void);
 
@@ -153,6 +257,7 @@ private:
      */
 
     inline void find_and_shift(const Tok::Token&, std::string at_place);
+    inline void find_and_shift(Tok::Kind, std::string at_place);
 
     inline bool at_open_generic(void);
     inline bool at_close_generic(void);
@@ -160,41 +265,24 @@ private:
     [[noreturn]] inline void _throw(std::string message);
 
     /**
-     * @brief The held lexer.
+     * @brief The held lexers: one for the file being parsed, and one for
+     *        each import being read.
      */
-    Lexer lexer;
+    LexerStack lexer;
 
-    /**
-     * @brief The map of operator precedences.
-     */
-    std::map<std::string, int> precedences {
-        {"=", 200},
-        {"||", 300},
-        {"&&", 400},
-        {"|", 500},
-        {"^", 600},
-        {"&", 700},
-        {"==", 800},
-        {"!=", 800},
-
-        {"<", 900},
-        {"<=", 900},
-        {">", 900},
-        {">=", 900},
+    SourceManager &sources;
 
-        {"<<", 1000},
-        {">>", 1000},
+    /** @brief Where to look for imported files. */
+    std::vector<std::string> import_dirs;
 
-        {"+", 1100},
-        {"-", 1100},
+    /** @brief The real paths of the files read so far. */
+    std::set<std::string> imported;
 
-        {"*", 1200},
-        {"/", 1200},
-        {"%", 1200},
-
-        {".", 1400},
-        {"->", 1400},
-    };
+    /**
+     * @brief The interfaces imported but not yet returned as `Import` nodes,
+     *        with where they were imported.
+     */
+    std::deque<std::pair<std::string, SourcePos> > interfaces;
 };
 
 }
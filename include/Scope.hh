@@ -1,7 +1,7 @@
 /**
  * @file Scope.hh
  *
- * Scopes, as maps (optimized for small sizes) which can be pushed and popped.
+ * Scopes, as maps keyed on interned symbols which can be pushed and popped.
  */
 
 /* Craeft: a new systems programming language.
@@ -24,7 +24,11 @@
 
 #pragma once
 
-#include <boost/range/adaptor/reversed.hpp>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Symbol.hh"
 
 namespace Craeft {
 
@@ -32,51 +36,130 @@ class KeyNotPresentException {};
 
 class EmptyPopException {};
 
+/**
+ * @brief A stack of nested scopes mapping symbols to bindings.
+ *
+ * Each symbol's innermost binding is found by indexing a table on the
+ * symbol's ID, so lookups cost the same however much is in scope.  Bindings
+ * are kept on a single stack, each remembering the binding it shadows;
+ * popping a scope unwinds just the bindings made in it.
+ *
+ * References returned by `operator[]` stay valid until the binding they
+ * refer to is popped.
+ */
 template<typename T>
 class Scope {
 public:
-    bool present(const std::string &key) const {
-        for (const auto &vec: boost::adaptors::reverse(map)) {
-            for (const auto &pair: vec) {
-                if (pair.first == key) {
-                    return true;
-                }
-            }
-        }
+    bool present(Symbol key) const {
+        return find(key) != nullptr;
+    }
 
-        return false;
+    /**
+     * @brief Get the number of scopes pushed.
+     */
+    size_t depth(void) const {
+        return marks.size();
     }
 
     void push(void) {
-        map.push_back(std::vector<std::pair<std::string, T> >());
+        marks.push_back(bindings.size());
     }
 
     void pop(void) {
-        if (map.size()) {
-            map.pop_back();
-        } else {
-            throw EmptyPopException();
+        if (!marks.size()) throw EmptyPopException();
+
+        while (bindings.size() > marks.back()) {
+            const auto &binding = bindings.back();
+            current[binding.key] = binding.shadowed;
+            bindings.pop_back();
         }
+
+        marks.pop_back();
     }
 
-    void bind(const std::string &key, const T &binding) {
-        map.back().push_back(std::pair<std::string, T>(key, binding));
+    void bind(Symbol key, const T &binding) {
+        uint32_t id = key.id();
+
+        if (id >= current.size()) current.resize(Symbol::count(), NONE);
+
+        bindings.push_back(Binding { binding, id, current[id] });
+        current[id] = bindings.size() - 1;
     }
 
-    const T &operator[](const std::string &key) const {
-        for (const auto &vec: boost::adaptors::reverse(map)) {
-            for (const auto &pair: boost::adaptors::reverse(vec)) {
-                if (pair.first == key) {
-                    return pair.second;
-                }
-            }
-        }
+    /**
+     * @brief Bind a symbol in the outermost scope, whatever scopes have been
+     *        pushed since.
+     *
+     * Such bindings are never popped, and are shadowed by any other binding
+     * of the symbol.
+     */
+    void bind_outermost(Symbol key, const T &binding) {
+        uint32_t id = key.id();
+
+        if (id >= outermost.size()) outermost.resize(Symbol::count(), NONE);
+
+        outermost_bindings.push_back(binding);
+        outermost[id] = outermost_bindings.size() - 1;
+    }
+
+    const T &operator[](Symbol key) const {
+        const T *result = find(key);
+
+        if (!result) throw KeyNotPresentException();
 
-        throw KeyNotPresentException();
+        return *result;
     }
 
 private:
-    std::vector< std::vector<std::pair<std::string, T> > >map;
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Binding {
+        T value;
+
+        /** @brief ID of the symbol bound. */
+        uint32_t key;
+
+        /** @brief Index of the binding this one shadows, or NONE. */
+        uint32_t shadowed;
+    };
+
+    /**
+     * @brief Get the binding of a symbol, or null if there is none.
+     */
+    const T *find(Symbol key) const {
+        uint32_t id = key.id();
+
+        if (id < current.size() && current[id] != NONE) {
+            return &bindings[current[id]].value;
+        }
+        if (id < outermost.size() && outermost[id] != NONE) {
+            return &outermost_bindings[outermost[id]];
+        }
+
+        return nullptr;
+    }
+
+    /** @brief Every live binding, innermost scope last.  A deque, so
+     *         references to bindings survive pushes. */
+    std::deque<Binding> bindings;
+
+    /** @brief Index of each symbol's innermost binding, by symbol ID. */
+    std::vector<uint32_t> current;
+
+    /** @brief Size of `bindings` when each scope was pushed. */
+    std::vector<size_t> marks;
+
+    /** @brief The bindings made with `bind_outermost`. */
+    std::deque<T> outermost_bindings;
+
+    /**
+     * @brief Index of each symbol's binding in `outermost_bindings`, by
+     *        symbol ID.
+     */
+    std::vector<uint32_t> outermost;
 };
 
+template<typename T>
+const uint32_t Scope<T>::NONE;
+
 }
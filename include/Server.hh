@@ -0,0 +1,54 @@
+/**
+ * @file Server.hh
+ *
+ * @brief A compile server, which saves each compile the cost of starting
+ *        up.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Craeft {
+
+/**
+ * @brief Handles one request: runs the compiler on the client's arguments
+ *        (without the program name), returning its exit status.
+ */
+using RequestHandler = std::function<int(const std::vector<std::string> &)>;
+
+/**
+ * @brief Serve compile requests from `craeftc-client` on a Unix socket,
+ *        until interrupted or terminated.
+ *
+ * The server starts up (loading the compiler and registering LLVM's
+ * targets) once, then forks a child for each request, which starts from
+ * there.  The child takes on the client's working directory, standard
+ * input, output and error, so that the request runs exactly as it would
+ * have in a process of its own, and requests run concurrently.
+ *
+ * @return An exit status, if the server could not start.
+ */
+int serve(const std::string &socket_path, const RequestHandler &handler);
+
+}
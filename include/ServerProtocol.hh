@@ -0,0 +1,64 @@
+/**
+ * @file ServerProtocol.hh
+ *
+ * @brief The messages between `craeftc --server` and `craeftc-client`.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Craeft {
+
+/**
+ * @brief Send a compile request over a connected Unix socket: the client's
+ *        working directory and arguments, along with its standard input,
+ *        output and error, which the compile uses as its own.
+ *
+ * @return Whether the request was sent.
+ */
+bool send_request(int sock, const std::string &cwd,
+                  const std::vector<std::string> &args);
+
+/**
+ * @brief Receive a request sent by `send_request`.
+ *
+ * @param fds Set to the client's standard input, output and error.
+ *
+ * @return Whether a whole request was received.
+ */
+bool receive_request(int sock, std::string &cwd,
+                     std::vector<std::string> &args, int fds[3]);
+
+/**
+ * @brief Send the exit status of a compile back to the client.
+ */
+bool send_status(int sock, int status);
+
+/**
+ * @brief Receive the exit status of a compile.
+ *
+ * @return Whether it was received; if not, the compile died.
+ */
+bool receive_status(int sock, int &status);
+
+}
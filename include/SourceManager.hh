@@ -0,0 +1,152 @@
+/**
+ * @file SourceManager.hh
+ *
+ * @brief The table of source files that `SourcePos`es refer to.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "Error.hh"
+
+namespace Craeft {
+
+/**
+ * @brief The source files read so far, for turning positions back into file
+ *        names, lines and columns.
+ *
+ * There is one table for each compilation, shared by everything that reads
+ * its files, so that positions from any of them can be resolved on whichever
+ * thread an error is emitted.  It must outlive the compilation's parser and
+ * code generator.  Files are only ever added, and the table is safe to use
+ * from several threads.
+ */
+class SourceManager {
+public:
+    /**
+     * @brief A position, resolved for printing.
+     */
+    struct Location {
+        /** @brief The file name, or empty for positions in no file. */
+        std::string fname;
+        /** @brief The line number, from 1. */
+        size_t lineno = 0;
+        /** @brief The column, in bytes from 1. */
+        size_t charno = 0;
+        /** @brief The text of the line, if the source is available. */
+        std::string line;
+        bool has_line = false;
+    };
+
+    SourceManager(void);
+
+    SourceManager(const SourceManager &) = delete;
+    SourceManager &operator=(const SourceManager &) = delete;
+
+    /**
+     * @brief Add a file whose contents are all in the given buffer.
+     *
+     * @return The file's index, for `SourcePos::file`.
+     */
+    uint32_t add_buffer(const std::string &fname,
+                        std::shared_ptr<llvm::MemoryBuffer> buffer);
+
+    /**
+     * @brief Add a file which is read a block at a time; its contents are
+     *        added with `append` as they are read.
+     *
+     * @return The file's index, for `SourcePos::file`.
+     */
+    uint32_t add_stream(const std::string &fname);
+
+    /**
+     * @brief Add the next block of a file added with `add_stream`.
+     */
+    void append(uint32_t file, llvm::StringRef text);
+
+    /**
+     * @brief Get the position of the start of the named file, for errors
+     *        about the file as a whole.
+     *
+     * Adds an empty file of that name if there is none yet.
+     */
+    SourcePos start_of(const std::string &fname);
+
+    /**
+     * @brief Work out the file, line and column of a position.
+     */
+    Location resolve(SourcePos pos);
+
+    /**
+     * @brief Work out just the line and column of a position, both from 1,
+     *        or 0 for positions in no file.
+     *
+     * Unlike `resolve`, this doesn't scan the file, so it is cheap enough to
+     * do for every statement (see `DebugInfoGen`).
+     */
+    std::pair<unsigned, unsigned> line_and_column(SourcePos pos);
+
+    /**
+     * @brief Get the name of the file a position is in, or empty for
+     *        positions in no file.
+     */
+    std::string file_name(SourcePos pos);
+
+private:
+    struct File {
+        std::string fname;
+        /** @brief The contents, if all read at once. */
+        std::shared_ptr<llvm::MemoryBuffer> buffer;
+        /** @brief The contents read so far otherwise. */
+        std::string streamed;
+        /**
+         * @brief The offset of the start of each line after the first, as
+         *        far as `indexed`.
+         */
+        std::vector<uint32_t> line_starts;
+        size_t indexed = 0;
+
+        llvm::StringRef text(void) const {
+            return buffer ? buffer->getBuffer() : llvm::StringRef(streamed);
+        }
+    };
+
+    /**
+     * @brief Find the line and column of an offset in a file, indexing its
+     *        lines as far as needed.
+     */
+    std::pair<unsigned, unsigned> locate(File &file, size_t offset);
+
+    std::mutex lock;
+    /** @brief Every file, by index.  Index 0 is no file. */
+    std::vector<std::unique_ptr<File> > files;
+};
+
+}
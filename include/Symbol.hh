@@ -0,0 +1,118 @@
+/**
+ * @file Symbol.hh
+ *
+ * @brief Interned names.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace Craeft {
+
+/**
+ * @brief A handle to an interned string.
+ *
+ * Every distinct string is stored exactly once, in a global table, so a
+ * Symbol is a single pointer: copying is free, and comparing two Symbols is a
+ * pointer comparison.  Each distinct string also gets a small, dense integer
+ * ID, suitable for indexing tables.
+ *
+ * Interning is thread-safe; entries are never freed.
+ */
+class Symbol {
+public:
+    /**
+     * @brief The interned empty string.
+     */
+    Symbol(void);
+
+    /**
+     * @brief Intern the given string.
+     */
+    Symbol(llvm::StringRef str);
+    Symbol(const std::string &str): Symbol(llvm::StringRef(str)) {}
+    Symbol(const char *str): Symbol(llvm::StringRef(str)) {}
+
+    /**
+     * @brief Get the interned string.
+     */
+    const std::string &str(void) const { return entry->str; }
+
+    /**
+     * @brief Get the dense ID of this symbol.
+     *
+     * IDs are assigned in order of interning, starting at 0.
+     */
+    uint32_t id(void) const { return entry->id; }
+
+    /**
+     * @brief Get the number of symbols interned so far.
+     *
+     * All IDs are less than this.
+     */
+    static uint32_t count(void);
+
+    bool operator==(const Symbol &other) const {
+        return entry == other.entry;
+    }
+
+    bool operator!=(const Symbol &other) const {
+        return entry != other.entry;
+    }
+
+    /**
+     * @brief Order by ID (i.e., by order of interning, not alphabetically).
+     */
+    bool operator<(const Symbol &other) const {
+        return id() < other.id();
+    }
+
+    struct Entry {
+        std::string str;
+        uint32_t id;
+    };
+
+private:
+    const Entry *entry;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const Symbol &sym) {
+    return out << sym.str();
+}
+
+}
+
+namespace std {
+
+template<>
+struct hash<Craeft::Symbol> {
+    size_t operator()(const Craeft::Symbol &sym) const {
+        return sym.id();
+    }
+};
+
+}
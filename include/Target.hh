@@ -0,0 +1,88 @@
+/**
+ * @file Target.hh
+ *
+ * @brief Selecting the machine to generate code for.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "llvm/Support/Host.h"
+
+namespace llvm {
+    class Target;
+}
+
+namespace Craeft {
+
+/**
+ * @brief Describes the machine to generate code for.
+ */
+struct TargetSpec {
+    explicit TargetSpec(std::string triple=llvm::sys::getDefaultTargetTriple())
+        : triple(triple), cpu("generic") {}
+
+    /**
+     * @brief The target triple.
+     */
+    std::string triple;
+
+    /**
+     * @brief An architecture (as for llc's `-march`) overriding the
+     *        triple's, or empty to use the triple's.
+     */
+    std::string arch;
+
+    /**
+     * @brief The CPU to tune and select instructions for, or "native" for
+     *        the host CPU.
+     */
+    std::string cpu;
+
+    /**
+     * @brief Comma-separated features to enable (`+feature`) or disable
+     *        (`-feature`), on top of those of the CPU.
+     */
+    std::string features;
+
+    /**
+     * @brief Find the LLVM target for this specification, and make it
+     *        concrete.
+     *
+     * Applies `arch` to the triple, and replaces a "native" CPU with the name
+     * of the host CPU and the host's features.  Features given explicitly
+     * still take precedence.  Resolving a resolved specification changes
+     * nothing.
+     *
+     * @return The LLVM target, or null (with `error` set) if there is none or
+     *         it doesn't know the CPU.
+     */
+    const llvm::Target *resolve(std::string &error);
+};
+
+/**
+ * @brief Register all of LLVM's targets.  Safe to call repeatedly and from
+ *        several threads.
+ */
+void initialize_targets(void);
+
+}
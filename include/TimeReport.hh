@@ -0,0 +1,186 @@
+/**
+ * @file TimeReport.hh
+ *
+ * @brief Per-phase timing, memory and size statistics for a compilation.
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Craeft {
+
+/**
+ * @brief Collects the time and memory spent in each phase of compilation,
+ *        and counts of the things compiled.
+ *
+ * At most one report is active at a time.  Phases are timed with `Scope`s;
+ * phases may nest, and time spent in a nested phase is not counted towards
+ * the enclosing one, so the phases timed on the thread that activated the
+ * report add up to the total.  Phases timed on other threads are counted
+ * with their own CPU time, and added to the report each time the thread
+ * leaves its outermost phase; since they run alongside the rest, the phases
+ * may then add up to more than the total.  Counts may be added from any
+ * thread.
+ *
+ * When no report is active, scopes and counts do nothing.
+ */
+class TimeReport {
+    struct Timeline;
+
+public:
+    TimeReport(void);
+    ~TimeReport(void);
+
+    TimeReport(const TimeReport &) = delete;
+    TimeReport &operator=(const TimeReport &) = delete;
+
+    /**
+     * @brief Start recording into this report, timing phases on the calling
+     *        thread.
+     */
+    void activate(void);
+
+    /**
+     * @brief Print a table of the phases and counts.
+     */
+    void print_text(std::ostream &out);
+
+    /**
+     * @brief Print the phases and counts as a JSON object.
+     */
+    void print_json(std::ostream &out);
+
+    /**
+     * @brief Add `n` to the named count in the active report.
+     */
+    static void add(const std::string &counter, uint64_t n=1);
+
+    /**
+     * @brief Times a phase for as long as it is alive.
+     */
+    class Scope {
+    public:
+        /**
+         * @param phase The name of the phase.
+         * @param precise Whether to measure CPU time and memory.  Doing so
+         *                takes a system call, so phases entered very often
+         *                (e.g. lexing a token) should pass `false`; their
+         *                CPU time is then taken to be their wall time.  Such
+         *                phases must not contain other phases.
+         */
+        explicit Scope(const char *phase, bool precise=true);
+        ~Scope(void);
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        TimeReport *report;
+        /** @brief The phases of the thread the scope is on. */
+        Timeline *timeline;
+    };
+
+private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    struct Phase {
+        std::string name;
+        /** @brief When the phase was first entered, to order the report. */
+        TimePoint first;
+        double wall = 0;
+        double cpu = 0;
+        /** @brief Peak resident set size at the end of the phase, in KiB. */
+        long peak_rss = 0;
+    };
+
+    struct Frame {
+        size_t phase;
+        bool precise;
+        TimePoint wall_start;
+        double cpu_start;
+        /** @brief CPU time of imprecise phases nested in this one. */
+        double cpu_nested;
+    };
+
+    /**
+     * @brief The phases timed on one thread, and the ones it is in.
+     */
+    struct Timeline {
+        std::vector<Phase> phases;
+        std::vector<Frame> stack;
+
+        /**
+         * @brief Whether to count the thread's own CPU time, rather than the
+         *        whole process's.
+         */
+        bool thread_cpu = false;
+
+        void enter(const char *phase, bool precise);
+        void exit(void);
+    };
+
+    /**
+     * @brief Get the timeline of the calling thread, if it is not the one
+     *        that activated the report.
+     */
+    static Timeline &thread_timeline(void);
+
+    /**
+     * @brief Add the time of a phase to the phase of the same name in a
+     *        list, adding it to the list if it is not there.
+     */
+    static void add_phase(std::vector<Phase> &phases, const Phase &phase);
+
+    /**
+     * @brief Add the phases another thread has timed to `merged`, and clear
+     *        them.
+     */
+    void merge(Timeline &);
+
+    /**
+     * @brief Get all the phases timed, in the order they were first entered.
+     */
+    std::vector<Phase> all_phases(void);
+
+    /** @brief The phases of the thread that activated the report. */
+    Timeline timeline;
+
+    /** @brief The phases of other threads, merged. */
+    std::mutex merged_lock;
+    std::vector<Phase> merged;
+
+    TimePoint wall_start;
+    double cpu_start;
+
+    std::thread::id owner;
+
+    std::mutex counts_lock;
+    std::vector<std::pair<std::string, uint64_t> > counts;
+};
+
+}
@@ -3,8 +3,10 @@
  *
  * @brief Tokens as output by the lexer.
  *
- * Consists of a series of small classes grouped in the namespace `Tok`, and a
- * variant type `Token` which can be any of those classes.
+ * Consists of the enums `Kind`, the kinds of lexemes, and `Op`, the operators,
+ * grouped in the namespace `Tok` with the value type `Token`, which is a kind
+ * tagged with its payload: a literal's value, or the interned `Symbol` of a
+ * name.
  */
 
 /* Craeft: a new systems programming language.
@@ -30,9 +32,9 @@
 #include <cstdint>
 #include <string>
 
-#include "llvm/Support/Casting.h"
+#include "llvm/ADT/StringRef.h"
 
-#include <boost/variant.hpp>
+#include "Symbol.hh"
 
 namespace Craeft {
 
@@ -42,241 +44,159 @@ namespace Craeft {
 namespace Tok {
 
 /**
- * @brief Craeft lexemes.
- *
- * Uses LLVM RTTI, which is rather heavy-duty for a token stream; should
- * perhaps refactor.
+ * @brief The kinds of Craeft lexemes.
  */
-class Token {
-public:
-    enum TokenKind {
-        TypeName,
-        Identifier,
-        IntLiteral,
-        UIntLiteral,
-        FloatLiteral,
-        StringLiteral,
-        Operator,
-        OpenParen,
-        CloseParen,
-        OpenBrace,
-        CloseBrace,
-        Comma,
-        Semicolon,
-        Fn,
-        Struct,
-        Type,
-        Return,
-        If,
-        Else,
-        While,
-        InvalidToken
-    };
-
-    Token(TokenKind kind): _kind(kind) {}
-
-    TokenKind kind(void) const {
-        return _kind;
-    }
-
-    virtual bool operator==(const Token& other) const = 0;
-
-    bool operator!=(const Token& other) const {
-        return !(operator==(other));
-    }
-
-    virtual ~Token() {}
-
-    virtual std::string repr(void) const = 0;
-
-private:
-    TokenKind _kind;
+enum Kind: uint8_t {
+    TypeName,
+    Identifier,
+    IntLiteral,
+    UIntLiteral,
+    FloatLiteral,
+    StringLiteral,
+    Operator,
+    OpenParen,
+    CloseParen,
+    OpenBrace,
+    CloseBrace,
+    OpenBracket,
+    CloseBracket,
+    Comma,
+    Semicolon,
+    Fn,
+    Struct,
+    Type,
+    Return,
+    If,
+    Else,
+    While,
+    For,
+    Restrict,
+    Const,
+    Async,
+    Await,
+    ThreadLocal,
+    Import,
+    Become,
+    InvalidToken
 };
 
 /**
- * Just expands to some boilerplate for LLVM RTTI.
- */
-#define TOK_CLASS(X)\
-    static bool classof(const Token *t) {\
-        return t->kind() == TokenKind::X;\
-    }\
-    virtual bool operator==(const Token&) const override;\
-    ~X(void) override {}
-
-/**
- * @brief Names of types.
- */
-struct TypeName: public Token {
-    std::string name;
-
-    virtual std::string repr(void) const override;
-
-    TypeName(std::string name)
-        : Token(TokenKind::TypeName), name(std::move(name)) {}
-
-    TOK_CLASS(TypeName);
-};
-
-/**
- * @brief Non-type identifiers.
+ * @brief The operators with a meaning of their own.
+ *
+ * The lexer classifies every `Operator` token, so nothing after it compares
+ * spellings.  Any other run of operator characters is `Other`.
  */
-struct Identifier: public Token {
-    std::string name;
-
-    virtual std::string repr(void) const override;
-
-    Identifier(std::string name)
-        : Token(TokenKind::Identifier), name(std::move(name)) {}
-
-    TOK_CLASS(Identifier);
+enum class Op: uint8_t {
+    Other,
+    Assign,
+    Or,
+    And,
+    BitOr,
+    BitXor,
+    BitAnd,
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    Shl,
+    Shr,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Rem,
+    Dot,
+    Arrow,
+    At,
+    OpenGeneric,
+    CloseGeneric
 };
 
 /**
- * @brief Signed integer literals.
+ * @brief Get the operator with the given spelling, or `Op::Other`.
  */
-struct IntLiteral: public Token {
-    int64_t value;
-
-    virtual std::string repr(void) const override;
-
-    IntLiteral(int64_t value): Token(TokenKind::IntLiteral), value(value) {}
-
-    TOK_CLASS(IntLiteral);
-};
+Op classify_op(llvm::StringRef spelling);
 
 /**
- * @brief Unsigned integer literals.
+ * @brief Get the spelling of an operator other than `Op::Other`.
  */
-struct UIntLiteral: public Token {
-    uint64_t value;
-
-    virtual std::string repr(void) const override;
-
-    UIntLiteral(uint64_t value):
-        Token(TokenKind::UIntLiteral),
-        value(value) {}
-
-    TOK_CLASS(UIntLiteral);
-};
+const char *spelling(Op op);
 
 /**
- * @brief Floating-point literals.
- */
-struct FloatLiteral: public Token {
-    double value;
-
-    virtual std::string repr(void) const override;
-
-    FloatLiteral(double value):
-        Token(TokenKind::FloatLiteral),
-        value(value) {}
-
-    TOK_CLASS(FloatLiteral);
-};
-
-/**
- * @brief String literals.
+ * @brief Craeft lexemes.
+ *
+ * A small tagged value, cheap to copy and never heap-allocated.  Which of the
+ * payload fields is meaningful depends on the kind.
  */
-struct StringLiteral: public Token {
-    std::string value;
-
-    virtual std::string repr(void) const override;
-
-    StringLiteral(const std::string &value):
-        Token(TokenKind::StringLiteral),
-        value(value) {}
-
-    TOK_CLASS(StringLiteral);
-};
+struct Token {
+    Kind kind;
+
+    /** @brief Which operator an `Operator` is. */
+    Op op;
+
+    union {
+        /** @brief The value of an `IntLiteral`. */
+        int64_t int_value;
+        /** @brief The value of a `UIntLiteral`. */
+        uint64_t uint_value;
+        /** @brief The value of a `FloatLiteral`. */
+        double float_value;
+    };
 
-/**
- * @brief Operators.
- */
-struct Operator: public Token {
-    std::string op;
+    /**
+     * @brief The name of a `TypeName` or `Identifier`, or the spelling of an
+     *        `Operator` of kind `Op::Other`.
+     */
+    Symbol name;
+
+    /**
+     * @brief The contents of a `StringLiteral`, between the quotes and with
+     *        escape sequences still in place.
+     *
+     * Points into storage owned by the lexer, so is valid only as long as
+     * the lexer is.
+     */
+    llvm::StringRef text;
+
+    Token(Kind kind = InvalidToken)
+        : kind(kind), op(Op::Other), uint_value(0) {}
+
+    Token(Kind kind, Symbol name)
+        : kind(kind), op(Op::Other), uint_value(0), name(name) {}
+
+    /**
+     * @brief Construct an `Operator` token for a known operator.
+     */
+    static Token op_token(Op op) {
+        Token result(Operator);
+        result.op = op;
+        return result;
+    }
 
-    virtual std::string repr(void) const override;
+    /**
+     * @brief Construct an `Operator` token for an unknown operator.
+     */
+    static Token other_op_token(Symbol spelling) {
+        return Token(Operator, spelling);
+    }
 
-    Operator(std::string op): Token(TokenKind::Operator), op(std::move(op)) {}
+    bool is(Kind k) const { return kind == k; }
 
-    TOK_CLASS(Operator);
-};
+    /**
+     * @brief Check whether this is the given operator.
+     */
+    bool is_op(Op o) const { return kind == Operator && op == o; }
 
-/**
- * @defgroup Empty Tokens with no meaning other than disambiguating syntax.
- */
+    bool operator==(const Token &other) const;
 
-#define TOK_SIMPLE(X)\
-    X(): Token(TokenKind::X) {}\
-    virtual bool operator==(const Token& other) const override {\
-        return llvm::isa<X>(other);\
-    }\
-    static bool classof(const Token *t) {\
-        return t->kind() == TokenKind::X;\
-    }\
-    ~X(void) override {}
+    bool operator!=(const Token &other) const {
+        return !(operator==(other));
+    }
 
-struct OpenParen: public Token {
-    virtual std::string repr(void) const override { return "("; }
-    TOK_SIMPLE(OpenParen);
-};
-struct CloseParen: public Token {
-    virtual std::string repr(void) const override { return ")"; }
-    TOK_SIMPLE(CloseParen);
-};
-struct OpenBrace: public Token {
-    virtual std::string repr(void) const override { return "{"; }
-    TOK_SIMPLE(OpenBrace);
-};
-struct CloseBrace: public Token {
-    virtual std::string repr(void) const override { return "}"; }
-    TOK_SIMPLE(CloseBrace);
-};
-struct Comma: public Token {
-    virtual std::string repr(void) const override { return ","; }
-    TOK_SIMPLE(Comma);
-};
-struct Semicolon: public Token {
-    virtual std::string repr(void) const override { return ";"; }
-    TOK_SIMPLE(Semicolon);
-};
-struct Fn: public Token {
-    virtual std::string repr(void) const override { return "fn"; }
-    TOK_SIMPLE(Fn);
+    std::string repr(void) const;
 };
-struct Struct: public Token {
-    virtual std::string repr(void) const override { return "struct"; }
-    TOK_SIMPLE(Struct);
-};
-struct Type: public Token {
-    virtual std::string repr(void) const override { return "type"; }
-    TOK_SIMPLE(Type);
-};
-struct Return: public Token {
-    virtual std::string repr(void) const override { return "return"; }
-    TOK_SIMPLE(Return);
-};
-struct If: public Token {
-    virtual std::string repr(void) const override { return "if"; }
-    TOK_SIMPLE(If);
-};
-struct Else: public Token {
-    virtual std::string repr(void) const override { return "else"; }
-    TOK_SIMPLE(Else);
-};
-struct While: public Token {
-    virtual std::string repr(void) const override { return "while"; }
-    TOK_SIMPLE(While);
-};
-struct InvalidToken: public Token {
-    virtual std::string repr(void) const override { return "[INVALID]"; }
-    TOK_SIMPLE(InvalidToken);
-};
-
-#undef TOK_CLASS
-#undef TOK_SIMPLE
-
-/** @} */
 
 }
 
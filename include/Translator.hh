@@ -24,14 +24,20 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
 
-#include "llvm/Support/Host.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 
 #include "Block.hh"
 #include "Environment.hh"
+#include "SourceManager.hh"
+#include "Target.hh"
 #include "Value.hh"
 #include "Type.hh"
 
@@ -55,8 +61,318 @@ public:
     std::unique_ptr<IfThenElseImpl> pimpl;
 };
 
+/**
+ * @brief Abstract implementation of `Loop`.
+ */
+struct LoopImpl;
+
+/**
+ * @brief Abstract representation of a Craeft loop.
+ *
+ * Should only be used through `Translator`'s methods on it.
+ */
+class Loop {
+public:
+    Loop(std::unique_ptr<LoopImpl> pimpl);
+    Loop(Loop &&other);
+    ~Loop(void);
+    std::unique_ptr<LoopImpl> pimpl;
+};
+
+/**
+ * @brief Hints to the optimizer about how to transform a loop.
+ */
+struct LoopHints {
+    enum Choice {
+        /** @brief Leave it to the optimizer. */
+        Default,
+        Enable,
+        Disable
+    };
+
+    Choice unroll = Default;
+
+    /** @brief How many times to unroll the loop, or 0 for any number. */
+    unsigned unroll_count = 0;
+
+    Choice vectorize = Default;
+
+    /** @brief The number of lanes to vectorize with, or 0 for any number. */
+    unsigned vectorize_width = 0;
+
+    /** @brief How many vectorized iterations to interleave, or 0 for any. */
+    unsigned interleave_count = 0;
+};
+
+/**
+ * @brief Which of IEEE 754's rules floating-point arithmetic may break for
+ *        speed: LLVM's fast-math flags.
+ */
+struct FastMath {
+    /** @brief Reassociate operations, as in vectorizing a sum. */
+    bool reassoc = false;
+    /** @brief Fuse a multiplication and an addition into one `fma`. */
+    bool contract = false;
+    /** @brief Assume no operand or result is NaN. */
+    bool nnan = false;
+    /** @brief Assume no operand or result is infinite. */
+    bool ninf = false;
+    /** @brief Ignore the sign of zero. */
+    bool nsz = false;
+    /** @brief Multiply by a reciprocal rather than dividing. */
+    bool arcp = false;
+    /** @brief Approximate functions such as `sqrt`. */
+    bool afn = false;
+
+    /** @brief Every flag, as C compilers' `-ffast-math` sets. */
+    static FastMath all(void);
+
+    /**
+     * @brief Set the flag with the given name.
+     *
+     * @return Whether there is one.
+     */
+    bool set(const std::string &flag, bool value);
+
+    /** @brief The names of the flags set, separated by commas. */
+    std::string str(void) const;
+};
+
+/**
+ * @brief Attributes requested for a function.
+ */
+struct FunctionAttributes {
+    /**
+     * @brief The calling convention: C's, or one which only Craeft code can
+     *        call.
+     */
+    enum Convention {
+        C,
+        /** @brief Whatever is fastest; LLVM's `fastcc`. */
+        Fast,
+        /** @brief Keeping the caller's registers; LLVM's `coldcc`. */
+        Cold
+    };
+
+    Convention convention = C;
+
+    enum Inlining {
+        /** @brief Leave it to the optimizer. */
+        Default,
+        Always,
+        Never
+    };
+
+    Inlining inlining = Default;
+
+    /** @brief Whether the function is called often, or rarely. */
+    bool hot = false;
+    bool cold = false;
+
+    /** @brief Whether the function reads no memory, or writes none. */
+    bool readnone = false;
+    bool readonly = false;
+
+    /** @brief Whether the function never returns. */
+    bool noreturn = false;
+
+    /**
+     * @brief Whether the function allocates memory, returning a pointer to
+     *        memory no other pointer points to.
+     */
+    bool allocator = false;
+
+    /**
+     * @brief The index of the argument giving the size in bytes of what an
+     *        allocator returns, if there is one.
+     */
+    boost::optional<unsigned> alloc_size;
+
+    /**
+     * @brief Whether the function is an `async fn`: a coroutine, which
+     *        returns a handle to itself and its result through `await`.
+     */
+    bool async = false;
+
+    /**
+     * @brief The fast-math flags for the function's arithmetic, or none for
+     *        the module's (see `Translator::set_fast_math`).
+     */
+    boost::optional<FastMath> fast_math;
+
+    /**
+     * @brief The CPU features to compile extra versions of the function
+     *        for, each chosen at run time on CPUs which have it.
+     */
+    std::vector<std::string> target_clones;
+
+    /**
+     * @brief CPU features the function may use beyond the module's, as LLVM
+     *        writes them (`+avx2`).
+     */
+    std::string target_features;
+
+    /**
+     * @brief Whether the function is private to the module.  Its linkage is
+     *        only made internal once the module is complete, by
+     *        `Translator::internalize`, since the pieces of a module
+     *        generated in parallel call each other's functions.
+     */
+    bool internal = false;
+};
+
 class TranslatorImpl;
 
+/**
+ * @brief The size of a generated module.
+ */
+struct ModuleCounts {
+    /** @brief The number of functions defined (not just declared). */
+    size_t functions = 0;
+    /** @brief The number of IR instructions in those functions. */
+    size_t instructions = 0;
+};
+
+/**
+ * @brief Which part of the optimization pipeline to run.
+ *
+ * Modules generated separately and then linked together are optimized in two
+ * phases: each piece before linking, and the whole program after.
+ */
+enum class OptPhase {
+    /** @brief Optimize a complete module. */
+    Whole,
+    /** @brief Simplify functions in a module which will be linked later. */
+    PreLink,
+    /** @brief Optimize a module built by linking `PreLink` modules. */
+    PostLink,
+    /**
+     * @brief Simplify a module to be emitted as bitcode and optimized
+     *        further by ThinLTO at link time.
+     */
+    ThinPreLink
+};
+
+/**
+ * @brief Settings for profile-guided optimization.
+ */
+struct ProfileOptions {
+    /** @brief Whether to instrument the module to record a profile. */
+    bool generate = false;
+
+    /**
+     * @brief The file the instrumented program writes its raw profile to
+     *        (which may contain `%m` and the like, as `LLVM_PROFILE_FILE`
+     *        may), or empty for the profiling runtime's default.
+     */
+    std::string generate_file;
+
+    /**
+     * @brief An indexed profile (from `llvm-profdata merge`) to annotate the
+     *        module with before optimizing it, or empty for none.
+     */
+    std::string use_file;
+};
+
+/**
+ * @brief How much debug information to generate.
+ */
+enum class DebugLevel {
+    None,
+    /** @brief Only line tables, as profilers and backtraces need. */
+    LineTables,
+    /** @brief Line tables, plus the types of functions and variables. */
+    Full,
+    /**
+     * @brief Source locations on the generated code, for optimization
+     *        remarks, but no debug information in the output.
+     */
+    Locations
+};
+
+/**
+ * @brief The kinds of file a module can be emitted as.
+ */
+enum class Artifact {
+    IR,
+    /** @brief Bitcode, with a ThinLTO summary. */
+    Bitcode,
+    Assembly,
+    Object,
+    /**
+     * @brief The optimization remarks recorded so far, as YAML (see
+     *        `Translator::set_remarks`).
+     */
+    Remarks,
+    /**
+     * @brief The module's interface, for other modules to import (see
+     *        `ModuleGen::record_interface`).  Not emitted by the
+     *        `Translator`.
+     */
+    Interface
+};
+
+/**
+ * @brief Receives each artifact as soon as it has been generated.
+ */
+typedef std::function<void(Artifact, std::string)> ArtifactSink;
+
+/**
+ * @brief The operations with which a vector can be reduced to a scalar.
+ */
+enum class Reduction {
+    Add,
+    Mul,
+    Min,
+    Max,
+    And,
+    Or,
+    Xor
+};
+
+/**
+ * @brief The operations on scalars and vectors which map directly onto LLVM
+ *        intrinsics, and so onto single instructions where the target has
+ *        them.
+ */
+enum class Intrinsic {
+    /** @brief The number of set bits. */
+    Popcount,
+    /** @brief The number of leading zero bits, the width for 0. */
+    CountLeadingZeros,
+    /** @brief The number of trailing zero bits, the width for 0. */
+    CountTrailingZeros,
+    ByteSwap,
+    RotateLeft,
+    RotateRight,
+    Sqrt,
+    /** @brief `a * b + c`, rounded once. */
+    FusedMultiplyAdd
+};
+
+/**
+ * @brief The orderings of atomic operations, as in C11.
+ */
+enum class AtomicOrdering {
+    Relaxed,
+    Acquire,
+    Release,
+    AcqRel,
+    SeqCst
+};
+
+/**
+ * @brief The atomic read-modify-write operations.
+ */
+enum class AtomicOp {
+    Xchg,
+    Add,
+    Sub,
+    And,
+    Or,
+    Xor
+};
+
 /**
  * @brief Facilities for translating Craeft to LLVM.
  *
@@ -65,11 +381,18 @@ class TranslatorImpl;
  */
 class Translator {
 public:
+    /**
+     * @param sources The table of the compilation's source files, for
+     *                errors.  Must outlive the translator.
+     */
     Translator(std::string module_name, std::string filename,
-               std::string triple=llvm::sys::getDefaultTargetTriple());
+               SourceManager &sources, TargetSpec target=TargetSpec());
 
     ~Translator();
 
+    Translator(Translator &&);
+    Translator &operator=(Translator &&);
+
     /**
      * @defgroup Craeft instructions.
      *
@@ -122,18 +445,22 @@ public:
 
     /**
      * @brief Add the given values.
+     *
+     * Unsigned integers wrap around on overflow.  Signed integers may be
+     * assumed not to overflow, unless `wrapping` is set or the module was
+     * given `set_wrapping_overflow`, in which case they wrap too.
      */
-    Value add(Value lhs, Value rhs, SourcePos pos);
+    Value add(Value lhs, Value rhs, SourcePos pos, bool wrapping=false);
 
     /**
-     * @brief Subtract the given values.
+     * @brief Subtract the given values, overflowing as for `add`.
      */
-    Value sub(Value lhs, Value rhs, SourcePos pos);
+    Value sub(Value lhs, Value rhs, SourcePos pos, bool wrapping=false);
 
     /**
-     * @brief Multiply the given values.
+     * @brief Multiply the given values, overflowing as for `add`.
      */
-    Value mul(Value lhs, Value rhs, SourcePos pos);
+    Value mul(Value lhs, Value rhs, SourcePos pos, bool wrapping=false);
 
     /**
      * @brief Divide the given values.
@@ -200,31 +527,214 @@ public:
      */
     Value field_address(Value ptr, std::string field, SourcePos pos);
 
+    /**
+     * @brief Get an element of the given array.
+     *
+     * @param index An integer less than the length of the array.
+     */
+    Value element_access(Value array, Value index, SourcePos pos);
+
+    /**
+     * @brief Get the address of an element of the given array pointer.
+     *
+     * @param ptr   A pointer to an array type.
+     * @param index An integer less than the length of the array.
+     */
+    Value element_address(Value ptr, Value index, SourcePos pos);
+
     /**
      * @brief Function call.
      */
-    Value call(std::string func, std::vector<Value> &args, SourcePos pos);
+    Value call(Symbol func, std::vector<Value> &args, SourcePos pos);
 
     /**
      * @brief Template function call.
      */
-    Value call(std::string func, std::vector<Type> &templ_args,
+    Value call(Symbol func, std::vector<Type> &templ_args,
                std::vector<Value> &v_args, SourcePos pos);
 
+    /**
+     * @brief Get whether the given name refers to a function or function
+     *        template defined in the program.
+     */
+    bool is_function(Symbol name) const;
+
+    /**
+     * @brief Atomically load the integer or pointer the given pointer points
+     *        to.
+     */
+    Value atomic_load(Value pointer, AtomicOrdering ordering, SourcePos pos);
+
+    /**
+     * @brief Atomically store an integer or pointer through the given
+     *        pointer.
+     */
+    Value atomic_store(Value pointer, Value val, AtomicOrdering ordering,
+                       SourcePos pos);
+
+    /**
+     * @brief Atomically combine the value the given pointer points to with
+     *        `val`, getting the value it had before.
+     *
+     * Only `AtomicOp::Xchg` applies to pointers.
+     */
+    Value atomic_rmw(AtomicOp op, Value pointer, Value val,
+                     AtomicOrdering ordering, SourcePos pos);
+
+    /**
+     * @brief Atomically replace the value `pointer` points to with `desired`
+     *        if it is equal to the one `expected` points to, getting whether
+     *        it was.
+     *
+     * Either way, the value found is left in `*expected`.  A weak exchange
+     * may fail even if the values are equal, but can be cheaper in a loop.
+     * If it fails, the exchange only has the ordering of a load.
+     */
+    Value atomic_cmpxchg(Value pointer, Value expected, Value desired,
+                         bool weak, AtomicOrdering ordering, SourcePos pos);
+
+    /**
+     * @brief Order memory accesses around this point.
+     */
+    Value atomic_fence(AtomicOrdering ordering, SourcePos pos);
+
+    /**
+     * @brief Call an `async fn` and run it to completion, getting its result.
+     *
+     * Inside another `async fn`, this suspends the caller each time the
+     * callee does, resuming the callee when the caller is resumed; elsewhere
+     * it just resumes the callee until it is done.
+     */
+    Value await_(Symbol func, std::vector<Value> &args, SourcePos pos);
+
+    /**
+     * @brief Suspend the current `async fn`, returning to whoever called or
+     *        resumed it.
+     */
+    Value async_suspend(SourcePos pos);
+
+    /**
+     * @brief Resume the coroutine with the given handle.
+     */
+    Value async_resume(Value handle, SourcePos pos);
+
+    /**
+     * @brief Get whether the coroutine with the given handle has finished.
+     */
+    Value async_done(Value handle, SourcePos pos);
+
+    /**
+     * @brief Free the coroutine with the given handle.
+     */
+    Value async_destroy(Value handle, SourcePos pos);
+
+    /**
+     * @brief Get a vector of the given type with every lane set to `val`.
+     */
+    Value splat(const Type &vec, Value val, SourcePos pos);
+
+    /**
+     * @brief Get the size in bytes of a value of the given type, including
+     *        any padding up to its alignment (the stride of an array of
+     *        them), as a `U64` constant.
+     */
+    Value size_of(const Type &t, SourcePos pos);
+
+    /**
+     * @brief Get the alignment in bytes of the given type, as a `U64`
+     *        constant.
+     */
+    Value align_of(const Type &t, SourcePos pos);
+
+    /**
+     * @brief Allocate a value of the given type on the heap, with C's
+     *        `malloc` (or `aligned_alloc`, for over-aligned types).
+     *
+     * Calls to the C allocator are known to the optimizer, which can
+     * remove allocations whose memory is never read.
+     *
+     * @return A pointer to the uninitialized value.
+     */
+    Value allocate(const Type &t, SourcePos pos);
+
+    /**
+     * @brief Free a value of the given type allocated with `allocate`.
+     */
+    Value deallocate(const Type &t, Value pointer, SourcePos pos);
+
+    /**
+     * @brief Get lane `index` of the given vector.
+     */
+    Value extract(Value vec, Value index, SourcePos pos);
+
+    /**
+     * @brief Get a copy of the given vector with lane `index` set to `val`.
+     */
+    Value insert(Value vec, Value index, Value val, SourcePos pos);
+
+    /**
+     * @brief Build a vector out of the lanes of two vectors of the same type.
+     *
+     * @param indices Constant integers: lane `i` of the result is lane
+     *                `indices[i]` of the concatenation of `lhs` and `rhs`.
+     */
+    Value shuffle(Value lhs, Value rhs, const std::vector<Value> &indices,
+                  SourcePos pos);
+
+    /**
+     * @brief Combine the lanes of a vector with the given operation.
+     *
+     * Float additions and multiplications are done in no particular order.
+     */
+    Value reduce(Reduction op, Value vec, SourcePos pos);
+
+    /**
+     * @brief Apply an intrinsic operation to integers, floats, or vectors of
+     *        either, lane by lane.
+     *
+     * The operands must all have the same type, except that a scalar may be
+     * rotated by an integer of any width.  The result has the type of the
+     * first.
+     */
+    Value intrinsic(Intrinsic op, const std::vector<Value> &args,
+                    SourcePos pos);
+
+    /**
+     * @brief Mark a boolean as probably true (`likely`) or probably false, so
+     *        that branches on it favour that side.
+     */
+    Value expect(Value cond, bool likely, SourcePos pos);
+
+    /**
+     * @brief Hint that the memory at `pointer` will soon be read, or
+     *        written if `write` is set.
+     *
+     * @param locality A constant integer from 0 (used once, don't keep it in
+     *                 cache) to 3 (keep it in every level of cache), by
+     *                 default 3.
+     */
+    Value prefetch(Value pointer, bool write,
+                   boost::optional<Value> locality, SourcePos pos);
+
     /**
      * Get a string literal as a char pointer.
      */
     Value string_literal(const std::string &str);
 
+    /**
+     * @brief Get the value of a type with every bit zero.
+     */
+    Value zero(const Type &t);
+
     /**
      * @brief Create a variable with the given name and type.
      */
-    Variable declare(const std::string &name, const Type &t);
+    Variable declare(Symbol name, const Type &t);
 
     /**
      * @brief Assign the given value to the given variable.
      */
-    void assign(const std::string &varname, Value val, SourcePos pos);
+    void assign(Symbol varname, Value val, SourcePos pos);
 
     /**
      * @brief Return the given value, or void if none provided.
@@ -232,6 +742,16 @@ public:
     void return_(Value val, SourcePos pos);
     void return_(SourcePos pos);
 
+    /**
+     * @brief Return the result of the call just made, making the call a
+     *        guaranteed tail call (`become`): the caller's frame is gone by
+     *        the time the callee runs, so it doesn't grow the stack.
+     *
+     * The callee must have the same argument and result types and calling
+     * convention as the caller.
+     */
+    void tail_return(Value call, SourcePos pos);
+
     /** @} **/
 
     /**
@@ -245,19 +765,49 @@ public:
      *
      * Raise an Error if not present.
      */
-    Value get_identifier_addr(std::string ident, SourcePos pos);
+    Value get_identifier_addr(Symbol ident, SourcePos pos);
 
     /**
      * @brief Get the value of the given identifier.
      *
      * Raise an Error if not present.
      */
-    Value get_identifier_value(std::string ident, SourcePos pos);
+    Value get_identifier_value(Symbol ident, SourcePos pos);
+
+    /**
+     * @brief Define a compile-time constant of the given type.
+     *
+     * The constant is stored in read-only memory, so its address can be
+     * taken, but reading it gives the value itself.
+     *
+     * @param val Must be a constant.
+     */
+    void define_constant(Symbol name, const Type &t, Value val,
+                         SourcePos pos);
+
+    /**
+     * @brief Define a global variable of the given type.
+     *
+     * @param init The initial value, which must be a constant.  Without one
+     *             the variable starts zeroed.
+     * @param is_thread_local Whether each thread has its own copy.
+     * @param define Whether to define the variable, or only to declare it as
+     *               defined by another module of the program.
+     */
+    void define_global(Symbol name, const Type &t, boost::optional<Value> init,
+                       bool is_thread_local, bool define, SourcePos pos);
+
+    /**
+     * @brief Get the value of the given compile-time constant.
+     *
+     * Raise an Error if the identifier is not present or not a constant.
+     */
+    Value get_constant(Symbol ident, SourcePos pos);
 
     /**
      * @brief Look up the given type by name.
      */
-    Type lookup_type(std::string tname, SourcePos pos);
+    Type lookup_type(Symbol tname, SourcePos pos);
 
     /**
      * @brief Push a new scope.
@@ -272,26 +822,46 @@ public:
     /**
      * @brief Bind the given name to the given type.
      */
-    void bind_type(std::string, Type t);
+    void bind_type(Symbol, Type t);
 
-    Type specialize_template(std::string template_name,
+    Type specialize_template(Symbol template_name,
                              const std::vector<Type> &args,
                              SourcePos pos);
 
     /**
      * @brief Register a template function.
      */
-    void register_template(std::string name,
+    void register_template(Symbol name,
                            std::shared_ptr<AST::FunctionDefinition>,
-                           std::vector<std::string> args,
+                           std::vector<Symbol> args,
                            TemplateFunction func);
 
     /**
      * @brief Register a template struct.
      */
-    void register_template(TemplateStruct, std::string name);
+    void register_template(TemplateStruct, Symbol name);
+
+    /**
+     * @brief Register a function which may be evaluated at compile time.
+     *
+     * The function itself must still be declared or defined.
+     */
+    void register_const_function(std::shared_ptr<AST::FunctionDefinition>);
+
+    /**
+     * @brief Get the `const fn` of the given name, or null if there is none.
+     */
+    std::shared_ptr<AST::FunctionDefinition> lookup_const_function(
+            Symbol name) const;
+
+    /**
+     * @brief Set the function called to bind names which are not bound,
+     *        such as those declared in imported interfaces, before giving up
+     *        on them (see `Environment::set_resolver`).
+     */
+    void set_resolver(std::function<bool(Symbol)> resolver);
 
-    Struct<TemplateType> respecialize_template(std::string template_name,
+    Struct<TemplateType> respecialize_template(Symbol template_name,
                                          const std::vector<TemplateType>
                                               &args,
                                          SourcePos pos);
@@ -325,6 +895,33 @@ public:
      */
     void end_ifthenelse(IfThenElse structure);
 
+    /**
+     * @brief Create and return a loop, and start emitting its condition.
+     *
+     * @param hints Recorded on the loop's back edge.
+     */
+    Loop create_loop(const LoopHints &hints);
+
+    /**
+     * @brief Branch on the loop's condition, and start emitting the body in a
+     *        new namespace.
+     */
+    void start_loop_body(Loop &loop, Value cond, SourcePos pos);
+
+    /**
+     * @brief End the body and start emitting the step run after each
+     *        iteration.
+     *
+     * Optional; must come after `start_loop_body`.
+     */
+    void start_loop_step(Loop &loop);
+
+    /**
+     * @brief Jump back to the condition, and start emitting instructions
+     *        after the loop.
+     */
+    void end_loop(Loop loop);
+
     /** @} */
 
     /**
@@ -333,11 +930,35 @@ public:
      * @{
      */
 
-    void create_function_prototype(Function<> f, std::string name);
+    /**
+     * @brief Declare a function.  A function may be declared any number of
+     *        times, as long as it is always with the same type.
+     */
+    void create_function_prototype(
+            Function<> f, std::string name, SourcePos pos,
+            const FunctionAttributes &attrs=FunctionAttributes());
 
-    void create_and_start_function(Function<> f,
-                                   std::vector<std::string> args,
-                                   std::string name);
+    /**
+     * @brief Define a function and start emitting its body.
+     *
+     * @param pos Where the function is defined, for debug information.
+     */
+    void create_and_start_function(
+            Function<> f, std::vector<Symbol> args, std::string name,
+            SourcePos pos,
+            const FunctionAttributes &attrs=FunctionAttributes());
+
+    /**
+     * @brief Define a function with `target_clones` which calls the best of
+     *        its versions for the CPU it runs on.  The choice is made on the
+     *        first call, and remembered.
+     *
+     * @return The name and attributes of each version, to define with
+     *         `create_and_start_function`.
+     */
+    std::vector<std::pair<std::string, FunctionAttributes> >
+    create_dispatcher(Function<> f, std::string name, SourcePos pos,
+                      const FunctionAttributes &attrs);
 
     void create_struct(Struct<> t);
     void create_struct(TemplateStruct t);
@@ -363,13 +984,198 @@ public:
      */
 
     void validate(std::ostream &);
-    void optimize(int opt_level);
+    /**
+     * @brief Optimize the module.
+     *
+     * @param opt_level 0-3, as for `-O`.
+     * @param size_level 0 for speed, 1 to also optimize for size (`-Os`), 2
+     *                   to optimize aggressively for size (`-Oz`).
+     */
+    void optimize(int opt_level, int size_level=0,
+                  OptPhase phase=OptPhase::Whole);
     void emit_ir(std::ostream &fd);
     void emit_obj(int fd);
     void emit_asm(int fd);
+    void emit_bitcode(std::ostream &out);
+    /**
+     * @brief Emit bitcode with a ThinLTO summary, for linking with
+     *        `-flto=thin`.
+     */
+    void emit_bc(int fd);
+
+    /**
+     * @brief Emit several artifacts, running the backend at most once.
+     *
+     * IR and bitcode are generated first, since the backend modifies the
+     * module.  If both assembly and an object are wanted, the object is
+     * assembled from the assembly.  Remarks come last, so that they include
+     * the backend's.
+     *
+     * @param sink Called with each artifact, in the order they are produced.
+     */
+    void emit(const std::vector<Artifact> &artifacts,
+              const ArtifactSink &sink);
+
+    /**
+     * @brief Count the functions and instructions in the module.
+     */
+    ModuleCounts counts(void);
+
+    /**
+     * @brief Link modules, given as LLVM bitcode, into this one, in order.
+     *
+     * Functions which are already defined in this module (e.g. template
+     * instantiations generated by both modules) keep their existing
+     * definitions.
+     */
+    void link_bitcode(const std::vector<std::string> &bitcode);
+
+    /**
+     * @brief Get the bitcode for a module containing just the definition of
+     *        the given function (and any private globals it uses).
+     *
+     * Everything else it refers to is only declared.
+     *
+     * @param declare Functions to declare even if it no longer refers to them
+     *                (e.g. after inlining them).
+     *
+     * @return The bitcode, or empty if the function is no longer defined (a
+     *         template instantiation may be dropped once inlined everywhere).
+     */
+    std::string extract_bitcode(const std::string &function,
+                                const std::vector<std::string> &declare={});
+
+    /**
+     * @brief Like `extract_bitcode`, but optimize the function (as
+     *        `optimize` would) in its module of its own first.
+     *
+     * The result depends only on the function and the declarations of what
+     * it uses, not on the bodies of the other functions in this module,
+     * which optimizing this module could inline into it.  This module is
+     * left unchanged.
+     */
+    std::string extract_optimized_bitcode(
+            const std::string &function,
+            const std::vector<std::string> &declare,
+            int opt_level, int size_level, OptPhase phase);
+
+    /**
+     * @brief Get the names of the functions the given function calls (or
+     *        otherwise refers to directly).
+     */
+    std::vector<std::string> callees(const std::string &function);
+
+    /**
+     * @brief Run the module in-process, calling the given function.
+     *
+     * See `run_jit`.  This consumes the module; nothing else may be done with
+     * the translator afterwards.
+     */
+    int run(const std::string &entry, const std::vector<std::string> &args);
+
+    /**
+     * @brief Get the names of the functions which are declared but not
+     *        defined in this module.
+     */
+    std::vector<std::string> undefined_functions(void);
+
+    /**
+     * @brief Give the named functions internal linkage, so that the
+     *        optimizer may drop, specialize and change the calling
+     *        convention of them.  Names not defined in the module are
+     *        skipped.
+     */
+    void internalize(const std::vector<std::string> &names);
 
     /** @} */
 
+    /**
+     * @brief Choose template instantiations to only declare.
+     *
+     * When a template is first instantiated, its mangled name is passed to
+     * `is_external`; if that returns true, the instantiation's definition is
+     * expected to be linked in later, and code is not generated for it.
+     */
+    void set_external_instances(
+            std::function<bool(const std::string &)> is_external);
+
+    /**
+     * @brief Instrument or annotate the module with a profile when it is
+     *        optimized.
+     *
+     * Profiles identify functions by name, so template instantiations match
+     * up across builds by their mangled names.  Even at -O0, `optimize` must
+     * be called for this to take effect.
+     */
+    void set_profile(const ProfileOptions &profile);
+
+    /**
+     * @brief Generate debug information for the module.
+     *
+     * Must be called before generating any code.
+     */
+    void set_debug_level(DebugLevel level);
+
+    /**
+     * @brief Relax the floating-point arithmetic of functions which don't
+     *        ask for their own fast-math flags.
+     *
+     * Must be called before generating any code.
+     */
+    void set_fast_math(const FastMath &flags);
+
+    /**
+     * @brief Make signed integer arithmetic wrap around on overflow, as
+     *        unsigned does, rather than assume it doesn't overflow.
+     *
+     * Must be called before generating any code.
+     */
+    void set_wrapping_overflow(void);
+
+    /**
+     * @brief Record optimization remarks: why passes did or did not
+     *        transform the code.
+     *
+     * Remarks are located by the code's debug locations, so the module
+     * should have at least `DebugLevel::Locations`.
+     *
+     * @param passes A regular expression matching the names of the passes
+     *               to record remarks from, or empty for all.
+     *
+     * @throws Error If `passes` is not a valid regular expression.
+     */
+    void set_remarks(const std::string &passes);
+
+    /**
+     * @brief Generate machine code as quickly as possible, for unoptimized
+     *        builds: FastISel, the fast register allocator, and none of the
+     *        backend's optional passes.
+     */
+    void set_fast_backend(void);
+
+    /**
+     * @brief Generate object code on `n` threads, each given part of the
+     *        module.  The parts are merged with a relocatable link by `ld`,
+     *        which must be on the path.
+     *
+     * Only objects emitted on their own are split; along with assembly,
+     * they are assembled from it.
+     */
+    void set_backend_threads(unsigned n);
+
+    /**
+     * @brief Get the remarks recorded since the last call, as YAML.
+     */
+    std::string take_remarks(void);
+
+    /**
+     * @brief Attribute the code generated from here on to the given
+     *        position in the debug information.
+     *
+     * Does nothing without debug information, or outside a function.
+     */
+    void set_location(SourcePos pos);
+
     /**
      * @brief Get the translator's LLVM context.
      */
@@ -25,13 +25,20 @@
 #pragma once
 
 #include <functional>
+#include <unordered_map>
+
+#include <boost/optional.hpp>
 
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
 
+#include "Abi.hh"
 #include "Block.hh"
+#include "DebugInfo.hh"
 #include "Environment.hh"
 #include "Error.hh"
+#include "Target.hh"
 #include "Translator.hh"
 #include "Type.hh"
 #include "Value.hh"
@@ -46,7 +53,7 @@ namespace Craeft {
 class TranslatorImpl {
 public:
     TranslatorImpl(std::string module_name, std::string filename,
-                   std::string triple);
+                   SourceManager &sources, TargetSpec target_spec);
 
     Value cast(Value val, const Type &t, SourcePos pos);
     Value add_load(Value pointer, SourcePos pos);
@@ -58,9 +65,9 @@ public:
     Value bit_or(Value lhs, Value rhs, SourcePos pos);
     Value bit_xor(Value lhs, Value rhs, SourcePos pos);
     Value bit_not(Value val, SourcePos pos);
-    Value add(Value lhs, Value rhs, SourcePos pos);
-    Value sub(Value lhs, Value rhs, SourcePos pos);
-    Value mul(Value lhs, Value rhs, SourcePos pos);
+    Value add(Value lhs, Value rhs, SourcePos pos, bool wrapping);
+    Value sub(Value lhs, Value rhs, SourcePos pos, bool wrapping);
+    Value mul(Value lhs, Value rhs, SourcePos pos, bool wrapping);
     Value div(Value lhs, Value rhs, SourcePos pos);
     Value equal(Value lhs, Value rhs, SourcePos pos);
     Value nequal(Value lhs, Value rhs, SourcePos pos);
@@ -74,46 +81,98 @@ public:
 
     Value field_access(Value lhs, std::string field, SourcePos pos);
     Value field_address(Value ptr, std::string field, SourcePos pos);
+    Value element_access(Value array, Value index, SourcePos pos);
+    Value element_address(Value ptr, Value index, SourcePos pos);
 
-    Value call(std::string func, std::vector<Value> &args, SourcePos pos);
-    Value call(std::string func, std::vector<Type> &templ_args,
+    Value call(Symbol func, std::vector<Value> &args, SourcePos pos);
+    Value call(Symbol func, std::vector<Type> &templ_args,
                std::vector<Value> &v_args, SourcePos pos);
+    bool is_function(Symbol name) const;
+    Value atomic_load(Value pointer, AtomicOrdering ordering, SourcePos pos);
+    Value atomic_store(Value pointer, Value val, AtomicOrdering ordering,
+                       SourcePos pos);
+    Value atomic_rmw(AtomicOp op, Value pointer, Value val,
+                     AtomicOrdering ordering, SourcePos pos);
+    Value atomic_cmpxchg(Value pointer, Value expected, Value desired,
+                         bool weak, AtomicOrdering ordering, SourcePos pos);
+    Value atomic_fence(AtomicOrdering ordering, SourcePos pos);
+    Value await_(Symbol func, std::vector<Value> &args, SourcePos pos);
+    Value async_suspend(SourcePos pos);
+    Value async_resume(Value handle, SourcePos pos);
+    Value async_done(Value handle, SourcePos pos);
+    Value async_destroy(Value handle, SourcePos pos);
+    Value splat(const Type &vec, Value val, SourcePos pos);
+    Value size_of(const Type &t, SourcePos pos);
+    Value align_of(const Type &t, SourcePos pos);
+    Value allocate(const Type &t, SourcePos pos);
+    Value deallocate(const Type &t, Value pointer, SourcePos pos);
+    Value extract(Value vec, Value index, SourcePos pos);
+    Value insert(Value vec, Value index, Value val, SourcePos pos);
+    Value shuffle(Value lhs, Value rhs, const std::vector<Value> &indices,
+                  SourcePos pos);
+    Value reduce(Reduction op, Value vec, SourcePos pos);
+    Value intrinsic(Intrinsic op, const std::vector<Value> &args,
+                    SourcePos pos);
+    Value expect(Value cond, bool likely, SourcePos pos);
+    Value prefetch(Value pointer, bool write,
+                   boost::optional<Value> locality, SourcePos pos);
     Value string_literal(const std::string &str);
-    Variable declare(const std::string &name, const Type &t);
-    void assign(const std::string &varname, Value val, SourcePos pos);
+    Value zero(const Type &t);
+    Variable declare(Symbol name, const Type &t);
+    void assign(Symbol varname, Value val, SourcePos pos);
     void return_(Value val, SourcePos pos);
     void return_(SourcePos pos);
+    void tail_return(Value call, SourcePos pos);
 
-    Value get_identifier_addr(std::string ident, SourcePos pos);
-    Value get_identifier_value(std::string ident, SourcePos pos);
-    Type lookup_type(std::string tname, SourcePos pos);
+    Value get_identifier_addr(Symbol ident, SourcePos pos);
+    Value get_identifier_value(Symbol ident, SourcePos pos);
+    void define_constant(Symbol name, const Type &t, Value val,
+                         SourcePos pos);
+    void define_global(Symbol name, const Type &t, boost::optional<Value> init,
+                       bool is_thread_local, bool define, SourcePos pos);
+    Value get_constant(Symbol ident, SourcePos pos);
+    Type lookup_type(Symbol tname, SourcePos pos);
 
     void push_scope(void);
     void pop_scope(void);
 
-    void bind_type(std::string, Type t);
+    void bind_type(Symbol, Type t);
 
-    Type specialize_template(std::string template_name,
+    Type specialize_template(Symbol template_name,
                              const std::vector<Type> &args,
                              SourcePos pos);
-    Struct<TemplateType> respecialize_template(std::string template_name,
+    Struct<TemplateType> respecialize_template(Symbol template_name,
                                                const std::vector<TemplateType>
                                                &args,
                                                SourcePos pos);
 
-    void register_template(std::string name,
+    void register_template(Symbol name,
                            std::shared_ptr<AST::FunctionDefinition>,
-                           std::vector<std::string> args,
+                           std::vector<Symbol> args,
                            TemplateFunction func);
-    void register_template(TemplateStruct, std::string name);
+    void register_template(TemplateStruct, Symbol name);
+    void register_const_function(std::shared_ptr<AST::FunctionDefinition>);
+    std::shared_ptr<AST::FunctionDefinition> lookup_const_function(
+            Symbol name) const;
+    void set_resolver(std::function<bool(Symbol)> resolver);
 
 
     IfThenElse create_ifthenelse(Value cond, SourcePos pos);
     void point_to_else(IfThenElse &structure);
     void end_ifthenelse(IfThenElse structure);
-    void create_function_prototype(Function<> f, std::string name);
-    void create_and_start_function(Function<> f, std::vector<std::string> args,
-                                   std::string name);
+    Loop create_loop(const LoopHints &hints);
+    void start_loop_body(Loop &loop, Value cond, SourcePos pos);
+    void start_loop_step(Loop &loop);
+    void end_loop(Loop loop);
+    void create_function_prototype(Function<> f, std::string name,
+                                   SourcePos pos,
+                                   const FunctionAttributes &attrs);
+    void create_and_start_function(Function<> f, std::vector<Symbol> args,
+                                   std::string name, SourcePos pos,
+                                   const FunctionAttributes &attrs);
+    std::vector<std::pair<std::string, FunctionAttributes> >
+    create_dispatcher(Function<> f, std::string name, SourcePos pos,
+                      const FunctionAttributes &attrs);
 
     void create_struct(Struct<> t);
 
@@ -121,29 +180,392 @@ public:
         end_function(void);
 
     void validate(std::ostream &);
-    void optimize(int opt_level);
+    void optimize(int opt_level, int size_level, OptPhase phase);
     void emit_ir(std::ostream &);
     void emit_obj(int fd);
     void emit_asm(int fd);
+    void emit_bitcode(std::ostream &);
+    void emit_bc(int fd);
+    void emit(const std::vector<Artifact> &artifacts,
+              const ArtifactSink &sink);
+    ModuleCounts counts(void);
+    void link_bitcode(const std::vector<std::string> &bitcode);
+    int run(const std::string &entry, const std::vector<std::string> &args);
+    std::string extract_bitcode(const std::string &function,
+                                const std::vector<std::string> &declare);
+    std::string extract_optimized_bitcode(
+            const std::string &function,
+            const std::vector<std::string> &declare,
+            int opt_level, int size_level, OptPhase phase);
+    std::vector<std::string> callees(const std::string &function);
+    std::vector<std::string> undefined_functions(void);
+    void internalize(const std::vector<std::string> &names);
+
+    /**
+     * @brief See `Translator::set_external_instances`.
+     */
+    std::function<bool(const std::string &)> external_instances;
+
+    /**
+     * @brief See `Translator::set_profile`.
+     */
+    ProfileOptions profile;
+
+    void set_debug_level(DebugLevel level);
+    void set_fast_math(const FastMath &flags);
+    void set_wrapping_overflow(void);
+    void set_remarks(const std::string &passes);
+    void set_fast_backend(void);
+    void set_backend_threads(unsigned n);
+    std::string take_remarks(void);
+    void set_location(SourcePos pos);
 
     llvm::LLVMContext &get_ctx(void) { return context; }
 
 private:
-    inline std::pair<unsigned, Type *>
+    inline std::pair<unsigned, const Type *>
     get_field_idx(Type t, std::string field, SourcePos pos);
 
     /**
-     * @brief The return type of the current function, or NULL if none.
+     * @brief The alignment of the memory a pointer value points to.
+     */
+    unsigned pointee_align(const Value &pointer);
+
+    /**
+     * @brief Get the type an atomic operation through the given pointer
+     *        acts on, checking that it is an integer or pointer of a size
+     *        the target can access atomically.
+     */
+    const Type &atomic_pointee(const Value &pointer, SourcePos pos);
+
+    /**
+     * @brief Make sure an alloca is at least as aligned as values of type `t`.
+     */
+    void raise_alignment(llvm::AllocaInst *alloca, const Type &t);
+
+    /**
+     * @brief Make stack space for a value of type `t` in the entry block of
+     *        the current function, aligned for it.
+     *
+     * Only allocas in the entry block are promoted to registers, and there
+     * they're allocated once however often the code around them runs.
+     */
+    llvm::AllocaInst *entry_alloca(const Type &t, const std::string &name);
+    llvm::AllocaInst *entry_alloca(llvm::Type *t, const std::string &name);
+
+    /**
+     * @brief Store a value to memory.
+     *
+     * Zeroed aggregates are stored with `llvm.memset`, and big ones just
+     * loaded from memory are copied from there with `llvm.memcpy`, rather
+     * than through registers a field at a time.
+     *
+     * @return The instruction storing it.
+     */
+    llvm::Instruction *store_value(const Value &val, llvm::Value *addr,
+                                   llvm::Align align);
+
+    /**
+     * @defgroup Passing structs and arrays as the target's ABI does (see
+     *           `AbiLowering`).
+     *
+     * @{
+     */
+
+    /**
+     * @brief Call a function, passing its arguments and getting its result
+     *        as its ABI says.
+     */
+    Value call_function(llvm::Function *callee, const Function<> &type,
+                        const std::vector<Value> &args);
+
+    /**
+     * @brief Split a value into the parts it is passed as.
+     */
+    std::vector<llvm::Value *> split_value(const Value &val,
+                                           const AbiValue &lowered);
+
+    /**
+     * @brief Store the parts a value was passed as into memory for it,
+     *        aligned for type `t`.
+     */
+    void store_parts(llvm::ArrayRef<llvm::Value *> parts,
+                     const AbiValue &lowered, llvm::Value *addr,
+                     const Type &t);
+
+    /**
+     * @brief The lowering of the current function.
+     */
+    const FunctionAbi *function_abi = nullptr;
+
+    /**
+     * @brief The last call whose result did not come straight from the call
+     *        instruction, so `become` can undo the conversion.
+     */
+    struct LoweredCall {
+        llvm::Value *result;
+        llvm::CallInst *call;
+    };
+
+    LoweredCall last_call { nullptr, nullptr };
+
+    /** @} */
+
+    /**
+     * @brief Extend or truncate an array index to the width of a pointer.
      */
-    Type *rettype;
+    llvm::Value *gep_index(Value index);
+
+    /**
+     * @brief The -O1 pipeline: a handful of cheap function passes.
+     */
+    void optimize_quick(void);
+
+    /**
+     * @brief Keep scalar locals in registers rather than on the stack, as
+     *        cheaply as possible: the only transformation made at -O0.
+     */
+    void promote_locals(void);
+
+    /**
+     * @brief Split each `async fn` into its ramp, resume and destroy
+     *        functions, for pipelines which don't do so themselves.
+     */
+    void lower_coroutines(void);
+
+    /**
+     * @brief Tag a function with the target CPU and features, with any the
+     *        function adds.
+     */
+    void set_target_attributes(llvm::Function *f,
+                               const FunctionAttributes &attrs);
+
+    /**
+     * @brief Let the linker merge a function with its copies in other
+     *        modules, and the optimizer drop it once it is unused: give it
+     *        `linkonce_odr` linkage, in a COMDAT of its own where the object
+     *        format has them.
+     *
+     * For template instantiations, which every module using them defines.
+     */
+    void make_mergeable(llvm::Function *f);
+
+    /**
+     * @brief Add the attributes the user asked for to a function.
+     */
+    static void set_attributes(llvm::Function *f,
+                               const FunctionAttributes &attrs);
+
+    /**
+     * @brief Mark every function in the module as not unwinding.
+     */
+    void mark_nounwind(void);
+
+    /**
+     * @brief Finish the debug information, if any, before the module is
+     *        verified, optimized or written.
+     */
+    void finish_debug_info(void);
+
+    /**
+     * @brief Write bitcode with a ThinLTO summary.
+     */
+    void write_bc(llvm::raw_ostream &out);
+
+    /**
+     * @brief Run the backend on the module, producing assembly or an object.
+     */
+    std::string run_backend(llvm::CodeGenFileType type);
+
+    /**
+     * @brief Generate an object on `backend_threads` threads: split the
+     *        module into that many parts, run the backend on each in a
+     *        context of its own, and merge the objects with `ld -r`.
+     */
+    std::string run_backend_split(void);
+
+    /**
+     * @brief Combine objects into one with a relocatable link.
+     */
+    std::string link_objects(const std::vector<std::string> &objects);
+
+    /**
+     * @brief Assemble assembly from `run_backend` into an object.
+     */
+    std::string assemble(const std::string &assembly);
+
+    /**
+     * @brief The return type of the current function, if any.
+     *
+     * For an `async fn`, the type of its result rather than its handle.
+     */
+    boost::optional<Type> rettype;
+
+    /**
+     * @defgroup Coroutines, for `async fn`s.
+     *
+     * @{
+     */
+
+    /**
+     * @brief Record that the named function is an `async fn`, returning the
+     *        type of the function as called: taking the same arguments, but
+     *        returning a handle to the coroutine.
+     */
+    Function<> async_function(const std::string &name, const Function<> &f);
+
+    /**
+     * @brief Start the body of an `async fn`: allocate its frame and set up
+     *        the blocks it suspends and finishes through.
+     */
+    void start_coroutine(llvm::Function *f, const Type &result,
+                         SourcePos pos);
+
+    /**
+     * @brief Finish the body of the current `async fn`.
+     */
+    void end_coroutine(void);
+
+    /**
+     * @brief Get one of the functions `async fn`s allocate their frames
+     *        with, which must be declared with the given type.
+     *
+     * @param declaration How the function should be declared, for errors.
+     */
+    llvm::Function *async_hook(Symbol name, const Function<> &type,
+                               const std::string &declaration,
+                               SourcePos pos);
+
+    /**
+     * @brief Suspend the current `async fn`, continuing in a new block when
+     *        it is resumed.
+     */
+    llvm::Instruction *suspend(void);
+
+    /**
+     * @brief Check that the given value is a coroutine handle.
+     */
+    static void check_handle(const Value &handle, SourcePos pos);
+
+    /**
+     * @brief The blocks and values of the `async fn` being generated.
+     */
+    struct Coroutine {
+        llvm::Value *id;
+        llvm::Value *handle;
+
+        /** @brief Where the result is kept for the awaiting caller, if any. */
+        llvm::AllocaInst *promise;
+
+        /** @brief The final suspend point, where returns go. */
+        Block final_suspend;
+
+        /** @brief Where the frame is freed when the coroutine is destroyed. */
+        llvm::BasicBlock *cleanup;
+
+        /** @brief Where control returns to the caller or resumer. */
+        llvm::BasicBlock *suspended;
+
+        /** @brief The blocks to move after the body once it is done. */
+        std::vector<llvm::BasicBlock *> epilogue;
+    };
+
+    boost::optional<Coroutine> coroutine;
+
+    /** @brief The result type of each `async fn` declared, by name. */
+    std::unordered_map<std::string, Type> async_results;
+
+    /** @} */
 
     /**
      * @brief The list of specializations that are used but have not yet been
      *        defined.
+     *
+     * Each instantiation is added exactly once, when it is first entered in
+     * `function_instances`.
      */
     std::vector< std::pair< std::vector<Type>, TemplateValue > >
         specializations;
 
+    /**
+     * @brief A template function specialized for particular arguments.
+     */
+    struct FunctionInstance {
+        Function<> type;
+        llvm::Function *function;
+    };
+
+    /**
+     * @brief Every template function instantiation used in this module.
+     */
+    std::unordered_map<InstanceKey, FunctionInstance> function_instances;
+
+    /**
+     * @brief Every template struct instantiation used in this module.
+     */
+    std::unordered_map<InstanceKey, Type> struct_instances;
+
+    /**
+     * @defgroup Alias scopes for `restrict` pointers.
+     *
+     * Each `restrict` variable in the current function gets its own scope.
+     * Memory accesses through pointers based on one are recorded, and once
+     * the function is done, marked as not aliasing accesses based on any of
+     * the others.
+     *
+     * @{
+     */
+
+    /**
+     * @brief Mark `noalias` the `restrict` parameters of a function, and
+     *        give those passing values in memory their ABI attributes.
+     */
+    void set_param_attributes(llvm::Function *f, const Function<> &t);
+
+    /**
+     * @brief Mark the result of an `@malloc` function `noalias`, and its size
+     *        argument `allocsize`.
+     */
+    void set_allocator_attributes(llvm::Function *f, const Function<> &t,
+                                  const FunctionAttributes &attrs,
+                                  SourcePos pos);
+
+    /**
+     * @brief Get a function of the C library which `allocate` and
+     *        `deallocate` call, declaring it if need be.
+     */
+    llvm::Function *c_allocator(const std::string &name,
+                                llvm::FunctionType *type, SourcePos pos);
+
+    /**
+     * @brief Give a new variable a scope if it is a `restrict` pointer.
+     */
+    void add_restrict_variable(llvm::AllocaInst *alloca, const Type &t);
+
+    /**
+     * @brief Record an access through `pointer` if it has a scope.
+     */
+    void note_access(llvm::Instruction *inst, const Value &pointer);
+
+    /**
+     * @brief Mark the accesses in the current function, and forget its
+     *        scopes.
+     */
+    void add_alias_metadata(void);
+
+    /** @brief The scope of each `restrict` variable, by its address. */
+    std::unordered_map<llvm::Value *, llvm::MDNode *> restrict_variables;
+
+    /** @brief The domain of the current function's scopes, if it has any. */
+    llvm::MDNode *alias_domain = nullptr;
+
+    std::vector<llvm::MDNode *> alias_scopes;
+
+    std::vector<std::pair<llvm::Instruction *, llvm::MDNode *> >
+        restricted_accesses;
+
+    /** @} */
+
     /**
      * @brief Move to the other block.
      */
@@ -156,12 +578,27 @@ private:
      */
     std::string fname;
 
+    /** @brief The compilation's source files, for error messages. */
+    SourceManager &sources;
+
+    /**
+     * @brief The optimization remarks recorded so far, and the stream LLVM
+     *        writes them to, if they are being recorded.
+     *
+     * Declared before the context, so that they outlive it.
+     */
+    std::string remarks;
+    std::unique_ptr<llvm::raw_string_ostream> remarks_out;
+
     /**
      * @brief The compilation context.
      *
-     * Essentially holds all LLVM state not particular to a module.
+     * Essentially holds all LLVM state not particular to a module.  Owned
+     * through a pointer so that it can be handed off along with the module
+     * (see `run`).
      */
-    llvm::LLVMContext context;
+    std::unique_ptr<llvm::LLVMContext> owned_context;
+    llvm::LLVMContext &context;
 
     /**
      * @brief LLVM's helper for emitting IR.
@@ -173,16 +610,48 @@ private:
      */
     std::unique_ptr<llvm::Module> module;
 
+    /**
+     * @brief The LLVM types corresponding to Craeft types in this module.
+     */
+    LlvmTypeCache types;
+
+    /**
+     * @brief How functions in this module pass their arguments and results.
+     */
+    AbiLowering abi;
+
+    /**
+     * @brief The module's debug information, if it has any.
+     */
+    std::unique_ptr<DebugInfoGen> debug;
+    DebugLevel debug_level = DebugLevel::None;
+
+    /**
+     * @brief The fast-math flags of functions which don't set their own.
+     */
+    FastMath fast_math;
+
+    /** @brief Whether signed arithmetic wraps around on overflow. */
+    bool wrapping_overflow = false;
+
     /**
      * @brief Current namespace.
      */
     Environment env;
 
+    /**
+     * @brief What to generate code for; resolved, so never "native".
+     */
+    TargetSpec target_spec;
+
     /**
      * @brief The target machine (target triple + CPU information).
      */
 	llvm::TargetMachine *target;
 
+    /** @brief How many threads to generate object code on. */
+    unsigned backend_threads = 1;
+
     /**
      * @brief The block currently writing to.
      */
@@ -25,10 +25,14 @@
 
 #include <memory>
 #include <sstream>
+#include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/variant.hpp>
 
+#include "Symbol.hh"
+
 // Forward-declare LLVM things.
 namespace llvm {
     class Type;
@@ -143,51 +147,173 @@ public:
     bool operator==(const Void &other) const { return true; }
 };
 
-struct Type;
+/**
+ * @brief An integer given to a template in place of a type, for one of its
+ *        integer parameters (see `is_integer_parameter`).
+ *
+ * It is the type of no value; it is one only so that template arguments are
+ * all `Type`s, and instances are keyed and named alike whatever they take.
+ */
+class IntegerArg {
+public:
+    IntegerArg(uint64_t value): value(value) {}
+
+    uint64_t get_value(void) const { return value; }
+
+    bool operator==(const IntegerArg &other) const {
+        return value == other.value;
+    }
+
+private:
+    uint64_t value;
+};
+
+class Type;
 
 /*****************************************************************************
  * Generic, "nonterminal" types.
  */
 
+/**
+ * @brief How nonterminal types hold the types they are built from.
+ *
+ * Template types own their components.  Completed types are interned (see
+ * `Type`), so a component is just a handle to the canonical type.
+ */
+template<typename TypeType>
+struct Component {
+    typedef std::shared_ptr<TypeType> Ref;
+
+    static Ref make(const TypeType &t) { return std::make_shared<TypeType>(t); }
+
+    static const TypeType &get(const Ref &ref) { return *ref; }
+};
+
+template<>
+struct Component<Type> {
+    typedef Type Ref;
+
+    static const Type &make(const Type &t) { return t; }
+
+    static const Type &get(const Type &ref) { return ref; }
+};
+
 /**
  * @brief Pointer types.
  */
 template<typename TypeType=Type>
 class Pointer {
 public:
+    typedef typename Component<TypeType>::Ref Ref;
+
     /**
      * @brief Build a pointer type pointing to the given type.
+     *
+     * @param restrict Whether the pointer is `restrict`-qualified: while it
+     *                 is live, the memory it is used to access is accessed
+     *                 through no other pointer.
      */
-    Pointer(TypeType pointed)
-        : pointed(std::make_shared<TypeType>(pointed)) {}
+    Pointer(const TypeType &pointed, bool restrict=false)
+        : pointed(Component<TypeType>::make(pointed)), restrict(restrict) {}
 
-    Pointer(std::shared_ptr<TypeType> pointed): pointed(pointed) {}
+    const TypeType *get_pointed(void) const {
+        return &Component<TypeType>::get(pointed);
+    }
 
-    TypeType *get_pointed(void) const { return pointed.get(); }
+    bool is_restrict(void) const { return restrict; }
 
     bool operator==(const Pointer<TypeType> &other) const {
-        return *pointed == *other.pointed;
+        return *get_pointed() == *other.get_pointed()
+            && restrict == other.restrict;
     }
 
 private:
-    std::shared_ptr<TypeType> pointed;
+    Ref pointed;
+    bool restrict;
 };
 
+/**
+ * @brief Fixed-length SIMD vectors of integers or floats.
+ *
+ * Arithmetic, bitwise operations and comparisons on vectors work element by
+ * element.
+ */
 template<typename TypeType=Type>
-class Function {
+class Vector {
+public:
+    typedef typename Component<TypeType>::Ref Ref;
+
+    /**
+     * @brief Build a vector of `lanes` elements of the given type.
+     */
+    Vector(const TypeType &element, unsigned lanes)
+        : element(Component<TypeType>::make(element)), lanes(lanes) {}
+
+    const TypeType *get_element(void) const {
+        return &Component<TypeType>::get(element);
+    }
+
+    unsigned get_lanes(void) const { return lanes; }
+
+    bool operator==(const Vector<TypeType> &other) const {
+        return lanes == other.lanes && *get_element() == *other.get_element();
+    }
+
+private:
+    Ref element;
+    unsigned lanes;
+};
+
+/**
+ * @brief Fixed-length arrays, stored contiguously in place.
+ */
+template<typename TypeType=Type>
+class Array {
 public:
-    Function(std::shared_ptr<TypeType> rettype,
-             std::vector<std::shared_ptr<TypeType> >args)
-          : rettype(rettype), args(args) {
-        assert(rettype.get());
+    typedef typename Component<TypeType>::Ref Ref;
+
+    /**
+     * @brief Build an array of `length` elements of the given type.
+     *
+     * @param length_parameter In a template type, the index of the integer
+     *                         parameter giving the length in place of
+     *                         `length`, or -1 if there is none.
+     */
+    Array(const TypeType &element, uint64_t length, int length_parameter=-1)
+        : element(Component<TypeType>::make(element)), length(length),
+          length_parameter(length_parameter) {}
+
+    const TypeType *get_element(void) const {
+        return &Component<TypeType>::get(element);
+    }
+
+    uint64_t get_length(void) const { return length; }
+
+    int get_length_parameter(void) const { return length_parameter; }
+
+    bool operator==(const Array<TypeType> &other) const {
+        return length == other.length
+            && length_parameter == other.length_parameter
+            && *get_element() == *other.get_element();
     }
 
-    /*Function(Function<TypeType> &other):
-        rettype(other.rettype), args(other.args) {}*/
+private:
+    Ref element;
+    uint64_t length;
+    int length_parameter;
+};
+
+template<typename TypeType=Type>
+class Function {
+public:
+    typedef typename Component<TypeType>::Ref Ref;
+
+    Function(Ref rettype, std::vector<Ref> args)
+          : rettype(rettype), args(args) {}
 
     bool operator==(const Function<TypeType> &other) const {
         // Check that return types are equal,
-        if (*other.rettype != *rettype) {
+        if (*other.get_rettype() != *get_rettype()) {
             return false;
         }
 
@@ -197,7 +323,8 @@ public:
 
         // and argument types are equal.
         for (unsigned i = 0; i < args.size(); ++i) {
-            if (*args[i] != *other.args[i]) {
+            if (Component<TypeType>::get(args[i])
+             != Component<TypeType>::get(other.args[i])) {
                 return false;
             }
         }
@@ -205,39 +332,79 @@ public:
         return true;
     }
 
-    TypeType *get_rettype(void) const {
-        return rettype.get();
+    const TypeType *get_rettype(void) const {
+        return &Component<TypeType>::get(rettype);
     }
 
-    const std::vector<std::shared_ptr<TypeType> > &get_args(void) const {
+    const std::vector<Ref> &get_args(void) const {
         return args;
     }
 
 private:
-    std::shared_ptr<TypeType> rettype;
-    std::vector<std::shared_ptr<TypeType> > args;
+    Ref rettype;
+    std::vector<Ref> args;
 };
 
 /**
  * @brief Craeft structs.
  */
+/**
+ * @brief How the fields of a struct are placed in memory.
+ *
+ * By default, fields are laid out in order, each at its natural alignment,
+ * as C does.
+ */
+struct StructLayout {
+    /** @brief The minimum alignment of the struct, or 0 for the natural. */
+    unsigned align = 0;
+
+    /** @brief Whether to leave out the padding normally between fields. */
+    bool packed = false;
+
+    /**
+     * @brief Whether to place fields by decreasing alignment and size, to
+     *        minimize padding, instead of in order.
+     */
+    bool reorder = false;
+
+    /**
+     * @brief The minimum alignment of each field, or 0 for its natural one.
+     *
+     * Empty if no field has one.
+     */
+    std::vector<unsigned> field_aligns;
+
+    bool is_default(void) const {
+        return !align && !packed && !reorder && field_aligns.empty();
+    }
+
+    bool operator==(const StructLayout &other) const {
+        return align == other.align && packed == other.packed
+            && reorder == other.reorder && field_aligns == other.field_aligns;
+    }
+
+    bool operator!=(const StructLayout &other) const {
+        return !(*this == other);
+    }
+};
+
 template<typename TypeType=Type>
 class Struct {
 public:
+    typedef typename Component<TypeType>::Ref Ref;
+
     /**
      * @brief Create a new struct type.
      *
      * @param fields An array of field name/type pairs.
      */
-    Struct(std::vector< std::pair< std::string, std::shared_ptr<TypeType> > >
-                fields,
-            std::string name)
-          : fields(fields), name(name) {
+    Struct(std::vector< std::pair<std::string, Ref> > fields,
+           std::string name, StructLayout layout=StructLayout())
+          : fields(fields), name(name), layout(std::move(layout)) {
 
     }
 
-    const std::vector<std::pair<std::string, std::shared_ptr<TypeType> > > &
-          get_fields(void) const {
+    const std::vector<std::pair<std::string, Ref> > &get_fields(void) const {
         return fields;
     }
 
@@ -245,15 +412,25 @@ public:
         return name;
     }
 
+    const StructLayout &get_layout(void) const {
+        return layout;
+    }
+
+    /**
+     * @brief Structs are equal if they have the same name, fields and
+     *        layout.
+     */
     bool operator==(const Struct<TypeType> &other) const {
-        if (fields.size() != other.fields.size()) {
+        if (name != other.name || fields.size() != other.fields.size()
+         || layout != other.layout) {
             return false;
         }
 
         // Check that field types are equal.
         for (unsigned i = 0; i < fields.size(); ++i) {
             if ((fields[i].first != other.fields[i].first)
-             || (*fields[i].second != other.fields[i].second)) {
+             || (Component<TypeType>::get(fields[i].second)
+              != Component<TypeType>::get(other.fields[i].second))) {
                 return false;
             }
         }
@@ -267,20 +444,22 @@ public:
      *
      * Return `(-1, nullptr)` if no such field.
      */
-    std::pair<int, TypeType *>operator[](std::string field_name) {
+    std::pair<int, const TypeType *>operator[](std::string field_name) const {
         for (int i = 0; i < (int)fields.size(); ++i) {
             const auto &pair = fields[i];
             if (pair.first == field_name) {
-                return std::pair<int, TypeType *>(i, pair.second.get());
+                return std::pair<int, const TypeType *>(
+                        i, &Component<TypeType>::get(pair.second));
             }
         }
 
-        return std::pair<int, TypeType *>(-1, NULL);
+        return std::pair<int, const TypeType *>(-1, NULL);
     }
 
 private:
-    std::vector< std::pair< std::string, std::shared_ptr<TypeType> > > fields;
+    std::vector< std::pair<std::string, Ref> > fields;
     std::string name;
+    StructLayout layout;
 };
 
 
@@ -289,37 +468,144 @@ private:
  */
 
 typedef boost::variant<SignedInt, UnsignedInt, Float, Void, Pointer<Type>,
-                       Function<Type>, Struct<Type> > _Type;
+                       Function<Type>, Struct<Type>, Vector<Type>,
+                       Array<Type>, IntegerArg> _Type;
+
+struct TypeNode;
 
 /**
  * @brief Internal representation of Craeft types.
  *
  * Both represents everything about Craeft types and allows for simple
  * translation to the corresponding LLVM type.
+ *
+ * Types are hash-consed: constructing a `Type` looks the structure up in a
+ * global table, so that each distinct type is a single canonical node.  A
+ * `Type` is just a handle to that node, which makes copies and comparisons
+ * O(1), and lets the node cache derived information such as the type's name.
  */
-struct Type: public _Type {
-    template<typename... Args>
-    Type(Args... args): _Type(args...) {}
+class Type {
+public:
+    /**
+     * @brief Get the canonical type with the given structure.
+     */
+    template<typename T>
+    Type(const T &t): node(intern(_Type(t))) {}
+
+    /**
+     * @brief Get the structure of this type.
+     *
+     * Use this to visit the type or to `boost::get` a particular kind of type.
+     */
+    const _Type &variant(void) const;
+
+    /**
+     * @brief The type of the underlying variant, as for `boost::variant`.
+     */
+    const std::type_info &type(void) const { return variant().type(); }
+
+    /**
+     * @brief Get a unique name for this type, usable in mangled names.
+     */
+    const std::string &get_name(void) const;
+
+    /**
+     * @brief Two types are equal exactly if they are the same canonical type.
+     */
+    bool operator==(const Type &other) const { return node == other.node; }
+
+    bool operator!=(const Type &other) const { return node != other.node; }
+
+    /**
+     * @brief A hash consistent with `==`.
+     */
+    size_t hash(void) const { return std::hash<const TypeNode *>()(node); }
+
+private:
+    static const TypeNode *intern(const _Type &structure);
+
+    const TypeNode *node;
+};
 
-    bool operator==(const _Type &other) const {
-        return (const _Type &)(*this) == other;
-    } 
+}
+
+namespace std {
 
-    bool operator!=(const Type &other) const {
-        return !((const Type &)(*this) == other);
-    } 
+template<>
+struct hash<Craeft::Type> {
+    size_t operator()(const Craeft::Type &t) const { return t.hash(); }
 };
 
+}
+
+namespace Craeft {
+
 /**
- * @brief Convert the given type to a corresponding LLVM type.
+ * @brief Converts Craeft types to the corresponding LLVM types in a module's
+ *        context.
  *
  * The LLVM type may encode less information, but all operations which are
  * possible on the Craeft type can be represented in LLVM on the returned
- * type.
+ * type.  Results are cached, so each type is only converted once per context.
  */
-llvm::Type *to_llvm_type(const Type &t, llvm::Module &module);
+class LlvmTypeCache {
+public:
+    explicit LlvmTypeCache(llvm::Module &module);
+
+    /**
+     * @brief Get the LLVM type corresponding to the given type.
+     */
+    llvm::Type *get(const Type &t);
+
+    /**
+     * @brief Get the alignment in bytes of values of the given type.
+     *
+     * This can be more than LLVM's alignment for the LLVM type, for structs
+     * with a custom layout, so it should be set on every memory access.
+     */
+    unsigned get_alignment(const Type &t);
 
-std::string get_name(Type t);
+    /**
+     * @brief Get the index of a struct's field in its LLVM type, which need
+     *        not be the same as in the struct.
+     */
+    unsigned get_field_index(const Struct<Type> &str, unsigned field);
+
+    /**
+     * @brief Where a struct's fields go in its LLVM type.
+     */
+    struct FieldPlacement {
+        /** @brief The LLVM index of each field. */
+        std::vector<unsigned> indices;
+        /** @brief The alignment of the struct. */
+        unsigned align;
+    };
+
+private:
+    const FieldPlacement &get_placement(const Struct<Type> &str);
+
+    llvm::StructType *lay_out(const Struct<Type> &str);
+
+    llvm::Module &module;
+
+    std::unordered_map<Type, llvm::Type *> cache;
+
+    std::unordered_map<Type, unsigned> alignments;
+
+    /* Keyed by name, like LLVM's named structs. */
+    std::unordered_map<std::string, FieldPlacement> placements;
+
+    friend struct ToLlvmVisitor;
+};
+
+const std::string &get_name(const Type &t);
+
+/**
+ * @brief Get a type without any `restrict` qualifier on it.
+ *
+ * Values of the two types can be used in place of each other.
+ */
+Type unqualified(const Type &t);
 
 /*****************************************************************************
  * Template types: types with template parameters potentially missing.
@@ -327,11 +613,34 @@ std::string get_name(Type t);
 
 struct TemplateType;
 
+/**
+ * @brief Whether a template parameter stands for an integer, such as an
+ *        array length, rather than for a type.  Integer parameters are named
+ *        like values, in lower case.
+ */
+bool is_integer_parameter(Symbol name);
+
+/**
+ * @brief A use of an integer template parameter in a template type.  Plain
+ *        `int`s are uses of type parameters.
+ */
+struct IntegerParameter {
+    int index;
+
+    bool operator==(const IntegerParameter &other) const {
+        return index == other.index;
+    }
+};
+
 struct TemplateStruct {
-    TemplateStruct(Struct<TemplateType> inner, int n_parameters);
+    TemplateStruct(Struct<TemplateType> inner,
+                   std::vector<Symbol> parameters);
 
     int n_parameters;
 
+    /** @brief The names of the parameters, in order. */
+    std::vector<Symbol> parameters;
+
     Struct<TemplateType> inner;
 
     int get_nparameters(void) const;
@@ -348,7 +657,7 @@ struct TemplateFunction {
     int n_parameters;
 
     TemplateFunction(Function<TemplateType> inner,
-                     std::vector<std::string> args);
+                     std::vector<Symbol> args);
 
     Function<TemplateType> inner;
 
@@ -361,7 +670,9 @@ struct TemplateFunction {
 
 typedef boost::variant<SignedInt, UnsignedInt, Float, Void,
                        Pointer<TemplateType>, Struct<TemplateType>,
-                       Function<TemplateType>, int>
+                       Function<TemplateType>, Vector<TemplateType>,
+                       Array<TemplateType>, int, IntegerArg,
+                       IntegerParameter>
         _TemplateType;
 
 struct TemplateType: public _TemplateType {
@@ -388,4 +699,42 @@ Type specialize(const TemplateType &temp,
 std::string mangle_name(std::string fname,
                         const std::vector<Type> &args);
 
+/**
+ * @brief Check whether the given label was produced by `mangle_name`.
+ */
+bool is_mangled_name(const std::string &name);
+
+/**
+ * @brief Identifies an instantiation of a template: the template's name and
+ *        its (canonical) arguments.
+ */
+struct InstanceKey {
+    InstanceKey(Symbol name, std::vector<Type> args)
+        : name(name), args(std::move(args)) {}
+
+    Symbol name;
+    std::vector<Type> args;
+
+    bool operator==(const InstanceKey &other) const {
+        return name == other.name && args == other.args;
+    }
+};
+
+}
+
+namespace std {
+
+template<>
+struct hash<Craeft::InstanceKey> {
+    size_t operator()(const Craeft::InstanceKey &key) const {
+        size_t result = key.name.id();
+
+        for (const auto &arg: key.args) {
+            result = result * 31 + arg.hash();
+        }
+
+        return result;
+    }
+};
+
 }
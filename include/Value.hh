@@ -30,6 +30,7 @@
 
 // Forward-declare llvm::Value.
 namespace llvm {
+    class MDNode;
     class Value;
 }
 
@@ -50,6 +51,14 @@ public:
      */
     Value(llvm::Value *inst, Type ty);
 
+    /**
+     * @brief Make a new pointer value to memory which is less aligned than
+     *        its pointed-to type, such as a field of a packed struct.
+     *
+     * @param pointee_align The alignment in bytes of the pointed-to memory.
+     */
+    Value(llvm::Value *inst, Type ty, unsigned pointee_align);
+
     /**
      * @brief Convert this Craeft value to an LLVM value.
      */
@@ -62,9 +71,25 @@ public:
      */
     const Type &get_type(void) const { return ty; }
 
+    /**
+     * @brief Get the alignment of the memory this pointer points to, or 0 if
+     *        it is that of the pointed-to type.
+     */
+    unsigned get_pointee_align(void) const { return pointee_align; }
+
+    /**
+     * @brief Get the alias scope of the `restrict` pointer this pointer is
+     *        based on, or null if it is not known to be based on one.
+     */
+    llvm::MDNode *get_alias_scope(void) const { return alias_scope; }
+
+    void set_alias_scope(llvm::MDNode *scope) { alias_scope = scope; }
+
 private:
     llvm::Value *inst;
     Type ty;
+    unsigned pointee_align;
+    llvm::MDNode *alias_scope;
 };
 
 }
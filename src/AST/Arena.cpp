@@ -0,0 +1,45 @@
+/**
+ * @file AST/Arena.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AST/Arena.hh"
+
+namespace Craeft {
+
+namespace AST {
+
+static thread_local Arena *current_arena = nullptr;
+
+Arena *Arena::current(void) {
+    return current_arena;
+}
+
+ArenaScope::ArenaScope(Arena &arena): saved(current_arena) {
+    current_arena = &arena;
+}
+
+ArenaScope::~ArenaScope(void) {
+    current_arena = saved;
+}
+
+}
+
+}
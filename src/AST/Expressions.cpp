@@ -77,8 +77,16 @@ private:
         out << ", " << access.field() << "}";
     }
 
+    void operator()(const Index &index) override {
+        out << "Index {";
+        visit(index.array());
+        out << ", ";
+        visit(index.index());
+        out << "}";
+    }
+
     void operator()(const Binop &bin) override {
-        out << "Binop {" << bin.op() << ", ";
+        out << "Binop {" << Tok::spelling(bin.op()) << ", ";
         visit(bin.lhs());
         out << ", ";
         visit(bin.rhs());
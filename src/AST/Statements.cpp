@@ -59,6 +59,8 @@ private:
 
         print_expr(decl.name(), out);
 
+        if (decl.zeroed()) out << ", {}";
+
         out << "}";
     }
 
@@ -75,7 +77,7 @@ private:
     }
 
     void operator()(const Return &ret) {
-        out << "Return {";
+        out << (ret.is_tail() ? "Become {" : "Return {");
 
         print_expr(ret.retval(), out);
 
@@ -118,11 +120,58 @@ private:
         out << "}}";
     }
 
+    void print_block(const std::vector<std::unique_ptr<Statement>> &block) {
+        out << "Body {";
+        for (const auto &stmt: block) {
+            visit(*stmt);
+            out << ", ";
+        }
+        out << "}";
+    }
+
+    void operator()(const WhileLoop &loop) {
+        out << "WhileLoop {";
+        print_annotations(loop.annotations(), out);
+        out << ", ";
+        print_expr(loop.condition(), out);
+        out << ", ";
+        print_block(loop.body());
+        out << "}";
+    }
+
+    void operator()(const ForLoop &loop) {
+        out << "ForLoop {";
+        print_annotations(loop.annotations(), out);
+        out << ", ";
+        if (loop.init()) visit(*loop.init());
+        out << ", ";
+        print_expr(loop.condition(), out);
+        out << ", ";
+        if (loop.step()) visit(*loop.step());
+        out << ", ";
+        print_block(loop.body());
+        out << "}";
+    }
+
     std::ostream &out;
 };
 
 }
 
+void print_annotations(const std::vector<Annotation> &annotations,
+                       std::ostream &out) {
+    out << "Annotations {";
+    for (const auto &annotation: annotations) {
+        out << annotation.name << "(";
+        for (const auto &arg: annotation.args) {
+            if (arg.first != Symbol()) out << arg.first << "=";
+            out << arg.second << ", ";
+        }
+        out << "), ";
+    }
+    out << "}";
+}
+
 void print_statement(const Statement &stmt, std::ostream &out) {
     StatementPrintVisitor printer(out);
     printer.visit(stmt);
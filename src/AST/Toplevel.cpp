@@ -40,11 +40,13 @@ private:
     }
 
     void operator()(const StructDeclaration &sdecl) override {
-        out << "StructDeclaration {" << sdecl.name();
+        out << "StructDeclaration {" << sdecl.name() << ", ";
+        print_annotations(sdecl.annotations(), out);
 
-        for (const auto &mem: sdecl.members()) {
+        for (size_t i = 0; i < sdecl.members().size(); ++i) {
             out << ", ";
-            print_statement(*mem, out);
+            print_annotations(sdecl.member_annotations()[i], out);
+            print_statement(*sdecl.members()[i], out);
         }
 
         out << "}";
@@ -52,6 +54,8 @@ private:
 
     void operator()(const FunctionDeclaration &fdecl) override {
         out << "FunctionDeclaration {" << fdecl.name() << ", ";
+        print_annotations(fdecl.annotations(), out);
+        out << ", ";
 
         for (const auto &arg: fdecl.args()) {
             print_statement(*arg, out);
@@ -99,6 +103,29 @@ private:
         out << "}";
     }
 
+    void operator()(const ConstDefinition &cd) override {
+        out << "ConstDefinition {";
+        print_statement(cd.decl(), out);
+        out << "}";
+    }
+
+    void operator()(const ConstFunctionDefinition &fd) override {
+        out << "ConstFunctionDefinition {";
+        operator()(*fd.def());
+        out << "}";
+    }
+
+    void operator()(const GlobalDefinition &gd) override {
+        out << "GlobalDefinition {";
+        if (gd.is_thread_local()) out << "thread_local, ";
+        print_statement(gd.decl(), out);
+        out << "}";
+    }
+
+    void operator()(const Import &import) override {
+        out << "Import {\"" << import.path() << "\"}";
+    }
+
     std::ostream &out;
 };
 
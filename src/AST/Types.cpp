@@ -60,9 +60,32 @@ private:
     void operator()(const Pointer &pt) override {
         out << "Pointer {";
         visit(pt.pointed());
+        if (pt.restrict()) out << ", restrict";
         out << "}";
     }
 
+    void operator()(const Vector &v) override {
+        out << "Vector {";
+        visit(v.element());
+        out << ", " << v.lanes() << "}";
+    }
+
+    void operator()(const Array &a) override {
+        out << "Array {";
+        visit(a.element());
+        out << ", ";
+        visit(a.length());
+        out << "}";
+    }
+
+    void operator()(const IntegerArg &i) override {
+        if (i.is_literal()) {
+            out << i.value();
+        } else {
+            out << i.name();
+        }
+    }
+
     std::ostream &out;
 };
 
@@ -0,0 +1,359 @@
+/**
+ * @file Abi.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Abi.hh"
+
+#include <algorithm>
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/DataLayout.h"
+
+#include "VariantUtils.hh"
+
+namespace Craeft {
+
+bool is_aggregate(const Type &t) {
+    return is_type<Struct<> >(t) || is_type<Array<> >(t);
+}
+
+AbiLowering::AbiLowering(llvm::Module &module, LlvmTypeCache &types)
+    : module(module), types(types) {}
+
+const FunctionAbi &AbiLowering::get(const Function<> &f) {
+    Type key(f);
+    auto found = cache.find(key);
+    if (found == cache.end()) {
+        found = cache.emplace(key, lower(f)).first;
+    }
+
+    return found->second;
+}
+
+FunctionAbi AbiLowering::lower(const Function<> &f) {
+    auto &ctx = module.getContext();
+
+    // The target is only known once the module's triple is set.
+    llvm::Triple triple(module.getTargetTriple());
+    auto convention = Convention::None;
+    if (triple.getArch() == llvm::Triple::x86_64) {
+        convention = triple.isOSWindows() ? Convention::Win64
+                                          : Convention::SysV;
+    } else if (triple.isAArch64()) {
+        convention = Convention::AArch64;
+    }
+
+    FunctionAbi result;
+    Registers left { 6, 8 };
+
+    auto classify = [&](const Type &t, bool is_result) {
+        switch (convention) {
+            case Convention::SysV:
+                return sysv(t, is_result, left);
+            case Convention::Win64:
+                return win64(t, is_result);
+            case Convention::AArch64:
+                return aarch64(t, is_result);
+            case Convention::None:
+                break;
+        }
+        return AbiValue();
+    };
+
+    const auto &rettype = *f.get_rettype();
+    result.result = classify(rettype, true);
+
+    std::vector<llvm::Type *> params;
+    llvm::Type *ret = nullptr;
+
+    switch (result.result.kind) {
+        case AbiValue::Direct:
+            ret = types.get(rettype);
+            break;
+        case AbiValue::Coerced: {
+            const auto &parts = result.result.parts;
+            ret = parts.size() == 1 ? parts[0]
+                                    : llvm::StructType::get(ctx, parts);
+            break;
+        }
+        case AbiValue::Indirect:
+            ret = llvm::Type::getVoidTy(ctx);
+            params.push_back(types.get(rettype)->getPointerTo());
+            // The pointer takes the first integer register.
+            if (left.integer) --left.integer;
+            break;
+    }
+
+    for (const auto &arg: f.get_args()) {
+        result.params.push_back(params.size());
+        result.args.push_back(classify(arg, false));
+
+        const auto &lowered = result.args.back();
+        switch (lowered.kind) {
+            case AbiValue::Direct:
+                params.push_back(types.get(arg));
+                break;
+            case AbiValue::Coerced:
+                params.insert(params.end(), lowered.parts.begin(),
+                              lowered.parts.end());
+                break;
+            case AbiValue::Indirect:
+                params.push_back(types.get(arg)->getPointerTo());
+                break;
+        }
+    }
+
+    result.type = llvm::FunctionType::get(ret, params, false);
+
+    return result;
+}
+
+namespace {
+
+/* The System V classes of an eightbyte, ignoring those for `long double`. */
+enum class Class { None, Integer, Sse, Memory };
+
+Class merge(Class l, Class r) {
+    if (l == r || r == Class::None) return l;
+    if (l == Class::None) return r;
+    if (l == Class::Memory || r == Class::Memory) return Class::Memory;
+    if (l == Class::Integer || r == Class::Integer) return Class::Integer;
+    return Class::Sse;
+}
+
+}
+
+AbiValue AbiLowering::sysv(const Type &t, bool result, Registers &left) {
+    const auto &dl = module.getDataLayout();
+    auto &ctx = module.getContext();
+
+    if (!is_aggregate(t)) {
+        // Scalars go in registers until they run out, then on the stack, as
+        // the backend does on its own; they only count against aggregates.
+        auto *ll = types.get(t);
+        if (ll->isVoidTy() || result) return AbiValue();
+
+        if (ll->isFloatingPointTy() || ll->isVectorTy()) {
+            if (left.sse) --left.sse;
+        } else {
+            auto words = (dl.getTypeAllocSize(ll).getFixedSize() + 7) / 8;
+            left.integer -= std::min<uint64_t>(words, left.integer);
+        }
+        return AbiValue();
+    }
+
+    auto size = size_of(t);
+    if (size == 0) return AbiValue();
+
+    std::vector<Leaf> scalars;
+    if (size > 16 || !leaves(t, 0, scalars)) {
+        return indirect(t, !result, 8);
+    }
+
+    Class classes[2] = { Class::None, Class::None };
+    for (const auto &leaf: scalars) {
+        auto cls = leaf.type->isFloatingPointTy() || leaf.type->isVectorTy()
+                 ? Class::Sse : Class::Integer;
+        auto end = leaf.offset
+                 + dl.getTypeAllocSize(leaf.type).getFixedSize();
+        for (auto i = leaf.offset / 8; i < (end + 7) / 8; ++i) {
+            classes[i] = merge(classes[i], cls);
+        }
+    }
+
+    unsigned words = (size + 7) / 8;
+    Registers needed { 0, 0 };
+    for (unsigned i = 0; i < words; ++i) {
+        if (classes[i] == Class::Memory) return indirect(t, !result, 8);
+        if (classes[i] == Class::Sse) {
+            ++needed.sse;
+        } else {
+            ++needed.integer;
+        }
+    }
+
+    // A 16-byte vector takes a whole register, not two halves.
+    if (scalars.size() == 1 && scalars[0].type->isVectorTy()
+     && size == 16) {
+        needed = { 0, 1 };
+    }
+
+    if (!result) {
+        if (needed.integer > left.integer || needed.sse > left.sse) {
+            return indirect(t, true, 8);
+        }
+        left.integer -= needed.integer;
+        left.sse -= needed.sse;
+    }
+
+    AbiValue lowered;
+    lowered.kind = AbiValue::Coerced;
+
+    if (needed.sse == 1 && needed.integer == 0 && words == 2) {
+        lowered.parts.push_back(scalars[0].type);
+        return lowered;
+    }
+
+    for (unsigned i = 0; i < words; ++i) {
+        auto bytes = std::min<uint64_t>(8, size - 8 * i);
+
+        if (classes[i] != Class::Sse) {
+            lowered.parts.push_back(llvm::IntegerType::get(ctx, bytes * 8));
+            continue;
+        }
+
+        // Floats alone in an eightbyte go as one or two of them.
+        bool low = false, high = false, other = false;
+        for (const auto &leaf: scalars) {
+            if (leaf.offset / 8 != i) continue;
+            if (!leaf.type->isFloatTy()) {
+                other = true;
+            } else if (leaf.offset % 8 == 0) {
+                low = true;
+            } else {
+                high = true;
+            }
+        }
+
+        auto *single = llvm::Type::getFloatTy(ctx);
+        if (other || !low) {
+            lowered.parts.push_back(llvm::Type::getDoubleTy(ctx));
+        } else if (high) {
+            lowered.parts.push_back(llvm::FixedVectorType::get(single, 2));
+        } else {
+            lowered.parts.push_back(single);
+        }
+    }
+
+    return lowered;
+}
+
+AbiValue AbiLowering::win64(const Type &t, bool result) {
+    if (!is_aggregate(t)) return AbiValue();
+
+    // Aggregates the size of an integer register are passed as one; any
+    // others by a pointer to a copy.
+    auto size = size_of(t);
+    if (size != 1 && size != 2 && size != 4 && size != 8) {
+        return indirect(t, false);
+    }
+
+    AbiValue lowered;
+    lowered.kind = AbiValue::Coerced;
+    lowered.parts.push_back(llvm::IntegerType::get(module.getContext(),
+                                                   size * 8));
+    return lowered;
+}
+
+AbiValue AbiLowering::aarch64(const Type &t, bool result) {
+    const auto &dl = module.getDataLayout();
+    auto &ctx = module.getContext();
+
+    if (!is_aggregate(t)) return AbiValue();
+
+    auto size = size_of(t);
+    if (size == 0) return AbiValue();
+
+    AbiValue lowered;
+    lowered.kind = AbiValue::Coerced;
+
+    // Homogeneous aggregates of up to four floating-point or short vector
+    // members go in consecutive SIMD registers.
+    std::vector<Leaf> scalars;
+    if (size <= 64 && leaves(t, 0, scalars) && scalars.size() <= 4) {
+        auto *base = scalars[0].type;
+        auto base_size = dl.getTypeAllocSize(base).getFixedSize();
+
+        bool homogeneous = base->isFloatingPointTy()
+                        || (base->isVectorTy()
+                         && (base_size == 8 || base_size == 16));
+        for (const auto &leaf: scalars) {
+            homogeneous = homogeneous && leaf.type == base;
+        }
+
+        if (homogeneous && base_size * scalars.size() == size) {
+            lowered.parts.push_back(llvm::ArrayType::get(base,
+                                                         scalars.size()));
+            return lowered;
+        }
+    }
+
+    if (size > 16) return indirect(t, false);
+
+    // Others go in general registers, in pairs if 16-byte aligned.
+    unsigned bits = types.get_alignment(t) >= 16 ? 128 : 64;
+    auto *word = llvm::IntegerType::get(ctx, bits);
+    auto words = (size * 8 + bits - 1) / bits;
+    lowered.parts.push_back(words == 1 ? static_cast<llvm::Type *>(word)
+                                       : llvm::ArrayType::get(word, words));
+    return lowered;
+}
+
+AbiValue AbiLowering::indirect(const Type &t, bool byval,
+                               unsigned min_align) {
+    AbiValue lowered;
+    lowered.kind = AbiValue::Indirect;
+    lowered.byval = byval;
+    lowered.align = std::max(types.get_alignment(t), byval ? min_align : 1);
+    return lowered;
+}
+
+bool AbiLowering::leaves(const Type &t, uint64_t offset,
+                         std::vector<Leaf> &out) {
+    const auto &dl = module.getDataLayout();
+
+    if (auto *str = boost::get<Struct<> >(&t.variant())) {
+        auto *ll = llvm::cast<llvm::StructType>(types.get(t));
+        auto *layout = dl.getStructLayout(ll);
+
+        bool aligned = true;
+        const auto &fields = str->get_fields();
+        for (unsigned i = 0; i < fields.size(); ++i) {
+            auto index = types.get_field_index(*str, i);
+            aligned = leaves(fields[i].second,
+                             offset + layout->getElementOffset(index), out)
+                   && aligned;
+        }
+        return aligned;
+    }
+
+    if (auto *arr = boost::get<Array<> >(&t.variant())) {
+        const auto &element = *arr->get_element();
+        auto element_size = size_of(element);
+
+        bool aligned = true;
+        for (uint64_t i = 0; i < arr->get_length(); ++i) {
+            aligned = leaves(element, offset + i * element_size, out)
+                   && aligned;
+        }
+        return aligned;
+    }
+
+    out.push_back(Leaf { offset, types.get(t) });
+    return offset % types.get_alignment(t) == 0;
+}
+
+uint64_t AbiLowering::size_of(const Type &t) {
+    return module.getDataLayout().getTypeAllocSize(types.get(t))
+                                 .getFixedSize();
+}
+
+}
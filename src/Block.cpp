@@ -20,6 +20,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
+
 #include "Block.hh"
 
 namespace Craeft {
@@ -46,7 +49,26 @@ void Block::cond_jump(Value cond, Block then_b, Block else_b) {
 
     llvm::IRBuilder<> builder(underlying);
 
-    builder.CreateCondBr(cond.to_llvm(), then_b.to_llvm(), else_b.to_llvm());
+    auto *condition = cond.to_llvm();
+    llvm::MDNode *weights = nullptr;
+
+    // Turn a hint into weights straight away, rather than leaving it to the
+    // optimizer, so that blocks are laid out by it at every level.  The
+    // weights are those `LowerExpectIntrinsic` would use.
+    auto *expect = llvm::dyn_cast<llvm::IntrinsicInst>(condition);
+    if (expect && expect->getIntrinsicID() == llvm::Intrinsic::expect) {
+        bool likely = llvm::cast<llvm::ConstantInt>(expect->getArgOperand(1))
+                          ->isOne();
+        weights = llvm::MDBuilder(builder.getContext())
+                      .createBranchWeights(likely ? 2000 : 1,
+                                           likely ? 1 : 2000);
+        condition = expect->getArgOperand(0);
+
+        if (expect->use_empty()) expect->eraseFromParent();
+    }
+
+    builder.CreateCondBr(condition, then_b.to_llvm(), else_b.to_llvm(),
+                         weights);
 
     terminated = true;
 }
@@ -0,0 +1,135 @@
+/**
+ * @file Codegen/Cache.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Codegen/Cache.hh"
+
+namespace Craeft {
+
+namespace Codegen {
+
+/* Bump this whenever the format of entries changes. */
+static const char *CACHE_VERSION = "craeft-cache-1";
+
+BuildCache::BuildCache(std::string dir, const std::string &compiler,
+                       const TargetSpec &target, int opt_level,
+                       int size_level, bool thin_lto,
+                       const std::string &profile,
+                       const FastMath &fast_math, bool wrapping_overflow)
+    : dir(dir) {
+    llvm::sys::fs::create_directories(dir);
+
+    llvm::raw_string_ostream out(config);
+    out << CACHE_VERSION << '\0' << LLVM_VERSION_STRING << '\0'
+        << compiler << '\0' << target.triple << '\0' << target.cpu << '\0'
+        << target.features << '\0' << opt_level << '\0' << size_level
+        << '\0' << thin_lto << '\0' << profile << '\0' << fast_math.str()
+        << '\0' << wrapping_overflow;
+}
+
+void BuildCache::set_toplevels(
+        const std::vector<ToplevelFingerprint> &toplevels) {
+    this->toplevels = toplevels;
+
+    llvm::MD5 digest;
+    digest.update(config);
+
+    for (const auto &toplevel: toplevels) {
+        digest.update(toplevel.interface.Bytes);
+    }
+
+    digest.final(context);
+}
+
+std::string BuildCache::key(const std::string &kind,
+                            llvm::ArrayRef<uint8_t> data) const {
+    llvm::MD5 digest;
+    digest.update(context.Bytes);
+    digest.update(kind);
+    digest.update(data);
+
+    Fingerprint result;
+    digest.final(result);
+
+    return result.digest().str().str();
+}
+
+std::string BuildCache::function_key(size_t idx) const {
+    return key("function", toplevels[idx].whole.Bytes);
+}
+
+std::string BuildCache::instance_key(const std::string &mangled) const {
+    return key("instance", llvm::arrayRefFromStringRef(mangled));
+}
+
+std::string BuildCache::path(const std::string &key) const {
+    llvm::SmallString<128> result(dir);
+    llvm::sys::path::append(result, key + ".bc");
+    return result.str().str();
+}
+
+bool BuildCache::contains(const std::string &key) const {
+    return llvm::sys::fs::exists(path(key));
+}
+
+bool BuildCache::load(const std::string &key, std::string &bitcode) const {
+    auto buf = llvm::MemoryBuffer::getFile(path(key));
+    if (!buf) return false;
+
+    bitcode = (*buf)->getBuffer().str();
+    return true;
+}
+
+void BuildCache::store(const std::string &key,
+                       const std::string &bitcode) const {
+    llvm::SmallString<128> model(dir);
+    llvm::sys::path::append(model, key + "-%%%%%%%%.tmp");
+
+    int fd;
+    llvm::SmallString<128> tmp;
+    if (llvm::sys::fs::createUniqueFile(model, fd, tmp)) return;
+
+    {
+        llvm::raw_fd_ostream out(fd, true);
+        out << bitcode;
+        out.close();
+
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmp);
+            return;
+        }
+    }
+
+    if (llvm::sys::fs::rename(tmp, path(key))) {
+        llvm::sys::fs::remove(tmp);
+    }
+}
+
+}
+
+}
@@ -0,0 +1,361 @@
+/**
+ * @file Codegen/Constant.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "llvm/IR/Constants.h"
+
+#include "Codegen/Constant.hh"
+#include "Codegen/Type.hh"
+#include "Codegen/Value.hh"
+
+namespace Craeft {
+
+namespace Codegen {
+
+/* Enough for loops filling tables of a few hundred thousand entries. */
+static const size_t MAX_STEPS = 1 << 20;
+
+static const unsigned MAX_DEPTH = 256;
+
+bool is_constant(const Value &val) {
+    return llvm::isa<llvm::ConstantInt>(val.to_llvm())
+        || llvm::isa<llvm::ConstantFP>(val.to_llvm());
+}
+
+[[noreturn]] static void not_constant(SourcePos pos) {
+    throw Error("type error",
+                "expression cannot be evaluated at compile time", pos);
+}
+
+/**
+ * @brief Check that the result of an operation on constants was folded.
+ */
+static Value check_constant(Value val, SourcePos pos) {
+    if (llvm::isa<llvm::UndefValue>(val.to_llvm())) {
+        throw Error("type error",
+                    "constant expression has an undefined result", pos);
+    }
+
+    if (!is_constant(val)) not_constant(pos);
+
+    return val;
+}
+
+/**
+ * @brief Executes the statements of a `const fn`.
+ *
+ * Visiting a statement returns whether it returned from the function.
+ */
+class ConstantStatementGen: public AST::StatementVisitor<bool> {
+public:
+    ConstantStatementGen(ConstantGen &eval): eval(eval) {}
+
+    /**
+     * @brief Run a block in a new scope.
+     *
+     * @return Whether it returned from the function.
+     */
+    bool run(const std::vector<std::unique_ptr<AST::Statement> > &block) {
+        eval.push_scope();
+
+        for (const auto &stmt: block) {
+            eval.step(stmt->pos());
+            if (visit(*stmt)) return true;
+        }
+
+        eval.pop_scope();
+        return false;
+    }
+
+    /** @brief The returned value, once a statement has returned. */
+    boost::optional<Value> result;
+
+private:
+    bool operator()(const AST::ExpressionStatement &expr) override {
+        eval.visit(expr.expr());
+        return false;
+    }
+
+    bool operator()(const AST::Return &ret) override {
+        result = eval.visit(ret.retval());
+        return true;
+    }
+
+    bool operator()(const AST::VoidReturn &ret) override {
+        throw Error("type error", "const functions must return a value",
+                    ret.pos());
+    }
+
+    bool operator()(const AST::Assignment &assignment) override {
+        auto *var = llvm::dyn_cast<AST::Variable>(&assignment.lhs());
+        if (!var) not_constant(assignment.pos());
+
+        eval.assign(var->name(), eval.visit(assignment.rhs()),
+                    assignment.pos());
+        return false;
+    }
+
+    bool operator()(const AST::Declaration &decl) override {
+        auto t = TypeGen(eval._translator).visit(decl.type());
+        eval.declare(decl.name().name(), t);
+        if (decl.zeroed()) {
+            eval.assign(decl.name().name(), eval._translator.zero(t),
+                        decl.pos());
+        }
+        return false;
+    }
+
+    bool operator()(const AST::CompoundDeclaration &cdecl) override {
+        auto val = eval.visit(cdecl.rhs());
+        auto name = cdecl.name().name();
+
+        eval.declare(name, TypeGen(eval._translator).visit(cdecl.type()));
+        eval.assign(name, val, cdecl.pos());
+        return false;
+    }
+
+    bool operator()(const AST::IfStatement &if_stmt) override {
+        if (condition(if_stmt.condition())) {
+            return run(if_stmt.if_block());
+        }
+
+        return run(if_stmt.else_block());
+    }
+
+    bool operator()(const AST::WhileLoop &loop) override {
+        while (condition(loop.condition())) {
+            if (run(loop.body())) return true;
+            eval.step(loop.pos());
+        }
+
+        return false;
+    }
+
+    bool operator()(const AST::ForLoop &loop) override {
+        eval.push_scope();
+
+        if (loop.init() && visit(*loop.init())) return true;
+
+        while (condition(loop.condition())) {
+            if (run(loop.body())) return true;
+            if (loop.step() && visit(*loop.step())) return true;
+            eval.step(loop.pos());
+        }
+
+        eval.pop_scope();
+        return false;
+    }
+
+    bool condition(const AST::Expression &cond) {
+        auto val = eval.visit(cond);
+        auto *c = llvm::dyn_cast<llvm::ConstantInt>(val.to_llvm());
+
+        if (!c || c->getBitWidth() != 1) {
+            throw Error("type error", "condition must be a boolean",
+                        cond.pos());
+        }
+
+        return c->isOne();
+    }
+
+    ConstantGen &eval;
+};
+
+Value ConstantGen::call(const AST::FunctionDefinition &fd,
+                        const std::vector<Value> &args, SourcePos pos) {
+    const auto &sig = fd.signature();
+
+    if (_depth >= MAX_DEPTH) {
+        throw Error("evaluation error",
+                    "constant evaluation nested too deeply", pos);
+    }
+
+    if (args.size() != sig.args().size()) {
+        throw Error("type error", "wrong number of arguments to \""
+                                + sig.name().str() + "\"", pos);
+    }
+
+    ConstantGen inner(_translator, _steps, _depth + 1);
+    TypeGen tg(_translator);
+
+    inner.push_scope();
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const auto &decl = *sig.args()[i];
+        auto ty = tg.visit(decl.type());
+
+        if (unqualified(args[i].get_type()) != unqualified(ty)) {
+            throw Error("type error", "argument does not match function type",
+                        pos);
+        }
+
+        inner.declare(decl.name().name(), ty);
+        inner.assign(decl.name().name(), args[i], pos);
+    }
+
+    ConstantStatementGen body(inner);
+
+    if (!body.run(fd.block())) {
+        throw Error("type error", "const function \"" + sig.name().str()
+                                + "\" did not return a value", pos);
+    }
+
+    if (unqualified(body.result->get_type())
+            != unqualified(tg.visit(sig.ret_type()))) {
+        throw Error("type error", "returned value does not match function "
+                                  "type", pos);
+    }
+
+    return *body.result;
+}
+
+Value ConstantGen::operator()(const AST::IntLiteral &lit) {
+    return ValueGen(_translator).visit(lit);
+}
+
+Value ConstantGen::operator()(const AST::UIntLiteral &lit) {
+    return ValueGen(_translator).visit(lit);
+}
+
+Value ConstantGen::operator()(const AST::FloatLiteral &lit) {
+    return ValueGen(_translator).visit(lit);
+}
+
+Value ConstantGen::operator()(const AST::StringLiteral &lit) {
+    not_constant(lit.pos());
+}
+
+Value ConstantGen::operator()(const AST::Variable &var) {
+    if (!_names.present(var.name())) {
+        return _translator.get_constant(var.name(), var.pos());
+    }
+
+    const auto &local = _locals[_names[var.name()]];
+
+    if (!local.value) {
+        throw Error("type error", "variable \"" + var.name().str()
+                                + "\" used before it is assigned", var.pos());
+    }
+
+    return *local.value;
+}
+
+Value ConstantGen::operator()(const AST::Reference &ref) {
+    not_constant(ref.pos());
+}
+
+Value ConstantGen::operator()(const AST::Dereference &deref) {
+    not_constant(deref.pos());
+}
+
+Value ConstantGen::operator()(const AST::FieldAccess &access) {
+    not_constant(access.pos());
+}
+
+Value ConstantGen::operator()(const AST::Index &index) {
+    not_constant(index.pos());
+}
+
+Value ConstantGen::operator()(const AST::Binop &binop) {
+    auto lhs = visit(binop.lhs());
+    auto rhs = visit(binop.rhs());
+
+    return check_constant(
+            apply_binop(_translator, binop.op(), lhs, rhs, binop.pos()),
+            binop.pos());
+}
+
+Value ConstantGen::operator()(const AST::FunctionCall &call) {
+    if (call.awaited()) not_constant(call.pos());
+
+    auto fd = _translator.lookup_const_function(call.fname());
+
+    if (!fd) {
+        throw Error("type error", "cannot call non-const function \""
+                                + call.fname().str() + "\" at compile time",
+                    call.pos());
+    }
+
+    std::vector<Value> args;
+
+    for (const auto &arg: call.args()) {
+        args.push_back(visit(*arg));
+    }
+
+    return this->call(*fd, args, call.pos());
+}
+
+Value ConstantGen::operator()(const AST::TemplateFunctionCall &call) {
+    not_constant(call.pos());
+}
+
+Value ConstantGen::operator()(const AST::Cast &cast) {
+    auto dest_ty = TypeGen(_translator).visit(cast.type());
+
+    auto cast_val = visit(cast.arg());
+
+    return check_constant(_translator.cast(cast_val, dest_ty, cast.pos()),
+                          cast.pos());
+}
+
+void ConstantGen::push_scope(void) {
+    _names.push();
+    _marks.push_back(_locals.size());
+}
+
+void ConstantGen::pop_scope(void) {
+    _names.pop();
+    _locals.erase(_locals.begin() + _marks.back(), _locals.end());
+    _marks.pop_back();
+}
+
+void ConstantGen::declare(Symbol name, const Type &t) {
+    _names.bind(name, _locals.size());
+    _locals.push_back(Local { t, boost::none });
+}
+
+void ConstantGen::assign(Symbol name, Value val, SourcePos pos) {
+    if (!_names.present(name)) {
+        throw Error("type error", "cannot assign to \"" + name.str()
+                                + "\" at compile time", pos);
+    }
+
+    auto &local = _locals[_names[name]];
+
+    if (unqualified(val.get_type()) != unqualified(local.type)) {
+        throw Error("type error",
+                    "cannot assign to variable of different type",
+                    pos);
+    }
+
+    local.value = val;
+}
+
+void ConstantGen::step(SourcePos pos) {
+    if (++_steps > MAX_STEPS) {
+        throw Error("evaluation error",
+                    "constant evaluation takes too long", pos);
+    }
+}
+
+}
+
+}
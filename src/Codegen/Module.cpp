@@ -22,37 +22,110 @@
 
 #include "Codegen/Module.hh"
 #include "Codegen/ModuleImpl.hh"
+#include "TimeReport.hh"
 
 namespace Craeft {
 
 namespace Codegen {
 
 ModuleGen::ModuleGen(std::string name, std::string filename,
-                             std::string triple)
-    : pimpl(new ModuleGenImpl(name, triple, filename)) {}
+                     SourceManager &sources, TargetSpec target)
+    : pimpl(new ModuleGenImpl(name, target, filename, sources)) {}
 
 ModuleGen::~ModuleGen() {}
 
-void ModuleGen::codegen(const AST::Toplevel &t) { pimpl->visit(t); }
+void ModuleGen::codegen(const AST::Toplevel &t) {
+    TimeReport::Scope timer("codegen");
+    pimpl->record(t);
+    pimpl->visit(t);
+}
+
+void ModuleGen::codegen_parallel(
+        const std::vector<const AST::Toplevel *> &nodes,
+        int nthreads, int opt_level, int size_level, BuildCache *cache,
+        bool thin_lto) {
+    TimeReport::Scope timer("codegen");
+    for (const auto *node: nodes) pimpl->record(*node);
+    pimpl->codegen_parallel(nodes, nthreads, opt_level, size_level, cache,
+                            thin_lto);
+}
+
+void ModuleGen::set_profile(const ProfileOptions &profile) {
+    pimpl->set_profile(profile);
+}
+
+void ModuleGen::set_debug_level(DebugLevel level) {
+    pimpl->set_debug_level(level);
+}
+
+void ModuleGen::set_fast_math(const FastMath &flags) {
+    pimpl->set_fast_math(flags);
+}
+
+void ModuleGen::set_wrapping_overflow(void) {
+    pimpl->set_wrapping_overflow();
+}
+
+void ModuleGen::record_interface(void) {
+    pimpl->record_interface();
+}
+
+void ModuleGen::set_remarks(const std::string &passes) {
+    pimpl->set_remarks(passes);
+}
+
+void ModuleGen::set_fast_backend(void) {
+    pimpl->set_fast_backend();
+}
+
+void ModuleGen::set_backend_threads(unsigned n) {
+    pimpl->set_backend_threads(n);
+}
 
 void ModuleGen::emit_ir(std::ostream &out) {
+    TimeReport::Scope timer("emit");
     pimpl->emit_ir(out);
 }
 
 void ModuleGen::emit_obj(int fd) {
+    TimeReport::Scope timer("emit");
     pimpl->emit_obj(fd);
 }
 
 void ModuleGen::emit_asm(int fd) {
+    TimeReport::Scope timer("emit");
     pimpl->emit_asm(fd);
 }
 
+void ModuleGen::emit_bc(int fd) {
+    TimeReport::Scope timer("emit");
+    pimpl->emit_bc(fd);
+}
+
+void ModuleGen::emit(const std::vector<Artifact> &artifacts,
+                     const ArtifactSink &sink) {
+    TimeReport::Scope timer("emit");
+    pimpl->emit(artifacts, sink);
+}
+
 void ModuleGen::validate(std::ostream &out) {
+    TimeReport::Scope timer("codegen");
     pimpl->validate(out);
 }
 
-void ModuleGen::optimize(int level) {
-    pimpl->optimize(level);
+void ModuleGen::optimize(int level, int size_level, bool thin_lto) {
+    TimeReport::Scope timer("optimize");
+    pimpl->optimize(level, size_level, thin_lto);
+}
+
+int ModuleGen::run(const std::string &entry,
+                   const std::vector<std::string> &args) {
+    TimeReport::Scope timer("run");
+    return pimpl->run(entry, args);
+}
+
+ModuleCounts ModuleGen::counts(void) {
+    return pimpl->counts();
 }
 
 }
@@ -21,28 +21,437 @@
  */
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/TargetSelect.h"
-#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Target/TargetOptions.h"
 
+#include "Codegen/Constant.hh"
 #include "Codegen/ModuleImpl.hh"
 #include "Codegen/Type.hh"
 #include "Codegen/Statement.hh"
+#include "TimeReport.hh"
 
 namespace Craeft {
 
 namespace Codegen {
 
-ModuleGenImpl::ModuleGenImpl(std::string name, std::string triple,
-                                     std::string fname)
-    : _translator(name, fname, triple) {
+ModuleGenImpl::ModuleGenImpl(std::string name, TargetSpec target,
+                             std::string fname, SourceManager &sources)
+    : _name(name), _target(target), _fname(fname), _sources(sources),
+      _translator(name, fname, sources, target) {
+}
+
+void ModuleGenImpl::declare(const AST::Toplevel &t) {
+    if (auto *fd = llvm::dyn_cast<AST::FunctionDefinition>(&t)) {
+        (*this)(fd->signature());
+    } else if (auto *cfd = llvm::dyn_cast<AST::ConstFunctionDefinition>(&t)) {
+        _translator.register_const_function(cfd->def());
+        (*this)(cfd->def()->signature());
+    } else if (auto *gd = llvm::dyn_cast<AST::GlobalDefinition>(&t)) {
+        global(*gd, false);
+    } else {
+        visit(t);
+    }
+}
+
+/**
+ * @brief Get the function the given node defines code for, or null if it
+ *        defines none.
+ */
+static const AST::FunctionDefinition *defined_function(
+        const AST::Toplevel *t) {
+    if (auto *fd = llvm::dyn_cast<AST::FunctionDefinition>(t)) return fd;
+    if (auto *cfd = llvm::dyn_cast<AST::ConstFunctionDefinition>(t)) {
+        return cfd->def().get();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Convert the annotations on a function to its attributes.
+ */
+static FunctionAttributes get_function_attributes(
+        const AST::FunctionDeclaration &fd) {
+    FunctionAttributes result;
+    result.async = fd.is_async();
+
+    auto conflict = [](const AST::Annotation &annotation) {
+        throw Error("annotation error", "conflicting function annotations",
+                    annotation.pos);
+    };
+
+    for (const auto &annotation: fd.annotations()) {
+        const auto &name = annotation.name.str();
+
+        if (name == "fastmath") {
+            /* `@fastmath`, or with named flags turned on or off, as in
+             * `@fastmath(nnan=0, ninf=0)`. */
+            if (result.fast_math) conflict(annotation);
+            result.fast_math = FastMath::all();
+            for (const auto &arg: annotation.args) {
+                if ((arg.second != 0 && arg.second != 1)
+                 || !result.fast_math->set(arg.first.str(), arg.second)) {
+                    throw Error("annotation error",
+                                "invalid arguments to @fastmath",
+                                annotation.pos);
+                }
+            }
+            continue;
+        }
+
+        if (name == "malloc") {
+            /* `@malloc`, or with the argument giving the size allocated,
+             * counting from 1, as in `@malloc(size=1)`. */
+            if (result.allocator) conflict(annotation);
+            result.allocator = true;
+            for (const auto &arg: annotation.args) {
+                if (arg.first.str() != "size" || result.alloc_size
+                 || arg.second < 1
+                 || arg.second > (int64_t)fd.args().size()) {
+                    throw Error("annotation error",
+                                "invalid arguments to @malloc",
+                                annotation.pos);
+                }
+                result.alloc_size = arg.second - 1;
+            }
+            continue;
+        }
+
+        if (name == "target_clones") {
+            /* `@target_clones(avx2, avx512f)`: the CPU features to make
+             * versions of the function for, besides the default.  Dots in
+             * LLVM's names are written as underscores (`sse4_2`). */
+            if (!result.target_clones.empty()) conflict(annotation);
+            for (const auto &arg: annotation.args) {
+                if (arg.first == Symbol() || arg.second != 1) {
+                    throw Error("annotation error",
+                                "invalid arguments to "
+                                "@target_clones", annotation.pos);
+                }
+
+                auto feature = arg.first.str();
+                if (feature == "default") continue;
+                std::replace(feature.begin(), feature.end(), '_', '.');
+                result.target_clones.push_back(feature);
+            }
+            continue;
+        }
+
+        if (!annotation.args.empty()) {
+            throw Error("annotation error", "@" + name + " takes no arguments",
+                        annotation.pos);
+        }
+
+        if (name == "nofastmath") {
+            if (result.fast_math) conflict(annotation);
+            result.fast_math = FastMath();
+        } else if (name == "inline" || name == "noinline") {
+            auto inlining = name == "inline" ? FunctionAttributes::Always
+                                             : FunctionAttributes::Never;
+            if (result.inlining != FunctionAttributes::Default
+             && result.inlining != inlining) {
+                conflict(annotation);
+            }
+            result.inlining = inlining;
+        } else if (name == "hot") {
+            if (result.cold) conflict(annotation);
+            result.hot = true;
+        } else if (name == "cold") {
+            if (result.hot) conflict(annotation);
+            result.cold = true;
+        } else if (name == "pure") {
+            if (result.readonly) conflict(annotation);
+            result.readnone = true;
+        } else if (name == "readonly") {
+            if (result.readnone) conflict(annotation);
+            result.readonly = true;
+        } else if (name == "noreturn") {
+            result.noreturn = true;
+        } else if (name == "private") {
+            result.internal = true;
+        } else if (name == "fastcc" || name == "coldcc") {
+            auto convention = name == "fastcc" ? FunctionAttributes::Fast
+                                               : FunctionAttributes::Cold;
+            if (result.convention != FunctionAttributes::C
+             && result.convention != convention) {
+                conflict(annotation);
+            }
+            result.convention = convention;
+        } else {
+            throw Error("annotation error",
+                        "unknown function annotation @" + name,
+                        annotation.pos);
+        }
+    }
+
+    return result;
+}
+
+namespace {
+
+/**
+ * @brief What one code generation thread produced.
+ */
+struct WorkerResult {
+    /**
+     * @brief The worker's module as LLVM bitcode, if it succeeded.
+     */
+    std::string bitcode;
+
+    /**
+     * @brief The optimization remarks on the worker's functions, if they
+     *        are being recorded.
+     */
+    std::string remarks;
+
+    /**
+     * @brief The first error the worker reported, and the index of the node
+     *        it was reported for.
+     */
+    std::unique_ptr<Error> error;
+    size_t error_at = SIZE_MAX;
+};
+
+}
+
+void ModuleGenImpl::codegen_parallel(
+        const std::vector<const AST::Toplevel *> &nodes,
+        int nthreads, int opt_level, int size_level,
+        BuildCache *cache, bool thin_lto, bool use_cached) {
+    // Look up each function definition in the cache; only the misses need
+    // to be generated.
+    std::vector<std::string> keys(nodes.size());
+    std::vector<std::string> cached(nodes.size());
+    std::vector<bool> hit(nodes.size(), false);
+
+    if (cache) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (!defined_function(nodes[i])) continue;
+
+            keys[i] = cache->function_key(i);
+            hit[i] = use_cached && cache->load(keys[i], cached[i]);
+            TimeReport::add(hit[i] ? "cache hits" : "cache misses");
+        }
+    }
+
+    // Split the function definitions to generate into contiguous runs of
+    // roughly equal amounts of source, one per worker.  Every worker
+    // still visits every other node, in order, so that each one sees exactly
+    // the declarations it would when compiling sequentially.
+    std::vector<int> owner(nodes.size(), 0);
+    std::vector<size_t> sizes(nodes.size(), 0);
+    size_t total_size = 0;
+    int nfunctions = 0;
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (!defined_function(nodes[i]) || hit[i]) continue;
+
+        size_t start = nodes[i]->pos().offset;
+        size_t end = i + 1 < nodes.size() ? nodes[i + 1]->pos().offset
+                                          : start + 1;
+        sizes[i] = std::max(end, start + 1) - start;
+        total_size += sizes[i];
+        ++nfunctions;
+    }
+
+    nthreads = std::max(1, std::min(nthreads, nfunctions));
+
+    size_t seen_size = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (!sizes[i]) continue;
+        owner[i] = std::min<size_t>(nthreads - 1,
+                                    seen_size * nthreads / total_size);
+        seen_size += sizes[i];
+    }
+
+    std::vector<WorkerResult> results(nthreads);
+    std::vector<std::thread> workers;
+
+    for (int k = 0; k < nthreads; ++k) {
+        workers.emplace_back([&, k] {
+            ModuleGenImpl gen(_name, _target, _fname, _sources);
+            gen.set_profile(_profile);
+            gen.set_debug_level(_debug_level);
+            gen.set_fast_math(_fast_math);
+            if (_wrapping_overflow) gen.set_wrapping_overflow();
+            if (_remarks_enabled) gen.set_remarks(_remarks_passes);
+            auto &result = results[k];
+
+            // Instantiations already in the cache are linked in afterwards.
+            if (cache && use_cached) {
+                gen._translator.set_external_instances(
+                        [&](const std::string &name) {
+                            return cache->contains(cache->instance_key(name));
+                        });
+            }
+
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                bool generate = sizes[i] > 0 && owner[i] == k;
+
+                // Globals are defined by the first worker, and only
+                // declared by the rest.
+                bool declare_only = defined_function(nodes[i])
+                        ? !generate
+                        : llvm::isa<AST::GlobalDefinition>(nodes[i]) && k;
+
+                try {
+                    if (declare_only) {
+                        gen.declare(*nodes[i]);
+                    } else {
+                        gen.visit(*nodes[i]);
+                    }
+                } catch (Error &e) {
+                    // Only report errors once, from the owning worker; either
+                    // way, this worker's state is unusable from here on.
+                    if (owner[i] == k) {
+                        result.error = std::make_unique<Error>(e);
+                        result.error_at = i;
+                    }
+                    return;
+                }
+            }
+
+            // What to cache: each generated function, along with the
+            // instantiations it uses.  Note those before optimizing, which
+            // may inline them.
+            std::vector<std::pair<std::string, std::string> > entries;
+            std::vector<std::vector<std::string> > instances_used;
+
+            if (cache) {
+                for (size_t i = 0; i < nodes.size(); ++i) {
+                    if (!sizes[i] || owner[i] != k) continue;
+
+                    auto *fd = defined_function(nodes[i]);
+                    entries.push_back(std::make_pair(
+                                keys[i], fd->signature().name().str()));
+                }
+
+                for (const auto &name: gen._instances) {
+                    entries.push_back(std::make_pair(
+                                cache->instance_key(name), name));
+                }
+
+                for (const auto &entry: entries) {
+                    instances_used.emplace_back();
+                    for (auto &callee: gen._translator.callees(entry.second)) {
+                        if (!is_mangled_name(callee)) continue;
+                        instances_used.back().push_back(std::move(callee));
+                    }
+                }
+            }
+
+            // For ThinLTO, the pieces are optimized as the whole would be,
+            // and link time does the rest.
+            auto phase = thin_lto ? OptPhase::ThinPreLink : OptPhase::PreLink;
+
+            // Entries are optimized each on its own: optimized along with
+            // the worker's other functions, one could inline another, and
+            // go stale when that one's body changed but its key did not.
+            for (size_t j = 0; j < entries.size(); ++j) {
+                auto bitcode = gen._translator.extract_optimized_bitcode(
+                        entries[j].second, instances_used[j], opt_level,
+                        size_level, phase);
+                if (!bitcode.empty()) {
+                    cache->store(entries[j].first, bitcode);
+                }
+            }
+
+            gen._translator.optimize(opt_level, size_level, phase);
+            result.remarks = gen._translator.take_remarks();
+
+            std::ostringstream out;
+            gen._translator.emit_bitcode(out);
+            result.bitcode = out.str();
+        });
+    }
+
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    // Report the error which would have come first compiling sequentially.
+    auto first_error = std::min_element(results.begin(), results.end(),
+            [](const WorkerResult &l, const WorkerResult &r) {
+                return l.error_at < r.error_at;
+            });
+    if (first_error->error) {
+        throw *first_error->error;
+    }
+
+    TimeReport::Scope timer("optimize");
+
+    Translator linked(_name, _fname, _sources, _target);
+    linked.set_profile(_profile);
+    if (_remarks_enabled) linked.set_remarks(_remarks_passes);
+    if (_fast_backend) linked.set_fast_backend();
+    linked.set_backend_threads(_backend_threads);
+    std::vector<std::string> pieces;
+
+    for (auto &result: results) {
+        pieces.push_back(std::move(result.bitcode));
+        _remarks += result.remarks;
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (hit[i]) pieces.push_back(std::move(cached[i]));
+    }
+
+    linked.link_bitcode(pieces);
+
+    if (cache) {
+        // Link in cached instantiations until none are missing.  Linking one
+        // can bring in uses of others.
+        bool missing = false;
+        do {
+            pieces.clear();
+            missing = false;
+
+            for (const auto &name: linked.undefined_functions()) {
+                if (!is_mangled_name(name)) continue;
+
+                std::string bitcode;
+                if (cache->load(cache->instance_key(name), bitcode)) {
+                    pieces.push_back(std::move(bitcode));
+                } else {
+                    missing = true;
+                }
+            }
+
+            linked.link_bitcode(pieces);
+        } while (!pieces.empty());
+
+        // Something was removed from the cache while we were using it; start
+        // over, regenerating everything.
+        if (missing) {
+            codegen_parallel(nodes, nthreads, opt_level, size_level,
+                             cache, thin_lto, false);
+            return;
+        }
+    }
+
+    // Private functions are only internal once every piece is linked.
+    std::vector<std::string> private_names;
+    for (const auto *node: nodes) {
+        auto *fd = defined_function(node);
+        if (fd && get_function_attributes(fd->signature()).internal) {
+            private_names.push_back(fd->signature().name().str());
+        }
+    }
+    linked.internalize(private_names);
+
+    if (!thin_lto) linked.optimize(opt_level, size_level, OptPhase::PostLink);
+    _translator = std::move(linked);
 }
 
 void ModuleGenImpl::emit_ir(std::ostream &out) {
@@ -57,21 +466,110 @@ void ModuleGenImpl::emit_obj(int fd) {
     _translator.emit_obj(fd);
 }
 
+void ModuleGenImpl::emit_bc(int fd) {
+    _translator.emit_bc(fd);
+}
+
+void ModuleGenImpl::emit(const std::vector<Artifact> &artifacts,
+                         const ArtifactSink &sink) {
+    std::vector<Artifact> generated;
+    for (auto artifact: artifacts) {
+        if (artifact != Artifact::Interface) {
+            generated.push_back(artifact);
+        } else {
+            sink(artifact, _interface ? _interface->finish()
+                                      : InterfaceWriter(_sources).finish());
+        }
+    }
+
+    _translator.emit(generated, [&](Artifact artifact, std::string data) {
+        // Remarks from generating the code come before those from
+        // optimizing and emitting it.
+        if (artifact == Artifact::Remarks) {
+            data = std::move(_remarks) + data;
+            _remarks.clear();
+        }
+        sink(artifact, std::move(data));
+    });
+}
+
 void ModuleGenImpl::operator()(const AST::TypeDeclaration &td) {
     throw Error("error", "type declarations not implemented", td.pos());
 }
 
+/**
+ * @brief Get the alignment from an `@align(N)` annotation.
+ */
+static unsigned get_align(const AST::Annotation &annotation) {
+    const auto &args = annotation.args;
+    if (args.size() != 1 || args[0].first != Symbol()
+     || args[0].second <= 0 || args[0].second > (1 << 30)
+     || (args[0].second & (args[0].second - 1))) {
+        throw Error("annotation error",
+                    "@align takes a power of two", annotation.pos);
+    }
+    return args[0].second;
+}
+
+/**
+ * @brief Convert the annotations on a struct and its members to its layout.
+ */
+static StructLayout get_struct_layout(const AST::StructDeclaration &sd) {
+    StructLayout result;
+
+    for (const auto &annotation: sd.annotations()) {
+        const auto &name = annotation.name.str();
+
+        if (name == "align") {
+            result.align = std::max(result.align, get_align(annotation));
+        } else if (name == "packed" || name == "reorder") {
+            if (!annotation.args.empty()) {
+                throw Error("annotation error",
+                            "@" + name + " takes no arguments",
+                            annotation.pos);
+            }
+            (name == "packed" ? result.packed : result.reorder) = true;
+        } else {
+            throw Error("annotation error",
+                        "unknown struct annotation @" + name, annotation.pos);
+        }
+    }
+
+    for (const auto &annotations: sd.member_annotations()) {
+        unsigned align = 0;
+
+        for (const auto &annotation: annotations) {
+            if (annotation.name != Symbol("align")) {
+                throw Error("annotation error",
+                            "unknown field annotation @"
+                          + annotation.name.str(), annotation.pos);
+            }
+            align = std::max(align, get_align(annotation));
+        }
+
+        result.field_aligns.push_back(align);
+    }
+
+    /* Keep the default layout recognizable. */
+    if (std::all_of(result.field_aligns.begin(), result.field_aligns.end(),
+                    [](unsigned align) { return align == 0; })) {
+        result.field_aligns.clear();
+    }
+
+    return result;
+}
+
 void ModuleGenImpl::operator()(const AST::StructDeclaration &sd) {
-    std::vector<std::pair<std::string, std::shared_ptr<Type> > >fields;
+    std::vector<std::pair<std::string, Type> >fields;
     TypeGen tg(_translator);
 
     for (const auto &decl: sd.members()) {
-        auto t = std::make_shared<Type>(tg.visit(decl->type()));
-        fields.push_back(std::pair<std::string, std::shared_ptr<Type> >
-                                  (decl->name().name(), t));
+        fields.push_back(std::pair<std::string, Type>
+                                  (decl->name().name().str(),
+                                   tg.visit(decl->type())));
     }
 
-    Struct<> t(fields, sd.name());
+    Struct<> t(fields, sd.name().str(), get_struct_layout(sd));
 
     _translator.create_struct(t);
 }
@@ -84,33 +582,35 @@ void ModuleGenImpl::operator()(const AST::TemplateStructDeclaration &s) {
         auto t = std::make_shared<TemplateType>(tg.visit(decl->type()));
         fields.push_back(std::pair<std::string,
                                   std::shared_ptr<TemplateType> >
-                                  (decl->name().name(), t));
+                                  (decl->name().name().str(), t));
     }
 
-    Struct<TemplateType> t(fields, s.decl().name());
+    Struct<TemplateType> t(fields, s.decl().name().str(),
+                           get_struct_layout(s.decl()));
 
-    TemplateStruct tmpl(t, s.argnames().size());
+    TemplateStruct tmpl(t, s.argnames());
 
     _translator.register_template(tmpl, s.decl().name());
 }
 
 Function<> ModuleGenImpl::type_of_ast_decl(
         const AST::FunctionDeclaration &fd) {
-    std::vector<std::shared_ptr<Type> > arg_types;
+    std::vector<Type> arg_types;
     TypeGen tg(_translator);
 
     for (const auto &decl: fd.args()) {
-        arg_types.push_back(std::make_shared<Type>(tg.visit(decl->type())));
+        arg_types.push_back(tg.visit(decl->type()));
     }
 
-    auto ret_type = std::make_shared<Type>(tg.visit(fd.ret_type()));
+    auto ret_type = tg.visit(fd.ret_type());
 
     return Function<>(ret_type, arg_types);
 }
 
 void ModuleGenImpl::operator()(const AST::FunctionDeclaration &fd) {
     auto ty = type_of_ast_decl(fd);
-    _translator.create_function_prototype(ty, fd.name());
+    _translator.create_function_prototype(ty, fd.name().str(), fd.pos(),
+                                          get_function_attributes(fd));
 }
 
 std::vector< std::pair< std::vector<Type>, TemplateValue> >
@@ -119,24 +619,45 @@ ModuleGenImpl::codegen_function_with_name(
         std::string name) {
     auto ty = type_of_ast_decl(fd.signature());
 
-    std::vector<std::string> arg_names;
+    std::vector<Symbol> arg_names;
 
     for (auto &decl: fd.signature().args()) {
         arg_names.push_back(decl->name().name());
     }
 
-    _translator.create_and_start_function(ty, arg_names, name);
+    auto generate = [&](const std::string &name,
+                        const FunctionAttributes &attrs) {
+        _translator.create_and_start_function(ty, arg_names, name, fd.pos(),
+                                              attrs);
+
+        for (const auto &arg: fd.block()) {
+            StatementGen(_translator).generate(*arg);
+        }
+
+        return _translator.end_function();
+    };
 
-    for (const auto &arg: fd.block()) {
-        StatementGen(_translator).visit(*arg);
+    auto attrs = get_function_attributes(fd.signature());
+    if (attrs.target_clones.empty()) return generate(name, attrs);
+
+    // Each version is the whole function, compiled for its own CPU.
+    std::vector< std::pair< std::vector<Type>, TemplateValue> > result;
+    for (const auto &version:
+            _translator.create_dispatcher(ty, name, fd.pos(), attrs)) {
+        auto specializations = generate(version.first, version.second);
+        result.insert(result.end(), specializations.begin(),
+                      specializations.end());
     }
 
-    return _translator.end_function();
+    return result;
 }
 
 void ModuleGenImpl::operator()(const AST::FunctionDefinition &fd) {
-    auto specializations = codegen_function_with_name(fd,
-                                                      fd.signature().name());
+    auto specializations =
+        codegen_function_with_name(fd, fd.signature().name().str());
+    if (get_function_attributes(fd.signature()).internal) {
+        _private.push_back(fd.signature().name().str());
+    }
 
     for (int i = 0; i < (int)specializations.size(); ++i) {
         const auto specialization = specializations[i];
@@ -145,13 +666,28 @@ void ModuleGenImpl::operator()(const AST::FunctionDefinition &fd) {
 
         assert(val.arg_names.size() == args.size());
 
+        TimeReport::Scope timer("instantiate templates");
+        TimeReport::add("template instantiations");
+
         _translator.push_scope();
 
         for (int j = 0; j < (int)args.size(); ++j) {
-            _translator.bind_type(val.arg_names[j], args[j]);
+            // Integer parameters are constants, so they work both as array
+            // lengths and as values in the body.
+            if (const auto *n = boost::get<IntegerArg>(&args[j].variant())) {
+                UnsignedInt u64(64);
+                auto *ll_n = llvm::ConstantInt::get(
+                        llvm::Type::getInt64Ty(_translator.get_ctx()),
+                        n->get_value());
+                _translator.define_constant(val.arg_names[j], u64,
+                                            Value(ll_n, u64), val.fd->pos());
+            } else {
+                _translator.bind_type(val.arg_names[j], args[j]);
+            }
         }
 
-        auto name = mangle_name(val.fd->signature().name(), args);
+        auto name = mangle_name(val.fd->signature().name().str(), args);
+        _instances.push_back(name);
 
         // Add any specializations added in codegen for *this* specialization.
         auto new_specializations = codegen_function_with_name(*val.fd, name);
@@ -184,8 +720,133 @@ void ModuleGenImpl::operator()(const AST::TemplateFunctionDefinition &f) {
                                  TemplateFunction(t, f.argnames()));
 }
 
-void ModuleGenImpl::optimize(int opt_level) {
-    _translator.optimize(opt_level);
+void ModuleGenImpl::operator()(const AST::ConstDefinition &cd) {
+    const auto &decl = cd.decl();
+    auto ty = TypeGen(_translator).visit(decl.type());
+    auto val = ConstantGen(_translator).visit(decl.rhs());
+
+    _translator.define_constant(decl.name().name(), ty, val, cd.pos());
+}
+
+void ModuleGenImpl::operator()(const AST::ConstFunctionDefinition &f) {
+    // Registered first, so that it may be evaluated in its own body.
+    _translator.register_const_function(f.def());
+    (*this)(*f.def());
+}
+
+void ModuleGenImpl::operator()(const AST::GlobalDefinition &gd) {
+    global(gd, true);
+}
+
+void ModuleGenImpl::global(const AST::GlobalDefinition &gd, bool define) {
+    auto ty = TypeGen(_translator).visit(gd.type());
+
+    boost::optional<Value> init;
+    if (define && gd.initializer()) {
+        init = ConstantGen(_translator).visit(*gd.initializer());
+    }
+
+    _translator.define_global(gd.name().name(), ty, init,
+                              gd.is_thread_local(), define, gd.pos());
+}
+
+void ModuleGenImpl::operator()(const AST::Import &import) {
+    import_interface(import.path(), import.pos());
+}
+
+void ModuleGenImpl::import_interface(const std::string &path,
+                                     SourcePos pos) {
+    if (!_interface_paths.insert(path).second) return;
+
+    auto interface = std::make_unique<Interface>(path, pos, _sources);
+    auto imports = interface->imports();
+    _interfaces.push_back(std::move(interface));
+
+    // Names missing from the interfaces so far may be in this one.
+    _resolved.clear();
+
+    if (_interfaces.size() == 1) {
+        _translator.set_resolver([this](Symbol name) {
+            return resolve(name);
+        });
+    }
+
+    for (const auto &import: imports) import_interface(import, pos);
+}
+
+bool ModuleGenImpl::resolve(Symbol name) {
+    if (name.id() >= _resolved.size()) _resolved.resize(Symbol::count());
+    if (_resolved[name.id()]) return false;
+    _resolved[name.id()] = true;
+
+    for (auto &interface: _interfaces) {
+        if (auto *node = interface->load(name)) {
+            TimeReport::add("interface entries loaded");
+            declare(*node);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ModuleGenImpl::set_profile(const ProfileOptions &profile) {
+    _profile = profile;
+    _translator.set_profile(profile);
+}
+
+void ModuleGenImpl::set_debug_level(DebugLevel level) {
+    _debug_level = level;
+    _translator.set_debug_level(level);
+}
+
+void ModuleGenImpl::set_fast_math(const FastMath &flags) {
+    _fast_math = flags;
+    _translator.set_fast_math(flags);
+}
+
+void ModuleGenImpl::set_wrapping_overflow(void) {
+    _wrapping_overflow = true;
+    _translator.set_wrapping_overflow();
+}
+
+void ModuleGenImpl::set_fast_backend(void) {
+    _fast_backend = true;
+    _translator.set_fast_backend();
+}
+
+void ModuleGenImpl::set_backend_threads(unsigned n) {
+    _backend_threads = n;
+    _translator.set_backend_threads(n);
+}
+
+void ModuleGenImpl::record_interface(void) {
+    _interface = std::make_unique<InterfaceWriter>(_sources);
+}
+
+void ModuleGenImpl::record(const AST::Toplevel &t) {
+    if (_interface) _interface->add(t);
+}
+
+void ModuleGenImpl::set_remarks(const std::string &passes) {
+    _remarks_enabled = true;
+    _remarks_passes = passes;
+    _translator.set_remarks(passes);
+}
+
+void ModuleGenImpl::optimize(int opt_level, int size_level, bool thin_lto) {
+    _translator.internalize(_private);
+    _translator.optimize(opt_level, size_level,
+                         thin_lto ? OptPhase::ThinPreLink : OptPhase::Whole);
+}
+
+int ModuleGenImpl::run(const std::string &entry,
+                       const std::vector<std::string> &args) {
+    return _translator.run(entry, args);
+}
+
+ModuleCounts ModuleGenImpl::counts(void) {
+    return _translator.counts();
 }
 
 void ModuleGenImpl::validate(std::ostream &out) {
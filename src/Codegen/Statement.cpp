@@ -20,6 +20,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdint>
+
 #include "Codegen/Statement.hh"
 #include "Codegen/Value.hh"
 #include "Codegen/Type.hh"
@@ -28,6 +30,11 @@ namespace Craeft {
 
 namespace Codegen {
 
+void StatementGen::generate(const AST::Statement &stmt) {
+    _translator.set_location(stmt.pos());
+    visit(stmt);
+}
+
 void StatementGen::operator()(const AST::ExpressionStatement &expr) {
     ValueGen vg(_translator);
     vg.visit(expr.expr());
@@ -44,6 +51,17 @@ void StatementGen::operator()(const AST::Assignment &assignment) {
 
 void StatementGen::operator()(const AST::Return &ret) {
     ValueGen vg(_translator);
+
+    if (ret.is_tail()) {
+        if (!llvm::isa<AST::FunctionCall>(ret.retval())
+         && !llvm::isa<AST::TemplateFunctionCall>(ret.retval())) {
+            throw Error("type error", "can only become a function call",
+                        ret.pos());
+        }
+        _translator.tail_return(vg.visit(ret.retval()), ret.pos());
+        return;
+    }
+
     _translator.return_(vg.visit(ret.retval()), ret.pos());
 }
 
@@ -53,11 +71,14 @@ void StatementGen::operator()(const AST::VoidReturn &ret) {
 
 void StatementGen::operator()(const AST::Declaration &decl) {
     auto t = TypeGen(_translator).visit(decl.type());
-    _translator.declare(decl.name().name(), t);
+    auto var = _translator.declare(decl.name().name(), t);
+    if (decl.zeroed()) {
+        _translator.add_store(var.get_val(), _translator.zero(t), decl.pos());
+    }
 }
 
 void StatementGen::operator()(const AST::CompoundDeclaration &cdecl) {
-    std::string name = cdecl.name().name();
+    Symbol name = cdecl.name().name();
     auto t = TypeGen(_translator).visit(cdecl.type());
     Variable result = _translator.declare(name, t);
     _translator.add_store(result.get_val(),
@@ -72,18 +93,133 @@ void StatementGen::operator()(const AST::IfStatement &if_stmt) {
     auto structure = _translator.create_ifthenelse(cond, if_stmt.pos());
 
     for (const auto &arg: if_stmt.if_block()) {
-        visit(*arg);
+        generate(*arg);
     }
 
     _translator.point_to_else(structure);
 
     // Generate "else" code.
     for (const auto &arg: if_stmt.else_block()) {
-        visit(*arg);
+        generate(*arg);
     }
 
     _translator.end_ifthenelse(std::move(structure));
 }
 
+[[noreturn]] static void invalid_args(const AST::Annotation &annotation) {
+    throw Error("annotation error",
+                "invalid arguments to @" + annotation.name.str(),
+                annotation.pos);
+}
+
+/**
+ * @brief Check that an annotation argument is a valid count.
+ */
+static unsigned get_count(const AST::Annotation &annotation, int64_t arg) {
+    if (arg <= 0 || arg > UINT32_MAX) invalid_args(annotation);
+    return arg;
+}
+
+/**
+ * @brief Convert the annotations on a loop to hints for the optimizer.
+ */
+static LoopHints get_loop_hints(
+        const std::vector<AST::Annotation> &annotations) {
+    LoopHints result;
+
+    auto choose = [](LoopHints::Choice &choice, LoopHints::Choice value,
+                     const AST::Annotation &annotation) {
+        if (choice != LoopHints::Default && choice != value) {
+            throw Error("annotation error", "conflicting loop annotations",
+                        annotation.pos);
+        }
+        choice = value;
+    };
+
+    for (const auto &annotation: annotations) {
+        const auto &name = annotation.name.str();
+        const auto &args = annotation.args;
+
+        if (name == "unroll") {
+            /* `@unroll` or `@unroll(count)`. */
+            choose(result.unroll, LoopHints::Enable, annotation);
+            if (args.size() > 1
+                    || (args.size() && args[0].first != Symbol())) {
+                invalid_args(annotation);
+            }
+            if (args.size()) {
+                result.unroll_count = get_count(annotation, args[0].second);
+            }
+        } else if (name == "vectorize") {
+            /* `@vectorize`, `@vectorize(width)` or with named `width` and
+             * `interleave`. */
+            choose(result.vectorize, LoopHints::Enable, annotation);
+            for (const auto &arg: args) {
+                if (arg.first == Symbol() || arg.first == Symbol("width")) {
+                    result.vectorize_width = get_count(annotation,
+                                                       arg.second);
+                } else if (arg.first == Symbol("interleave")) {
+                    result.interleave_count = get_count(annotation,
+                                                        arg.second);
+                } else {
+                    invalid_args(annotation);
+                }
+            }
+        } else if (name == "nounroll" || name == "novectorize") {
+            if (!args.empty()) invalid_args(annotation);
+            choose(name == "nounroll" ? result.unroll : result.vectorize,
+                   LoopHints::Disable, annotation);
+        } else {
+            throw Error("annotation error", "unknown loop annotation @" + name,
+                        annotation.pos);
+        }
+    }
+
+    return result;
+}
+
+void StatementGen::operator()(const AST::WhileLoop &loop) {
+    auto structure = _translator.create_loop(
+            get_loop_hints(loop.annotations()));
+
+    _translator.set_location(loop.condition().pos());
+    auto cond = ValueGen(_translator).visit(loop.condition());
+    _translator.start_loop_body(structure, cond, loop.condition().pos());
+
+    for (const auto &stmt: loop.body()) {
+        generate(*stmt);
+    }
+
+    _translator.end_loop(std::move(structure));
+}
+
+void StatementGen::operator()(const AST::ForLoop &loop) {
+    auto hints = get_loop_hints(loop.annotations());
+
+    /* The initializer's variables are only visible in the loop. */
+    _translator.push_scope();
+
+    if (loop.init()) generate(*loop.init());
+
+    auto structure = _translator.create_loop(hints);
+
+    _translator.set_location(loop.condition().pos());
+    auto cond = ValueGen(_translator).visit(loop.condition());
+    _translator.start_loop_body(structure, cond, loop.condition().pos());
+
+    for (const auto &stmt: loop.body()) {
+        generate(*stmt);
+    }
+
+    if (loop.step()) {
+        _translator.start_loop_step(structure);
+        generate(*loop.step());
+    }
+
+    _translator.end_loop(std::move(structure));
+
+    _translator.pop_scope();
+}
+
 }
 }
@@ -20,7 +20,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits>
+
+#include "llvm/IR/Constants.h"
+
 #include "Codegen/Type.hh"
+#include "Error.hh"
+#include "VariantUtils.hh"
 
 namespace Craeft {
 
@@ -36,7 +42,7 @@ Type TypeGen::operator()(const AST::Void &_) {
 }
 
 Type TypeGen::operator()(const AST::Pointer &ut) {
-    return Pointer<>(visit(ut.pointed()));
+    return Pointer<>(visit(ut.pointed()), ut.restrict());
 }
 
 Type TypeGen::operator()(const AST::TemplatedType &t) {
@@ -49,6 +55,79 @@ Type TypeGen::operator()(const AST::TemplatedType &t) {
     return translator.specialize_template(t.name(), args, t.pos());
 }
 
+/**
+ * @brief Check that a vector's elements are scalars and that it has at least
+ *        one of them.
+ *
+ * @tparam Variant The variant of either a `Type` or a `TemplateType`.
+ */
+template<typename Variant>
+static void validate_vector(const Variant &element, uint64_t lanes,
+                            const SourcePos &pos) {
+    if (!boost::get<SignedInt>(&element) && !boost::get<UnsignedInt>(&element)
+            && !boost::get<Float>(&element)) {
+        throw Error("type error",
+                    "vector elements must be integers or floats", pos);
+    }
+
+    if (lanes == 0 || lanes > std::numeric_limits<unsigned>::max()) {
+        throw Error("type error", "invalid number of vector lanes", pos);
+    }
+}
+
+Type TypeGen::operator()(const AST::Vector &v) {
+    auto element = visit(v.element());
+    validate_vector(element.variant(), v.lanes(), v.pos());
+    return Vector<>(element, v.lanes());
+}
+
+/**
+ * @brief Check that an array's elements have a size and that it has at least
+ *        one of them.
+ *
+ * @tparam Variant The variant of either a `Type` or a `TemplateType`.
+ */
+template<typename Variant>
+static void validate_array(const Variant &element, uint64_t length,
+                           const SourcePos &pos) {
+    if (boost::get<Void>(&element)) {
+        throw Error("type error", "array elements cannot be Void", pos);
+    }
+
+    if (length == 0) {
+        throw Error("type error", "arrays must have at least one element",
+                    pos);
+    }
+}
+
+Type TypeGen::operator()(const AST::Array &a) {
+    auto element = visit(a.element());
+    auto length = boost::get<IntegerArg>(visit(a.length()).variant())
+                      .get_value();
+    validate_array(element.variant(), length, a.pos());
+    return Array<>(element, length);
+}
+
+Type TypeGen::operator()(const AST::IntegerArg &i) {
+    if (i.is_literal()) return IntegerArg(i.value());
+
+    // A constant, or an integer parameter of the template being
+    // instantiated, which is bound as one.
+    auto value = translator.get_constant(i.name(), i.pos());
+    const auto &type = value.get_type();
+    auto *c = llvm::dyn_cast<llvm::ConstantInt>(value.to_llvm());
+    bool is_signed = is_type<SignedInt>(type);
+
+    if (!c || (!is_signed && !is_type<UnsignedInt>(type))
+     || (is_signed && c->isNegative())) {
+        throw Error("type error", "\"" + i.name().str()
+                                + "\" is not a non-negative integer",
+                    i.pos());
+    }
+
+    return IntegerArg(c->getZExtValue());
+}
+
 /*****************************************************************************
  * Code generation for template types.
  */
@@ -68,7 +147,7 @@ TemplateType TemplateTypeGen::operator()(const AST::Void &_) {
 }
 
 TemplateType TemplateTypeGen::operator()(const AST::Pointer &ut) {
-    return Pointer<TemplateType>(visit(ut.pointed()));
+    return Pointer<TemplateType>(visit(ut.pointed()), ut.restrict());
 }
 
 TemplateType TemplateTypeGen::operator()(const AST::TemplatedType &t) {
@@ -81,5 +160,39 @@ TemplateType TemplateTypeGen::operator()(const AST::TemplatedType &t) {
     return translator.respecialize_template(t.name(), args, t.pos());
 }
 
+TemplateType TemplateTypeGen::operator()(const AST::Vector &v) {
+    /* Template parameters are rejected as elements, so that every
+     * specialization is a valid vector. */
+    auto element = visit(v.element());
+    validate_vector(element, v.lanes(), v.pos());
+    return Vector<TemplateType>(element, v.lanes());
+}
+
+TemplateType TemplateTypeGen::operator()(const AST::Array &a) {
+    auto element = visit(a.element());
+    auto length = visit(a.length());
+
+    /* Arguments for integer parameters are checked to be positive when the
+     * template is specialized, so only the element is checked here. */
+    if (auto *param = boost::get<IntegerParameter>(&length)) {
+        validate_array(element, 1, a.pos());
+        return Array<TemplateType>(element, 0, param->index);
+    }
+
+    auto value = boost::get<IntegerArg>(length).get_value();
+    validate_array(element, value, a.pos());
+    return Array<TemplateType>(element, value);
+}
+
+TemplateType TemplateTypeGen::operator()(const AST::IntegerArg &i) {
+    if (!i.is_literal()) {
+        for (int j = 0; j < (int)args.size(); ++j) {
+            if (i.name() == args[j]) return IntegerParameter { j };
+        }
+    }
+
+    return to_template(TypeGen(translator).visit(i));
+}
+
 }
 }
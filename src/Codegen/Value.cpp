@@ -20,6 +20,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/optional.hpp>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "Codegen/Constant.hh"
 #include "Codegen/Type.hh"
 #include "Codegen/Value.hh"
 
@@ -39,7 +48,7 @@ Value LValueGen::operator()(const AST::Dereference &deref) {
 Value LValueGen::operator()(const AST::FieldAccess &fa) {
     if (auto *structure = llvm::dyn_cast<AST::LValue>(&fa.structure())) {
         return _translator.field_address(
-                visit(*structure), fa.field(), fa.pos());
+                visit(*structure), fa.field().str(), fa.pos());
     }
 
     throw Error("parser error",
@@ -47,6 +56,18 @@ Value LValueGen::operator()(const AST::FieldAccess &fa) {
                 fa.pos());
 }
 
+Value LValueGen::operator()(const AST::Index &index) {
+    if (auto *array = llvm::dyn_cast<AST::LValue>(&index.array())) {
+        return _translator.element_address(
+                visit(*array), ValueGen(_translator).visit(index.index()),
+                index.pos());
+    }
+
+    throw Error("parser error",
+                "expected lvalue array in lvalue access",
+                index.pos());
+}
+
 Value ValueGen::operator()(const AST::IntLiteral &lit) {
     SignedInt type(64);
     auto *llvm_type = type.to_llvm(_ctx);
@@ -78,7 +99,20 @@ Value ValueGen::operator()(const AST::Dereference &deref) {
 Value ValueGen::operator()(const AST::FieldAccess &access) {
     auto lhs = visit(access.structure());
 
-    return _translator.field_access(lhs, access.field(), access.pos());
+    return _translator.field_access(lhs, access.field().str(), access.pos());
+}
+
+Value ValueGen::operator()(const AST::Index &index) {
+    /* Arrays in memory are indexed there, rather than loaded whole. */
+    if (llvm::isa<AST::LValue>(index.array())) {
+        return _translator.add_load(LValueGen(_translator).visit(index),
+                                    index.pos());
+    }
+
+    auto array = visit(index.array());
+    auto i = visit(index.index());
+
+    return _translator.element_access(array, i, index.pos());
 }
 
 Value ValueGen::operator()(const AST::Reference &ref) {
@@ -91,51 +125,234 @@ Value ValueGen::operator()(const AST::Variable &var) {
     return _translator.get_identifier_value(var.name(), var.pos());
 }
 
+Value apply_binop(Translator &translator, Tok::Op op,
+                  Value lhs, Value rhs, SourcePos pos) {
+    switch (op) {
+        case Tok::Op::Shl: return translator.left_shift(lhs, rhs, pos);
+        case Tok::Op::Shr: return translator.right_shift(lhs, rhs, pos);
+        case Tok::Op::BitAnd: return translator.bit_and(lhs, rhs, pos);
+        case Tok::Op::BitOr: return translator.bit_or(lhs, rhs, pos);
+        case Tok::Op::BitXor: return translator.bit_xor(lhs, rhs, pos);
+        case Tok::Op::Add: return translator.add(lhs, rhs, pos);
+        case Tok::Op::Sub: return translator.sub(lhs, rhs, pos);
+        case Tok::Op::Mul: return translator.mul(lhs, rhs, pos);
+        case Tok::Op::Div: return translator.div(lhs, rhs, pos);
+        case Tok::Op::Eq: return translator.equal(lhs, rhs, pos);
+        case Tok::Op::Ne: return translator.nequal(lhs, rhs, pos);
+        case Tok::Op::Lt: return translator.less(lhs, rhs, pos);
+        case Tok::Op::Le: return translator.lesseq(lhs, rhs, pos);
+        case Tok::Op::Gt: return translator.greater(lhs, rhs, pos);
+        case Tok::Op::Ge: return translator.greatereq(lhs, rhs, pos);
+        case Tok::Op::And: return translator.bool_and(lhs, rhs, pos);
+        case Tok::Op::Or: return translator.bool_or(lhs, rhs, pos);
+        default: break;
+    }
+
+    throw Error("internal error", "unrecognized operator \""
+                                + std::string(Tok::spelling(op)) + "\"", pos);
+}
+
 Value ValueGen::operator()(const AST::Binop &binop) {
     auto lhs = visit(binop.lhs());
     auto rhs = visit(binop.rhs());
 
-    auto pos = binop.pos();
-
-    if (binop.op() == "<<") {
-        return _translator.left_shift(lhs, rhs, pos);
-    } else if (binop.op() == ">>") {
-        return _translator.right_shift(lhs, rhs, pos);
-    } else if (binop.op() == "&") {
-        return _translator.bit_and(lhs, rhs, pos);
-    } else if (binop.op() == "|") {
-        return _translator.bit_or(lhs, rhs, pos);
-    } else if (binop.op() == "^") {
-        return _translator.bit_xor(lhs, rhs, pos);
-    } else if (binop.op() == "+") {
-        return _translator.add(lhs, rhs, pos);
-    } else if (binop.op() == "-") {
-        return _translator.sub(lhs, rhs, pos);
-    } else if (binop.op() == "*") {
-        return _translator.mul(lhs, rhs, pos);
-    } else if (binop.op() == "/") {
-        return _translator.div(lhs, rhs, pos);
-    } else if (binop.op() == "==") {
-        return _translator.equal(lhs, rhs, pos);
-    } else if (binop.op() == "!=") {
-        return _translator.nequal(lhs, rhs, pos);
-    } else if (binop.op() == "<") {
-        return _translator.less(lhs, rhs, pos);
-    } else if (binop.op() == "<=") {
-        return _translator.lesseq(lhs, rhs, pos);
-    } else if (binop.op() == ">") {
-        return _translator.greater(lhs, rhs, pos);
-    } else if (binop.op() == ">=") {
-        return _translator.greatereq(lhs, rhs, pos);
-    } else if (binop.op() == "&&") {
-        return _translator.bool_and(lhs, rhs, pos);
-    } else if (binop.op() == "||") {
-        return _translator.bool_or(lhs, rhs, pos);
-    } else {
-        throw Error("internal error", "unrecognized operator \"" + binop.op()
-                                                                 + "\"", pos);
-                    
+    return apply_binop(_translator, binop.op(), lhs, rhs, binop.pos());
+}
+
+/**
+ * @brief Check that a builtin was given the right number of arguments.
+ */
+static void check_nargs(Symbol fname, const std::vector<Value> &args,
+                        size_t expected, SourcePos pos) {
+    if (args.size() != expected) {
+        throw Error("type error",
+                    "wrong number of arguments to \"" + fname.str()
+                  + "\"", pos);
+    }
+}
+
+/**
+ * @brief Generate code for a call to a builtin atomic operation: `atomic_`,
+ *        then the operation, then optionally `_` and an ordering (by default
+ *        `seq_cst`), as in `atomic_fetch_add_relaxed`.
+ *
+ * @return The result, or none if `fname` is not an atomic builtin.
+ */
+static boost::optional<Value> call_atomic_builtin(
+        Translator &translator, Symbol fname, const std::vector<Value> &args,
+        SourcePos pos) {
+    static const std::unordered_map<std::string, AtomicOrdering> orderings {
+        { "relaxed", AtomicOrdering::Relaxed },
+        { "acquire", AtomicOrdering::Acquire },
+        { "release", AtomicOrdering::Release },
+        { "acq_rel", AtomicOrdering::AcqRel },
+        { "seq_cst", AtomicOrdering::SeqCst }
+    };
+
+    static const std::unordered_map<std::string, AtomicOp> rmw_ops {
+        { "xchg", AtomicOp::Xchg },
+        { "fetch_add", AtomicOp::Add },
+        { "fetch_sub", AtomicOp::Sub },
+        { "fetch_and", AtomicOp::And },
+        { "fetch_or", AtomicOp::Or },
+        { "fetch_xor", AtomicOp::Xor }
+    };
+
+    llvm::StringRef name = fname.str();
+    if (!name.consume_front("atomic_")) return boost::none;
+
+    auto ordering = AtomicOrdering::SeqCst;
+    for (const auto &suffix: orderings) {
+        if (name.consume_back("_" + suffix.first)) {
+            ordering = suffix.second;
+            break;
+        }
+    }
+
+    if (name == "load") {
+        check_nargs(fname, args, 1, pos);
+        return translator.atomic_load(args[0], ordering, pos);
+    }
+
+    if (name == "store") {
+        check_nargs(fname, args, 2, pos);
+        return translator.atomic_store(args[0], args[1], ordering, pos);
+    }
+
+    if (name == "cmpxchg" || name == "cmpxchg_weak") {
+        check_nargs(fname, args, 3, pos);
+        return translator.atomic_cmpxchg(args[0], args[1], args[2],
+                                         name == "cmpxchg_weak", ordering,
+                                         pos);
+    }
+
+    if (name == "fence") {
+        check_nargs(fname, args, 0, pos);
+        return translator.atomic_fence(ordering, pos);
+    }
+
+    auto rmw_op = rmw_ops.find(name.str());
+    if (rmw_op != rmw_ops.end()) {
+        check_nargs(fname, args, 2, pos);
+        return translator.atomic_rmw(rmw_op->second, args[0], args[1],
+                                     ordering, pos);
+    }
+
+    return boost::none;
+}
+
+/**
+ * @brief Generate code for a call to a builtin vector, bit, arithmetic,
+ *        floating-point, prefetch, branch hint, atomic or coroutine
+ *        operation.
+ *
+ * Builtins are only used where the program does not define a function of the
+ * same name.
+ *
+ * @return The result, or none if `fname` is not a builtin.
+ */
+static boost::optional<Value> call_builtin(Translator &translator,
+                                           Symbol fname,
+                                           const std::vector<Value> &args,
+                                           SourcePos pos) {
+    static const std::unordered_map<std::string, Reduction> reductions {
+        { "reduce_add", Reduction::Add },
+        { "reduce_mul", Reduction::Mul },
+        { "reduce_min", Reduction::Min },
+        { "reduce_max", Reduction::Max },
+        { "reduce_and", Reduction::And },
+        { "reduce_or", Reduction::Or },
+        { "reduce_xor", Reduction::Xor }
+    };
+
+    static const std::unordered_map<std::string,
+                                    std::pair<Intrinsic, size_t> > intrinsics {
+        { "popcount", { Intrinsic::Popcount, 1 } },
+        { "clz", { Intrinsic::CountLeadingZeros, 1 } },
+        { "ctz", { Intrinsic::CountTrailingZeros, 1 } },
+        { "bswap", { Intrinsic::ByteSwap, 1 } },
+        { "rotl", { Intrinsic::RotateLeft, 2 } },
+        { "rotr", { Intrinsic::RotateRight, 2 } },
+        { "sqrt", { Intrinsic::Sqrt, 1 } },
+        { "fma", { Intrinsic::FusedMultiplyAdd, 3 } }
+    };
+
+    auto atomic = call_atomic_builtin(translator, fname, args, pos);
+    if (atomic) return atomic;
+
+    auto intrinsic = intrinsics.find(fname.str());
+    if (intrinsic != intrinsics.end()) {
+        check_nargs(fname, args, intrinsic->second.second, pos);
+        return translator.intrinsic(intrinsic->second.first, args, pos);
+    }
+
+    if (fname == Symbol("wrapping_add") || fname == Symbol("wrapping_sub")
+     || fname == Symbol("wrapping_mul")) {
+        check_nargs(fname, args, 2, pos);
+        return fname == Symbol("wrapping_add")
+             ? translator.add(args[0], args[1], pos, true)
+             : fname == Symbol("wrapping_sub")
+             ? translator.sub(args[0], args[1], pos, true)
+             : translator.mul(args[0], args[1], pos, true);
+    }
+
+    if (fname == Symbol("likely") || fname == Symbol("unlikely")) {
+        check_nargs(fname, args, 1, pos);
+        return translator.expect(args[0], fname == Symbol("likely"), pos);
+    }
+
+    if (fname == Symbol("prefetch") || fname == Symbol("prefetch_write")) {
+        if (args.size() != 2) check_nargs(fname, args, 1, pos);
+        return translator.prefetch(
+                args[0], fname == Symbol("prefetch_write"),
+                args.size() == 2 ? boost::make_optional(args[1])
+                                 : boost::none,
+                pos);
+    }
+
+    auto reduction = reductions.find(fname.str());
+    if (reduction != reductions.end()) {
+        check_nargs(fname, args, 1, pos);
+        return translator.reduce(reduction->second, args[0], pos);
+    }
+
+    if (fname == Symbol("extract")) {
+        check_nargs(fname, args, 2, pos);
+        return translator.extract(args[0], args[1], pos);
+    }
+
+    if (fname == Symbol("insert")) {
+        check_nargs(fname, args, 3, pos);
+        return translator.insert(args[0], args[1], args[2], pos);
+    }
+
+    if (fname == Symbol("async_suspend")) {
+        check_nargs(fname, args, 0, pos);
+        return translator.async_suspend(pos);
+    }
+
+    if (fname == Symbol("async_resume")) {
+        check_nargs(fname, args, 1, pos);
+        return translator.async_resume(args[0], pos);
+    }
+
+    if (fname == Symbol("async_done")) {
+        check_nargs(fname, args, 1, pos);
+        return translator.async_done(args[0], pos);
+    }
+
+    if (fname == Symbol("async_destroy")) {
+        check_nargs(fname, args, 1, pos);
+        return translator.async_destroy(args[0], pos);
     }
+
+    if (fname == Symbol("shuffle")) {
+        if (args.size() < 3) check_nargs(fname, args, 3, pos);
+        std::vector<Value> indices(args.begin() + 2, args.end());
+        return translator.shuffle(args[0], args[1], indices, pos);
+    }
+
+    return boost::none;
 }
 
 Value ValueGen::operator()(const AST::FunctionCall &call) {
@@ -145,6 +362,26 @@ Value ValueGen::operator()(const AST::FunctionCall &call) {
         args.push_back(visit(*arg));
     }
 
+    if (call.awaited()) {
+        return _translator.await_(call.fname(), args, call.pos());
+    }
+
+    if (!_translator.is_function(call.fname())) {
+        auto result = call_builtin(_translator, call.fname(), args,
+                                   call.pos());
+        if (result) return *result;
+    }
+
+    // Calls to `const fn`s with constant arguments are evaluated now where
+    // possible; if not, the function is just called at run time.
+    auto const_fn = _translator.lookup_const_function(call.fname());
+    if (const_fn && std::all_of(args.begin(), args.end(), is_constant)) {
+        try {
+            return ConstantGen(_translator).call(*const_fn, args,
+                                                 call.pos());
+        } catch (Error &) {}
+    }
+
     return _translator.call(call.fname(), args, call.pos());
 }
 
@@ -163,6 +400,42 @@ Value ValueGen::operator()(const AST::TemplateFunctionCall &call) {
         args.push_back(visit(*arg));
     }
 
+    if (call.fname() == Symbol("splat")
+            && !_translator.is_function(call.fname())) {
+        if (tmpl_args.size() != 1) {
+            throw Error("type error",
+                        "splat takes one vector type", call.pos());
+        }
+        check_nargs(call.fname(), args, 1, call.pos());
+        return _translator.splat(tmpl_args[0], args[0], call.pos());
+    }
+
+    if ((call.fname() == Symbol("sizeof") || call.fname() == Symbol("alignof"))
+            && !_translator.is_function(call.fname())) {
+        if (tmpl_args.size() != 1 || is_type<IntegerArg>(tmpl_args[0])) {
+            throw Error("type error", call.fname().str() + " takes one type",
+                        call.pos());
+        }
+        check_nargs(call.fname(), args, 0, call.pos());
+        return call.fname() == Symbol("sizeof")
+             ? _translator.size_of(tmpl_args[0], call.pos())
+             : _translator.align_of(tmpl_args[0], call.pos());
+    }
+
+    if ((call.fname() == Symbol("new") || call.fname() == Symbol("delete"))
+            && !_translator.is_function(call.fname())) {
+        if (tmpl_args.size() != 1 || is_type<IntegerArg>(tmpl_args[0])) {
+            throw Error("type error", call.fname().str() + " takes one type",
+                        call.pos());
+        }
+        if (call.fname() == Symbol("new")) {
+            check_nargs(call.fname(), args, 0, call.pos());
+            return _translator.allocate(tmpl_args[0], call.pos());
+        }
+        check_nargs(call.fname(), args, 1, call.pos());
+        return _translator.deallocate(tmpl_args[0], args[0], call.pos());
+    }
+
     return _translator.call(call.fname(), tmpl_args, args, call.pos());
 }
 
@@ -0,0 +1,331 @@
+/**
+ * @file DebugInfo.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DebugInfo.hh"
+
+#include <functional>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include "SourceManager.hh"
+
+namespace Craeft {
+
+DebugInfoGen::DebugInfoGen(llvm::Module &module, LlvmTypeCache &types,
+                           DebugLevel level, const std::string &fname,
+                           SourceManager &sources)
+    : module(module), types(types), level(level), builder(module),
+      fname(fname), sources(sources) {
+    llvm::SmallString<128> dir;
+    llvm::sys::fs::current_path(dir);
+
+    std::string name = fname == "-" ? "<stdin>" : fname;
+    file = builder.createFile(name, dir);
+
+    // There is no DWARF language code for Craeft; C is the closest, and the
+    // one debuggers and profilers are sure to handle.
+    auto kind = level == DebugLevel::Full
+              ? llvm::DICompileUnit::FullDebug
+              : level == DebugLevel::LineTables
+              ? llvm::DICompileUnit::LineTablesOnly
+              : llvm::DICompileUnit::NoDebug;
+    unit = builder.createCompileUnit(llvm::dwarf::DW_LANG_C99, file,
+                                     "craeftc", false, "", 0, "", kind);
+
+    module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+    module.addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                         llvm::DEBUG_METADATA_VERSION);
+}
+
+void DebugInfoGen::start_function(llvm::Function *f, const Function<> &type,
+                                  SourcePos pos) {
+    unsigned line = sources.line_and_column(pos).first;
+
+    // Line tables don't need the real signature.
+    auto *sub_type = level == DebugLevel::Full
+                   ? get_function_type(type)
+                   : builder.createSubroutineType(
+                         builder.getOrCreateTypeArray({}));
+
+    auto *f_file = get_file(pos);
+
+    function = f;
+    subprogram = builder.createFunction(
+            f_file, f->getName(), "", f_file, line, sub_type, line,
+            llvm::DINode::FlagPrototyped,
+            llvm::DISubprogram::SPFlagDefinition);
+    f->setSubprogram(subprogram);
+}
+
+llvm::DebugLoc DebugInfoGen::location(SourcePos pos) {
+    if (!subprogram) return llvm::DebugLoc();
+
+    auto line_col = sources.line_and_column(pos);
+    if (!line_col.first) {
+        return llvm::DILocation::get(module.getContext(),
+                                     subprogram->getLine(), 0, subprogram);
+    }
+
+    return llvm::DILocation::get(module.getContext(), line_col.first,
+                                 line_col.second, subprogram);
+}
+
+void DebugInfoGen::declare_variable(Symbol name, const Type &t,
+                                    llvm::Value *addr, unsigned arg,
+                                    llvm::DebugLoc loc) {
+    if (level != DebugLevel::Full || !subprogram) return;
+
+    if (!loc) {
+        loc = llvm::DILocation::get(module.getContext(),
+                                    subprogram->getLine(), 0, subprogram);
+    }
+
+    llvm::DILocalVariable *var;
+    if (arg) {
+        var = builder.createParameterVariable(subprogram, name.str(), arg,
+                                              subprogram->getFile(),
+                                              loc.getLine(),
+                                              get_type(t), true);
+    } else {
+        var = builder.createAutoVariable(subprogram, name.str(),
+                                         subprogram->getFile(), loc.getLine(),
+                                         get_type(t), true);
+    }
+
+    auto *expr = builder.createExpression();
+    auto *inst = llvm::dyn_cast<llvm::Instruction>(addr);
+    if (!inst) {
+        // An argument passed in memory, declared while the entry block is
+        // being started.
+        auto *param = llvm::cast<llvm::Argument>(addr);
+        builder.insertDeclare(addr, var, expr, loc,
+                              &param->getParent()->getEntryBlock());
+    } else if (auto *next = inst->getNextNode()) {
+        builder.insertDeclare(addr, var, expr, loc, next);
+    } else {
+        builder.insertDeclare(addr, var, expr, loc, inst->getParent());
+    }
+}
+
+void DebugInfoGen::declare_global(Symbol name, const Type &t,
+                                  llvm::GlobalVariable *global,
+                                  SourcePos pos) {
+    if (level != DebugLevel::Full) return;
+
+    unsigned line = sources.line_and_column(pos).first;
+    global->addDebugInfo(builder.createGlobalVariableExpression(
+            unit, name.str(), global->getName(), get_file(pos), line,
+            get_type(t), false));
+}
+
+llvm::DIFile *DebugInfoGen::get_file(SourcePos pos) {
+    auto name = sources.file_name(pos);
+    if (name.empty() || name == fname) return file;
+
+    auto &result = imports[name];
+    if (!result) result = builder.createFile(name, file->getDirectory());
+    return result;
+}
+
+void DebugInfoGen::end_function(void) {
+    if (!subprogram) return;
+
+    llvm::DebugLoc last = llvm::DILocation::get(
+            module.getContext(), subprogram->getLine(), 0, subprogram);
+
+    for (auto &block: *function) {
+        for (auto &inst: block) {
+            if (inst.getDebugLoc()) {
+                last = inst.getDebugLoc();
+            } else {
+                inst.setDebugLoc(last);
+            }
+        }
+    }
+
+    builder.finalizeSubprogram(subprogram);
+    function = nullptr;
+    subprogram = nullptr;
+}
+
+void DebugInfoGen::finalize(void) {
+    if (finalized) return;
+
+    builder.finalize();
+    finalized = true;
+}
+
+namespace {
+
+/**
+ * @brief Describes types for `DebugInfoGen::get_type`.
+ */
+struct DITypeVisitor: public boost::static_visitor<llvm::DIType *> {
+    DITypeVisitor(llvm::DIBuilder &builder, llvm::DIFile *file,
+                  LlvmTypeCache &types, const llvm::DataLayout &layout,
+                  std::function<llvm::DIType *(const Type &)> get)
+        : builder(builder), file(file), types(types), layout(layout),
+          get(get) {}
+
+    llvm::DIType *operator()(const SignedInt &t) const {
+        auto nbits = t.get_nbits();
+        return builder.createBasicType("I" + std::to_string(nbits), nbits,
+                                       llvm::dwarf::DW_ATE_signed);
+    }
+
+    llvm::DIType *operator()(const UnsignedInt &t) const {
+        auto nbits = t.get_nbits();
+        if (nbits == 1) {
+            return builder.createBasicType("U1", 8,
+                                           llvm::dwarf::DW_ATE_boolean);
+        }
+        return builder.createBasicType("U" + std::to_string(nbits), nbits,
+                                       llvm::dwarf::DW_ATE_unsigned);
+    }
+
+    llvm::DIType *operator()(const Float &t) const {
+        bool single = t.get_precision() == SinglePrecision;
+        return builder.createBasicType(single ? "Float" : "Double",
+                                       single ? 32 : 64,
+                                       llvm::dwarf::DW_ATE_float);
+    }
+
+    llvm::DIType *operator()(const Void &) const {
+        return nullptr;
+    }
+
+    llvm::DIType *operator()(const IntegerArg &) const {
+        // Only a template argument; nothing has this type.
+        return nullptr;
+    }
+
+    llvm::DIType *operator()(const Pointer<> &t) const {
+        auto *result = builder.createPointerType(
+                get(*t.get_pointed()), layout.getPointerSizeInBits());
+        if (!t.is_restrict()) return result;
+
+        return builder.createQualifiedType(llvm::dwarf::DW_TAG_restrict_type,
+                                           result);
+    }
+
+    llvm::DIType *operator()(const Function<> &t) const {
+        std::vector<llvm::Metadata *> elements;
+        elements.push_back(get(*t.get_rettype()));
+        for (const auto &arg: t.get_args()) elements.push_back(get(arg));
+
+        return builder.createSubroutineType(
+                builder.getOrCreateTypeArray(elements));
+    }
+
+    llvm::DIType *operator()(const Struct<> &t) const {
+        auto *ll_t = llvm::cast<llvm::StructType>(types.get(t));
+        const auto *placement = layout.getStructLayout(ll_t);
+
+        std::vector<llvm::Metadata *> members;
+        const auto &fields = t.get_fields();
+        for (unsigned i = 0; i < fields.size(); ++i) {
+            const auto &field_t = fields[i].second;
+            auto idx = types.get_field_index(t, i);
+            members.push_back(builder.createMemberType(
+                    file, fields[i].first, file, 0,
+                    layout.getTypeSizeInBits(types.get(field_t)), 0,
+                    placement->getElementOffsetInBits(idx),
+                    llvm::DINode::FlagZero, get(field_t)));
+        }
+
+        return builder.createStructType(
+                file, t.get_name(), file, 0,
+                layout.getTypeAllocSizeInBits(ll_t),
+                types.get_alignment(t) * 8, llvm::DINode::FlagZero, nullptr,
+                builder.getOrCreateArray(members));
+    }
+
+    llvm::DIType *operator()(const Vector<> &t) const {
+        auto *ll_t = types.get(t);
+        auto *subscript = builder.getOrCreateSubrange(0, t.get_lanes());
+
+        return builder.createVectorType(
+                layout.getTypeAllocSizeInBits(ll_t),
+                types.get_alignment(t) * 8, get(*t.get_element()),
+                builder.getOrCreateArray({ subscript }));
+    }
+
+    llvm::DIType *operator()(const Array<> &t) const {
+        auto *ll_t = types.get(t);
+        auto *subscript = builder.getOrCreateSubrange(0, t.get_length());
+
+        return builder.createArrayType(
+                layout.getTypeAllocSizeInBits(ll_t),
+                types.get_alignment(t) * 8, get(*t.get_element()),
+                builder.getOrCreateArray({ subscript }));
+    }
+
+    llvm::DIBuilder &builder;
+    llvm::DIFile *file;
+    LlvmTypeCache &types;
+    const llvm::DataLayout &layout;
+    std::function<llvm::DIType *(const Type &)> get;
+};
+
+}
+
+llvm::DIType *DebugInfoGen::get_type(const Type &t) {
+    auto found = type_cache.find(t);
+    if (found != type_cache.end()) return found->second;
+
+    DITypeVisitor visitor(builder, file, types, module.getDataLayout(),
+                          [this](const Type &t) { return get_type(t); });
+    auto *result = boost::apply_visitor(visitor, t.variant());
+
+    type_cache[t] = result;
+    return result;
+}
+
+llvm::DISubroutineType *DebugInfoGen::get_function_type(
+        const Function<> &t) {
+    return llvm::cast<llvm::DISubroutineType>(get_type(t));
+}
+
+void merge_compile_units(llvm::Module &module) {
+    auto *units = module.getNamedMetadata("llvm.dbg.cu");
+    if (!units || units->getNumOperands() < 2) return;
+
+    auto *first = llvm::cast<llvm::DICompileUnit>(units->getOperand(0));
+
+    // Functions inlined before linking are described too, by subprograms
+    // reachable only from the locations of the inlined code.
+    llvm::DebugInfoFinder finder;
+    finder.processModule(module);
+    for (auto *subprogram: finder.subprograms()) {
+        if (subprogram->getUnit()) subprogram->replaceUnit(first);
+    }
+
+    units->clearOperands();
+    units->addOperand(first);
+}
+
+}
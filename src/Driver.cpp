@@ -0,0 +1,500 @@
+/**
+ * @file Driver.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "Driver.hh"
+#include "LTO.hh"
+#include "Parser.hh"
+#include "TimeReport.hh"
+
+namespace Craeft {
+
+/* Actually the privileges most compilers create object files with. */
+static const int OBJFILE_MODE_BLAZEIT = 420;
+
+/* How many top-level nodes the parser may get ahead of the code generator. */
+static const size_t PIPELINE_DEPTH = 64;
+
+namespace {
+
+/**
+ * @brief A top-level node from the parser, or the error it stopped at.
+ */
+struct Parsed {
+    AST::ArenaPtr<AST::Toplevel> ast;
+    std::unique_ptr<Error> error;
+};
+
+/**
+ * @brief A bounded queue of parsed nodes, from the parser's thread to the
+ *        code generator's.
+ *
+ * The parser blocks when it gets too far ahead, which bounds the memory held
+ * by trees waiting for code generation.
+ */
+class ParseQueue {
+public:
+    explicit ParseQueue(size_t capacity)
+        : capacity(capacity), closed(false), cancelled(false) {}
+
+    /**
+     * @brief Add a node, waiting for room.
+     *
+     * @return False if the consumer has stopped, in which case the producer
+     *         should too.
+     */
+    bool push(Parsed parsed) {
+        std::unique_lock<std::mutex> guard(lock);
+        not_full.wait(guard, [this] {
+            return items.size() < capacity || cancelled;
+        });
+        if (cancelled) return false;
+
+        items.push_back(std::move(parsed));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Take the next node, waiting for one.
+     *
+     * @return False once the queue is closed and empty.
+     */
+    bool pop(Parsed &out) {
+        std::unique_lock<std::mutex> guard(lock);
+        not_empty.wait(guard, [this] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+
+        out = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Mark that nothing more will be pushed.
+     */
+    void close(void) {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        not_empty.notify_one();
+    }
+
+    /**
+     * @brief Mark that nothing more will be popped, releasing the producer.
+     */
+    void cancel(void) {
+        std::lock_guard<std::mutex> guard(lock);
+        cancelled = true;
+        not_full.notify_one();
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    bool cancelled;
+
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<Parsed> items;
+};
+
+}
+
+/**
+ * @brief Parse the input on another thread, generating code for each
+ *        top-level node as the parser produces it.
+ *
+ * Both sides stop at their first error.  Nodes are generated in source
+ * order, so whichever error comes first in the source is the one reported.
+ */
+static bool handle_pipelined_input(Parser &p, Codegen::ModuleGen &c,
+                                   SourceManager &sources,
+                                   std::ostream &diagnostics) {
+    ParseQueue queue(PIPELINE_DEPTH);
+
+    std::thread parser([&p, &queue] {
+        for (;;) {
+            Parsed parsed;
+
+            try {
+                if (p.at_eof()) break;
+                parsed.ast = p.parse_toplevel();
+            } catch (Error e) {
+                parsed.error = std::make_unique<Error>(e);
+            }
+
+            bool failed = parsed.error != nullptr;
+            if (!queue.push(std::move(parsed)) || failed) break;
+        }
+
+        queue.close();
+    });
+
+    bool successful = true;
+
+    for (;;) {
+        Parsed parsed;
+        if (!queue.pop(parsed)) break;
+
+        try {
+            if (parsed.error) throw *parsed.error;
+            c.codegen(*parsed.ast);
+        } catch (Error e) {
+            e.emit(diagnostics, sources);
+            successful = false;
+            break;
+        }
+    }
+
+    queue.cancel();
+    parser.join();
+
+    return successful;
+}
+
+/**
+ * @brief Parse the whole input, then generate code for it on `jobs` threads,
+ *        reusing what is in `cache` if it is not null.
+ *
+ * If the parser fails, code is still generated for the nodes before the
+ * error, so that an error in them is the one reported, as it would be
+ * compiling sequentially.
+ */
+static bool handle_all_input(Parser &p, Codegen::ModuleGen &c,
+                             SourceManager &sources, int jobs, int opt_level, int size_level,
+                             Codegen::BuildCache *cache, bool thin_lto,
+                             std::ostream &diagnostics) {
+    std::vector<AST::ArenaPtr<AST::Toplevel> > asts;
+    std::vector<const AST::Toplevel *> nodes;
+    std::vector<ToplevelFingerprint> fingerprints;
+    std::unique_ptr<Error> parse_error;
+
+    p.set_fingerprinting(cache != nullptr);
+
+    try {
+        while (!p.at_eof()) {
+            asts.push_back(p.parse_toplevel());
+            nodes.push_back(asts.back().get());
+            if (cache) fingerprints.push_back(p.last_fingerprint());
+        }
+    } catch (Error e) {
+        parse_error = std::make_unique<Error>(e);
+    }
+
+    try {
+        if (parse_error) {
+            /* The code is thrown away, so neither optimize nor cache it. */
+            c.codegen_parallel(nodes, jobs, 0, 0, nullptr, thin_lto);
+        } else {
+            if (cache) cache->set_toplevels(fingerprints);
+            c.codegen_parallel(nodes, jobs, opt_level, size_level, cache,
+                               thin_lto);
+        }
+    } catch (Error e) {
+        e.emit(diagnostics, sources);
+        return false;
+    }
+
+    if (parse_error) {
+        parse_error->emit(diagnostics, sources);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Add the size of the module to the active time report.
+ */
+static void count_module(Codegen::ModuleGen &c, const std::string &suffix) {
+    auto counts = c.counts();
+    TimeReport::add("functions" + suffix, counts.functions);
+    TimeReport::add("IR instructions" + suffix, counts.instructions);
+}
+
+/**
+ * @brief Open an output file for writing, replacing anything already there
+ *        and printing an error if it can't be.
+ *
+ * @return The file descriptor, or -1 on failure.
+ */
+static int open_output(const std::string &fname, std::ostream &diagnostics) {
+    int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                  OBJFILE_MODE_BLAZEIT);
+    if (fd < 0) {
+        diagnostics << "craeftc: cannot open " << fname << ": "
+                    << strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+/**
+ * @brief Write all of `data` to `fd`.
+ *
+ * @return 0, or the `errno` of the write that failed.
+ */
+static int write_all(int fd, const std::string &data) {
+    const char *next = data.data();
+    const char *end = data.data() + data.size();
+
+    while (next < end) {
+        auto written = write(fd, next, end - next);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        next += written;
+    }
+
+    return 0;
+}
+
+Driver::Driver(DriverOptions options): options(options) {
+    /* Remarks are located by the code's debug locations. */
+    if (this->options.remarks
+     && this->options.debug_level == DebugLevel::None) {
+        this->options.debug_level = DebugLevel::Locations;
+    }
+
+    if (options.profile.use_file.empty()) return;
+
+    auto buffer = llvm::MemoryBuffer::getFile(options.profile.use_file);
+    if (!buffer) return;
+
+    llvm::MD5 digest;
+    digest.update((*buffer)->getBuffer());
+    llvm::MD5::MD5Result result;
+    digest.final(result);
+    profile_id = result.digest().str().str();
+}
+
+std::unique_ptr<Codegen::ModuleGen> Driver::compile(
+        const std::string &in_file, SourceManager &sources, int jobs,
+        std::ostream &diagnostics) {
+    if (in_file != "-" && !llvm::sys::fs::exists(in_file)) {
+        diagnostics << "craeftc: cannot read " << in_file << std::endl;
+        return nullptr;
+    }
+
+    /* Get a code generator. */
+    auto codegen = std::make_unique<Codegen::ModuleGen>(
+            "Craeft module", in_file, sources, options.target);
+    codegen->set_profile(options.profile);
+    codegen->set_debug_level(options.debug_level);
+    codegen->set_fast_math(options.fast_math);
+    if (options.wrapping_overflow) codegen->set_wrapping_overflow();
+    if (options.fast_compile) codegen->set_fast_backend();
+    if (options.split_codegen) codegen->set_backend_threads(jobs);
+    if (options.interface) codegen->record_interface();
+    if (options.remarks) {
+        try {
+            codegen->set_remarks(options.remarks_passes);
+        } catch (Error e) {
+            e.emit(diagnostics, sources);
+            return nullptr;
+        }
+    }
+    /* Construct a parser on that file. */
+    Parser parser(in_file, sources, options.import_dirs);
+
+    std::unique_ptr<Codegen::BuildCache> cache;
+    // Instrumentation adds globals which cached functions would leave
+    // behind, and debug information would go stale as code moves around.
+    if (!options.cache_dir.empty() && !options.profile.generate
+     && options.debug_level == DebugLevel::None) {
+        cache = std::make_unique<Codegen::BuildCache>(
+                options.cache_dir, options.compiler_id, options.target,
+                options.opt_level, options.size_level, options.thin_lto,
+                profile_id, options.fast_math, options.wrapping_overflow);
+    }
+
+    if (jobs > 1 || cache) {
+        /* Function bodies are optimized as they are generated. */
+        if (!handle_all_input(parser, *codegen, sources, jobs,
+                              options.opt_level, options.size_level,
+                              cache.get(), options.thin_lto, diagnostics)) {
+            return nullptr;
+        }
+
+        if (!options.fast_compile) codegen->validate(diagnostics);
+        count_module(*codegen, "");
+        return codegen;
+    }
+
+    /* Generate code for ASTs as they come out of the parser. */
+    if (!handle_pipelined_input(parser, *codegen, sources, diagnostics)) {
+        return nullptr;
+    }
+
+    /* Validate the module. */
+    if (!options.fast_compile) codegen->validate(diagnostics);
+    count_module(*codegen, "");
+    /* Optimize the module to the chosen level. */
+    codegen->optimize(options.opt_level, options.size_level,
+                      options.thin_lto);
+    if (options.opt_level > 0) count_module(*codegen, " after optimization");
+
+    return codegen;
+}
+
+bool Driver::emit(Codegen::ModuleGen &module, SourceManager &sources,
+                  const Outputs &outputs, std::ostream &diagnostics) {
+    const std::pair<Artifact, const std::string *> requested[] = {
+        { Artifact::IR, &outputs.ir },
+        { Artifact::Bitcode, &outputs.bc },
+        { Artifact::Assembly, &outputs.assembly },
+        { Artifact::Object, &outputs.obj },
+        { Artifact::Remarks, &outputs.remarks },
+        { Artifact::Interface, &outputs.interface }
+    };
+
+    /* Open every output before doing any work, so that a bad path fails
+     * fast. */
+    std::vector<Artifact> artifacts;
+    std::map<Artifact, std::pair<int, const std::string *> > files;
+    bool successful = true;
+
+    for (const auto &output: requested) {
+        if (output.second->empty()) continue;
+
+        int fd = open_output(*output.second, diagnostics);
+        if (fd < 0) {
+            successful = false;
+            continue;
+        }
+
+        artifacts.push_back(output.first);
+        files[output.first] = std::make_pair(fd, output.second);
+    }
+
+    if (successful) {
+        /* Write each artifact on its own thread, while the next is being
+         * generated. */
+        std::vector<std::thread> writers;
+        std::vector<std::pair<const std::string *, int> > errors(
+                artifacts.size(), std::make_pair(nullptr, 0));
+
+        try {
+            module.emit(artifacts, [&](Artifact artifact, std::string data) {
+                auto file = files[artifact];
+                auto &error = errors[writers.size()];
+                writers.emplace_back([file, &error](std::string data) {
+                    error = std::make_pair(file.second,
+                                           write_all(file.first, data));
+                }, std::move(data));
+            });
+        } catch (Error e) {
+            e.emit(diagnostics, sources);
+            successful = false;
+        }
+
+        for (auto &writer: writers) writer.join();
+
+        for (const auto &error: errors) {
+            if (!error.second) continue;
+            diagnostics << "craeftc: cannot write " << *error.first << ": "
+                        << strerror(error.second) << std::endl;
+            successful = false;
+        }
+    }
+
+    for (const auto &file: files) close(file.second.first);
+
+    return successful;
+}
+
+bool Driver::compile_one(const std::string &in_file, const Outputs &outputs,
+                         int jobs, std::ostream &diagnostics) {
+    SourceManager sources;
+    auto module = compile(in_file, sources, jobs, diagnostics);
+    return module && emit(*module, sources, outputs, diagnostics);
+}
+
+bool Driver::compile_all(const std::vector<std::string> &in_files,
+                         const std::vector<Outputs> &outputs,
+                         std::ostream &diagnostics) {
+    if (in_files.size() == 1) {
+        return compile_one(in_files[0], outputs[0], options.jobs,
+                           diagnostics);
+    }
+
+    size_t nthreads = std::min<size_t>(std::max(options.jobs, 1),
+                                       in_files.size());
+
+    std::vector<std::ostringstream> logs(in_files.size());
+    /* Not vector<bool>, whose elements can't be written concurrently. */
+    std::vector<char> succeeded(in_files.size(), false);
+    std::atomic<size_t> next(0);
+
+    auto work = [&](void) {
+        for (size_t i = next++; i < in_files.size(); i = next++) {
+            succeeded[i] = compile_one(in_files[i], outputs[i], 1, logs[i]);
+        }
+    };
+
+    if (nthreads == 1) {
+        work();
+    } else {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < nthreads; ++i) threads.emplace_back(work);
+        for (auto &thread: threads) thread.join();
+    }
+
+    bool successful = true;
+    for (size_t i = 0; i < in_files.size(); ++i) {
+        diagnostics << logs[i].str();
+        successful = successful && succeeded[i];
+    }
+    diagnostics.flush();
+
+    return successful;
+}
+
+bool Driver::link_all(const std::vector<std::string> &in_files,
+                      const std::vector<Outputs> &outputs,
+                      std::ostream &diagnostics) {
+    std::vector<std::string> objects;
+    for (const auto &output: outputs) objects.push_back(output.obj);
+
+    return thin_link(in_files, objects, options.target, options.opt_level,
+                     options.jobs, diagnostics);
+}
+
+}
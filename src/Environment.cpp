@@ -31,7 +31,7 @@ Type Variable::get_type(void) const {
 
     /* We actually only hold a *pointer* to the value, so we have to get
      * the pointed type. */
-    return *boost::get<Pointer<> >(val.get_type()).get_pointed();
+    return *boost::get<Pointer<> >(val.get_type().variant()).get_pointed();
 }
 
 Environment::Environment(llvm::LLVMContext &ctx) {
@@ -53,6 +53,7 @@ void Environment::pop(void) {
     type_map.pop();
     template_map.pop();
     templatefunc_map.pop();
+    constfunc_map.pop();
 }
 
 void Environment::push(void) {
@@ -60,72 +61,92 @@ void Environment::push(void) {
     type_map.push();
     template_map.push();
     templatefunc_map.push();
+    constfunc_map.push();
 }
 
-bool Environment::bound(const std::string &name) const {
-    if (islower(name[0]) && ident_map.present(name)) {
+bool Environment::bound(Symbol name) const {
+    if (islower(name.str()[0]) && present(ident_map, name)) {
         return true;
     } else {
-        return type_map.present(name);
+        return present(type_map, name);
     }
 
     return false;
 }
 
-Variable Environment::lookup_identifier(const std::string &name,
-                                        SourcePos pos) const {
-    assert(!isupper(name[0]));
+bool Environment::resolve(Symbol name) const {
+    if (!resolver) return false;
+
+    auto saved = resolving;
+    resolving = ident_map.depth();
 
+    bool result;
     try {
-        return ident_map[name];
-    } catch (KeyNotPresentException) {
-        throw Error("name error", "variable \"" + name + "\" not found", pos);
+        result = resolver(name);
+    } catch (...) {
+        resolving = saved;
+        throw;
+    }
+
+    resolving = saved;
+    return result;
+}
+
+Variable Environment::lookup_identifier(Symbol name,
+                                        SourcePos pos) const {
+    assert(!isupper(name.str()[0]));
+
+    if (!present(ident_map, name)) {
+        throw Error("name error", "variable \"" + name.str() + "\" not found",
+                    pos);
     }
+
+    return ident_map[name];
 }
 
-Variable Environment::add_identifier(std::string name, Value val) {
+Variable Environment::add_identifier(Symbol name, Value val) {
     Variable result(val);
-    ident_map.bind(name, result);
+    bind(ident_map, name, result);
     return result;
 }
 
-void Environment::add_type(std::string name, Type t) {
-    type_map.bind(name, t);
+void Environment::add_type(Symbol name, Type t) {
+    bind(type_map, name, t);
 }
 
-const Type &Environment::lookup_type(const std::string &tname,
-                                     SourcePos pos) const {
-    assert(isupper(tname[0]));
+const Type &Environment::lookup_type(Symbol tname, SourcePos pos) const {
+    assert(isupper(tname.str()[0]));
 
-    try {
-        return type_map[tname];
-    } catch (KeyNotPresentException) {
-        throw Error("name error", "type \"" + tname + "\" not found", pos);
+    if (!present(type_map, tname)) {
+        throw Error("name error", "type \"" + tname.str() + "\" not found",
+                    pos);
     }
+
+    return type_map[tname];
 }
 
 const TemplateStruct &Environment::lookup_template(
-        const std::string &tname, SourcePos pos) const {
-    assert(isupper(tname[0]));
+        Symbol tname, SourcePos pos) const {
+    assert(isupper(tname.str()[0]));
 
-    try {
-        return template_map[tname];
-    } catch (KeyNotPresentException) {
-        throw Error("name error", "template type \"" + tname + "\" not found",
-                    pos);
+    if (!present(template_map, tname)) {
+        throw Error("name error", "template type \"" + tname.str()
+                                + "\" not found", pos);
     }
+
+    return template_map[tname];
 }
 
 const TemplateValue &Environment::lookup_template_func(
-        const std::string &func_name,
+        Symbol func_name,
         SourcePos pos) const {
-    assert(islower(func_name[0]));
+    assert(islower(func_name.str()[0]));
 
-    try {
-        return templatefunc_map[func_name];
-    } catch (KeyNotPresentException) {
-        throw Error("name error", "template function \"" + func_name
+    if (!present(templatefunc_map, func_name)) {
+        throw Error("name error", "template function \"" + func_name.str()
                                 + "\" not found", pos);
     }
+
+    return templatefunc_map[func_name];
 }
 }
@@ -21,15 +21,11 @@
  */
 
 #include "Error.hh"
-#include "Environment.hh"
+#include "SourceManager.hh"
 
-#include <cassert>
-#include <fstream>
+#include <algorithm>
 #include <iostream>
-#include <map>
-#include <memory>
 #include <string>
-#include <vector>
 
 #define TERM_ERR   "\x1b[31;1m"
 #define TERM_IND   "\x1b[32;1m"
@@ -37,59 +33,28 @@
 
 namespace Craeft {
 
-/**
- * @brief Cache of vectors containing the lines in files read so far.
- *
- * Maps filenames to vectors of lines in the file.
- */
-static std::map<std::string, std::unique_ptr<std::vector<std::string>>>
-    files_read;
+Error::Error(std::string header, std::string msg, SourcePos pos)
+    : header(header), msg(msg), pos(pos) {}
 
-/**
- * @brief Get the vector of lines from the given filename.
- */
-static std::vector<std::string> &get_lines(std::string f) {
-    if (files_read.count(f)) {
-        return *files_read[f];
+void Error::emit(std::ostream &out, SourceManager &sources) {
+    auto loc = sources.resolve(pos);
+
+    if (loc.fname.empty()) {
+        out << "craeftc";
     } else {
-        auto v = std::make_unique<std::vector<std::string>>();
-        std::ifstream file(f);
-        char buf[81];
-        while (!(file.eof() || file.fail())) {
-            unsigned i;
-            char c;
-            for (i = 0; i < 80; ++i) {
-                if (file.eof() || file.fail()) break;
-                c = file.get();
-                if (c == '\n') {
-                    break;
-                }
-                buf[i] = c;
-            }
-            if (c != '\n') {
-                while (!(file.eof() || file.fail()) && file.get() != '\n');
-            }
-            buf[i] = '\0';
-            v->push_back(std::string(buf));
-        }
-        files_read[f] = std::move(v);
-        return *files_read[f];
+        out << loc.fname << ":" << loc.lineno << ":" << loc.charno;
     }
-}
 
-Error::Error(std::string header, std::string msg, SourcePos pos)
-    : header(header), msg(msg), pos(pos) {}
+    out << ": " << TERM_ERR << header << ": " << TERM_RESET << msg << "\n";
 
-void Error::emit(std::ostream &out) {
-    const std::vector<std::string> &lines = get_lines(*pos.fname);
-    if (pos.charno > 0) pos.charno--;
+    if (!loc.has_line) {
+        out.flush();
+        return;
+    }
 
-    out << *pos.fname
-        << ":" << pos.lineno << ":" << pos.charno + 1
-        << ": " << TERM_ERR << header << ": " << TERM_RESET
-        << msg << "\n\t"
-        << lines[pos.lineno] << "\n\t"
-        << std::string(std::max(0, pos.charno - 1), ' ')
+    out << "\t"
+        << loc.line << "\n\t"
+        << std::string(loc.charno - 1, ' ')
         << TERM_IND << "^" << TERM_RESET << std::endl;
 }
 
@@ -0,0 +1,1067 @@
+/**
+ * @file Interface.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+
+#include "Interface.hh"
+#include "SourceManager.hh"
+
+namespace Craeft {
+
+const char *const INTERFACE_EXTENSION = ".cri";
+
+namespace {
+
+/**
+ * @brief The first bytes of every interface file.  The last is the version
+ *        of the format, bumped whenever the AST or the encoding changes.
+ */
+const char MAGIC[8] = { 'C', 'R', 'A', 'E', 'F', 'T', 'I', 3 };
+
+/**
+ * @brief The header: the magic, then the number of entries, source files
+ *        and imports and the sizes of the entries' trees and the string
+ *        table, each as 32 bits, little-endian.
+ */
+const size_t HEADER_SIZE = sizeof(MAGIC) + 5 * 4;
+
+const size_t ENTRY_SIZE = 3 * 4;
+
+void put_u32(std::string &out, uint32_t value) {
+    char bytes[4];
+    llvm::support::endian::write32le(bytes, value);
+    out.append(bytes, 4);
+}
+
+/**
+ * @brief Get the name a top-level node declares, or the empty symbol if it
+ *        doesn't belong in an interface.
+ */
+Symbol declared_name(const AST::Toplevel &t) {
+    auto is_private = [](const AST::FunctionDeclaration &fd) {
+        return std::any_of(fd.annotations().begin(), fd.annotations().end(),
+                           [](const AST::Annotation &annotation) {
+                               return annotation.name == Symbol("private");
+                           });
+    };
+
+    switch (t.kind()) {
+        case AST::Toplevel::StructDeclaration:
+            return llvm::cast<AST::StructDeclaration>(t).name();
+        case AST::Toplevel::TemplateStructDeclaration:
+            return llvm::cast<AST::TemplateStructDeclaration>(t).decl()
+                                                                .name();
+        case AST::Toplevel::FunctionDeclaration: {
+            const auto &fd = llvm::cast<AST::FunctionDeclaration>(t);
+            return is_private(fd) ? Symbol() : fd.name();
+        }
+        case AST::Toplevel::FunctionDefinition: {
+            const auto &fd = llvm::cast<AST::FunctionDefinition>(t)
+                                 .signature();
+            return is_private(fd) ? Symbol() : fd.name();
+        }
+        case AST::Toplevel::TemplateFunctionDefinition:
+            return llvm::cast<AST::TemplateFunctionDefinition>(t).def()
+                       ->signature().name();
+        case AST::Toplevel::ConstDefinition:
+            return llvm::cast<AST::ConstDefinition>(t).decl().name().name();
+        case AST::Toplevel::ConstFunctionDefinition:
+            return llvm::cast<AST::ConstFunctionDefinition>(t).def()
+                       ->signature().name();
+        case AST::Toplevel::GlobalDefinition:
+            return llvm::cast<AST::GlobalDefinition>(t).name().name();
+        case AST::Toplevel::TypeDeclaration:
+        case AST::Toplevel::Import:
+            break;
+    }
+
+    return Symbol();
+}
+
+}
+
+/*****************************************************************************
+ * Writing interfaces.
+ */
+
+InterfaceWriter::InterfaceWriter(SourceManager &sources): sources(sources) {
+    // Offset 0 is the empty string.
+    intern("");
+}
+
+void InterfaceWriter::add(const AST::Toplevel &t) {
+    if (auto *import = llvm::dyn_cast<AST::Import>(&t)) {
+        auto path = intern(import->path());
+        if (std::find(imports.begin(), imports.end(), path)
+                == imports.end()) {
+            imports.push_back(path);
+        }
+        return;
+    }
+
+    Symbol name = declared_name(t);
+    if (name == Symbol() || !names.insert(name).second) return;
+
+    Entry entry;
+    entry.name = intern(name.str());
+    entry.offset = data.size();
+
+    // Function definitions are imported as declarations.
+    auto kind = llvm::isa<AST::FunctionDefinition>(t)
+              ? AST::Toplevel::FunctionDeclaration : t.kind();
+    write_number(kind);
+    write_pos(t.pos());
+
+    switch (t.kind()) {
+        case AST::Toplevel::StructDeclaration:
+            write_struct(llvm::cast<AST::StructDeclaration>(t));
+            break;
+        case AST::Toplevel::TemplateStructDeclaration: {
+            const auto &sd = llvm::cast<AST::TemplateStructDeclaration>(t);
+            write_number(sd.argnames().size());
+            for (auto arg: sd.argnames()) write_symbol(arg);
+            write_struct(sd.decl());
+            break;
+        }
+        case AST::Toplevel::FunctionDeclaration:
+            write_signature(llvm::cast<AST::FunctionDeclaration>(t));
+            break;
+        case AST::Toplevel::FunctionDefinition:
+            write_signature(llvm::cast<AST::FunctionDefinition>(t)
+                                .signature());
+            break;
+        case AST::Toplevel::TemplateFunctionDefinition: {
+            const auto &fd = llvm::cast<AST::TemplateFunctionDefinition>(t);
+            write_signature(fd.def()->signature());
+            write_number(fd.argnames().size());
+            for (auto arg: fd.argnames()) write_symbol(arg);
+            write_block(fd.def()->block());
+            break;
+        }
+        case AST::Toplevel::ConstDefinition:
+            write_statement(llvm::cast<AST::ConstDefinition>(t).decl());
+            break;
+        case AST::Toplevel::ConstFunctionDefinition: {
+            const auto &fd = llvm::cast<AST::ConstFunctionDefinition>(t);
+            write_signature(fd.def()->signature());
+            write_block(fd.def()->block());
+            break;
+        }
+        case AST::Toplevel::GlobalDefinition: {
+            const auto &gd = llvm::cast<AST::GlobalDefinition>(t);
+            write_statement(gd.decl());
+            write_number(gd.is_thread_local());
+            break;
+        }
+        case AST::Toplevel::TypeDeclaration:
+        case AST::Toplevel::Import:
+            assert(false);
+    }
+
+    entry.size = data.size() - entry.offset;
+    entries.push_back(entry);
+}
+
+std::string InterfaceWriter::finish(void) const {
+    auto sorted = entries;
+    std::sort(sorted.begin(), sorted.end(),
+              [this](const Entry &l, const Entry &r) {
+                  return std::strcmp(strings.data() + l.name,
+                                     strings.data() + r.name) < 0;
+              });
+
+    std::string result(MAGIC, sizeof(MAGIC));
+    put_u32(result, sorted.size());
+    put_u32(result, files.size());
+    put_u32(result, imports.size());
+    put_u32(result, data.size());
+    put_u32(result, strings.size());
+
+    for (auto file: files) put_u32(result, file);
+    for (auto import: imports) put_u32(result, import);
+    for (const auto &entry: sorted) {
+        put_u32(result, entry.name);
+        put_u32(result, entry.offset);
+        put_u32(result, entry.size);
+    }
+
+    result += data;
+    result += strings;
+    return result;
+}
+
+void InterfaceWriter::write_type(const AST::Type &t) {
+    write_number(t.kind());
+    write_pos(t.pos());
+
+    switch (t.kind()) {
+        case AST::Type::NamedType:
+            write_symbol(llvm::cast<AST::NamedType>(t).name());
+            break;
+        case AST::Type::Void:
+            break;
+        case AST::Type::TemplatedType: {
+            const auto &tt = llvm::cast<AST::TemplatedType>(t);
+            write_symbol(tt.name());
+            write_number(tt.args().size());
+            for (const auto &arg: tt.args()) write_type(*arg);
+            break;
+        }
+        case AST::Type::Pointer: {
+            const auto &p = llvm::cast<AST::Pointer>(t);
+            write_type(p.pointed());
+            write_number(p.restrict());
+            break;
+        }
+        case AST::Type::Vector: {
+            const auto &v = llvm::cast<AST::Vector>(t);
+            write_type(v.element());
+            write_number(v.lanes());
+            break;
+        }
+        case AST::Type::Array: {
+            const auto &a = llvm::cast<AST::Array>(t);
+            write_type(a.element());
+            write_type(a.length());
+            break;
+        }
+        case AST::Type::IntegerArg: {
+            const auto &i = llvm::cast<AST::IntegerArg>(t);
+            write_symbol(i.name());
+            write_number(i.value());
+            break;
+        }
+    }
+}
+
+void InterfaceWriter::write_expression(const AST::Expression &e) {
+    write_number(e.kind());
+    write_pos(e.pos());
+
+    switch (e.kind()) {
+        case AST::Expression::IntLiteral:
+            write_signed(llvm::cast<AST::IntLiteral>(e).value());
+            break;
+        case AST::Expression::UIntLiteral:
+            write_number(llvm::cast<AST::UIntLiteral>(e).value());
+            break;
+        case AST::Expression::FloatLiteral: {
+            double value = llvm::cast<AST::FloatLiteral>(e).value();
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            write_number(bits);
+            break;
+        }
+        case AST::Expression::StringLiteral:
+            write_string(llvm::cast<AST::StringLiteral>(e).value());
+            break;
+        case AST::Expression::Variable:
+            write_symbol(llvm::cast<AST::Variable>(e).name());
+            break;
+        case AST::Expression::Reference:
+            write_expression(llvm::cast<AST::Reference>(e).referand());
+            break;
+        case AST::Expression::Dereference:
+            write_expression(llvm::cast<AST::Dereference>(e).referand());
+            break;
+        case AST::Expression::FieldAccess: {
+            const auto &fa = llvm::cast<AST::FieldAccess>(e);
+            write_expression(fa.structure());
+            write_symbol(fa.field());
+            break;
+        }
+        case AST::Expression::Index: {
+            const auto &index = llvm::cast<AST::Index>(e);
+            write_expression(index.array());
+            write_expression(index.index());
+            break;
+        }
+        case AST::Expression::Binop: {
+            const auto &op = llvm::cast<AST::Binop>(e);
+            write_number(static_cast<uint64_t>(op.op()));
+            write_expression(op.lhs());
+            write_expression(op.rhs());
+            break;
+        }
+        case AST::Expression::FunctionCall: {
+            const auto &fc = llvm::cast<AST::FunctionCall>(e);
+            write_symbol(fc.fname());
+            write_number(fc.args().size());
+            for (const auto &arg: fc.args()) write_expression(*arg);
+            write_number(fc.awaited());
+            break;
+        }
+        case AST::Expression::TemplateFunctionCall: {
+            const auto &fc = llvm::cast<AST::TemplateFunctionCall>(e);
+            write_symbol(fc.fname());
+            write_number(fc.type_args().size());
+            for (const auto &arg: fc.type_args()) write_type(*arg);
+            write_number(fc.value_args().size());
+            for (const auto &arg: fc.value_args()) write_expression(*arg);
+            break;
+        }
+        case AST::Expression::Cast: {
+            const auto &cast = llvm::cast<AST::Cast>(e);
+            write_type(cast.type());
+            write_expression(cast.arg());
+            break;
+        }
+    }
+}
+
+void InterfaceWriter::write_statement(const AST::Statement &s) {
+    write_number(s.kind());
+    write_pos(s.pos());
+
+    switch (s.kind()) {
+        case AST::Statement::ExpressionStatement:
+            write_expression(llvm::cast<AST::ExpressionStatement>(s).expr());
+            break;
+        case AST::Statement::Return: {
+            const auto &ret = llvm::cast<AST::Return>(s);
+            write_expression(ret.retval());
+            write_number(ret.is_tail());
+            break;
+        }
+        case AST::Statement::VoidReturn:
+            break;
+        case AST::Statement::Assignment: {
+            const auto &a = llvm::cast<AST::Assignment>(s);
+            write_expression(a.lhs());
+            write_expression(a.rhs());
+            break;
+        }
+        case AST::Statement::Declaration: {
+            const auto &d = llvm::cast<AST::Declaration>(s);
+            write_type(d.type());
+            write_symbol(d.name().name());
+            write_pos(d.name().pos());
+            write_number(d.zeroed());
+            break;
+        }
+        case AST::Statement::CompoundDeclaration: {
+            const auto &d = llvm::cast<AST::CompoundDeclaration>(s);
+            write_type(d.type());
+            write_symbol(d.name().name());
+            write_pos(d.name().pos());
+            write_expression(d.rhs());
+            break;
+        }
+        case AST::Statement::IfStatement: {
+            const auto &is = llvm::cast<AST::IfStatement>(s);
+            write_expression(is.condition());
+            write_block(is.if_block());
+            write_block(is.else_block());
+            break;
+        }
+        case AST::Statement::WhileLoop: {
+            const auto &wl = llvm::cast<AST::WhileLoop>(s);
+            write_expression(wl.condition());
+            write_block(wl.body());
+            write_annotations(wl.annotations());
+            break;
+        }
+        case AST::Statement::ForLoop: {
+            const auto &fl = llvm::cast<AST::ForLoop>(s);
+            write_number(fl.init() != nullptr);
+            if (fl.init()) write_statement(*fl.init());
+            write_expression(fl.condition());
+            write_number(fl.step() != nullptr);
+            if (fl.step()) write_statement(*fl.step());
+            write_block(fl.body());
+            write_annotations(fl.annotations());
+            break;
+        }
+    }
+}
+
+void InterfaceWriter::write_block(
+        const std::vector<std::unique_ptr<AST::Statement> > &block) {
+    write_number(block.size());
+    for (const auto &stmt: block) write_statement(*stmt);
+}
+
+void InterfaceWriter::write_annotations(
+        const std::vector<AST::Annotation> &annotations) {
+    write_number(annotations.size());
+    for (const auto &annotation: annotations) {
+        write_symbol(annotation.name);
+        write_pos(annotation.pos);
+        write_number(annotation.args.size());
+        for (const auto &arg: annotation.args) {
+            write_symbol(arg.first);
+            write_signed(arg.second);
+        }
+    }
+}
+
+void InterfaceWriter::write_signature(const AST::FunctionDeclaration &fd) {
+    write_pos(fd.pos());
+    write_symbol(fd.name());
+    write_number(fd.args().size());
+    for (const auto &arg: fd.args()) write_statement(*arg);
+    write_type(fd.ret_type());
+    write_annotations(fd.annotations());
+    write_number(fd.is_async());
+}
+
+void InterfaceWriter::write_struct(const AST::StructDeclaration &sd) {
+    write_symbol(sd.name());
+    write_number(sd.members().size());
+    for (size_t i = 0; i < sd.members().size(); ++i) {
+        write_statement(*sd.members()[i]);
+        write_annotations(sd.member_annotations()[i]);
+    }
+    write_annotations(sd.annotations());
+}
+
+void InterfaceWriter::write_number(uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        data.push_back(byte);
+    } while (value);
+}
+
+void InterfaceWriter::write_signed(int64_t value) {
+    // Zigzag, so small negative numbers stay small.
+    write_number((static_cast<uint64_t>(value) << 1) ^ (value >> 63));
+}
+
+void InterfaceWriter::write_string(const std::string &value) {
+    write_number(value.size());
+    data += value;
+}
+
+void InterfaceWriter::write_symbol(Symbol symbol) {
+    write_number(intern(symbol.str()));
+}
+
+void InterfaceWriter::write_pos(SourcePos pos) {
+    if (!pos.file) {
+        write_number(0);
+        return;
+    }
+
+    auto found = file_indices.find(pos.file);
+    if (found == file_indices.end()) {
+        // Relative paths would depend on where the importer is compiled.
+        llvm::SmallString<128> fname(sources.file_name(pos));
+        llvm::sys::fs::make_absolute(fname);
+
+        files.push_back(intern(fname.str().str()));
+        found = file_indices.emplace(pos.file, files.size()).first;
+    }
+
+    write_number(found->second);
+    write_number(pos.offset);
+}
+
+uint32_t InterfaceWriter::intern(const std::string &value) {
+    auto found = string_offsets.find(value);
+    if (found != string_offsets.end()) return found->second;
+
+    uint32_t result = strings.size();
+    strings += value;
+    strings.push_back('\0');
+    string_offsets.emplace(value, result);
+    return result;
+}
+
+/*****************************************************************************
+ * Reading interfaces.
+ */
+
+/**
+ * @brief Reads the tree of one entry, allocating it in the current arena.
+ *
+ * Checks everything it reads, so a damaged file can't crash the compiler.
+ */
+class Interface::Reader {
+public:
+    Reader(Interface &interface, const char *start, const char *end)
+        : interface(interface), cur(start), end(end) {}
+
+    std::unique_ptr<AST::Toplevel> toplevel(void) {
+        auto kind = number();
+        auto pos = this->pos();
+
+        switch (kind) {
+            case AST::Toplevel::StructDeclaration: {
+                auto parts = struct_parts();
+                return std::make_unique<AST::StructDeclaration>(
+                        parts.name, std::move(parts.members),
+                        std::move(parts.member_annotations),
+                        std::move(parts.annotations), pos);
+            }
+            case AST::Toplevel::TemplateStructDeclaration: {
+                auto argnames = parameter_names();
+                auto parts = struct_parts();
+                return std::make_unique<AST::TemplateStructDeclaration>(
+                        parts.name, argnames, std::move(parts.members),
+                        std::move(parts.member_annotations),
+                        std::move(parts.annotations), pos);
+            }
+            case AST::Toplevel::FunctionDeclaration:
+                return signature();
+            case AST::Toplevel::TemplateFunctionDefinition: {
+                auto sig = signature();
+                auto argnames = parameter_names();
+                auto body = block();
+                return std::make_unique<AST::TemplateFunctionDefinition>(
+                        std::move(sig), argnames, std::move(body), pos);
+            }
+            case AST::Toplevel::ConstDefinition:
+                return std::make_unique<AST::ConstDefinition>(
+                        expect<AST::CompoundDeclaration>(statement()), pos);
+            case AST::Toplevel::ConstFunctionDefinition: {
+                auto sig = signature();
+                auto body = block();
+                return std::make_unique<AST::ConstFunctionDefinition>(
+                        std::move(sig), std::move(body), pos);
+            }
+            case AST::Toplevel::GlobalDefinition: {
+                auto decl = statement();
+                if (!llvm::isa<AST::Declaration>(*decl)
+                 && !llvm::isa<AST::CompoundDeclaration>(*decl)) {
+                    interface.corrupt();
+                }
+                bool is_thread_local = number();
+                return std::make_unique<AST::GlobalDefinition>(
+                        std::move(decl), is_thread_local, pos);
+            }
+        }
+
+        interface.corrupt();
+    }
+
+private:
+    /**
+     * @brief The parts of a struct declaration, which either kind of
+     *        struct node is made from.
+     */
+    struct StructParts {
+        Symbol name;
+        std::vector<std::unique_ptr<AST::Declaration> > members;
+        std::vector<std::vector<AST::Annotation> > member_annotations;
+        std::vector<AST::Annotation> annotations;
+    };
+
+    StructParts struct_parts(void) {
+        StructParts result;
+        result.name = type_name();
+
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) {
+            result.members.push_back(expect<AST::Declaration>(statement()));
+            result.member_annotations.push_back(annotations());
+        }
+        result.annotations = annotations();
+
+        return result;
+    }
+
+    std::unique_ptr<AST::FunctionDeclaration> signature(void) {
+        auto pos = this->pos();
+        auto name = identifier();
+
+        std::vector<std::unique_ptr<AST::Declaration> > args;
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) {
+            args.push_back(expect<AST::Declaration>(statement()));
+        }
+
+        auto ret_type = type();
+        auto annotations = this->annotations();
+        bool is_async = number();
+
+        return std::make_unique<AST::FunctionDeclaration>(
+                name, std::move(args), std::move(ret_type),
+                std::move(annotations), pos, is_async);
+    }
+
+    std::unique_ptr<AST::Type> type(void) {
+        auto kind = number();
+        auto pos = this->pos();
+
+        switch (kind) {
+            case AST::Type::NamedType:
+                return std::make_unique<AST::NamedType>(type_name(), pos);
+            case AST::Type::Void:
+                return std::make_unique<AST::Void>(pos);
+            case AST::Type::TemplatedType: {
+                auto name = type_name();
+                std::vector<std::unique_ptr<AST::Type> > args;
+                auto n = count();
+                for (size_t i = 0; i < n; ++i) args.push_back(type());
+                return std::make_unique<AST::TemplatedType>(
+                        name, std::move(args), pos);
+            }
+            case AST::Type::Pointer: {
+                auto pointed = type();
+                bool restrict = number();
+                return std::make_unique<AST::Pointer>(std::move(pointed),
+                                                      restrict, pos);
+            }
+            case AST::Type::Vector: {
+                auto element = type();
+                auto lanes = number();
+                return std::make_unique<AST::Vector>(std::move(element),
+                                                     lanes, pos);
+            }
+            case AST::Type::Array: {
+                auto element = type();
+                auto length = expect<AST::IntegerArg>(type());
+                return std::make_unique<AST::Array>(std::move(element),
+                                                    std::move(length), pos);
+            }
+            case AST::Type::IntegerArg: {
+                auto name = symbol();
+                auto value = number();
+                if (name != Symbol() && !is_identifier(name)) {
+                    interface.corrupt();
+                }
+                if (name == Symbol()) {
+                    return std::make_unique<AST::IntegerArg>(value, pos);
+                }
+                return std::make_unique<AST::IntegerArg>(name, pos);
+            }
+        }
+
+        interface.corrupt();
+    }
+
+    std::unique_ptr<AST::Expression> expression(void) {
+        auto kind = number();
+        auto pos = this->pos();
+
+        switch (kind) {
+            case AST::Expression::IntLiteral:
+                return std::make_unique<AST::IntLiteral>(signed_number(),
+                                                         pos);
+            case AST::Expression::UIntLiteral:
+                return std::make_unique<AST::UIntLiteral>(number(), pos);
+            case AST::Expression::FloatLiteral: {
+                uint64_t bits = number();
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return std::make_unique<AST::FloatLiteral>(value, pos);
+            }
+            case AST::Expression::StringLiteral:
+                return std::make_unique<AST::StringLiteral>(string(), pos);
+            case AST::Expression::Variable:
+                return std::make_unique<AST::Variable>(identifier(), pos);
+            case AST::Expression::Reference:
+                return std::make_unique<AST::Reference>(
+                        expect<AST::LValue>(expression()), pos);
+            case AST::Expression::Dereference:
+                return std::make_unique<AST::Dereference>(expression(), pos);
+            case AST::Expression::FieldAccess: {
+                auto structure = expression();
+                auto field = identifier();
+                return std::make_unique<AST::FieldAccess>(
+                        std::move(structure), field, pos);
+            }
+            case AST::Expression::Index: {
+                auto array = expression();
+                auto index = expression();
+                return std::make_unique<AST::Index>(
+                        std::move(array), std::move(index), pos);
+            }
+            case AST::Expression::Binop: {
+                auto op = number();
+                if (op > static_cast<uint64_t>(Tok::Op::CloseGeneric)) {
+                    interface.corrupt();
+                }
+                auto lhs = expression();
+                auto rhs = expression();
+                return std::make_unique<AST::Binop>(
+                        static_cast<Tok::Op>(op), std::move(lhs),
+                        std::move(rhs), pos);
+            }
+            case AST::Expression::FunctionCall: {
+                auto fname = identifier();
+                auto args = expressions();
+                bool awaited = number();
+                return std::make_unique<AST::FunctionCall>(
+                        fname, std::move(args), pos, awaited);
+            }
+            case AST::Expression::TemplateFunctionCall: {
+                auto fname = identifier();
+                std::vector<std::unique_ptr<AST::Type> > type_args;
+                auto n = count();
+                for (size_t i = 0; i < n; ++i) type_args.push_back(type());
+                auto value_args = expressions();
+                return std::make_unique<AST::TemplateFunctionCall>(
+                        fname, std::move(type_args), std::move(value_args),
+                        pos);
+            }
+            case AST::Expression::Cast: {
+                auto type = this->type();
+                auto arg = expression();
+                return std::make_unique<AST::Cast>(std::move(type),
+                                                   std::move(arg), pos);
+            }
+        }
+
+        interface.corrupt();
+    }
+
+    std::vector<std::unique_ptr<AST::Expression> > expressions(void) {
+        std::vector<std::unique_ptr<AST::Expression> > result;
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) result.push_back(expression());
+        return result;
+    }
+
+    std::unique_ptr<AST::Statement> statement(void) {
+        auto kind = number();
+        auto pos = this->pos();
+
+        switch (kind) {
+            case AST::Statement::ExpressionStatement:
+                return std::make_unique<AST::ExpressionStatement>(
+                        expression());
+            case AST::Statement::Return: {
+                auto retval = expression();
+                bool is_tail = number();
+                return std::make_unique<AST::Return>(std::move(retval), pos,
+                                                     is_tail);
+            }
+            case AST::Statement::VoidReturn:
+                return std::make_unique<AST::VoidReturn>(pos);
+            case AST::Statement::Assignment: {
+                auto lhs = expect<AST::LValue>(expression());
+                auto rhs = expression();
+                return std::make_unique<AST::Assignment>(
+                        std::move(lhs), std::move(rhs), pos);
+            }
+            case AST::Statement::Declaration: {
+                auto type = this->type();
+                auto name = identifier();
+                auto name_pos = this->pos();
+                bool zeroed = number();
+                return std::make_unique<AST::Declaration>(
+                        std::move(type), AST::Variable(name, name_pos), pos,
+                        zeroed);
+            }
+            case AST::Statement::CompoundDeclaration: {
+                auto type = this->type();
+                auto name = identifier();
+                auto name_pos = this->pos();
+                auto rhs = expression();
+                return std::make_unique<AST::CompoundDeclaration>(
+                        std::move(type), AST::Variable(name, name_pos),
+                        std::move(rhs), pos);
+            }
+            case AST::Statement::IfStatement: {
+                auto condition = expression();
+                auto if_block = block();
+                auto else_block = block();
+                return std::make_unique<AST::IfStatement>(
+                        std::move(condition), std::move(if_block),
+                        std::move(else_block), pos);
+            }
+            case AST::Statement::WhileLoop: {
+                auto condition = expression();
+                auto body = block();
+                auto annotations = this->annotations();
+                return std::make_unique<AST::WhileLoop>(
+                        std::move(condition), std::move(body),
+                        std::move(annotations), pos);
+            }
+            case AST::Statement::ForLoop: {
+                std::unique_ptr<AST::Statement> init, step;
+                if (number()) init = statement();
+                auto condition = expression();
+                if (number()) step = statement();
+                auto body = block();
+                auto annotations = this->annotations();
+                return std::make_unique<AST::ForLoop>(
+                        std::move(init), std::move(condition),
+                        std::move(step), std::move(body),
+                        std::move(annotations), pos);
+            }
+        }
+
+        interface.corrupt();
+    }
+
+    std::vector<std::unique_ptr<AST::Statement> > block(void) {
+        std::vector<std::unique_ptr<AST::Statement> > result;
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) result.push_back(statement());
+        return result;
+    }
+
+    std::vector<AST::Annotation> annotations(void) {
+        std::vector<AST::Annotation> result;
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) {
+            auto name = identifier();
+            result.emplace_back(name, pos());
+
+            auto nargs = count();
+            for (size_t j = 0; j < nargs; ++j) {
+                auto arg_name = symbol();
+                result.back().args.push_back(
+                        std::make_pair(arg_name, signed_number()));
+            }
+        }
+        return result;
+    }
+
+    std::vector<Symbol> parameter_names(void) {
+        std::vector<Symbol> result;
+        auto n = count();
+        for (size_t i = 0; i < n; ++i) {
+            auto name = symbol();
+            if (!is_identifier(name) && !is_type_name(name)) {
+                interface.corrupt();
+            }
+            result.push_back(name);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Check that a node is of the kind expected where it was read.
+     */
+    template<typename T, typename Base>
+    std::unique_ptr<T> expect(std::unique_ptr<Base> node) {
+        if (!llvm::isa<T>(*node)) interface.corrupt();
+        return std::unique_ptr<T>(llvm::cast<T>(node.release()));
+    }
+
+    uint64_t number(void) {
+        uint64_t result = 0;
+
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (cur == end) interface.corrupt();
+
+            uint8_t byte = *cur++;
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return result;
+        }
+
+        interface.corrupt();
+    }
+
+    int64_t signed_number(void) {
+        auto value = number();
+        return static_cast<int64_t>(value >> 1)
+             ^ -static_cast<int64_t>(value & 1);
+    }
+
+    /**
+     * @brief Read a count of things which follow, each at least a byte.
+     */
+    size_t count(void) {
+        auto result = number();
+        if (result > static_cast<size_t>(end - cur)) interface.corrupt();
+        return result;
+    }
+
+    std::string string(void) {
+        auto size = count();
+        std::string result(cur, size);
+        cur += size;
+        return result;
+    }
+
+    Symbol symbol(void) {
+        auto offset = number();
+        if (offset > UINT32_MAX) interface.corrupt();
+        return Symbol(interface.string_at(offset));
+    }
+
+    /**
+     * @brief Whether a name could have been lexed as a type name, or as an
+     *        identifier.  The environment relies on the difference.
+     */
+    static bool is_type_name(Symbol name) {
+        return isupper(static_cast<unsigned char>(name.str()[0]));
+    }
+
+    static bool is_identifier(Symbol name) {
+        auto c = static_cast<unsigned char>(name.str()[0]);
+        return islower(c) || c >= 128;
+    }
+
+    Symbol type_name(void) {
+        auto result = symbol();
+        if (!is_type_name(result)) interface.corrupt();
+        return result;
+    }
+
+    Symbol identifier(void) {
+        auto result = symbol();
+        if (!is_identifier(result)) interface.corrupt();
+        return result;
+    }
+
+    SourcePos pos(void) {
+        auto file = number();
+        if (!file) return SourcePos();
+        if (file > interface.nfiles) interface.corrupt();
+
+        auto offset = number();
+        if (offset > UINT32_MAX) interface.corrupt();
+
+        // Source files are only added once something in them is read.
+        auto &id = interface.file_ids[file - 1];
+        if (!id) {
+            auto fname = interface.string_at(
+                    interface.read_u32(HEADER_SIZE + 4 * (file - 1))).str();
+            auto buffer = llvm::MemoryBuffer::getFile(fname);
+            id = buffer ? interface.sources.add_buffer(fname,
+                                                       std::move(*buffer))
+                        : interface.sources.start_of(fname).file;
+        }
+
+        return SourcePos(id, offset);
+    }
+
+    Interface &interface;
+    const char *cur;
+    const char *end;
+};
+
+Interface::Interface(const std::string &path, SourcePos pos,
+                     SourceManager &sources)
+    : path(path), pos(pos), sources(sources), arena(std::make_shared<AST::Arena>()) {
+    auto file = llvm::MemoryBuffer::getFile(path, false, false);
+    if (!file) {
+        throw Error("error", "cannot read \"" + path + "\": "
+                           + file.getError().message(), pos);
+    }
+    buffer = std::move(*file);
+
+    auto size = buffer->getBufferSize();
+    if (size < HEADER_SIZE
+     || std::memcmp(buffer->getBufferStart(), MAGIC, sizeof(MAGIC))) {
+        corrupt();
+    }
+
+    nentries = read_u32(sizeof(MAGIC));
+    nfiles = read_u32(sizeof(MAGIC) + 4);
+    nimports = read_u32(sizeof(MAGIC) + 8);
+    uint64_t data_size = read_u32(sizeof(MAGIC) + 12);
+    uint64_t strings_size = read_u32(sizeof(MAGIC) + 16);
+
+    entries_start = HEADER_SIZE + 4 * (uint64_t(nfiles) + nimports);
+    data_start = entries_start + ENTRY_SIZE * uint64_t(nentries);
+    strings_start = data_start + data_size;
+    strings_end = strings_start + strings_size;
+
+    if (strings_end != size || !strings_size
+     || buffer->getBufferStart()[size - 1]) {
+        corrupt();
+    }
+
+    for (uint32_t i = 0; i < nentries; ++i) {
+        auto offset = read_u32(entries_start + ENTRY_SIZE * i + 4);
+        auto entry_size = read_u32(entries_start + ENTRY_SIZE * i + 8);
+        if (uint64_t(offset) + entry_size > data_size) corrupt();
+    }
+
+    loaded.resize(nentries, false);
+    file_ids.resize(nfiles, 0);
+}
+
+std::vector<std::string> Interface::imports(void) const {
+    std::vector<std::string> result;
+    for (uint32_t i = 0; i < nimports; ++i) {
+        result.push_back(
+                string_at(read_u32(HEADER_SIZE + 4 * (nfiles + i))).str());
+    }
+    return result;
+}
+
+const AST::Toplevel *Interface::load(Symbol name) {
+    // Binary search, straight out of the mapped file.
+    uint32_t lo = 0, hi = nentries;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = string_at(read_u32(entries_start + ENTRY_SIZE * mid))
+                      .compare(name.str());
+        if (!cmp) {
+            lo = mid;
+            break;
+        }
+        if (cmp < 0) lo = mid + 1; else hi = mid;
+    }
+
+    if (lo >= hi || loaded[lo]) return nullptr;
+    loaded[lo] = true;
+
+    auto offset = read_u32(entries_start + ENTRY_SIZE * lo + 4);
+    auto size = read_u32(entries_start + ENTRY_SIZE * lo + 8);
+    const char *start = buffer->getBufferStart() + data_start + offset;
+
+    AST::ArenaScope scope(*arena);
+    Reader reader(*this, start, start + size);
+    nodes.push_back(AST::ArenaPtr<AST::Toplevel>(reader.toplevel().release(),
+                                                 AST::ArenaDeleter { arena }));
+    return nodes.back().get();
+}
+
+Fingerprint Interface::fingerprint(void) const {
+    llvm::MD5 digest;
+    digest.update(buffer->getBuffer());
+
+    for (const auto &import: imports()) {
+        auto imported = Interface(import, pos, sources).fingerprint();
+        digest.update(llvm::ArrayRef<uint8_t>(imported.Bytes));
+    }
+
+    Fingerprint result;
+    digest.final(result);
+    return result;
+}
+
+uint32_t Interface::read_u32(size_t offset) const {
+    if (offset + 4 > buffer->getBufferSize()) corrupt();
+    return llvm::support::endian::read32le(buffer->getBufferStart() + offset);
+}
+
+llvm::StringRef Interface::string_at(uint32_t offset) const {
+    if (strings_start + offset >= strings_end) corrupt();
+
+    // The table ends with a null, so this stays in the file.
+    return llvm::StringRef(buffer->getBufferStart() + strings_start + offset);
+}
+
+void Interface::corrupt(void) const {
+    throw Error("error", "\"" + path + "\" is not a valid interface file",
+                pos);
+}
+
+}
@@ -0,0 +1,220 @@
+/**
+ * @file JIT.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/Host.h"
+
+#include "JIT.hh"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/* The C runtime's CPU detection, which `@target_clones` dispatchers call.
+ * It is linked in statically, so is not found searching the process. */
+extern "C" {
+extern unsigned int __cpu_model[4];
+extern unsigned int __cpu_features2;
+int __cpu_indicator_init(void);
+}
+#endif
+
+namespace Craeft {
+
+namespace {
+
+/**
+ * @brief How an entry point is called.
+ */
+struct EntrySignature {
+    /** @brief Whether it takes `argc` and `argv`. */
+    bool takes_args;
+    /** @brief The width of the integer it returns, or 0 for none. */
+    unsigned return_bits;
+};
+
+/**
+ * @brief Work out how to call the given entry point.
+ *
+ * @return Whether it can be called at all.
+ */
+bool entry_signature(const llvm::Function &f, EntrySignature &out) {
+    auto *ty = f.getFunctionType();
+    auto *ret = ty->getReturnType();
+
+    if (ty->isVarArg()) return false;
+
+    if (ret->isVoidTy()) {
+        out.return_bits = 0;
+    } else if (ret->isIntegerTy() && ret->getIntegerBitWidth() <= 64) {
+        out.return_bits = ret->getIntegerBitWidth();
+    } else {
+        return false;
+    }
+
+    if (ty->getNumParams() == 0) {
+        out.takes_args = false;
+        return true;
+    }
+
+    // `I32 argc, U8 **argv`.
+    auto &ctx = f.getContext();
+    auto *argv_ty = llvm::Type::getInt8PtrTy(ctx)->getPointerTo();
+    out.takes_args = true;
+    return ty->getNumParams() == 2
+        && ty->getParamType(0)->isIntegerTy(32)
+        && ty->getParamType(1) == argv_ty;
+}
+
+/**
+ * @brief Call an entry point at the given address.
+ */
+int call_entry(llvm::JITTargetAddress address, EntrySignature sig,
+               int argc, char **argv) {
+    int64_t result;
+
+    // Integers narrower than a register are returned in its low bits, with
+    // the rest undefined; so call it as returning a full register, and
+    // sign-extend what it actually returned.
+    if (sig.takes_args) {
+        auto *f = (int64_t (*)(int, char **))address;
+        result = f(argc, argv);
+    } else {
+        auto *f = (int64_t (*)(void))address;
+        result = f();
+    }
+
+    if (sig.return_bits == 0) return 0;
+    if (sig.return_bits < 64) {
+        result = llvm::SignExtend64(result, sig.return_bits);
+    }
+
+    return (int)result;
+}
+
+}
+
+int run_jit(std::unique_ptr<llvm::Module> module,
+            std::unique_ptr<llvm::LLVMContext> context,
+            const TargetSpec &target, const std::string &entry,
+            const std::vector<std::string> &args, SourcePos pos) {
+    llvm::Triple triple(target.triple);
+    llvm::Triple host(llvm::sys::getProcessTriple());
+
+    if (triple.getArch() != host.getArch() || triple.getOS() != host.getOS()) {
+        throw Error("error", "cannot run code generated for " + target.triple
+                             + " on this machine", pos);
+    }
+
+    auto *f = module->getFunction(entry);
+    if (!f || f->isDeclaration()) {
+        throw Error("name error", "no function named \"" + entry
+                                + "\" to run", pos);
+    }
+
+    if (f->hasLocalLinkage()) {
+        throw Error("name error", "cannot run \"" + entry
+                                + "\", which is private", pos);
+    }
+
+    EntrySignature sig;
+    if (!entry_signature(*f, sig)) {
+        throw Error("type error", "\"" + entry + "\" must take no arguments "
+                                  "or (I32, U8 **), and return an integer or "
+                                  "nothing", pos);
+    }
+
+    auto fail = [&](llvm::Error error) {
+        throw Error("internal error", llvm::toString(std::move(error)), pos);
+    };
+
+    llvm::orc::JITTargetMachineBuilder machine(triple);
+    machine.setCPU(target.cpu);
+
+    std::vector<std::string> features;
+    for (auto feature: llvm::split(target.features, ',')) {
+        if (!feature.empty()) features.push_back(feature.str());
+    }
+    machine.addFeatures(features);
+
+    // LLLazyJIT only compiles each function when it is first called.
+    auto jit = llvm::orc::LLLazyJITBuilder()
+        .setJITTargetMachineBuilder(std::move(machine))
+        .create();
+    if (!jit) fail(jit.takeError());
+
+    auto &dylib = (*jit)->getMainJITDylib();
+
+    // Resolve anything the module doesn't define (e.g. the C library) in
+    // this process.
+    auto process = llvm::orc::DynamicLibrarySearchGenerator
+        ::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+    if (!process) fail(process.takeError());
+    dylib.addGenerator(std::move(*process));
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    llvm::orc::SymbolMap runtime;
+    auto add_runtime = [&](const char *name, const void *address) {
+        runtime[(*jit)->mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(
+                llvm::pointerToJITTargetAddress(address),
+                llvm::JITSymbolFlags::Exported);
+    };
+    add_runtime("__cpu_model", __cpu_model);
+    add_runtime("__cpu_features2", &__cpu_features2);
+    add_runtime("__cpu_indicator_init",
+                reinterpret_cast<const void *>(&__cpu_indicator_init));
+    if (auto error = dylib.define(
+                llvm::orc::absoluteSymbols(std::move(runtime)))) {
+        fail(std::move(error));
+    }
+#endif
+
+    module->setDataLayout((*jit)->getDataLayout());
+
+    llvm::orc::ThreadSafeModule tsm(std::move(module), std::move(context));
+    if (auto error = (*jit)->addLazyIRModule(std::move(tsm))) {
+        fail(std::move(error));
+    }
+
+    auto symbol = (*jit)->lookup(entry);
+    if (!symbol) fail(symbol.takeError());
+
+    if (auto error = (*jit)->initialize(dylib)) fail(std::move(error));
+
+    std::vector<std::string> arg_storage(args);
+    std::vector<char *> argv;
+    for (auto &arg: arg_storage) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    int result = call_entry(symbol->getAddress(), sig,
+                            (int)arg_storage.size(), argv.data());
+
+    if (auto error = (*jit)->deinitialize(dylib)) fail(std::move(error));
+
+    return result;
+}
+
+}
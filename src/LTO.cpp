@@ -0,0 +1,154 @@
+/**
+ * @file LTO.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "LTO.hh"
+#include "TimeReport.hh"
+
+namespace Craeft {
+
+bool thin_link(const std::vector<std::string> &in_files,
+               const std::vector<std::string> &objects,
+               const TargetSpec &target, int opt_level, int jobs,
+               std::ostream &diagnostics) {
+    TimeReport::Scope timer("thin link");
+    initialize_targets();
+
+    llvm::lto::Config config;
+    config.CPU = target.cpu;
+    llvm::SmallVector<llvm::StringRef, 8> features;
+    llvm::StringRef(target.features).split(features, ',', -1, false);
+    for (auto feature: features) config.MAttrs.push_back(feature.str());
+    config.DefaultTriple = target.triple;
+    // As for modules compiled directly; see `TranslatorImpl`.
+    config.RelocModel = llvm::Reloc::Model();
+    config.OptLevel = opt_level;
+    config.CGOptLevel = opt_level == 0 ? llvm::CodeGenOpt::None
+                      : opt_level >= 3 ? llvm::CodeGenOpt::Aggressive
+                                       : llvm::CodeGenOpt::Default;
+
+    llvm::lto::LTO lto(std::move(config),
+                       llvm::lto::createInProcessThinBackend(
+                           llvm::heavyweight_hardware_concurrency(jobs)));
+
+    // The inputs must outlive the link.
+    std::vector<std::unique_ptr<llvm::MemoryBuffer> > buffers;
+    std::set<std::string> defined;
+
+    for (const auto &in_file: in_files) {
+        auto buffer = llvm::MemoryBuffer::getFile(in_file);
+        if (!buffer) {
+            diagnostics << "craeftc: cannot read " << in_file << ": "
+                        << buffer.getError().message() << std::endl;
+            return false;
+        }
+        buffers.push_back(std::move(*buffer));
+        auto ref = buffers.back()->getMemBufferRef();
+
+        // Modules without summaries would all be merged into one extra
+        // object, which would have to be named.
+        auto info = llvm::getBitcodeLTOInfo(ref);
+        if (!info || !info->IsThinLTO) {
+            if (!info) llvm::consumeError(info.takeError());
+            diagnostics << "craeftc: " << in_file << " is not bitcode with a "
+                        << "ThinLTO summary (from --bc)" << std::endl;
+            return false;
+        }
+
+        auto input = llvm::lto::InputFile::create(ref);
+        if (!input) {
+            diagnostics << "craeftc: " << in_file << ": "
+                        << llvm::toString(input.takeError()) << std::endl;
+            return false;
+        }
+
+        // The objects may be linked with anything, so everything stays
+        // visible; the first definition of a symbol is the one kept.
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (const auto &symbol: (*input)->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            resolution.Prevailing = !symbol.isUndefined()
+                && defined.insert(symbol.getName().str()).second;
+            resolution.VisibleToRegularObj = true;
+            resolutions.push_back(resolution);
+        }
+
+        auto error = lto.add(std::move(*input), resolutions);
+        if (error) {
+            diagnostics << "craeftc: " << in_file << ": "
+                        << llvm::toString(std::move(error)) << std::endl;
+            return false;
+        }
+    }
+
+    std::mutex lock;
+    bool successful = true;
+
+    // Task 0 is the (empty) module of inputs without summaries; the rest
+    // are the inputs, in order.
+    auto add_stream = [&](unsigned task)
+            -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream> > {
+        if (task == 0 || task > objects.size()) {
+            return std::make_unique<llvm::CachedFileStream>(
+                    std::make_unique<llvm::raw_null_ostream>());
+        }
+
+        const auto &path = objects[task - 1];
+        std::error_code ec;
+        auto out = std::make_unique<llvm::raw_fd_ostream>(
+                path, ec, llvm::sys::fs::OF_None);
+        if (ec) {
+            std::lock_guard<std::mutex> guard(lock);
+            diagnostics << "craeftc: cannot open " << path << ": "
+                        << ec.message() << std::endl;
+            successful = false;
+            return std::make_unique<llvm::CachedFileStream>(
+                    std::make_unique<llvm::raw_null_ostream>());
+        }
+
+        return std::make_unique<llvm::CachedFileStream>(std::move(out), path);
+    };
+
+    auto error = lto.run(add_stream);
+    if (error) {
+        diagnostics << "craeftc: " << llvm::toString(std::move(error))
+                    << std::endl;
+        return false;
+    }
+
+    return successful;
+}
+
+}
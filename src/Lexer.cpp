@@ -20,11 +20,17 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cassert>
 #include <cmath>
 #include <cctype>
-#include <sstream>
+#include <cstring>
+
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
 
 #include "Lexer.hh"
+#include "SourceManager.hh"
+#include "TimeReport.hh"
 
 namespace {
 
@@ -35,6 +41,49 @@ inline bool is_unicode(char c) {
     return (uint8_t)c >= 128;
 }
 
+/**
+ * @brief Size of the blocks read in stream mode.
+ */
+const size_t BLOCK_SIZE = 1 << 16;
+
+enum CharClass: uint8_t {
+    SPACE = 1,
+    DIGIT = 2,
+    /* Characters that may continue an identifier or type name. */
+    WORD  = 4
+};
+
+/**
+ * @brief Character classes for every byte value, so the scanning loops don't
+ *        have to go through the locale-aware <cctype> functions.
+ */
+struct CharTable {
+    uint8_t classes[256];
+
+    CharTable(void) {
+        for (int i = 0; i < 256; ++i) {
+            classes[i] = 0;
+            if (i < 128 && std::isspace(i)) classes[i] |= SPACE;
+            if (i < 128 && std::isdigit(i)) classes[i] |= DIGIT;
+            if ((i < 128 && (std::isalnum(i) || i == '_'))
+             || is_unicode((char)i)) {
+                classes[i] |= WORD;
+            }
+        }
+    }
+};
+
+const CharTable char_table;
+
+/* These take an int so they also accept -1 (end of input). */
+inline bool has_class(int c, CharClass cls) {
+    return c >= 0 && (char_table.classes[c] & cls);
+}
+
+inline bool has_class(char c, CharClass cls) {
+    return char_table.classes[(uint8_t)c] & cls;
+}
+
 }
 
 /**
@@ -44,17 +93,98 @@ inline bool is_unicode(char c) {
  */
 namespace Craeft {
 
-Lexer::Lexer(const std::string &fname)
+Lexer::Lexer(const std::string &fname, SourceManager &sources)
     : c(' '),
-      eof(false),
-      tok(std::make_unique<Tok::OpenParen>()),
-      pos(0, 0, std::make_shared<std::string>(fname)),
-      stream(fname) {
+      has_next(false),
+      sources(sources),
+      cur(nullptr),
+      end(nullptr),
+      window(nullptr),
+      window_offset(0),
+      stream(nullptr) {
+    if (fname == "-") {
+        stream = &std::cin;
+    } else if (llvm::sys::fs::is_regular_file(fname)) {
+        /* MemoryBuffer mmaps the file if it's big enough to be worth it, and
+         * just reads it otherwise. */
+        auto buf = llvm::MemoryBuffer::getFile(fname);
+        if (buf) {
+            buffer = std::move(*buf);
+            cur = window = buffer->getBufferStart();
+            end = buffer->getBufferEnd();
+            file = sources.add_buffer(fname, buffer);
+        }
+    }
+
+    /* Fall back to streaming for anything we couldn't map. */
+    if (!buffer && !stream) {
+        owned_stream = std::make_unique<std::ifstream>(fname);
+        stream = owned_stream.get();
+    }
+
+    if (stream) {
+        block.resize(BLOCK_SIZE);
+        file = sources.add_stream(fname);
+    }
+
+    shift();
+}
+
+Lexer::Lexer(std::istream &in, const std::string &fname,
+             SourceManager &sources)
+    : c(' '),
+      has_next(false),
+      sources(sources),
+      file(sources.add_stream(fname)),
+      cur(nullptr),
+      end(nullptr),
+      window(nullptr),
+      window_offset(0),
+      stream(&in),
+      block(BLOCK_SIZE) {
     shift();
 }
 
+Lexer::~Lexer(void) {
+    TimeReport::add("tokens", ntokens);
+}
+
 SourcePos Lexer::get_pos(void) const {
-    return pos;
+    return SourcePos(file, current.offset);
+}
+
+uint32_t Lexer::char_offset(void) const {
+    size_t consumed = window_offset + (cur - window);
+    /* At the end of the input, nothing was taken for the current
+     * character. */
+    return c == -1 ? consumed : consumed - 1;
+}
+
+SourcePos Lexer::char_pos(void) const {
+    return SourcePos(file, char_offset());
+}
+
+bool Lexer::refill(void) {
+    if (!stream) return false;
+
+    window_offset += end - window;
+
+    stream->read(block.data(), block.size());
+    cur = window = block.data();
+    end = cur + stream->gcount();
+
+    sources.append(file, llvm::StringRef(cur, end - cur));
+
+    return cur != end;
+}
+
+void Lexer::get(void) {
+    if (cur == end && !refill()) {
+        c = -1;
+        return;
+    }
+
+    c = (uint8_t)*cur++;
 }
 
 static inline uint8_t digit(char n) {
@@ -62,53 +192,98 @@ static inline uint8_t digit(char n) {
     return n - 48;
 }
 
-static inline bool is_opchar(char c) {
-    return std::string("!:.*=+-><&%^@~/").find(c) != std::string::npos;
+static inline bool is_opchar(int c) {
+    return c > 0 && std::strchr("!:.*=+-><&|%^@~/", c) != nullptr;
 }
 
-boost::variant<double, uint64_t> Lexer::lex_number(void) {
+uint64_t Lexer::lex_digits(void) {
     uint64_t num = 0;
 
-    /* Parse the initial series of digits. */
-    while (isdigit(c)) {
+    while (has_class(c, DIGIT)) {
         num *= 10;
         num += digit(c);
+
+        /* Take the rest of the run straight out of the window. */
+        const char *p = cur;
+        while (p != end && has_class(*p, DIGIT)) {
+            num *= 10;
+            num += digit(*p);
+            ++p;
+        }
+
+        cur = p;
+        get();
+    }
+
+    return num;
+}
+
+llvm::StringRef Lexer::lex_word(void) {
+    /* The current character is always the last one taken from the window. */
+    const char *start = cur - 1;
+    const char *p = cur;
+
+    while (p != end && has_class(*p, WORD)) ++p;
+
+    cur = p;
+
+    /* The common case: the whole word is in the window, so it can be
+     * returned in place.  (`get` won't refill the window, since we stopped
+     * short of its end.) */
+    if (p != end || !stream) {
+        llvm::StringRef result(start, p - start);
+        get();
+        return result;
+    }
+
+    /* The word runs off the end of this block; copy it out before the block
+     * is overwritten. */
+    scratch.assign(start, p);
+    for (get(); has_class(c, WORD); get()) {
+        scratch.push_back(c);
+    }
+
+    return scratch;
+}
+
+void Lexer::skip_whitespace(void) {
+    while (has_class(c, SPACE)) {
+        const char *p = cur;
+
+        while (p != end && has_class(*p, SPACE)) ++p;
+
+        cur = p;
         get();
     }
+}
+
+void Lexer::lex_number(Tok::Token &out) {
+    /* Parse the initial series of digits. */
+    uint64_t num = lex_digits();
 
     /* If a decimal, */
     if (c == '.') {
         /* Parse the decimal bit. */
         double result = (double)num;
         double decimal_places = 0.1;
-        for (get(); isdigit(c); get()) {
+        for (get(); has_class(c, DIGIT); get()) {
             result += decimal_places * digit(c);
             decimal_places *= 0.1;
         }
 
+        out.kind = Tok::FloatLiteral;
+        out.float_value = result;
+    } else if (c != 'e' && c != 'E') {
+        out.kind = Tok::UIntLiteral;
+        out.uint_value = num;
+        return;
+    } else {
+        out.kind = Tok::FloatLiteral;
+        out.float_value = (double)num;
+    }
 
-        /* Parse the exponent if present. */
-        if (c == 'e' || c == 'E') {
-            get();
-
-            bool neg = false;
-
-            if (c == '-') {
-                get();
-                neg = true;
-            }
-
-            uint64_t exp = 0;
-            for (; isdigit(c); get()) {
-                exp *= 10;
-                exp += digit(c);
-            }
-
-            return result * pow(10.0, (neg? -1: 1) * exp);
-        }
-
-        return result;
-    } else if (c == 'e' || c == 'E') {
+    /* Parse the exponent if present. */
+    if (c == 'e' || c == 'E') {
         get();
 
         bool neg = false;
@@ -117,183 +292,274 @@ boost::variant<double, uint64_t> Lexer::lex_number(void) {
             neg = true;
         }
 
-        double result = (double)num;
+        double exp = (double)lex_digits();
 
-        double exp = 0;
-        for (; isdigit(c); get()) {
-            exp *= 10.0;
-            exp += (double)digit(c);
-        }
-
-        return result * pow(10.0, (neg? -1: 1) * exp);
-    } else {
-        return num;
+        out.float_value *= pow(10.0, (neg? -1: 1) * exp);
     }
 }
 
-std::string Lexer::lex_string(void) {
-    std::ostringstream result;
+llvm::StringRef Lexer::lex_string(void) {
+    /* In buffer mode, the contents can be left where they are. */
+    const char *start = cur;
+    std::string *copy = nullptr;
+
+    if (stream) {
+        literals.emplace_back();
+        copy = &literals.back();
+    }
 
     while (true) {
         get();
 
-        if (eof) {
-            throw Error("lexer error", "unterminated string", pos);
+        if (c == -1) {
+            throw Error("lexer error", "unterminated string", char_pos());
         }
 
+        if (c == '"') break;
+
+        if (copy) copy->push_back(c);
+
+        /* Escape sequences are left to the parser, but an escaped quote
+         * mustn't end the string. */
         if (c == '\\') {
             get();
 
-            switch (c) {
-                case 'a':
-                    result << '\a';
-                    break;
-                case 'b':
-                    result << '\b';
-                    break;
-                case 'f':
-                    result << '\f';
-                    break;
-                case 'n':
-                    result << '\n';
-                    break;
-                case 'r':
-                    result << '\r';
-                    break;
-                case 't':
-                    result << '\t';
-                    break;
-                case 'v':
-                    result << '\v';
-                    break;
-                default:
-                    result << c;
-                    break;
+            if (c == -1) {
+                throw Error("lexer error", "unterminated string", char_pos());
             }
 
-            continue;
-        } else if (c == '"') {
-            break;
+            if (copy) copy->push_back(c);
         }
-
-        result << c;
     }
 
-    return result.str();
+    if (copy) return *copy;
+
+    /* `cur` is just past the closing quote. */
+    return llvm::StringRef(start, cur - 1 - start);
 }
 
 bool Lexer::at_eof(void) const {
-    return eof;
+    return current.eof;
+}
+
+const Tok::Token &Lexer::peek(void) {
+    if (!has_next) {
+        lex(next);
+        has_next = true;
+    }
+
+    return next.tok;
+}
+
+void Lexer::start_fingerprint(void) {
+    digest = std::make_unique<llvm::MD5>();
+}
+
+Fingerprint Lexer::fingerprint(void) const {
+    assert(digest);
+
+    auto copy = *digest;
+    Fingerprint result;
+    copy.final(result);
+
+    return result;
 }
 
 void Lexer::shift(void) {
-    while (std::isspace(c)) {
-        get();
+    if (digest) {
+        const auto &tok = current.tok;
+        digest->update((uint8_t)tok.kind);
+
+        switch (tok.kind) {
+        case Tok::TypeName:
+        case Tok::Identifier:
+            digest->update(tok.name.str());
+            digest->update((uint8_t)0);
+            break;
+        case Tok::Operator:
+            digest->update((uint8_t)tok.op);
+            if (tok.op == Tok::Op::Other) {
+                digest->update(tok.name.str());
+                digest->update((uint8_t)0);
+            }
+            break;
+        case Tok::IntLiteral:
+        case Tok::UIntLiteral:
+        case Tok::FloatLiteral:
+            digest->update(llvm::ArrayRef<uint8_t>(
+                        (const uint8_t *)&tok.uint_value,
+                        sizeof(tok.uint_value)));
+            break;
+        case Tok::StringLiteral:
+            digest->update(tok.text);
+            digest->update((uint8_t)0);
+            break;
+        default:
+            break;
+        }
     }
 
-    if (c == std::char_traits<char>::eof()) {
-        eof = true;
-        return;
+    if (has_next) {
+        current = next;
+        has_next = false;
+    } else {
+        lex(current);
     }
+}
 
-    /* Type name. */
-    if (isupper(c)) {
-        std::string tname;
+void Lexer::lex(Lexeme &out) {
+    TimeReport::Scope timer("lex", false);
 
-        while (isalpha(c) || isdigit(c) || c == '_' || is_unicode(c)) {
-            tname.push_back(c);
-            get();
-        }
+    Tok::Token &tok = out.tok;
+    out.eof = false;
+    ++ntokens;
 
-        tok = std::make_unique<Tok::TypeName>(tname);
+    skip_whitespace();
+    out.offset = char_offset();
+
+    if (c == -1) {
+        tok = Tok::Token(Tok::InvalidToken);
+        out.eof = true;
+    /* Type name. */
+    } else if (isupper(c)) {
+        tok = Tok::Token(Tok::TypeName, lex_word());
     /* Identifiers and identifier-like keywords. */
     } else if (islower(c) || is_unicode(c)) {
-        std::string ident;
-
-        while (isalpha(c) || isdigit(c) || c == '_' || is_unicode(c)) {
-            ident.push_back(c);
-            get();
-        }
+        llvm::StringRef word = lex_word();
 
         /* Keywords that otherwise look like identifiers. */
-        if (ident == "fn") {
-            tok = std::make_unique<Tok::Fn>();
-        } else if (ident == "struct") {
-            tok = std::make_unique<Tok::Struct>();
-        } else if (ident == "type") {
-            tok =  std::make_unique<Tok::Type>();
-        } else if (ident == "return") {
-            tok =  std::make_unique<Tok::Return>();
-        } else if (ident == "if") {
-            tok =  std::make_unique<Tok::If>();
-        } else if (ident == "else") {
-                tok = std::make_unique<Tok::Else>();
-        } else if (ident == "while") {
-            tok = std::make_unique<Tok::While>();
+        Tok::Kind kind = llvm::StringSwitch<Tok::Kind>(word)
+            .Case("fn", Tok::Fn)
+            .Case("struct", Tok::Struct)
+            .Case("type", Tok::Type)
+            .Case("return", Tok::Return)
+            .Case("if", Tok::If)
+            .Case("else", Tok::Else)
+            .Case("while", Tok::While)
+            .Case("for", Tok::For)
+            .Case("restrict", Tok::Restrict)
+            .Case("const", Tok::Const)
+            .Case("async", Tok::Async)
+            .Case("await", Tok::Await)
+            .Case("thread_local", Tok::ThreadLocal)
+            .Case("import", Tok::Import)
+            .Case("become", Tok::Become)
+            .Default(Tok::Identifier);
+
         /* If none of those, an identifier. */
+        if (kind == Tok::Identifier) {
+            tok = Tok::Token(Tok::Identifier, word);
         } else {
-            tok = std::make_unique<Tok::Identifier>(ident);
+            tok = Tok::Token(kind);
         }
     /* Numeric literal. */
-    } else if (isdigit(c)) {
-        auto result = lex_number();
-        if (result.which() == 0) {
-            auto literal = boost::get<double>(result);
-            tok = std::make_unique<Tok::FloatLiteral>(literal);
-        } else {
-            auto literal = boost::get<uint64_t>(result);
-            tok = std::make_unique<Tok::UIntLiteral>(literal);
-        }
+    } else if (has_class(c, DIGIT)) {
+        lex_number(tok);
     /* Operators.  This is easily extensible to user-defined operators. */
     } else if (is_opchar(c)) {
-        std::string result;
-        result.push_back(c);
+        /* Operators are short enough to stay in the string's inline
+         * buffer. */
+        scratch.assign(1, (char)c);
 
         for (get(); is_opchar(c); get()) {
-            result.push_back(c);
+            scratch.push_back(c);
         }
 
-        tok = std::make_unique<Tok::Operator>(result);
+        auto op = Tok::classify_op(scratch);
+        tok = op == Tok::Op::Other
+            ? Tok::Token::other_op_token(llvm::StringRef(scratch))
+            : Tok::Token::op_token(op);
     /* Some random syntax. */
     } else if (c == '(') {
-        tok = std::make_unique<Tok::OpenParen>();
+        tok = Tok::Token(Tok::OpenParen);
         get();
     } else if (c == ')') {
-        tok = std::make_unique<Tok::CloseParen>();
+        tok = Tok::Token(Tok::CloseParen);
         get();
     } else if (c == '{') {
-        tok = std::make_unique<Tok::OpenBrace>();
+        tok = Tok::Token(Tok::OpenBrace);
         get();
     } else if (c == '}') {
-        tok = std::make_unique<Tok::CloseBrace>();
+        tok = Tok::Token(Tok::CloseBrace);
+        get();
+    } else if (c == '[') {
+        tok = Tok::Token(Tok::OpenBracket);
+        get();
+    } else if (c == ']') {
+        tok = Tok::Token(Tok::CloseBracket);
         get();
     } else if (c == ';') {
-        tok = std::make_unique<Tok::Semicolon>();
+        tok = Tok::Token(Tok::Semicolon);
         get();
     } else if (c == ',') {
-        tok = std::make_unique<Tok::Comma>();
+        tok = Tok::Token(Tok::Comma);
         get();
     } else if (c == '"') {
-        tok = std::make_unique<Tok::StringLiteral>(lex_string());
+        tok = Tok::Token(Tok::StringLiteral);
+        tok.text = lex_string();
         get();
     } else throw Error("lexer error",
-                       std::string("character \"") + c + "\" not recognized",
-                       pos);
+                       std::string("character \"") + (char)c
+                                                    + "\" not recognized",
+                       char_pos());
 }
 
 const Tok::Token &Lexer::get_tok(void) const {
-    return *tok;
+    return current.tok;
 }
 
-void Lexer::get(void) {
-    c = stream.get();
+/*****************************************************************************
+ * LexerStack.
+ */
 
-    if (c == '\n' || c == '\r') {
-        pos.lineno++;
-        pos.charno = 0;
-    } else {
-        pos.charno++;
-    }
+LexerStack::LexerStack(const std::string &fname, SourceManager &sources)
+    : sources(sources) {
+    push(fname);
+}
+
+void LexerStack::push(const std::string &fname) {
+    lexers.push_back(std::make_unique<Lexer>(fname, sources));
+    fnames.push_back(fname);
+}
+
+bool LexerStack::pop_finished(void) {
+    if (lexers.size() == 1 || !lexers.back()->at_eof()) return false;
+
+    lexers.pop_back();
+    fnames.pop_back();
+    return true;
+}
+
+const std::string &LexerStack::fname(void) const {
+    return fnames.back();
+}
+
+SourcePos LexerStack::get_pos(void) const {
+    return lexers.back()->get_pos();
+}
+
+const Tok::Token &LexerStack::get_tok(void) const {
+    return lexers.back()->get_tok();
+}
+
+const Tok::Token &LexerStack::peek(void) {
+    return lexers.back()->peek();
+}
+
+bool LexerStack::at_eof(void) const {
+    return lexers.back()->at_eof();
+}
+
+void LexerStack::shift(void) {
+    lexers.back()->shift();
+}
+
+void LexerStack::start_fingerprint(void) {
+    lexers.back()->start_fingerprint();
+}
+
+Fingerprint LexerStack::fingerprint(void) const {
+    return lexers.back()->fingerprint();
 }
 
 }
@@ -22,27 +22,57 @@
 
 #include "Parser.hh"
 #include "ParserImpl.hh"
+#include "TimeReport.hh"
 
 namespace Craeft {
 
-Parser::Parser(const std::string &fname): pimpl(new ParserImpl(fname)) {}
+Parser::Parser(const std::string &fname, SourceManager &sources,
+               const std::vector<std::string> &import_dirs)
+    : pimpl(new ParserImpl(fname, sources, import_dirs)) {}
 
 Parser::~Parser() {}
 
-std::unique_ptr<AST::Expression> Parser::parse_expression(void) {
-    return pimpl->parse_expression();
+/**
+ * @brief Run the given parsing method with nodes allocated from a fresh
+ *        arena, and hand the resulting tree ownership of the arena.
+ */
+template<typename T>
+static AST::ArenaPtr<T> parse_in_arena(
+        ParserImpl &impl, std::unique_ptr<T> (ParserImpl::*method)(void)) {
+    TimeReport::Scope timer("parse");
+
+    auto arena = std::make_shared<AST::Arena>();
+    AST::ArenaScope scope(*arena);
+
+    AST::ArenaPtr<T> result((impl.*method)().release(),
+                            AST::ArenaDeleter { arena });
+    TimeReport::add("AST nodes", arena->allocations());
+
+    return result;
 }
 
-std::unique_ptr<AST::Statement> Parser::parse_statement(void) {
-    return pimpl->parse_statement();
+AST::ArenaPtr<AST::Expression> Parser::parse_expression(void) {
+    return parse_in_arena(*pimpl, &ParserImpl::parse_expression);
 }
 
-std::unique_ptr<AST::Toplevel> Parser::parse_toplevel(void) {
-    return pimpl->parse_toplevel();
+AST::ArenaPtr<AST::Statement> Parser::parse_statement(void) {
+    return parse_in_arena(*pimpl, &ParserImpl::parse_statement);
+}
+
+AST::ArenaPtr<AST::Toplevel> Parser::parse_toplevel(void) {
+    return parse_in_arena(*pimpl, &ParserImpl::parse_toplevel);
 }
 
 bool Parser::at_eof(void) {
     return pimpl->at_eof();
 }
 
+void Parser::set_fingerprinting(bool enabled) {
+    pimpl->fingerprinting = enabled;
+}
+
+const ToplevelFingerprint &Parser::last_fingerprint(void) const {
+    return pimpl->fingerprint;
+}
+
 }
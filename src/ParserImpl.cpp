@@ -20,10 +20,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
 
 #include <boost/type_index.hpp>
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include "Interface.hh"
 #include "ParserImpl.hh"
 #include "VariantUtils.hh"
 
@@ -33,22 +39,109 @@
 
 namespace Craeft {
 
-template <typename AstLiteral, typename TokLiteral>
-static inline std::unique_ptr<AstLiteral> get_literal(
-        TokLiteral tok, SourcePos pos) {
-    return std::make_unique<AstLiteral>(tok.value, pos);
+template <typename AstLiteral, typename T>
+static inline std::unique_ptr<AstLiteral> get_literal(T value, SourcePos pos) {
+    return std::make_unique<AstLiteral>(value, pos);
+}
+
+/**
+ * @brief Expand the escape sequences in the raw contents of a string literal.
+ */
+static std::string unescape(llvm::StringRef raw) {
+    std::string result;
+    result.reserve(raw.size());
+
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+
+        if (c != '\\' || i + 1 == raw.size()) {
+            result.push_back(c);
+            continue;
+        }
+
+        switch (raw[++i]) {
+            case 'a':
+                result.push_back('\a');
+                break;
+            case 'b':
+                result.push_back('\b');
+                break;
+            case 'f':
+                result.push_back('\f');
+                break;
+            case 'n':
+                result.push_back('\n');
+                break;
+            case 'r':
+                result.push_back('\r');
+                break;
+            case 't':
+                result.push_back('\t');
+                break;
+            case 'v':
+                result.push_back('\v');
+                break;
+            default:
+                result.push_back(raw[i]);
+                break;
+        }
+    }
+
+    return result;
 }
 
 /*****************************************************************************
  * Utilities for checking tokens.
  */
 
+/**
+ * @brief Operator spellings the parser checks for, interned once.
+ */
 bool is_arrow(const Tok::Token &tok) {
-    auto op = llvm::dyn_cast<Tok::Operator>(&tok);
+    return tok.is_op(Tok::Op::Arrow);
+}
 
-    if (!op) return false;
+/**
+ * @brief The precedence of each binary operator, or -1 for those which are
+ *        not binary operators.
+ */
+static int precedence(Tok::Op op) {
+    switch (op) {
+        case Tok::Op::Assign: return 200;
+        case Tok::Op::Or: return 300;
+        case Tok::Op::And: return 400;
+        case Tok::Op::BitOr: return 500;
+        case Tok::Op::BitXor: return 600;
+        case Tok::Op::BitAnd: return 700;
+
+        case Tok::Op::Eq:
+        case Tok::Op::Ne: return 800;
+
+        case Tok::Op::Lt:
+        case Tok::Op::Le:
+        case Tok::Op::Gt:
+        case Tok::Op::Ge: return 900;
+
+        case Tok::Op::Shl:
+        case Tok::Op::Shr: return 1000;
+
+        case Tok::Op::Add:
+        case Tok::Op::Sub: return 1100;
+
+        case Tok::Op::Mul:
+        case Tok::Op::Div:
+        case Tok::Op::Rem: return 1200;
+
+        case Tok::Op::Dot:
+        case Tok::Op::Arrow: return 1400;
+
+        case Tok::Op::At:
+        case Tok::Op::OpenGeneric:
+        case Tok::Op::CloseGeneric:
+        case Tok::Op::Other: break;
+    }
 
-    return op->op == "->";
+    return -1;
 }
 
 /*****************************************************************************
@@ -73,11 +166,16 @@ private:
     void operator()(const AST::Dereference &) override {}
     void operator()(const AST::FieldAccess &) override {}
 
+    void operator()(const AST::Index &index) override {
+        visit(index.array());
+        visit(index.index());
+    }
+
     /* On a binop, check if it is an `=`.  `=` are returned by the expression
      * parser, but they are not actually part of an expression, so this
      * results in an error. */
     void operator()(const AST::Binop &op) override {
-        if (op.op() == "=") {
+        if (op.op() == Tok::Op::Assign) {
             throw Error("parse error",
                         "\"=\" may not appear in an expression",
                         op.pos());
@@ -118,7 +216,7 @@ inline std::unique_ptr<AST::LValue> ParserImpl::to_lvalue(
     }
    
     if (auto binop = llvm::dyn_cast<AST::Binop>(expr.get())) {
-        if (binop->op() == ".") {
+        if (binop->op() == Tok::Op::Dot) {
              if (auto *name = llvm::dyn_cast<AST::Variable>(&binop->rhs())) {
                  SourcePos lhs_pos = binop->lhs().pos();
                  auto lvalue = to_lvalue(binop->release_lhs(), lhs_pos);
@@ -129,7 +227,7 @@ inline std::unique_ptr<AST::LValue> ParserImpl::to_lvalue(
                              "expected field name in field access",
                              pos);
              }
-         } else if (binop->op() == "->") {
+         } else if (binop->op() == Tok::Op::Arrow) {
              if (auto *name = llvm::dyn_cast<AST::Variable>(&binop->rhs())) {
                  SourcePos lhs_pos = binop->lhs().pos();
                  auto lvalue = std::make_unique<AST::Dereference>
@@ -169,6 +267,7 @@ private:
     IGNORE(Reference);
     IGNORE(Dereference);
     IGNORE(FieldAccess);
+    IGNORE(Index);
     IGNORE(FunctionCall);
     IGNORE(TemplateFunctionCall);
     IGNORE(Cast);
@@ -179,7 +278,7 @@ private:
      */
     std::unique_ptr<AST::Statement> operator()(
             std::unique_ptr<AST::Binop> op) override {
-        if (op->op() == "=") {
+        if (op->op() == Tok::Op::Assign) {
             // If they are, convert them to AST::Assignments.
             parser->verify_expression(op->lhs());
             parser->verify_expression(op->rhs());
@@ -205,44 +304,111 @@ inline std::unique_ptr<AST::Statement> ParserImpl::extract_assignments(
  * ParserImpl public methods.
  */
 
-ParserImpl::ParserImpl(const std::string &fname): lexer(fname) {}
+ParserImpl::ParserImpl(const std::string &fname, SourceManager &sources,
+                       const std::vector<std::string> &import_dirs)
+    : lexer(fname, sources), sources(sources), import_dirs(import_dirs) {
+    llvm::SmallString<128> path;
+    if (fname != "-" && !llvm::sys::fs::real_path(fname, path)) {
+        imported.insert(path.str().str());
+    }
+}
 
 std::unique_ptr<AST::Expression> ParserImpl::parse_expression(void) {
     return parse_binop(0, parse_unary());
 }
 
 std::unique_ptr<AST::Statement> ParserImpl::parse_statement(void) {
-    if (llvm::isa<Tok::TypeName>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::TypeName)) {
         auto result = parse_declaration();
-        find_and_shift(Tok::Semicolon(), "after declaration");
+        find_and_shift(Tok::Semicolon, "after declaration");
         return result;
-    } else if (llvm::isa<Tok::Return>(lexer.get_tok())) {
+    } else if (lexer.get_tok().is(Tok::Return)
+            || lexer.get_tok().is(Tok::Become)) {
         auto result = parse_return();
-        find_and_shift(Tok::Semicolon(), "after return statement");
+        find_and_shift(Tok::Semicolon, "after return statement");
         return result;
-    } else if (llvm::isa<Tok::If>(lexer.get_tok())) {
+    } else if (lexer.get_tok().is(Tok::If)) {
         return parse_if_statement();
+    } else if (lexer.get_tok().is(Tok::While)
+            || lexer.get_tok().is(Tok::For)
+            || lexer.get_tok().is_op(Tok::Op::At)) {
+        return parse_loop();
     } else {
         auto result = parse_expression();
-        find_and_shift(Tok::Semicolon(), "after top-level expression");
+        find_and_shift(Tok::Semicolon, "after top-level expression");
         return extract_assignments(std::move(result));
     }
 }
 
 std::unique_ptr<AST::Toplevel> ParserImpl::parse_toplevel(void) {
-    if (llvm::isa<Tok::Fn>(lexer.get_tok())) {
-        return parse_function();
-    } else if (llvm::isa<Tok::Struct>(lexer.get_tok())) {
-        return parse_struct_declaration();
-    } else if (llvm::isa<Tok::Type>(lexer.get_tok())) {
-        return parse_type_declaration();
+    skip_imports();
+
+    if (!interfaces.empty()) {
+        auto import = interfaces.front();
+        interfaces.pop_front();
+
+        // What an interface declares isn't parsed, so the whole thing counts.
+        if (fingerprinting) {
+            fingerprint.whole = Interface(import.first, import.second,
+                                          sources).fingerprint();
+            fingerprint.interface = fingerprint.whole;
+        }
+
+        return std::make_unique<AST::Import>(import.first, import.second);
+    }
+
+    if (fingerprinting) lexer.start_fingerprint();
+
+    std::unique_ptr<AST::Toplevel> result;
+
+    if (lexer.get_tok().is(Tok::Fn)) {
+        result = parse_function({});
+    } else if (lexer.get_tok().is(Tok::Struct)) {
+        result = parse_struct_declaration({});
+    } else if (lexer.get_tok().is(Tok::Const)) {
+        result = parse_const({});
+    } else if (lexer.get_tok().is(Tok::Async)) {
+        result = parse_async({});
+    } else if (lexer.get_tok().is_op(Tok::Op::At)) {
+        auto annotations = parse_annotations();
+        if (lexer.get_tok().is(Tok::Fn)) {
+            result = parse_function(std::move(annotations));
+        } else if (lexer.get_tok().is(Tok::Const)) {
+            result = parse_const(std::move(annotations));
+        } else if (lexer.get_tok().is(Tok::Async)) {
+            result = parse_async(std::move(annotations));
+        } else if (lexer.get_tok().is(Tok::Struct)) {
+            result = parse_struct_declaration(std::move(annotations));
+        } else {
+            _throw("expected function or struct declaration after "
+                   "annotations");
+        }
+    } else if (lexer.get_tok().is(Tok::Type)) {
+        result = parse_type_declaration();
+    } else if (lexer.get_tok().is(Tok::TypeName)
+            || lexer.get_tok().is(Tok::ThreadLocal)) {
+        result = parse_global();
     } else {
-        _throw("expected function or type declaration at top level");
+        _throw("expected function, constant, global or type declaration at "
+               "top level");
+    }
+
+    if (fingerprinting) {
+        fingerprint.whole = lexer.fingerprint();
+
+        // Function definitions set their interface fingerprint after parsing
+        // their signatures.
+        if (!llvm::isa<AST::FunctionDefinition>(*result)) {
+            fingerprint.interface = fingerprint.whole;
+        }
     }
+
+    return result;
 }
 
-bool ParserImpl::at_eof(void) const {
-    return lexer.at_eof();
+bool ParserImpl::at_eof(void) {
+    skip_imports();
+    return interfaces.empty() && lexer.at_eof();
 }
 
 /*****************************************************************************
@@ -258,7 +424,7 @@ std::vector<std::unique_ptr<AST::Expression>> ParserImpl::parse_expr_list(
         cont = false;
         exprs.push_back(parse_expression());
 
-        if (llvm::isa<Tok::Comma>(lexer.get_tok())) {
+        if (lexer.get_tok().is(Tok::Comma)) {
             lexer.shift();
             cont = true;
         }
@@ -267,15 +433,20 @@ std::vector<std::unique_ptr<AST::Expression>> ParserImpl::parse_expr_list(
     return exprs;
 }
 
-std::vector<std::unique_ptr<AST::Type>> ParserImpl::parse_type_list(void) {
+std::vector<std::unique_ptr<AST::Type>> ParserImpl::parse_template_args(
+        void) {
     std::vector<std::unique_ptr<AST::Type>> types;
 
     bool cont;
     do {
         cont = false;
-        types.push_back(parse_type());
+        if (auto integer = parse_integer_arg()) {
+            types.push_back(std::move(integer));
+        } else {
+            types.push_back(parse_type());
+        }
 
-        if (llvm::isa<Tok::Comma>(lexer.get_tok())) {
+        if (lexer.get_tok().is(Tok::Comma)) {
             lexer.shift();
             cont = true;
         }
@@ -284,45 +455,48 @@ std::vector<std::unique_ptr<AST::Type>> ParserImpl::parse_type_list(void) {
     return types;
 }
 
-std::unique_ptr<AST::Expression> ParserImpl::parse_variable(void) {
-    auto tok = llvm::cast<Tok::Identifier>(lexer.get_tok());
-
-    std::string id = tok.name;
+std::unique_ptr<AST::Expression> ParserImpl::parse_variable(bool awaited) {
+    Symbol id = lexer.get_tok().name;
 
     // Shift the name.
     lexer.shift();
 
     if (at_open_generic()) {
+        if (awaited) _throw("async functions cannot be templates");
+
         // Shift the <:.
         lexer.shift();
 
         std::vector<std::unique_ptr<AST::Type>> t_args;
 
         if (!at_close_generic()) {
-            t_args = parse_type_list();
+            t_args = parse_template_args();
 
             assert(t_args.size() > 0);
         }
 
-        find_and_shift(Tok::Operator(":>"), "after template argument list");
+        find_and_shift(Tok::Token::op_token(Tok::Op::CloseGeneric),
+                       "after template argument list");
 
-        find_and_shift(Tok::OpenParen(), "in template function call");
+        find_and_shift(Tok::OpenParen, "in template function call");
 
         std::vector<std::unique_ptr<AST::Expression>> args;
 
-        if (!llvm::isa<Tok::CloseParen>(lexer.get_tok())) {
+        if (!lexer.get_tok().is(Tok::CloseParen)) {
             args = parse_expr_list();
         }
 
         // Shift the close paren.
-        find_and_shift(Tok::CloseParen(), "after function argument list");
+        find_and_shift(Tok::CloseParen, "after function argument list");
 
         return std::make_unique<AST::TemplateFunctionCall>
                 (id, std::move(t_args), std::move(args), lexer.get_pos());
     }
 
     /* Case not function call. */
-    if (!llvm::isa<Tok::OpenParen>(lexer.get_tok())) {
+    if (!lexer.get_tok().is(Tok::OpenParen)) {
+        if (awaited) _throw("expected function call after await");
+
         return std::make_unique<AST::Variable>(id, lexer.get_pos());
     }
 
@@ -332,42 +506,59 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_variable(void) {
     // Accumulate vector of args.
     std::vector<std::unique_ptr<AST::Expression>> args;
 
-    if (!llvm::isa<Tok::CloseParen>(lexer.get_tok())) {
+    if (!lexer.get_tok().is(Tok::CloseParen)) {
         args = parse_expr_list();
     }
 
     // Shift the close paren.
-    find_and_shift(Tok::CloseParen(), "after function argument list");
+    find_and_shift(Tok::CloseParen, "after function argument list");
 
     return std::make_unique<AST::FunctionCall>(
-            std::move(id), std::move(args), lexer.get_pos());
+            std::move(id), std::move(args), lexer.get_pos(), awaited);
 }
 
 std::unique_ptr<AST::Expression> ParserImpl::parse_unary(void) {
     auto start = lexer.get_pos();
 
-    if (!llvm::isa<Tok::Operator>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::Await)) {
+        return parse_await();
+    }
+
+    if (!lexer.get_tok().is(Tok::Operator)) {
         return parse_primary();
     }
 
     // Save and shift the operator.
-    auto op = llvm::cast<Tok::Operator>(lexer.get_tok());
+    auto op = lexer.get_tok();
     lexer.shift();
 
     // Parse the operand.
     auto operand = parse_unary();
 
-    if (op.op == "*") {
+    if (op.op == Tok::Op::Mul) {
         return std::make_unique<AST::Dereference>(std::move(operand), start);
-    } else if (op.op == "&") {
+    } else if (op.op == Tok::Op::BitAnd) {
+        // Take the address of a whole chain of accesses, as in `&buf[i]`.
+        operand = parse_binop(precedence(Tok::Op::Dot), std::move(operand));
         return std::make_unique<AST::Reference>(
                 to_lvalue(std::move(operand), start), start);
     }
 
-    throw Error("parser error", "unrecognized operator \"" + op.op
+    throw Error("parser error", "unrecognized operator \"" + op.repr()
                               + "\"", start);
 }
 
+std::unique_ptr<AST::Expression> ParserImpl::parse_await(void) {
+    // Shift the `await`.
+    lexer.shift();
+
+    if (!lexer.get_tok().is(Tok::Identifier)) {
+        _throw("expected function call after await");
+    }
+
+    return parse_variable(true);
+}
+
 std::unique_ptr<AST::Expression> ParserImpl::parse_binop(
         int prec, std::unique_ptr<AST::Expression> lhs) {
     auto start = lexer.get_pos();
@@ -377,12 +568,25 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_binop(
 
         if (old_prec < prec) return lhs;
 
+        if (lexer.get_tok().is(Tok::OpenBracket)) {
+            // Shift the open bracket.
+            lexer.shift();
+
+            auto index = parse_expression();
+
+            find_and_shift(Tok::CloseBracket, "after array index");
+
+            lhs = std::make_unique<AST::Index>(std::move(lhs),
+                                               std::move(index), start);
+            continue;
+        }
+
         // Thing in expression was not an operator.
-        if (!llvm::isa<Tok::Operator>(lexer.get_tok())) {
+        if (!lexer.get_tok().is(Tok::Operator)) {
             _throw("expected operator in arithmetic expression");
         }
 
-        auto op = llvm::cast<Tok::Operator>(lexer.get_tok());
+        auto op = lexer.get_tok().op;
 
         lexer.shift();
 
@@ -394,10 +598,10 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_binop(
             rhs = parse_binop(old_prec + 1, std::move(rhs));
         }
 
-        if (op.op == "." || op.op == "->") {
+        if (op == Tok::Op::Dot || op == Tok::Op::Arrow) {
             if (auto *var = llvm::dyn_cast<AST::Variable>(rhs.get())) {
 
-                if (op.op == "->") {
+                if (op == Tok::Op::Arrow) {
                     auto pos = lhs->pos();
                     lhs = std::make_unique<AST::Dereference>(
                             std::move(lhs), pos);
@@ -412,7 +616,7 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_binop(
         }
 
         lhs = std::make_unique<AST::Binop>(
-                op.op, std::move(lhs), std::move(rhs), start);
+                op, std::move(lhs), std::move(rhs), start);
     }
 }
 
@@ -422,7 +626,7 @@ std::unique_ptr<AST::Cast> ParserImpl::parse_cast(void) {
     auto type = parse_type();
 
     // No closing parenthesis.
-    find_and_shift(Tok::CloseParen(), "after type in cast");
+    find_and_shift(Tok::CloseParen, "after type in cast");
 
     auto expr = parse_expression();
 
@@ -437,7 +641,7 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_parens(void) {
     lexer.shift();
 
     // Might be a cast.
-    if (llvm::isa<Tok::TypeName>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::TypeName)) {
         auto cast = parse_cast();
 
         // Fix starting position of cast to opening paren.
@@ -448,49 +652,45 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_parens(void) {
 
     auto contents = parse_expression();
 
-    find_and_shift(Tok::CloseParen(), "in parenthesized expression");
+    find_and_shift(Tok::CloseParen, "in parenthesized expression");
 
     return contents;
 }
 
 std::unique_ptr<AST::Expression> ParserImpl::parse_primary(void) {
     const auto &tok = lexer.get_tok();
-    switch (tok.kind()) {
-        case Tok::Token::TokenKind::Identifier:
+    switch (tok.kind) {
+        case Tok::Identifier:
             return parse_variable();
-        case Tok::Token::TokenKind::IntLiteral: {
-            auto i_lit = llvm::cast<Tok::IntLiteral>(tok);
+        case Tok::IntLiteral: {
             auto result = get_literal<AST::IntLiteral>
-                                     (i_lit, lexer.get_pos());
+                                     (tok.int_value, lexer.get_pos());
             lexer.shift();
             return std::move(result);
         }
 
-        case Tok::Token::TokenKind::UIntLiteral: {
-            auto u_lit = llvm::cast<Tok::UIntLiteral>(tok);
+        case Tok::UIntLiteral: {
             auto result = get_literal<AST::UIntLiteral>
-                                     (u_lit, lexer.get_pos());
+                                     (tok.uint_value, lexer.get_pos());
             lexer.shift();
             return std::move(result);
         }
 
-        case Tok::Token::TokenKind::FloatLiteral: {
-            auto f_lit = llvm::cast<Tok::FloatLiteral>(tok);
+        case Tok::FloatLiteral: {
             auto result = get_literal<AST::FloatLiteral>
-                                     (f_lit, lexer.get_pos());
+                                     (tok.float_value, lexer.get_pos());
             lexer.shift();
             return std::move(result);
         }
 
-        case Tok::Token::TokenKind::StringLiteral: {
-            auto s_lit = llvm::cast<Tok::StringLiteral>(tok);
+        case Tok::StringLiteral: {
             auto result = get_literal<AST::StringLiteral>
-                                     (s_lit, lexer.get_pos());
+                                     (unescape(tok.text), lexer.get_pos());
             lexer.shift();
             return std::move(result);
         }
 
-        case Tok::Token::TokenKind::OpenParen: {
+        case Tok::OpenParen: {
             return parse_parens();
         }
 
@@ -499,9 +699,30 @@ std::unique_ptr<AST::Expression> ParserImpl::parse_primary(void) {
     }
 }
 
+std::unique_ptr<AST::IntegerArg> ParserImpl::parse_integer_arg(void) {
+    const auto &tok = lexer.get_tok();
+    auto pos = lexer.get_pos();
+    std::unique_ptr<AST::IntegerArg> result;
+
+    if (tok.is(Tok::UIntLiteral)) {
+        result = std::make_unique<AST::IntegerArg>(tok.uint_value, pos);
+    } else if (tok.is(Tok::IntLiteral)) {
+        auto value = tok.int_value;
+        result = std::make_unique<AST::IntegerArg>(
+                static_cast<uint64_t>(value < 0 ? 0 : value), pos);
+    } else if (tok.is(Tok::Identifier)) {
+        result = std::make_unique<AST::IntegerArg>(tok.name, pos);
+    } else {
+        return nullptr;
+    }
+
+    lexer.shift();
+    return result;
+}
+
 std::unique_ptr<AST::Type> ParserImpl::parse_type(void) {
     /* TODO: Handle parentheses, array types, etc. */
-    auto tname = llvm::cast<Tok::TypeName>(lexer.get_tok()).name;
+    Symbol tname = lexer.get_tok().name;
 
     // Shift off the typename.
     lexer.shift();
@@ -509,27 +730,57 @@ std::unique_ptr<AST::Type> ParserImpl::parse_type(void) {
     std::unique_ptr<AST::Type> result
         = std::make_unique<AST::NamedType>(tname, lexer.get_pos());
 
-    if (at_open_generic()) {
+    bool vector = tname == Symbol("Vector");
+    if ((vector || tname == Symbol("Array")) && at_open_generic()) {
+        std::string what = vector ? "vector" : "array";
+        auto pos = lexer.get_pos();
+        lexer.shift();
+
+        auto element = parse_type();
+
+        find_and_shift(Tok::Comma, "after " + what + " element type");
+
+        // Only arrays can be as long as a constant or template parameter.
+        auto length = parse_integer_arg();
+        if (!length || (vector && !length->is_literal())) {
+            _throw(vector ? "expected number of lanes in vector type"
+                          : "expected length of array type");
+        }
+
+        find_and_shift(Tok::Token::op_token(Tok::Op::CloseGeneric),
+                       "after " + what + " type");
+
+        if (vector) {
+            result = std::make_unique<AST::Vector>(std::move(element),
+                                                   length->value(), pos);
+        } else {
+            result = std::make_unique<AST::Array>(std::move(element),
+                                                  std::move(length), pos);
+        }
+    } else if (at_open_generic()) {
         lexer.shift();
 
         std::vector<std::unique_ptr<AST::Type>> args;
         if (!at_close_generic()) {
-            args = parse_type_list();
+            args = parse_template_args();
         }
 
-        find_and_shift(Tok::Operator(":>"), "after template type");
+        find_and_shift(Tok::Token::op_token(Tok::Op::CloseGeneric),
+                       "after template type");
 
         result = std::make_unique<AST::TemplatedType>(
                 tname, std::move(args), lexer.get_pos());
     }
 
-    while (llvm::isa<Tok::Operator>(lexer.get_tok())) {
-        auto op = llvm::cast<Tok::Operator>(lexer.get_tok());
-        if (op.op != "*") break;
-
-        result = std::make_unique<AST::Pointer>(std::move(result),
-                                                lexer.get_pos());
+    while (lexer.get_tok().is_op(Tok::Op::Mul)) {
+        auto pos = lexer.get_pos();
         lexer.shift();
+
+        bool restrict = lexer.get_tok().is(Tok::Restrict);
+        if (restrict) lexer.shift();
+
+        result = std::make_unique<AST::Pointer>(std::move(result), restrict,
+                                                pos);
     }
 
     return result;
@@ -538,42 +789,45 @@ std::unique_ptr<AST::Type> ParserImpl::parse_type(void) {
 std::unique_ptr<AST::Statement> ParserImpl::parse_declaration(void) {
     auto start = lexer.get_pos();
 
-    if (!llvm::isa<Tok::TypeName>(lexer.get_tok())) {
+    if (!lexer.get_tok().is(Tok::TypeName)) {
         _throw("expected type name in declaration");
     }
 
     auto type = parse_type();
 
-    if (!llvm::isa<Tok::Identifier>(lexer.get_tok())) {
+    if (!lexer.get_tok().is(Tok::Identifier)) {
         _throw("expected identifier in declaration.");
     }
 
-    auto ident = llvm::cast<Tok::Identifier>(lexer.get_tok());
-
-    auto var = AST::Variable(ident.name, lexer.get_pos());
+    auto var = AST::Variable(lexer.get_tok().name, lexer.get_pos());
 
     lexer.shift();
 
-    if (llvm::isa<Tok::Semicolon>(lexer.get_tok())
-     || llvm::isa<Tok::CloseParen>(lexer.get_tok())
-     || llvm::isa<Tok::Comma>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::Semicolon)
+     || lexer.get_tok().is(Tok::CloseParen)
+     || lexer.get_tok().is(Tok::Comma)) {
         return std::make_unique<AST::Declaration>(std::move(type), var,
                                                   start);
     }
 
-    if (!llvm::isa<Tok::Operator>(lexer.get_tok())) {
-        _throw("expected equals sign in compound assignment");
-    }
-
-    auto op = llvm::cast<Tok::Operator>(lexer.get_tok());
-
-    if (op.op != "=") {
+    if (!lexer.get_tok().is_op(Tok::Op::Assign)) {
         _throw("expected equals sign in compound assignment");
     }
 
     // Shift the equals sign.
     lexer.shift();
 
+    if (lexer.get_tok().is(Tok::OpenBrace)) {
+        lexer.shift();
+        if (!lexer.get_tok().is(Tok::CloseBrace)) {
+            _throw("expected \"{}\" to zero the variable");
+        }
+        lexer.shift();
+
+        return std::make_unique<AST::Declaration>(std::move(type), var,
+                                                  start, true);
+    }
+
     auto rhs = parse_expression();
 
     return std::make_unique<AST::CompoundDeclaration>(std::move(type), var,
@@ -585,7 +839,7 @@ std::unique_ptr<AST::Declaration> ParserImpl::parse_simple_declaration(void) {
     std::unique_ptr<AST::Declaration> decl(
             llvm::dyn_cast<AST::Declaration>(decl_tmp.release()));
 
-    if (!decl) {
+    if (!decl || decl->zeroed()) {
         _throw("expected simple declaration");
     }
 
@@ -603,7 +857,7 @@ std::unique_ptr<AST::IfStatement> ParserImpl::parse_if_statement(void) {
 
     std::vector<std::unique_ptr<AST::Statement>> else_block;
 
-    if (!llvm::isa<Tok::Else>(lexer.get_tok())) {
+    if (!lexer.get_tok().is(Tok::Else)) {
         // No else block.
         return std::make_unique<AST::IfStatement>(std::move(cond),
                                                   std::move(if_block),
@@ -623,18 +877,122 @@ std::unique_ptr<AST::IfStatement> ParserImpl::parse_if_statement(void) {
                                               start);
 }
 
+std::vector<AST::Annotation> ParserImpl::parse_annotations(void) {
+    std::vector<AST::Annotation> result;
+
+    while (lexer.get_tok().is_op(Tok::Op::At)) {
+        // Errors point at the name.
+        auto pos = lexer.get_pos();
+
+        // Shift the "@".
+        lexer.shift();
+
+        if (!lexer.get_tok().is(Tok::Identifier)) {
+            _throw("expected annotation name");
+        }
+        result.emplace_back(lexer.get_tok().name, pos);
+        lexer.shift();
+
+        if (!lexer.get_tok().is(Tok::OpenParen)) continue;
+        lexer.shift();
+
+        auto &args = result.back().args;
+        while (!lexer.get_tok().is(Tok::CloseParen)) {
+            Symbol name;
+            if (lexer.get_tok().is(Tok::Identifier)) {
+                name = lexer.get_tok().name;
+                lexer.shift();
+
+                // A flag, as in `@target_clones(avx2)`.
+                if (!lexer.get_tok().is_op(Tok::Op::Assign)) {
+                    args.emplace_back(name, 1);
+                    if (!lexer.get_tok().is(Tok::Comma)) break;
+                    lexer.shift();
+                    continue;
+                }
+                lexer.shift();
+            }
+
+            if (lexer.get_tok().is(Tok::UIntLiteral)) {
+                args.emplace_back(name, lexer.get_tok().uint_value);
+            } else if (lexer.get_tok().is(Tok::IntLiteral)) {
+                args.emplace_back(name, lexer.get_tok().int_value);
+            } else {
+                _throw("expected integer annotation argument");
+            }
+            lexer.shift();
+
+            if (!lexer.get_tok().is(Tok::Comma)) break;
+            lexer.shift();
+        }
+
+        find_and_shift(Tok::CloseParen, "after annotation arguments");
+    }
+
+    return result;
+}
+
+std::unique_ptr<AST::Statement> ParserImpl::parse_loop(void) {
+    auto start = lexer.get_pos();
+    auto annotations = parse_annotations();
+
+    if (lexer.get_tok().is(Tok::While)) {
+        // Shift the "while".
+        lexer.shift();
+
+        auto cond = parse_expression();
+        auto body = parse_block();
+
+        return std::make_unique<AST::WhileLoop>(std::move(cond),
+                                                std::move(body),
+                                                std::move(annotations),
+                                                start);
+    }
+
+    if (!lexer.get_tok().is(Tok::For)) {
+        _throw("expected loop after annotations");
+    }
+
+    // Shift the "for".
+    lexer.shift();
+
+    std::unique_ptr<AST::Statement> init;
+    if (lexer.get_tok().is(Tok::TypeName)) {
+        init = parse_declaration();
+    } else if (!lexer.get_tok().is(Tok::Semicolon)) {
+        init = extract_assignments(parse_expression());
+    }
+    find_and_shift(Tok::Semicolon, "after loop initializer");
+
+    auto cond = parse_expression();
+    find_and_shift(Tok::Semicolon, "after loop condition");
+
+    std::unique_ptr<AST::Statement> step;
+    if (!lexer.get_tok().is(Tok::OpenBrace)) {
+        step = extract_assignments(parse_expression());
+    }
+
+    auto body = parse_block();
+
+    return std::make_unique<AST::ForLoop>(std::move(init), std::move(cond),
+                                          std::move(step), std::move(body),
+                                          std::move(annotations), start);
+}
+
 std::unique_ptr<AST::Statement> ParserImpl::parse_return(void) {
     auto start = lexer.get_pos();
-    // Shift the return.
+    bool is_tail = lexer.get_tok().is(Tok::Become);
+    // Shift the return or become.
     lexer.shift();
 
-    if (llvm::isa<Tok::Semicolon>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::Semicolon)) {
+        if (is_tail) _throw("expected a call after \"become\"");
         return std::make_unique<AST::VoidReturn>(start);
     }
 
     auto retval = parse_expression();
 
-    return std::make_unique<AST::Return>(std::move(retval), start);
+    return std::make_unique<AST::Return>(std::move(retval), start, is_tail);
 }
 
 std::unique_ptr<AST::TypeDeclaration>
@@ -644,33 +1002,34 @@ std::unique_ptr<AST::TypeDeclaration>
     lexer.shift();
 
     const auto &tok = lexer.get_tok();
-    auto *tname_ptr = llvm::dyn_cast<Tok::TypeName>(&tok);
 
-    if (!tname_ptr) {
+    if (!tok.is(Tok::TypeName)) {
         _throw("expected type name in type declaration.");
     }
 
-    auto tname = *tname_ptr;
+    Symbol tname = tok.name;
 
     // Shift the type name.
     lexer.shift();
 
-    return std::make_unique<AST::TypeDeclaration>(tname.name, start);
+    return std::make_unique<AST::TypeDeclaration>(tname, start);
 }
 
 std::vector<std::unique_ptr<AST::Declaration> >
-      ParserImpl::parse_declarations(void) {
-    find_and_shift(Tok::OpenBrace(), "in declaration block");
+      ParserImpl::parse_declarations(
+            std::vector<std::vector<AST::Annotation> > &annotations) {
+    find_and_shift(Tok::OpenBrace, "in declaration block");
 
     std::vector<std::unique_ptr<AST::Declaration> > result;
 
     // Until we get to the closing brace,
-    while (!llvm::isa<Tok::CloseBrace>(lexer.get_tok())) {
-        // parse a declaration
+    while (!lexer.get_tok().is(Tok::CloseBrace)) {
+        // parse any annotations and a declaration
+        annotations.push_back(parse_annotations());
         auto decl = parse_simple_declaration();
 
         // followed by a semicolon.
-        if (!llvm::isa<Tok::Semicolon>(lexer.get_tok())) {
+        if (!lexer.get_tok().is(Tok::Semicolon)) {
             _throw("expected semicolon after struct member declaration");
         }
 
@@ -686,7 +1045,8 @@ std::vector<std::unique_ptr<AST::Declaration> >
     return result;
 }
 
-std::unique_ptr<AST::Toplevel> ParserImpl::parse_struct_declaration(void) {
+std::unique_ptr<AST::Toplevel> ParserImpl::parse_struct_declaration(
+        std::vector<AST::Annotation> annotations) {
     auto start = lexer.get_pos();
 
     // Shift the `struct`.
@@ -695,71 +1055,196 @@ std::unique_ptr<AST::Toplevel> ParserImpl::parse_struct_declaration(void) {
     if (at_open_generic()) {
         lexer.shift();
 
-        const auto& tname_tok = lexer.get_tok();
-
-        std::vector<std::string> type_list;
+        std::vector<Symbol> type_list;
 
         if (!at_close_generic()) {
             bool cont;
             do {
                 cont = false;
-                auto *tname = llvm::dyn_cast<Tok::TypeName>(&tname_tok);
+                const auto &tname_tok = lexer.get_tok();
 
-                if (!tname) {
-                    _throw("expected type name in template argument list");
+                // Lower-case names are integer parameters.
+                if (!tname_tok.is(Tok::TypeName)
+                 && !tname_tok.is(Tok::Identifier)) {
+                    _throw("expected type or integer name in template "
+                           "argument list");
                 }
 
-                type_list.push_back(tname->name);
+                type_list.push_back(tname_tok.name);
 
                 lexer.shift();
 
-                if (llvm::isa<Tok::Comma>(lexer.get_tok())) {
+                if (lexer.get_tok().is(Tok::Comma)) {
                     lexer.shift();
                     cont = true;
                 }
             } while (cont);
         }
 
-        find_and_shift(Tok::Operator(":>"), "after template argument list");
+        find_and_shift(Tok::Token::op_token(Tok::Op::CloseGeneric),
+                       "after template argument list");
 
         const auto& struct_tok = lexer.get_tok();
 
-        auto *tname_ptr = llvm::dyn_cast<Tok::TypeName>(&struct_tok);
-
-        if (!tname_ptr) {
+        if (!struct_tok.is(Tok::TypeName)) {
             _throw("expected type name in template struct declaration");
         }
 
-        auto tname = *tname_ptr;
+        Symbol tname = struct_tok.name;
 
         // Shift the type name.
         lexer.shift();
 
-        auto members = parse_declarations();
+        std::vector<std::vector<AST::Annotation> > member_annotations;
+        auto members = parse_declarations(member_annotations);
 
         return std::make_unique<AST::TemplateStructDeclaration>(
-                tname.name, type_list, std::move(members), start);
+                tname, type_list, std::move(members),
+                std::move(member_annotations), std::move(annotations),
+                start);
     }
 
     const auto &tok = lexer.get_tok();
-    auto *tname_ptr = llvm::dyn_cast<Tok::TypeName>(&tok);
 
-    if (!tname_ptr) {
+    if (!tok.is(Tok::TypeName)) {
         _throw("expected type name in type declaration");
     }
 
-    auto tname = *tname_ptr;
+    Symbol tname = tok.name;
 
     // Shift the type name.
     lexer.shift();
 
-    auto members = parse_declarations();
+    std::vector<std::vector<AST::Annotation> > member_annotations;
+    auto members = parse_declarations(member_annotations);
 
     return std::make_unique<AST::StructDeclaration>(
-            tname.name, std::move(members), start);
+            tname, std::move(members), std::move(member_annotations),
+            std::move(annotations), start);
+}
+
+std::unique_ptr<AST::Toplevel> ParserImpl::parse_const(
+        std::vector<AST::Annotation> annotations) {
+    auto start = lexer.get_pos();
+
+    // Shift the `const`.
+    lexer.shift();
+
+    if (lexer.get_tok().is(Tok::Fn)) {
+        return parse_function(std::move(annotations), true);
+    }
+
+    if (!annotations.empty()) {
+        _throw("expected function after annotations");
+    }
+
+    if (!lexer.get_tok().is(Tok::TypeName)) {
+        _throw("expected type or fn after const");
+    }
+
+    auto decl = parse_declaration();
+
+    if (!llvm::isa<AST::CompoundDeclaration>(*decl)) {
+        _throw("expected initializer for constant");
+    }
+
+    find_and_shift(Tok::Semicolon, "after constant definition");
+
+    std::unique_ptr<AST::CompoundDeclaration> compound(
+            llvm::cast<AST::CompoundDeclaration>(decl.release()));
+    return std::make_unique<AST::ConstDefinition>(std::move(compound),
+                                                  start);
+}
+
+std::unique_ptr<AST::Toplevel> ParserImpl::parse_global(void) {
+    auto start = lexer.get_pos();
+
+    bool is_thread_local = lexer.get_tok().is(Tok::ThreadLocal);
+    if (is_thread_local) {
+        // Shift the `thread_local`.
+        lexer.shift();
+    }
+
+    auto decl = parse_declaration();
+
+    find_and_shift(Tok::Semicolon, "after global definition");
+
+    return std::make_unique<AST::GlobalDefinition>(std::move(decl),
+                                                   is_thread_local, start);
+}
+
+void ParserImpl::skip_imports(void) {
+    for (;;) {
+        if (lexer.pop_finished()) continue;
+        if (!lexer.get_tok().is(Tok::Import)) return;
+        parse_import();
+    }
+}
+
+void ParserImpl::parse_import(void) {
+    auto start = lexer.get_pos();
+
+    // Shift the `import`.
+    lexer.shift();
+
+    if (!lexer.get_tok().is(Tok::StringLiteral)) {
+        _throw("expected file name in quotes after \"import\"");
+    }
+
+    std::string name = lexer.get_tok().text.str();
+    lexer.shift();
+
+    find_and_shift(Tok::Semicolon, "after import");
+
+    auto path = resolve_import(name, start);
+    if (!imported.insert(path).second) return;
+
+    if (llvm::sys::path::extension(path) == INTERFACE_EXTENSION) {
+        interfaces.emplace_back(path, start);
+    } else {
+        lexer.push(path);
+    }
+}
+
+std::string ParserImpl::resolve_import(const std::string &name,
+                                       SourcePos pos) const {
+    std::vector<std::string> dirs;
+
+    llvm::SmallString<128> importer(lexer.fname());
+    llvm::sys::path::remove_filename(importer);
+    dirs.push_back(lexer.fname() == "-" ? "" : importer.str().str());
+    dirs.insert(dirs.end(), import_dirs.begin(), import_dirs.end());
+    dirs.push_back(CRAEFT_LIB_DIR);
+
+    for (const auto &dir: dirs) {
+        llvm::SmallString<128> path(dir);
+        llvm::sys::path::append(path, name);
+
+        llvm::SmallString<128> real;
+        if (llvm::sys::fs::is_regular_file(path)
+         && !llvm::sys::fs::real_path(path, real)) {
+            return real.str().str();
+        }
+    }
+
+    throw Error("error", "cannot find \"" + name + "\" to import", pos);
+}
+
+std::unique_ptr<AST::Toplevel> ParserImpl::parse_async(
+        std::vector<AST::Annotation> annotations) {
+    // Shift the `async`.
+    lexer.shift();
+
+    if (!lexer.get_tok().is(Tok::Fn)) {
+        _throw("expected fn after async");
+    }
+
+    return parse_function(std::move(annotations), false, true);
 }
 
-std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(void) {
+std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(
+        std::vector<AST::Annotation> annotations, bool is_const,
+        bool is_async) {
     auto start = lexer.get_pos();
 
     bool templ = false;
@@ -767,7 +1252,7 @@ std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(void) {
     // Shift the `fn`.
     lexer.shift();
 
-    std::vector<std::string> type_list;
+    std::vector<Symbol> type_list;
 
     if (at_open_generic()) {
         templ = true;
@@ -779,36 +1264,37 @@ std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(void) {
             do {
                 cont = false;
                 const auto &tok = lexer.get_tok();
-                auto *tname = llvm::dyn_cast<Tok::TypeName>(&tok);
 
-                if (!tname) {
-                    _throw("expected type name in function template "
-                           "argument list");
+                if (!tok.is(Tok::TypeName) && !tok.is(Tok::Identifier)) {
+                    _throw("expected type or integer name in function "
+                           "template argument list");
                 }
 
-                type_list.push_back(tname->name);
+                type_list.push_back(tok.name);
 
                 lexer.shift();
 
-                if (llvm::isa<Tok::Comma>(lexer.get_tok())) {
+                if (lexer.get_tok().is(Tok::Comma)) {
                     lexer.shift();
                     cont = true;
                 }
             } while (cont);
         }
 
-        find_and_shift(Tok::Operator(":>"), "after template argument list");
+        find_and_shift(Tok::Token::op_token(Tok::Op::CloseGeneric),
+                       "after template argument list");
+
+        if (is_const) _throw("const functions cannot be templates");
+        if (is_async) _throw("async functions cannot be templates");
     }
 
     const auto &tok = lexer.get_tok();
 
-    auto *ident = llvm::dyn_cast<Tok::Identifier>(&tok);
-
-    if (!ident) {
+    if (!tok.is(Tok::Identifier)) {
         _throw("expected identifier as function name");
     }
 
-    auto fname = std::move(ident->name);
+    Symbol fname = tok.name;
 
     // Shift the function name.
     lexer.shift();
@@ -826,17 +1312,31 @@ std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(void) {
     }
 
     auto decl = std::make_unique<AST::FunctionDeclaration>(
-            fname, std::move(args), std::move(ret_type), start);
+            fname, std::move(args), std::move(ret_type),
+            std::move(annotations), start, is_async);
 
     // If semicolon, this is just a forward declaration.
-    if (llvm::isa<Tok::Semicolon>(lexer.get_tok())) {
+    if (lexer.get_tok().is(Tok::Semicolon)) {
+        if (is_const) _throw("expected body of const function");
+
         // Shift the semicolon.
         lexer.shift();
         return std::move(decl);
     }
 
+    // Callers evaluate the bodies of `const fn`s, so those are all
+    // interface.
+    if (fingerprinting && !is_const) {
+        fingerprint.interface = lexer.fingerprint();
+    }
+
     auto body = parse_block();
 
+    if (is_const) {
+        return std::make_unique<AST::ConstFunctionDefinition>(
+                std::move(decl), std::move(body), start);
+    }
+
     if (templ) {
         return std::make_unique<AST::TemplateFunctionDefinition>(
                 std::move(decl), type_list, std::move(body), start);
@@ -849,11 +1349,11 @@ std::unique_ptr<AST::Toplevel> ParserImpl::parse_function(void) {
 }
 
 std::vector<std::unique_ptr<AST::Statement>> ParserImpl::parse_block(void) {
-    find_and_shift(Tok::OpenBrace(), "before block");
+    find_and_shift(Tok::OpenBrace, "before block");
 
     std::vector<std::unique_ptr<AST::Statement>> result;
 
-    while (!llvm::isa<Tok::CloseBrace>(lexer.get_tok())) {
+    while (!lexer.get_tok().is(Tok::CloseBrace)) {
         result.push_back(parse_statement());
     }
 
@@ -865,30 +1365,28 @@ std::vector<std::unique_ptr<AST::Statement>> ParserImpl::parse_block(void) {
 int ParserImpl::get_token_precedence(void) const {
     const auto &tok = lexer.get_tok();
 
-    if (auto *op = llvm::dyn_cast<Tok::Operator>(&tok)) {
-        auto i = precedences.find(op->op);
-        if (i != precedences.end()) {
-            return i->second;
-        }
-    }
+    if (tok.is(Tok::Operator)) return precedence(tok.op);
+
+    // Indexing binds as tightly as field access.
+    if (tok.is(Tok::OpenBracket)) return precedence(Tok::Op::Dot);
 
     return -1;
 }
 
 std::vector<std::unique_ptr<AST::Declaration> >
       ParserImpl::parse_arg_list(void) {
-    find_and_shift(Tok::OpenParen(), "before argument list");
+    find_and_shift(Tok::OpenParen, "before argument list");
 
     std::vector<std::unique_ptr<AST::Declaration> > args;
 
-    while (!llvm::isa<Tok::CloseParen>(lexer.get_tok())) {
+    while (!lexer.get_tok().is(Tok::CloseParen)) {
         auto decl = parse_simple_declaration();
 
         args.push_back(std::move(decl));
 
-        if (llvm::isa<Tok::CloseParen>(lexer.get_tok())) break;
+        if (lexer.get_tok().is(Tok::CloseParen)) break;
 
-        find_and_shift(Tok::Comma(), "in function declaration");
+        find_and_shift(Tok::Comma, "in function declaration");
     }
 
     // Shift the closing paren.
@@ -906,20 +1404,17 @@ inline void ParserImpl::find_and_shift(const Tok::Token& expected,
     lexer.shift();
 }
 
-inline bool ParserImpl::at_open_generic(void) {
-    const auto &tok = lexer.get_tok();
-
-    auto *_op = llvm::dyn_cast<Tok::Operator>(&tok);
+inline void ParserImpl::find_and_shift(Tok::Kind expected,
+                                       std::string at_place) {
+    find_and_shift(Tok::Token(expected), at_place);
+}
 
-    return _op && _op->op == "<:";
+inline bool ParserImpl::at_open_generic(void) {
+    return lexer.get_tok().is_op(Tok::Op::OpenGeneric);
 }
 
 inline bool ParserImpl::at_close_generic(void) {
-    const auto &tok = lexer.get_tok();
-
-    auto *_op = llvm::dyn_cast<Tok::Operator>(&tok);
-
-    return _op && _op->op == ":>";
+    return lexer.get_tok().is_op(Tok::Op::CloseGeneric);
 }
 
 [[noreturn]] inline void ParserImpl::_throw(std::string message) {
@@ -0,0 +1,147 @@
+/**
+ * @file Server.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Server.hh"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ServerProtocol.hh"
+#include "Target.hh"
+
+namespace Craeft {
+
+/** @brief The socket, for the signal handler to remove. */
+static char served_path[sizeof(sockaddr_un::sun_path)];
+
+static void stop(int) {
+    unlink(served_path);
+    _exit(0);
+}
+
+/**
+ * @brief Run one request, in a child of the server.
+ */
+[[noreturn]] static void handle(int conn, const RequestHandler &handler) {
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    std::string cwd;
+    std::vector<std::string> args;
+    int fds[3];
+    if (!receive_request(conn, cwd, args, fds)) _exit(2);
+
+    for (int i = 0; i < 3; ++i) {
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+
+    int status;
+    if (chdir(cwd.c_str())) {
+        std::cerr << "craeftc: cannot enter " << cwd << ": "
+                  << strerror(errno) << std::endl;
+        status = 2;
+    } else {
+        status = handler(args);
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    send_status(conn, status);
+    _exit(status);
+}
+
+int serve(const std::string &socket_path, const RequestHandler &handler) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof addr.sun_path) {
+        std::cerr << "craeftc: socket path too long: " << socket_path
+                  << std::endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path.c_str());
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        std::cerr << "craeftc: cannot create a socket: " << strerror(errno)
+                  << std::endl;
+        return 1;
+    }
+
+    /* Only take over the path if no server is listening on it. */
+    if (!connect(sock, (sockaddr *)&addr, sizeof addr)) {
+        std::cerr << "craeftc: a server is already listening on "
+                  << socket_path << std::endl;
+        return 1;
+    }
+    close(sock);
+    unlink(socket_path.c_str());
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || bind(sock, (sockaddr *)&addr, sizeof addr)
+     || listen(sock, SOMAXCONN)) {
+        std::cerr << "craeftc: cannot listen on " << socket_path << ": "
+                  << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    strcpy(served_path, socket_path.c_str());
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    /* Children are reaped automatically; they report to their clients. */
+    signal(SIGCHLD, SIG_IGN);
+
+    /* Everything the children would all do first. */
+    initialize_targets();
+
+    while (true) {
+        int conn = accept(sock, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "craeftc: cannot accept a connection: "
+                      << strerror(errno) << std::endl;
+            unlink(served_path);
+            return 1;
+        }
+
+        pid_t child = fork();
+        if (child == 0) {
+            close(sock);
+            handle(conn, handler);
+        }
+
+        /* If the fork failed, closing the connection tells the client. */
+        close(conn);
+    }
+}
+
+}
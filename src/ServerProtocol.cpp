@@ -0,0 +1,162 @@
+/**
+ * @file ServerProtocol.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ServerProtocol.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Both ends are on the same machine, so integers are sent as they are. */
+
+namespace Craeft {
+
+static bool write_all(int sock, const void *data, size_t len) {
+    const char *p = static_cast<const char *>(data);
+    while (len) {
+        auto written = write(sock, p, len);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        p += written;
+        len -= written;
+    }
+    return true;
+}
+
+static bool read_all(int sock, void *data, size_t len) {
+    char *p = static_cast<char *>(data);
+    while (len) {
+        auto got = read(sock, p, len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        len -= got;
+    }
+    return true;
+}
+
+static bool write_string(int sock, const std::string &str) {
+    uint32_t len = str.size();
+    return write_all(sock, &len, sizeof len)
+        && write_all(sock, str.data(), len);
+}
+
+static bool read_string(int sock, std::string &str) {
+    uint32_t len;
+    if (!read_all(sock, &len, sizeof len)) return false;
+    str.resize(len);
+    return read_all(sock, &str[0], len);
+}
+
+bool send_request(int sock, const std::string &cwd,
+                  const std::vector<std::string> &args) {
+    /* The descriptors go along with the first byte: the argument count. */
+    uint32_t nargs = args.size();
+    int fds[3] = { 0, 1, 2 };
+
+    char control[CMSG_SPACE(sizeof fds)];
+    memset(control, 0, sizeof control);
+
+    struct iovec iov;
+    iov.iov_base = &nargs;
+    iov.iov_len = sizeof nargs;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    auto *header = CMSG_FIRSTHDR(&msg);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof fds);
+    memcpy(CMSG_DATA(header), fds, sizeof fds);
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(sock, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != sizeof nargs) return false;
+
+    if (!write_string(sock, cwd)) return false;
+    for (const auto &arg: args) {
+        if (!write_string(sock, arg)) return false;
+    }
+    return true;
+}
+
+bool receive_request(int sock, std::string &cwd,
+                     std::vector<std::string> &args, int fds[3]) {
+    uint32_t nargs;
+    char control[CMSG_SPACE(3 * sizeof(int))];
+
+    struct iovec iov;
+    iov.iov_base = &nargs;
+    iov.iov_len = sizeof nargs;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t got;
+    do {
+        got = recvmsg(sock, &msg, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got != sizeof nargs) return false;
+
+    auto *header = CMSG_FIRSTHDR(&msg);
+    if (!header || header->cmsg_level != SOL_SOCKET
+     || header->cmsg_type != SCM_RIGHTS
+     || header->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(header), 3 * sizeof(int));
+
+    if (!read_string(sock, cwd)) return false;
+    args.resize(nargs);
+    for (auto &arg: args) {
+        if (!read_string(sock, arg)) return false;
+    }
+    return true;
+}
+
+bool send_status(int sock, int status) {
+    int32_t value = status;
+    return write_all(sock, &value, sizeof value);
+}
+
+bool receive_status(int sock, int &status) {
+    int32_t value;
+    if (!read_all(sock, &value, sizeof value)) return false;
+    status = value;
+    return true;
+}
+
+}
@@ -0,0 +1,133 @@
+/**
+ * @file SourceManager.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "SourceManager.hh"
+
+#include <algorithm>
+
+namespace Craeft {
+
+SourceManager::SourceManager(void) {
+    files.push_back(std::make_unique<File>());
+}
+
+uint32_t SourceManager::add_buffer(
+        const std::string &fname,
+        std::shared_ptr<llvm::MemoryBuffer> buffer) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    files.push_back(std::make_unique<File>());
+    files.back()->fname = fname;
+    files.back()->buffer = std::move(buffer);
+    return files.size() - 1;
+}
+
+uint32_t SourceManager::add_stream(const std::string &fname) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    files.push_back(std::make_unique<File>());
+    files.back()->fname = fname;
+    return files.size() - 1;
+}
+
+void SourceManager::append(uint32_t file, llvm::StringRef text) {
+    std::lock_guard<std::mutex> guard(lock);
+    files[file]->streamed.append(text.begin(), text.end());
+}
+
+SourcePos SourceManager::start_of(const std::string &fname) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (size_t i = files.size() - 1; i > 0; --i) {
+        if (files[i]->fname == fname) return SourcePos(i, 0);
+    }
+
+    files.push_back(std::make_unique<File>());
+    files.back()->fname = fname;
+    return SourcePos(files.size() - 1, 0);
+}
+
+std::pair<unsigned, unsigned> SourceManager::locate(File &file,
+                                                    size_t offset) {
+    auto text = file.text();
+    offset = std::min(offset, text.size());
+
+    for (; file.indexed < offset; ++file.indexed) {
+        if (text[file.indexed] == '\n') {
+            file.line_starts.push_back(file.indexed + 1);
+        }
+    }
+
+    // The number of lines starting at or before the offset.
+    auto after = std::upper_bound(file.line_starts.begin(),
+                                  file.line_starts.end(), offset);
+    size_t line = after - file.line_starts.begin();
+    size_t line_start = line ? file.line_starts[line - 1] : 0;
+
+    return std::make_pair(line + 1, offset - line_start + 1);
+}
+
+std::pair<unsigned, unsigned> SourceManager::line_and_column(SourcePos pos) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!pos.file || pos.file >= files.size()) return std::make_pair(0, 0);
+
+    return locate(*files[pos.file], pos.offset);
+}
+
+std::string SourceManager::file_name(SourcePos pos) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!pos.file || pos.file >= files.size()) return "";
+
+    return files[pos.file]->fname;
+}
+
+SourceManager::Location SourceManager::resolve(SourcePos pos) {
+    std::lock_guard<std::mutex> guard(lock);
+    Location result;
+
+    if (!pos.file || pos.file >= files.size()) return result;
+
+    auto &file = *files[pos.file];
+    auto text = file.text();
+    size_t offset = std::min<size_t>(pos.offset, text.size());
+
+    auto line_col = locate(file, offset);
+    size_t line_start = offset - (line_col.second - 1);
+    size_t line_end = std::min(text.find('\n', offset), text.size());
+
+    result.fname = file.fname;
+    result.lineno = line_col.first;
+    result.charno = line_col.second;
+
+    if (line_start < text.size()) {
+        result.line = text.slice(line_start, line_end).rtrim('\r').str();
+        result.has_line = true;
+    }
+
+    return result;
+}
+
+}
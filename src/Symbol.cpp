@@ -0,0 +1,88 @@
+/**
+ * @file Symbol.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Symbol.hh"
+
+#include <deque>
+#include <mutex>
+
+#include "llvm/ADT/StringMap.h"
+
+namespace Craeft {
+
+namespace {
+
+/**
+ * @brief The global intern table.
+ */
+struct SymbolTable {
+    std::mutex lock;
+
+    /** @brief Maps each string to its entry. */
+    llvm::StringMap<const Symbol::Entry *> index;
+
+    /** @brief Storage for the entries; a deque, so they never move. */
+    std::deque<Symbol::Entry> entries;
+
+    const Symbol::Entry *intern(llvm::StringRef str) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto inserted = index.insert(std::make_pair(str, nullptr));
+        auto &slot = inserted.first->second;
+
+        if (inserted.second) {
+            entries.push_back(Symbol::Entry {
+                str.str(), (uint32_t)entries.size()
+            });
+            slot = &entries.back();
+        }
+
+        return slot;
+    }
+
+    uint32_t count(void) {
+        std::lock_guard<std::mutex> guard(lock);
+        return entries.size();
+    }
+};
+
+/* Constructed on first use, so Symbols may be created during static
+ * initialization. */
+SymbolTable &table(void) {
+    static SymbolTable result;
+    return result;
+}
+
+}
+
+Symbol::Symbol(void) {
+    static const Entry *empty = table().intern(llvm::StringRef());
+    entry = empty;
+}
+
+Symbol::Symbol(llvm::StringRef str): entry(table().intern(str)) {}
+
+uint32_t Symbol::count(void) {
+    return table().count();
+}
+
+}
@@ -0,0 +1,111 @@
+/**
+ * @file Target.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Target.hh"
+
+#include <memory>
+#include <mutex>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+
+namespace Craeft {
+
+void initialize_targets(void) {
+    // LLVM's target registration is not thread-safe.
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmParsers();
+        llvm::InitializeAllAsmPrinters();
+    });
+}
+
+/**
+ * @brief Get the host's features, in the same format as `TargetSpec`.
+ */
+static std::string host_features(void) {
+    llvm::StringMap<bool> host;
+    std::string result;
+
+    if (!llvm::sys::getHostCPUFeatures(host)) return result;
+
+    for (const auto &feature: host) {
+        if (!result.empty()) result += ",";
+        result += (feature.second ? "+" : "-") + feature.first().str();
+    }
+
+    return result;
+}
+
+/**
+ * @brief Check that the target knows the CPU.
+ *
+ * LLVM only warns about a CPU it doesn't know, and ignoring it can leave the
+ * subtarget without features it then aborts for lacking.
+ */
+static bool check_cpu(const llvm::Target &target, const std::string &triple,
+                      const std::string &cpu, std::string &error) {
+    // The default, which every target copes with.
+    if (cpu == "generic") return true;
+
+    std::unique_ptr<llvm::MCSubtargetInfo> info(
+            target.createMCSubtargetInfo(triple, "", ""));
+    if (!info || info->isCPUStringValid(cpu)) return true;
+
+    error = "unknown CPU '" + cpu + "' for target '" + triple + "'";
+    return false;
+}
+
+const llvm::Target *TargetSpec::resolve(std::string &error) {
+    initialize_targets();
+
+    llvm::Triple parsed(triple);
+    auto *result = llvm::TargetRegistry::lookupTarget(arch, parsed, error);
+    if (!result) return nullptr;
+
+    triple = parsed.str();
+    arch = "";
+
+    if (cpu == "native") {
+        cpu = llvm::sys::getHostCPUName().str();
+
+        // Later features override earlier ones.
+        auto host = host_features();
+        if (features.empty()) {
+            features = host;
+        } else if (!host.empty()) {
+            features = host + "," + features;
+        }
+    }
+
+    if (!check_cpu(*result, triple, cpu, error)) return nullptr;
+
+    return result;
+}
+
+}
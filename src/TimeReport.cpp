@@ -0,0 +1,338 @@
+/**
+ * @file TimeReport.cpp
+ */
+
+/* Craeft: a new systems programming language.
+ *
+ * Copyright (C) 2017 Ian Kuehne <ikuehne@caltech.edu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimeReport.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+
+#include <sys/resource.h>
+
+namespace Craeft {
+
+static std::atomic<TimeReport *> active_report(nullptr);
+
+/**
+ * @brief CPU time used by the whole process so far, in seconds.
+ */
+static double cpu_time(void) {
+    return (double)std::clock() / CLOCKS_PER_SEC;
+}
+
+/**
+ * @brief CPU time used by the calling thread so far, in seconds.
+ */
+static double thread_cpu_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief The peak resident set size of the process so far, in KiB.
+ */
+static long peak_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double seconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+TimeReport::TimeReport(void)
+    : wall_start(std::chrono::steady_clock::now()),
+      cpu_start(cpu_time()) {}
+
+TimeReport::~TimeReport(void) {
+    TimeReport *self = this;
+    active_report.compare_exchange_strong(self, nullptr);
+}
+
+void TimeReport::activate(void) {
+    owner = std::this_thread::get_id();
+    active_report = this;
+}
+
+void TimeReport::add(const std::string &counter, uint64_t n) {
+    auto *report = active_report.load();
+    if (!report) return;
+
+    std::lock_guard<std::mutex> guard(report->counts_lock);
+
+    for (auto &count: report->counts) {
+        if (count.first == counter) {
+            count.second += n;
+            return;
+        }
+    }
+
+    report->counts.push_back(std::make_pair(counter, n));
+}
+
+TimeReport::Scope::Scope(const char *phase, bool precise)
+    : report(nullptr), timeline(nullptr) {
+    auto *active = active_report.load(std::memory_order_relaxed);
+    if (!active) return;
+
+    report = active;
+    timeline = active->owner == std::this_thread::get_id()
+             ? &active->timeline : &thread_timeline();
+    timeline->enter(phase, precise);
+}
+
+TimeReport::Scope::~Scope(void) {
+    if (!report) return;
+
+    timeline->exit();
+
+    // Other threads hand their phases over once they are out of all of them,
+    // so that the thread timing the phase need not take a lock.
+    if (timeline != &report->timeline && timeline->stack.empty()) {
+        report->merge(*timeline);
+    }
+}
+
+TimeReport::Timeline &TimeReport::thread_timeline(void) {
+    thread_local Timeline result;
+    result.thread_cpu = true;
+    return result;
+}
+
+void TimeReport::add_phase(std::vector<Phase> &phases, const Phase &phase) {
+    auto existing = std::find_if(phases.begin(), phases.end(),
+            [&](const Phase &p) { return p.name == phase.name; });
+
+    if (existing == phases.end()) {
+        phases.push_back(phase);
+        return;
+    }
+
+    existing->first = std::min(existing->first, phase.first);
+    existing->wall += phase.wall;
+    existing->cpu += phase.cpu;
+    existing->peak_rss = std::max(existing->peak_rss, phase.peak_rss);
+}
+
+void TimeReport::merge(Timeline &other) {
+    std::lock_guard<std::mutex> guard(merged_lock);
+    for (const auto &phase: other.phases) add_phase(merged, phase);
+    other.phases.clear();
+}
+
+std::vector<TimeReport::Phase> TimeReport::all_phases(void) {
+    auto result = timeline.phases;
+
+    {
+        std::lock_guard<std::mutex> guard(merged_lock);
+        for (const auto &phase: merged) add_phase(result, phase);
+    }
+
+    std::stable_sort(result.begin(), result.end(),
+                     [](const Phase &l, const Phase &r) {
+                         return l.first < r.first;
+                     });
+    return result;
+}
+
+void TimeReport::Timeline::enter(const char *name, bool precise) {
+    auto now = std::chrono::steady_clock::now();
+
+    size_t idx = 0;
+    while (idx < phases.size() && phases[idx].name != name) ++idx;
+
+    if (idx == phases.size()) {
+        phases.push_back(Phase());
+        phases.back().name = name;
+        phases.back().first = now;
+    }
+
+    double cpu_now = precise ? (thread_cpu ? thread_cpu_time() : cpu_time())
+                             : 0;
+
+    // Stop charging the enclosing phase.  An imprecise phase doesn't read the
+    // CPU clock, so the enclosing phase is charged for its CPU time when it
+    // next does, less that of the nested phases.
+    if (!stack.empty()) {
+        auto &top = stack.back();
+        phases[top.phase].wall += seconds(now - top.wall_start);
+
+        if (precise) {
+            phases[top.phase].cpu += cpu_now - top.cpu_start - top.cpu_nested;
+            top.cpu_nested = 0;
+        }
+    }
+
+    stack.push_back(Frame { idx, precise, now, cpu_now, 0 });
+}
+
+void TimeReport::Timeline::exit(void) {
+    auto frame = stack.back();
+    stack.pop_back();
+
+    auto &phase = phases[frame.phase];
+    auto now = std::chrono::steady_clock::now();
+    double wall = seconds(now - frame.wall_start);
+    double cpu_now = 0;
+
+    phase.wall += wall;
+
+    if (frame.precise) {
+        cpu_now = thread_cpu ? thread_cpu_time() : cpu_time();
+        phase.cpu += cpu_now - frame.cpu_start - frame.cpu_nested;
+        phase.peak_rss = std::max(phase.peak_rss, peak_rss());
+    } else {
+        phase.cpu += wall;
+    }
+
+    // Resume charging the enclosing phase.
+    if (!stack.empty()) {
+        auto &top = stack.back();
+        top.wall_start = now;
+
+        if (frame.precise) {
+            top.cpu_start = cpu_now;
+        } else {
+            top.cpu_nested += wall;
+        }
+    }
+}
+
+void TimeReport::print_text(std::ostream &out) {
+    double total_wall = seconds(std::chrono::steady_clock::now()
+                                - wall_start);
+    double total_cpu = cpu_time() - cpu_start;
+    double other_wall = total_wall;
+    double other_cpu = total_cpu;
+
+    auto rule = std::string(72, '=');
+
+    out << rule << "\n"
+        << "  Craeft compile-time report\n"
+        << rule << "\n"
+        << std::left << std::setw(32) << "  Phase"
+        << std::right << std::setw(12) << "Wall (s)"
+        << std::setw(12) << "CPU (s)"
+        << std::setw(16) << "Peak RSS (KiB)" << "\n";
+
+    auto row = [&](const std::string &name, double wall, double cpu,
+                   long rss) {
+        out << "  " << std::left << std::setw(30) << name << std::right
+            << std::fixed << std::setprecision(4)
+            << std::setw(12) << wall << std::setw(12) << cpu
+            << std::setw(16);
+        if (rss) {
+            out << rss;
+        } else {
+            out << "-";
+        }
+        out << "\n";
+    };
+
+    for (const auto &phase: all_phases()) {
+        row(phase.name, phase.wall, phase.cpu, phase.peak_rss);
+        other_wall -= phase.wall;
+        other_cpu -= phase.cpu;
+    }
+
+    row("other", std::max(0.0, other_wall), std::max(0.0, other_cpu), 0);
+    row("total", total_wall, total_cpu, peak_rss());
+
+    std::lock_guard<std::mutex> guard(counts_lock);
+
+    if (!counts.empty()) {
+        out << "\n" << std::left << std::setw(32) << "  Count" << "\n";
+
+        for (const auto &count: counts) {
+            out << "  " << std::left << std::setw(30) << count.first
+                << std::right << std::setw(12) << count.second << "\n";
+        }
+    }
+
+    out << rule << std::endl;
+}
+
+/**
+ * @brief Write a string as a JSON string literal.
+ */
+static void print_json_string(std::ostream &out, const std::string &str) {
+    out << '"';
+
+    for (char c: str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << (int)c << std::dec << std::setfill(' ');
+        } else {
+            out << c;
+        }
+    }
+
+    out << '"';
+}
+
+void TimeReport::print_json(std::ostream &out) {
+    double total_wall = seconds(std::chrono::steady_clock::now()
+                                - wall_start);
+    double total_cpu = cpu_time() - cpu_start;
+
+    auto phases = all_phases();
+
+    out << std::setprecision(6) << "{\"phases\": [";
+
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const auto &phase = phases[i];
+
+        out << (i ? ", " : "") << "{\"name\": ";
+        print_json_string(out, phase.name);
+        out << ", \"wall\": " << phase.wall
+            << ", \"cpu\": " << phase.cpu
+            << ", \"peak_rss_kib\": ";
+        if (phase.peak_rss) {
+            out << phase.peak_rss;
+        } else {
+            out << "null";
+        }
+        out << "}";
+    }
+
+    out << "], \"total\": {\"wall\": " << total_wall
+        << ", \"cpu\": " << total_cpu
+        << ", \"peak_rss_kib\": " << peak_rss() << "}, \"counts\": {";
+
+    std::lock_guard<std::mutex> guard(counts_lock);
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+        out << (i ? ", " : "");
+        print_json_string(out, counts[i].first);
+        out << ": " << counts[i].second;
+    }
+
+    out << "}}" << std::endl;
+}
+
+}
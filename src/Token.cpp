@@ -26,6 +26,8 @@
 
 #include <sstream>
 
+#include "llvm/ADT/StringSwitch.h"
+
 namespace {
 
 template<typename T>
@@ -43,56 +45,157 @@ namespace Craeft {
 
 namespace Tok {
 
-std::string TypeName::repr(void) const {
-    return name;
+Op classify_op(llvm::StringRef spelling) {
+    return llvm::StringSwitch<Op>(spelling)
+        .Case("=", Op::Assign)
+        .Case("||", Op::Or)
+        .Case("&&", Op::And)
+        .Case("|", Op::BitOr)
+        .Case("^", Op::BitXor)
+        .Case("&", Op::BitAnd)
+        .Case("==", Op::Eq)
+        .Case("!=", Op::Ne)
+        .Case("<", Op::Lt)
+        .Case("<=", Op::Le)
+        .Case(">", Op::Gt)
+        .Case(">=", Op::Ge)
+        .Case("<<", Op::Shl)
+        .Case(">>", Op::Shr)
+        .Case("+", Op::Add)
+        .Case("-", Op::Sub)
+        .Case("*", Op::Mul)
+        .Case("/", Op::Div)
+        .Case("%", Op::Rem)
+        .Case(".", Op::Dot)
+        .Case("->", Op::Arrow)
+        .Case("@", Op::At)
+        .Case("<:", Op::OpenGeneric)
+        .Case(":>", Op::CloseGeneric)
+        .Default(Op::Other);
 }
 
-#define TOK_EQUALS(X, Y, BODY)\
-    bool X::operator==(const Token& _TOK_EQUALS_OTHER) const {\
-        if (auto *Y = llvm::dyn_cast<X>(&_TOK_EQUALS_OTHER)) {\
-            return BODY;\
-        }\
-        return false;\
+const char *spelling(Op op) {
+    switch (op) {
+        case Op::Assign: return "=";
+        case Op::Or: return "||";
+        case Op::And: return "&&";
+        case Op::BitOr: return "|";
+        case Op::BitXor: return "^";
+        case Op::BitAnd: return "&";
+        case Op::Eq: return "==";
+        case Op::Ne: return "!=";
+        case Op::Lt: return "<";
+        case Op::Le: return "<=";
+        case Op::Gt: return ">";
+        case Op::Ge: return ">=";
+        case Op::Shl: return "<<";
+        case Op::Shr: return ">>";
+        case Op::Add: return "+";
+        case Op::Sub: return "-";
+        case Op::Mul: return "*";
+        case Op::Div: return "/";
+        case Op::Rem: return "%";
+        case Op::Dot: return ".";
+        case Op::Arrow: return "->";
+        case Op::At: return "@";
+        case Op::OpenGeneric: return "<:";
+        case Op::CloseGeneric: return ":>";
+        case Op::Other: break;
     }
 
-TOK_EQUALS(TypeName, lhs, name == lhs->name);
-
-std::string Identifier::repr(void) const {
-    return name;
-}
-
-TOK_EQUALS(Identifier, lhs, name == lhs->name);
-
-std::string IntLiteral::repr(void) const {
-    return to_string(value);
-}
-
-TOK_EQUALS(IntLiteral, lhs, value == lhs->value);
-
-std::string UIntLiteral::repr(void) const {
-    return to_string(value);
+    return "[UNKNOWN OPERATOR]";
 }
 
-TOK_EQUALS(UIntLiteral, lhs, value == lhs->value);
-
-std::string FloatLiteral::repr(void) const {
-    return to_string(value);
-}
-
-TOK_EQUALS(FloatLiteral, lhs, value == lhs->value);
-
-std::string StringLiteral::repr(void) const {
-    return value;
+bool Token::operator==(const Token &other) const {
+    if (kind != other.kind) return false;
+
+    switch (kind) {
+        case TypeName:
+        case Identifier:
+            return name == other.name;
+        case Operator:
+            return op == other.op && (op != Op::Other || name == other.name);
+        case IntLiteral:
+            return int_value == other.int_value;
+        case UIntLiteral:
+            return uint_value == other.uint_value;
+        case FloatLiteral:
+            return float_value == other.float_value;
+        case StringLiteral:
+            return text == other.text;
+        default:
+            return true;
+    }
 }
 
-TOK_EQUALS(StringLiteral, lhs, value == lhs->value);
+std::string Token::repr(void) const {
+    switch (kind) {
+        case TypeName:
+        case Identifier:
+            return name.str();
+        case Operator:
+            return op == Op::Other ? name.str() : spelling(op);
+        case IntLiteral:
+            return to_string(int_value);
+        case UIntLiteral:
+            return to_string(uint_value);
+        case FloatLiteral:
+            return to_string(float_value);
+        case StringLiteral:
+            return text.str();
+        case OpenParen:
+            return "(";
+        case CloseParen:
+            return ")";
+        case OpenBrace:
+            return "{";
+        case CloseBrace:
+            return "}";
+        case OpenBracket:
+            return "[";
+        case CloseBracket:
+            return "]";
+        case Comma:
+            return ",";
+        case Semicolon:
+            return ";";
+        case Fn:
+            return "fn";
+        case Struct:
+            return "struct";
+        case Type:
+            return "type";
+        case Return:
+            return "return";
+        case If:
+            return "if";
+        case Else:
+            return "else";
+        case While:
+            return "while";
+        case For:
+            return "for";
+        case Restrict:
+            return "restrict";
+        case Const:
+            return "const";
+        case Async:
+            return "async";
+        case Await:
+            return "await";
+        case ThreadLocal:
+            return "thread_local";
+        case Import:
+            return "import";
+        case Become:
+            return "become";
+        case InvalidToken:
+            break;
+    }
 
-std::string Operator::repr(void) const {
-    return op;
+    return "[INVALID]";
 }
 
-TOK_EQUALS(Operator, lhs, op == lhs->op);
-
 }
 
 }
@@ -1,15 +1,59 @@
+#include <utility>
+
 #include "Translator.hh"
 
 #include "TranslatorImpl.hh"
 
 namespace Craeft {
 
+/**
+ * @brief The fast-math flags, by name.
+ */
+static const std::pair<const char *, bool FastMath::*> FAST_MATH_FLAGS[] = {
+    { "reassoc", &FastMath::reassoc },
+    { "contract", &FastMath::contract },
+    { "nnan", &FastMath::nnan },
+    { "ninf", &FastMath::ninf },
+    { "nsz", &FastMath::nsz },
+    { "arcp", &FastMath::arcp },
+    { "afn", &FastMath::afn }
+};
+
+FastMath FastMath::all(void) {
+    FastMath result;
+    for (const auto &flag: FAST_MATH_FLAGS) result.*flag.second = true;
+    return result;
+}
+
+bool FastMath::set(const std::string &name, bool value) {
+    for (const auto &flag: FAST_MATH_FLAGS) {
+        if (name == flag.first) {
+            this->*flag.second = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string FastMath::str(void) const {
+    std::string result;
+    for (const auto &flag: FAST_MATH_FLAGS) {
+        if (!(this->*flag.second)) continue;
+        if (!result.empty()) result += ",";
+        result += flag.first;
+    }
+    return result;
+}
+
 Translator::Translator(std::string module_name, std::string filename,
-                       std::string triple)
-    : pimpl(new TranslatorImpl(module_name, filename, triple)) {}
+                       SourceManager &sources, TargetSpec target)
+    : pimpl(new TranslatorImpl(module_name, filename, sources, target)) {}
 
 Translator::~Translator() {}
 
+Translator::Translator(Translator &&) = default;
+Translator &Translator::operator=(Translator &&) = default;
+
 Value Translator::cast(Value val, const Type &t, SourcePos pos) {
     return pimpl->cast(val, t, pos);
 }
@@ -46,16 +90,19 @@ Value Translator::bit_not(Value val, SourcePos pos) {
     return pimpl->bit_not(val, pos);
 }
 
-Value Translator::add(Value lhs, Value rhs, SourcePos pos) {
-    return pimpl->add(lhs, rhs, pos);
+Value Translator::add(Value lhs, Value rhs, SourcePos pos,
+                       bool wrapping) {
+    return pimpl->add(lhs, rhs, pos, wrapping);
 }
 
-Value Translator::sub(Value lhs, Value rhs, SourcePos pos) {
-    return pimpl->sub(lhs, rhs, pos);
+Value Translator::sub(Value lhs, Value rhs, SourcePos pos,
+                       bool wrapping) {
+    return pimpl->sub(lhs, rhs, pos, wrapping);
 }
 
-Value Translator::mul(Value lhs, Value rhs, SourcePos pos) {
-    return pimpl->mul(lhs, rhs, pos);
+Value Translator::mul(Value lhs, Value rhs, SourcePos pos,
+                       bool wrapping) {
+    return pimpl->mul(lhs, rhs, pos, wrapping);
 }
 
 Value Translator::div(Value lhs, Value rhs, SourcePos pos) {
@@ -105,13 +152,121 @@ Value Translator::field_access(Value lhs, std::string field, SourcePos pos) {
 Value Translator::field_address(Value ptr, std::string field, SourcePos pos) {
     return pimpl->field_address(ptr, field, pos);
 }
+Value Translator::element_access(Value array, Value index, SourcePos pos) {
+    return pimpl->element_access(array, index, pos);
+}
+Value Translator::element_address(Value ptr, Value index, SourcePos pos) {
+    return pimpl->element_address(ptr, index, pos);
+}
+
+bool Translator::is_function(Symbol name) const {
+    return pimpl->is_function(name);
+}
+
+Value Translator::atomic_load(Value pointer, AtomicOrdering ordering,
+                              SourcePos pos) {
+    return pimpl->atomic_load(pointer, ordering, pos);
+}
+
+Value Translator::atomic_store(Value pointer, Value val,
+                               AtomicOrdering ordering, SourcePos pos) {
+    return pimpl->atomic_store(pointer, val, ordering, pos);
+}
+
+Value Translator::atomic_rmw(AtomicOp op, Value pointer, Value val,
+                             AtomicOrdering ordering, SourcePos pos) {
+    return pimpl->atomic_rmw(op, pointer, val, ordering, pos);
+}
 
-Value Translator::call(std::string func, std::vector<Value> &args,
+Value Translator::atomic_cmpxchg(Value pointer, Value expected,
+                                 Value desired, bool weak,
+                                 AtomicOrdering ordering, SourcePos pos) {
+    return pimpl->atomic_cmpxchg(pointer, expected, desired, weak, ordering,
+                                 pos);
+}
+
+Value Translator::atomic_fence(AtomicOrdering ordering, SourcePos pos) {
+    return pimpl->atomic_fence(ordering, pos);
+}
+
+Value Translator::await_(Symbol func, std::vector<Value> &args,
+                         SourcePos pos) {
+    return pimpl->await_(func, args, pos);
+}
+
+Value Translator::async_suspend(SourcePos pos) {
+    return pimpl->async_suspend(pos);
+}
+
+Value Translator::async_resume(Value handle, SourcePos pos) {
+    return pimpl->async_resume(handle, pos);
+}
+
+Value Translator::async_done(Value handle, SourcePos pos) {
+    return pimpl->async_done(handle, pos);
+}
+
+Value Translator::async_destroy(Value handle, SourcePos pos) {
+    return pimpl->async_destroy(handle, pos);
+}
+
+Value Translator::splat(const Type &vec, Value val, SourcePos pos) {
+    return pimpl->splat(vec, val, pos);
+}
+
+Value Translator::size_of(const Type &t, SourcePos pos) {
+    return pimpl->size_of(t, pos);
+}
+
+Value Translator::align_of(const Type &t, SourcePos pos) {
+    return pimpl->align_of(t, pos);
+}
+
+Value Translator::allocate(const Type &t, SourcePos pos) {
+    return pimpl->allocate(t, pos);
+}
+
+Value Translator::deallocate(const Type &t, Value pointer, SourcePos pos) {
+    return pimpl->deallocate(t, pointer, pos);
+}
+
+Value Translator::extract(Value vec, Value index, SourcePos pos) {
+    return pimpl->extract(vec, index, pos);
+}
+
+Value Translator::insert(Value vec, Value index, Value val, SourcePos pos) {
+    return pimpl->insert(vec, index, val, pos);
+}
+
+Value Translator::shuffle(Value lhs, Value rhs,
+                          const std::vector<Value> &indices, SourcePos pos) {
+    return pimpl->shuffle(lhs, rhs, indices, pos);
+}
+
+Value Translator::reduce(Reduction op, Value vec, SourcePos pos) {
+    return pimpl->reduce(op, vec, pos);
+}
+
+Value Translator::intrinsic(Intrinsic op, const std::vector<Value> &args,
+                            SourcePos pos) {
+    return pimpl->intrinsic(op, args, pos);
+}
+
+Value Translator::expect(Value cond, bool likely, SourcePos pos) {
+    return pimpl->expect(cond, likely, pos);
+}
+
+Value Translator::prefetch(Value pointer, bool write,
+                           boost::optional<Value> locality, SourcePos pos) {
+    return pimpl->prefetch(pointer, write, locality, pos);
+}
+
+Value Translator::call(Symbol func, std::vector<Value> &args,
                        SourcePos pos) {
     return pimpl->call(func, args, pos);
 }
 
-Value Translator::call(std::string func, std::vector<Type> &templ_args,
+Value Translator::call(Symbol func, std::vector<Type> &templ_args,
                        std::vector<Value> &v_args, SourcePos pos) {
     return pimpl->call(func, templ_args, v_args, pos);
 }
@@ -120,11 +275,15 @@ Value Translator::string_literal(const std::string &str) {
     return pimpl->string_literal(str);
 }
 
-Variable Translator::declare(const std::string &name, const Type &t) {
+Value Translator::zero(const Type &t) {
+    return pimpl->zero(t);
+}
+
+Variable Translator::declare(Symbol name, const Type &t) {
     return pimpl->declare(name, t);
 }
 
-void Translator::assign(const std::string &varname, Value val,
+void Translator::assign(Symbol varname, Value val,
                         SourcePos pos) {
     return pimpl->assign(varname, val, pos);
 }
@@ -137,13 +296,30 @@ void Translator::return_(SourcePos pos) {
     return pimpl->return_(pos);
 }
 
-Value Translator::get_identifier_addr(std::string ident, SourcePos pos) {
+void Translator::tail_return(Value call, SourcePos pos) {
+    return pimpl->tail_return(call, pos);
+}
+
+Value Translator::get_identifier_addr(Symbol ident, SourcePos pos) {
     return pimpl->get_identifier_addr(ident, pos);
 }
-Value Translator::get_identifier_value(std::string ident, SourcePos pos) {
+Value Translator::get_identifier_value(Symbol ident, SourcePos pos) {
     return pimpl->get_identifier_value(ident, pos);
 }
-Type Translator::lookup_type(std::string tname, SourcePos pos) {
+void Translator::define_constant(Symbol name, const Type &t, Value val,
+                                 SourcePos pos) {
+    pimpl->define_constant(name, t, val, pos);
+}
+void Translator::define_global(Symbol name, const Type &t,
+                               boost::optional<Value> init,
+                               bool is_thread_local, bool define,
+                               SourcePos pos) {
+    pimpl->define_global(name, t, init, is_thread_local, define, pos);
+}
+Value Translator::get_constant(Symbol ident, SourcePos pos) {
+    return pimpl->get_constant(ident, pos);
+}
+Type Translator::lookup_type(Symbol tname, SourcePos pos) {
     return pimpl->lookup_type(tname, pos);
 }
 void Translator::push_scope(void) {
@@ -153,26 +329,37 @@ void Translator::pop_scope(void) {
     pimpl->pop_scope();
 }
 
-void Translator::bind_type(std::string name, Type t) {
+void Translator::bind_type(Symbol name, Type t) {
     pimpl->bind_type(name, t);
 }
 
-Type Translator::specialize_template(std::string template_name,
+Type Translator::specialize_template(Symbol template_name,
                                      const std::vector<Type> &args,
                                      SourcePos pos) {
     return pimpl->specialize_template(template_name, args, pos);
 }
-void Translator::register_template(std::string name,
+void Translator::register_template(Symbol name,
                                    std::shared_ptr<AST::FunctionDefinition> d,
-                                   std::vector<std::string> args,
+                                   std::vector<Symbol> args,
                                    TemplateFunction func) {
     pimpl->register_template(name, d, args, func);
 }
-void Translator::register_template(TemplateStruct s, std::string name) {
+void Translator::register_template(TemplateStruct s, Symbol name) {
     pimpl->register_template(s, name);
 }
+void Translator::register_const_function(
+        std::shared_ptr<AST::FunctionDefinition> fd) {
+    pimpl->register_const_function(fd);
+}
+std::shared_ptr<AST::FunctionDefinition> Translator::lookup_const_function(
+        Symbol name) const {
+    return pimpl->lookup_const_function(name);
+}
+void Translator::set_resolver(std::function<bool(Symbol)> resolver) {
+    pimpl->set_resolver(std::move(resolver));
+}
 Struct<TemplateType> Translator::respecialize_template(
-        std::string template_name, const std::vector<TemplateType> &args,
+        Symbol template_name, const std::vector<TemplateType> &args,
         SourcePos pos) {
     return pimpl->respecialize_template(template_name, args, pos);
 }
@@ -187,13 +374,39 @@ void Translator::end_ifthenelse(IfThenElse structure) {
     pimpl->end_ifthenelse(std::move(structure));
 }
 
-void Translator::create_function_prototype(Function<> f, std::string name) {
-    pimpl->create_function_prototype(f, name);
+Loop Translator::create_loop(const LoopHints &hints) {
+    return pimpl->create_loop(hints);
+}
+
+void Translator::start_loop_body(Loop &loop, Value cond, SourcePos pos) {
+    pimpl->start_loop_body(loop, cond, pos);
+}
+
+void Translator::start_loop_step(Loop &loop) {
+    pimpl->start_loop_step(loop);
+}
+
+void Translator::end_loop(Loop loop) {
+    pimpl->end_loop(std::move(loop));
+}
+
+void Translator::create_function_prototype(Function<> f, std::string name,
+                                           SourcePos pos,
+                                           const FunctionAttributes &attrs) {
+    pimpl->create_function_prototype(f, name, pos, attrs);
 }
 void Translator::create_and_start_function(Function<> f,
-                                           std::vector<std::string> args,
-                                           std::string name) {
-    pimpl->create_and_start_function(f, args, name);
+                                           std::vector<Symbol> args,
+                                           std::string name,
+                                           SourcePos pos,
+                                           const FunctionAttributes &attrs) {
+    pimpl->create_and_start_function(f, args, name, pos, attrs);
+}
+
+std::vector<std::pair<std::string, FunctionAttributes> >
+Translator::create_dispatcher(Function<> f, std::string name, SourcePos pos,
+                              const FunctionAttributes &attrs) {
+    return pimpl->create_dispatcher(f, name, pos, attrs);
 }
 
 void Translator::create_struct(Struct<> t) {
@@ -208,8 +421,8 @@ Translator::end_function(void) {
 void Translator::validate(std::ostream &out) {
     pimpl->validate(out);
 }
-void Translator::optimize(int opt_level) {
-    pimpl->optimize(opt_level);
+void Translator::optimize(int opt_level, int size_level, OptPhase phase) {
+    pimpl->optimize(opt_level, size_level, phase);
 }
 void Translator::emit_ir(std::ostream &fd) {
     pimpl->emit_ir(fd);
@@ -220,6 +433,88 @@ void Translator::emit_obj(int fd) {
 void Translator::emit_asm(int fd) {
     pimpl->emit_asm(fd);
 }
+ModuleCounts Translator::counts(void) {
+    return pimpl->counts();
+}
+
+void Translator::emit_bitcode(std::ostream &out) {
+    pimpl->emit_bitcode(out);
+}
+void Translator::emit_bc(int fd) {
+    pimpl->emit_bc(fd);
+}
+void Translator::emit(const std::vector<Artifact> &artifacts,
+                      const ArtifactSink &sink) {
+    pimpl->emit(artifacts, sink);
+}
+void Translator::link_bitcode(const std::vector<std::string> &bitcode) {
+    pimpl->link_bitcode(bitcode);
+}
+std::string Translator::extract_bitcode(
+        const std::string &function, const std::vector<std::string> &declare) {
+    return pimpl->extract_bitcode(function, declare);
+}
+std::string Translator::extract_optimized_bitcode(
+        const std::string &function, const std::vector<std::string> &declare,
+        int opt_level, int size_level, OptPhase phase) {
+    return pimpl->extract_optimized_bitcode(function, declare, opt_level,
+                                            size_level, phase);
+}
+std::vector<std::string> Translator::callees(const std::string &function) {
+    return pimpl->callees(function);
+}
+int Translator::run(const std::string &entry,
+                    const std::vector<std::string> &args) {
+    return pimpl->run(entry, args);
+}
+std::vector<std::string> Translator::undefined_functions(void) {
+    return pimpl->undefined_functions();
+}
+
+void Translator::internalize(const std::vector<std::string> &names) {
+    pimpl->internalize(names);
+}
+
+void Translator::set_external_instances(
+        std::function<bool(const std::string &)> is_external) {
+    pimpl->external_instances = is_external;
+}
+
+void Translator::set_profile(const ProfileOptions &profile) {
+    pimpl->profile = profile;
+}
+
+void Translator::set_debug_level(DebugLevel level) {
+    pimpl->set_debug_level(level);
+}
+
+void Translator::set_fast_math(const FastMath &flags) {
+    pimpl->set_fast_math(flags);
+}
+
+void Translator::set_wrapping_overflow(void) {
+    pimpl->set_wrapping_overflow();
+}
+
+void Translator::set_remarks(const std::string &passes) {
+    pimpl->set_remarks(passes);
+}
+
+void Translator::set_fast_backend(void) {
+    pimpl->set_fast_backend();
+}
+
+void Translator::set_backend_threads(unsigned n) {
+    pimpl->set_backend_threads(n);
+}
+
+std::string Translator::take_remarks(void) {
+    return pimpl->take_remarks();
+}
+
+void Translator::set_location(SourcePos pos) {
+    pimpl->set_location(pos);
+}
 
 llvm::LLVMContext &Translator::get_ctx(void) {
     return pimpl->get_ctx();
@@ -20,19 +20,59 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <functional>
+#include <thread>
 
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/PassTimingInfo.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Linker/IRMover.h"
+#include "llvm/MC/MCAsmBackend.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCObjectWriter.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
+#include "llvm/MC/MCParser/MCTargetAsmParser.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/X86TargetParser.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/raw_os_ostream.h"
-#include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Coroutines/CoroCleanup.h"
+#include "llvm/Transforms/Coroutines/CoroEarly.h"
+#include "llvm/Transforms/Coroutines/CoroElide.h"
+#include "llvm/Transforms/Coroutines/CoroSplit.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
-
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "JIT.hh"
+#include "SourceManager.hh"
 #include "TranslatorImpl.hh"
 
 using namespace std::placeholders;
@@ -56,41 +96,148 @@ IfThenElse::IfThenElse(IfThenElse &&other)
 
 IfThenElse::~IfThenElse(void) {}
 
+struct LoopImpl {
+    Block cond_b;
+    Block body_b;
+    Block exit_b;
+    /* Only created if the loop has a step. */
+    std::unique_ptr<Block> step_b;
+    LoopHints hints;
+
+    LoopImpl(Block cond_b, Block body_b, Block exit_b, LoopHints hints)
+        : cond_b(cond_b), body_b(body_b), exit_b(exit_b), hints(hints) {}
+};
+
+Loop::Loop(std::unique_ptr<LoopImpl> pimpl): pimpl(std::move(pimpl)) {}
+
+Loop::Loop(Loop &&other): pimpl(std::move(other.pimpl)) {}
+
+Loop::~Loop(void) {}
+
 TranslatorImpl::TranslatorImpl(std::string module_name, std::string filename,
-                               std::string triple)
-    : rettype(NULL),
+                               SourceManager &sources,
+                               TargetSpec target_spec)
+    : rettype(),
       specializations(),
       fname(filename),
+      sources(sources),
+      owned_context(new llvm::LLVMContext()),
+      context(*owned_context),
       builder(context),
       module(new llvm::Module(module_name, context)),
-      env(context) {
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmParsers();
-    llvm::InitializeAllAsmPrinters();
-
+      types(*module),
+      abi(*module, types),
+      env(context),
+      target_spec(target_spec) {
     std::string error;
-    auto target_triple = llvm::Triple(triple);
-    /* TODO: Allow target-specific information. */
-    auto llvm_target =
-        llvm::TargetRegistry::lookupTarget("", target_triple, error);
+    auto llvm_target = this->target_spec.resolve(error);
 
-    /* TODO: fix this to properly handle the error. */
     if (!llvm_target) {
-        llvm::errs() << error;
+        auto pos = sources.start_of(fname);
+        throw Error("internal error", error, pos);
     }
 
-    /* TODO: give a more specific CPU. */
-    auto cpu = "generic";
-    auto features = "";
+    const auto &spec = this->target_spec;
     llvm::TargetOptions options;
     auto reloc_model = llvm::Reloc::Model();
 
-    target = llvm_target->createTargetMachine(triple, cpu, features,
+    target = llvm_target->createTargetMachine(spec.triple, spec.cpu,
+                                              spec.features,
                                               options, reloc_model);
     module->setDataLayout(target->createDataLayout());
-    module->setTargetTriple(triple);
+    module->setTargetTriple(spec.triple);
+}
+
+void TranslatorImpl::set_target_attributes(llvm::Function *f,
+                                           const FunctionAttributes &attrs) {
+    // Let the IR-level optimizations (in particular, the vectorizers) use
+    // everything the target CPU offers.
+    f->addFnAttr("target-cpu", target_spec.cpu);
+
+    // Later features override earlier ones.
+    auto features = target_spec.features;
+    if (!attrs.target_features.empty()) {
+        if (!features.empty()) features += ",";
+        features += attrs.target_features;
+    }
+    if (!features.empty()) f->addFnAttr("target-features", features);
+}
+
+void TranslatorImpl::make_mergeable(llvm::Function *f) {
+    f->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+    if (llvm::Triple(module->getTargetTriple()).supportsCOMDAT()) {
+        f->setComdat(module->getOrInsertComdat(f->getName()));
+    }
+}
+
+void TranslatorImpl::set_attributes(llvm::Function *f,
+                                    const FunctionAttributes &attrs) {
+    if (attrs.inlining == FunctionAttributes::Always) {
+        f->addFnAttr(llvm::Attribute::AlwaysInline);
+    } else if (attrs.inlining == FunctionAttributes::Never) {
+        f->addFnAttr(llvm::Attribute::NoInline);
+    }
+
+    if (attrs.hot) f->addFnAttr(llvm::Attribute::Hot);
+    if (attrs.cold) f->addFnAttr(llvm::Attribute::Cold);
+    if (attrs.readnone) f->addFnAttr(llvm::Attribute::ReadNone);
+    if (attrs.readonly) f->addFnAttr(llvm::Attribute::ReadOnly);
+    if (attrs.noreturn) f->addFnAttr(llvm::Attribute::NoReturn);
+
+    auto convention = attrs.convention == FunctionAttributes::Fast
+                    ? llvm::CallingConv::Fast
+                    : attrs.convention == FunctionAttributes::Cold
+                    ? llvm::CallingConv::Cold
+                    : llvm::CallingConv::C;
+    f->setCallingConv(convention);
+
+    // Calls made before the definition follow the declaration.
+    for (auto *user: f->users()) {
+        auto *call = llvm::dyn_cast<llvm::CallBase>(user);
+        if (call && call->getCalledFunction() == f) {
+            call->setCallingConv(convention);
+        }
+    }
+}
+
+/**
+ * @brief Get the LLVM fast-math flags corresponding to the Craeft ones.
+ */
+static llvm::FastMathFlags llvm_fast_math(const FastMath &flags) {
+    llvm::FastMathFlags result;
+    result.setAllowReassoc(flags.reassoc);
+    result.setAllowContract(flags.contract);
+    result.setNoNaNs(flags.nnan);
+    result.setNoInfs(flags.ninf);
+    result.setNoSignedZeros(flags.nsz);
+    result.setAllowReciprocal(flags.arcp);
+    result.setApproxFunc(flags.afn);
+    return result;
+}
+
+/**
+ * @brief Tell the backend what a function's floating-point arithmetic may
+ *        assume, as clang does.  The optimizer goes by the flags on each
+ *        instruction instead.
+ */
+static void set_fast_math_attributes(llvm::Function *f,
+                                     const FastMath &flags) {
+    auto set = [&](const char *name, bool value) {
+        if (value) f->addFnAttr(name, "true");
+    };
+
+    set("no-nans-fp-math", flags.nnan);
+    set("no-infs-fp-math", flags.ninf);
+    set("no-signed-zeros-fp-math", flags.nsz);
+    set("approx-func-fp-math", flags.afn);
+    set("unsafe-fp-math", flags.reassoc && flags.nsz && flags.arcp
+                       && flags.afn);
+}
+
+void TranslatorImpl::mark_nounwind(void) {
+    // Craeft has no exceptions, so, as in C, nothing unwinds through its
+    // code.
+    for (auto &f: *module) f.addFnAttr(llvm::Attribute::NoUnwind);
 }
 
 enum LlvmCastType {
@@ -178,18 +325,26 @@ struct CastVisitor: public boost::static_visitor<LlvmCastType> {
                             const Pointer<> &) const {
         return PtrToPtr;
     }
+
+    /* Vectors are cast element by element, with the same instructions. */
+    LlvmCastType operator()(const Vector<> &l, const Vector<> &r) const {
+        if (l.get_lanes() != r.get_lanes()) return Illegal;
+        return boost::apply_visitor(*this, l.get_element()->variant(),
+                                    r.get_element()->variant());
+    }
 };
 
 Value TranslatorImpl::cast(Value val, const Type &dest_ty, SourcePos pos) {
     Type source_ty = val.get_type();
-    llvm::Value *inst;
+    llvm::Value *inst = nullptr;
 
-    llvm::Type *dt = to_llvm_type(dest_ty, *module);
+    llvm::Type *dt = types.get(dest_ty);
     llvm::Value *v = val.to_llvm();
 
     if (source_ty == dest_ty) return val;
 
-    switch (boost::apply_visitor(CastVisitor(), source_ty, dest_ty)) {
+    switch (boost::apply_visitor(CastVisitor(), source_ty.variant(),
+                                 dest_ty.variant())) {
     case SWidth:
         inst = builder.CreateSExtOrTrunc(v, dt);
         break;
@@ -228,12 +383,19 @@ Value TranslatorImpl::cast(Value val, const Type &dest_ty, SourcePos pos) {
         throw Error("type error", "cannot cast types", pos);
     }
 
-    return Value(inst, dest_ty);
+    Value result(inst, dest_ty);
+
+    // A cast pointer is based on the same `restrict` pointer as the original.
+    if (is_type<Pointer<> >(dest_ty)) {
+        result.set_alias_scope(val.get_alias_scope());
+    }
+
+    return result;
 }
 
 Value TranslatorImpl::add_load(Value pointer, SourcePos pos) {
     auto ty = pointer.get_type();
-    auto *pointer_ty = boost::get<Pointer<> >(&ty);
+    auto *pointer_ty = boost::get<Pointer<> >(&ty.variant());
     // Make sure value is actually a pointer.
     if (!pointer_ty) {
         throw Error("type error", "cannot dereference non-pointer value",
@@ -241,9 +403,29 @@ Value TranslatorImpl::add_load(Value pointer, SourcePos pos) {
     }
 
     auto *pointed = pointer_ty->get_pointed();
-    auto *inst = builder.CreateLoad(pointer.to_llvm());
+    auto *inst = builder.CreateLoad(types.get(*pointed),
+                                    pointer.to_llvm());
+    inst->setAlignment(llvm::Align(pointee_align(pointer)));
+    note_access(inst, pointer);
+
+    Value result(inst, *pointed);
+
+    // Pointers loaded from `restrict` variables are based on them.
+    auto scope = restrict_variables.find(pointer.to_llvm());
+    if (scope != restrict_variables.end()) {
+        result.set_alias_scope(scope->second);
+    }
+
+    return result;
+}
 
-    return Value(inst, *pointed);
+/**
+ * @brief Get the global a compile-time constant is stored in, or null if the
+ *        given address is not one.
+ */
+static llvm::GlobalVariable *constant_global(const Value &addr) {
+    auto *global = llvm::dyn_cast<llvm::GlobalVariable>(addr.to_llvm());
+    return global && global->isConstant() ? global : nullptr;
 }
 
 void TranslatorImpl::add_store(Value pointer, Value new_val, SourcePos pos) {
@@ -253,39 +435,227 @@ void TranslatorImpl::add_store(Value pointer, Value new_val, SourcePos pos) {
                     pos);
     }
 
-    builder.CreateStore(new_val.to_llvm(), pointer.to_llvm());
+    if (constant_global(pointer)) {
+        throw Error("type error", "cannot assign to constant", pos);
+    }
+
+    auto *inst = store_value(new_val, pointer.to_llvm(),
+                             llvm::Align(pointee_align(pointer)));
+    // A copy also reads memory, which may be based on another `restrict`
+    // pointer.
+    if (!llvm::isa<llvm::MemCpyInst>(inst)) note_access(inst, pointer);
 }
 
-Value TranslatorImpl::left_shift(Value val, Value nbits, SourcePos pos) {
-    if (!nbits.is_integral()) {
+/**
+ * @brief Aggregates bigger than this many bytes are copied with
+ *        `llvm.memcpy`; smaller ones are left for SROA to split into their
+ *        fields.
+ */
+static const uint64_t MEMCPY_THRESHOLD = 16;
+
+llvm::Instruction *TranslatorImpl::store_value(const Value &val,
+                                               llvm::Value *addr,
+                                               llvm::Align align) {
+    auto *ll = val.to_llvm();
+    auto *ty = ll->getType();
+
+    if (ty->isAggregateType()) {
+        const auto &dl = module->getDataLayout();
+        auto size = dl.getTypeAllocSize(ty).getFixedSize();
+
+        auto *constant = llvm::dyn_cast<llvm::Constant>(ll);
+        if (constant && constant->isNullValue()) {
+            return builder.CreateMemSet(addr, builder.getInt8(0), size,
+                                        align);
+        }
+
+        // Only a load just made can be replaced: nothing has written to
+        // its memory since.
+        auto *load = llvm::dyn_cast<llvm::LoadInst>(ll);
+        auto *block = builder.GetInsertBlock();
+        if (load && load->isSimple() && size > MEMCPY_THRESHOLD
+         && builder.GetInsertPoint() == block->end()
+         && !block->empty() && &block->back() == load) {
+            auto *copy = builder.CreateMemCpy(addr, align,
+                                              load->getPointerOperand(),
+                                              load->getAlign(), size);
+            if (load->use_empty()) {
+                restricted_accesses.erase(
+                        std::remove_if(restricted_accesses.begin(),
+                                       restricted_accesses.end(),
+                                       [load](const auto &access) {
+                                           return access.first == load;
+                                       }),
+                        restricted_accesses.end());
+                load->eraseFromParent();
+            }
+            return copy;
+        }
+    }
+
+    return builder.CreateAlignedStore(ll, addr, align);
+}
+
+void TranslatorImpl::set_param_attributes(llvm::Function *f,
+                                          const Function<> &t) {
+    const auto &lowered = abi.get(t);
+
+    if (lowered.result.kind == AbiValue::Indirect) {
+        auto *ty = types.get(*t.get_rettype());
+        f->addParamAttr(0, llvm::Attribute::getWithStructRetType(context, ty));
+        f->addParamAttr(0, llvm::Attribute::NoAlias);
+        f->addParamAttr(0, llvm::Attribute::getWithAlignment(
+                context, llvm::Align(lowered.result.align)));
+    }
+
+    for (unsigned i = 0; i < t.get_args().size(); ++i) {
+        const auto &arg = t.get_args()[i];
+        auto param = lowered.params[i];
+
+        if (lowered.args[i].kind == AbiValue::Indirect) {
+            if (lowered.args[i].byval) {
+                f->addParamAttr(param, llvm::Attribute::getWithByValType(
+                        context, types.get(arg)));
+            }
+            f->addParamAttr(param, llvm::Attribute::getWithAlignment(
+                    context, llvm::Align(lowered.args[i].align)));
+        }
+
+        auto *ptr = boost::get<Pointer<> >(&arg.variant());
+        if (ptr && ptr->is_restrict()) {
+            f->addParamAttr(param, llvm::Attribute::NoAlias);
+        }
+    }
+}
+
+void TranslatorImpl::set_allocator_attributes(
+        llvm::Function *f, const Function<> &t,
+        const FunctionAttributes &attrs, SourcePos pos) {
+    if (!attrs.allocator) return;
+
+    if (!is_type<Pointer<> >(*t.get_rettype())) {
+        throw Error("type error", "@malloc functions must return a pointer",
+                    pos);
+    }
+    f->addRetAttr(llvm::Attribute::NoAlias);
+
+    if (!attrs.alloc_size) return;
+
+    const auto &size = t.get_args()[*attrs.alloc_size];
+    if (!is_type<UnsignedInt>(size) && !is_type<SignedInt>(size)) {
+        throw Error("type error", "the size of an @malloc function's "
+                                  "allocation must be an integer", pos);
+    }
+
+    auto param = abi.get(t).params[*attrs.alloc_size];
+    f->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(context, param,
+                                                       llvm::None));
+}
+
+void TranslatorImpl::add_restrict_variable(llvm::AllocaInst *alloca,
+                                           const Type &t) {
+    auto *ptr = boost::get<Pointer<> >(&t.variant());
+    if (!ptr || !ptr->is_restrict()) return;
+
+    llvm::MDBuilder md(context);
+    if (!alias_domain) {
+        alias_domain = md.createAnonymousAliasScopeDomain(
+                builder.GetInsertBlock()->getParent()->getName());
+    }
+
+    auto *scope = md.createAnonymousAliasScope(alias_domain,
+                                               alloca->getName());
+    alias_scopes.push_back(scope);
+    restrict_variables.emplace(alloca, scope);
+}
+
+void TranslatorImpl::note_access(llvm::Instruction *inst,
+                                 const Value &pointer) {
+    if (pointer.get_alias_scope()) {
+        restricted_accesses.emplace_back(inst, pointer.get_alias_scope());
+    }
+}
+
+void TranslatorImpl::add_alias_metadata(void) {
+    for (const auto &access: restricted_accesses) {
+        std::vector<llvm::Metadata *> others;
+        for (auto *scope: alias_scopes) {
+            if (scope != access.second) others.push_back(scope);
+        }
+
+        access.first->setMetadata(llvm::LLVMContext::MD_alias_scope,
+                                  llvm::MDNode::get(context, access.second));
+        if (!others.empty()) {
+            access.first->setMetadata(llvm::LLVMContext::MD_noalias,
+                                      llvm::MDNode::get(context, others));
+        }
+    }
+
+    restrict_variables.clear();
+    alias_domain = nullptr;
+    alias_scopes.clear();
+    restricted_accesses.clear();
+}
+
+unsigned TranslatorImpl::pointee_align(const Value &pointer) {
+    if (pointer.get_pointee_align()) return pointer.get_pointee_align();
+
+    auto &pointer_ty = boost::get<Pointer<> >(pointer.get_type().variant());
+    return types.get_alignment(*pointer_ty.get_pointed());
+}
+
+/**
+ * @brief Get the type of each element of a vector type, or the type itself
+ *        if it is not a vector.
+ */
+static const Type &scalar_type(const Type &ty) {
+    if (auto *vector = boost::get<Vector<> >(&ty.variant())) {
+        return *vector->get_element();
+    }
+    return ty;
+}
+
+/**
+ * @brief Check that a value of the given type can be shifted by one of the
+ *        other, throwing an error if not.
+ */
+static void check_shift(const Type &val, const Type &nbits, SourcePos pos) {
+    const auto &v_elem = scalar_type(val);
+    const auto &n_elem = scalar_type(nbits);
+
+    if (!is_type<SignedInt>(n_elem) && !is_type<UnsignedInt>(n_elem)) {
         throw Error("type error", "cannot shift by non-integer value",
                     pos);
     }
 
-    if (!val.is_integral()) {
+    if (!is_type<SignedInt>(v_elem) && !is_type<UnsignedInt>(v_elem)) {
         throw Error("type error", "cannot shift non-integer value",
                     pos);
     }
 
+    /* Vectors are shifted lane by lane. */
+    if ((&v_elem != &val || &n_elem != &nbits) && val != nbits) {
+        throw Error("type error", "cannot shift a vector by a value of a "
+                                  "different type", pos);
+    }
+}
+
+Value TranslatorImpl::left_shift(Value val, Value nbits, SourcePos pos) {
+    check_shift(val.get_type(), nbits.get_type(), pos);
+
     auto *inst = builder.CreateShl(val.to_llvm(), nbits.to_llvm());
     return Value(inst, val.get_type());
 }
 
 Value TranslatorImpl::right_shift(Value val, Value nbits, SourcePos pos) {
-    if (!nbits.is_integral()) {
-        throw Error("type error", "cannot shift by non-integer value",
-                    pos);
-    }
+    check_shift(val.get_type(), nbits.get_type(), pos);
 
     llvm::Value *inst;
 
-    if (is_type<SignedInt>(val.get_type())) {
+    if (is_type<SignedInt>(scalar_type(val.get_type()))) {
         inst = builder.CreateAShr(val.to_llvm(), nbits.to_llvm());
-    } else if (is_type<UnsignedInt>(val.get_type())) {
-        inst = builder.CreateLShr(val.to_llvm(), nbits.to_llvm());
     } else {
-        throw Error("type error", "cannot shift non-integer value",
-                    pos);
+        inst = builder.CreateLShr(val.to_llvm(), nbits.to_llvm());
     }
 
     return Value(inst, val.get_type());
@@ -294,9 +664,9 @@ Value TranslatorImpl::right_shift(Value val, Value nbits, SourcePos pos) {
 class Operator: public boost::static_visitor<Value> {
 public:
     Operator(const Value &lhs, const Value &rhs,
-             const SourcePos pos, llvm::Module &module,
+             const SourcePos pos, LlvmTypeCache &types,
              llvm::IRBuilder<> &builder)
-        : module(module), lhs(lhs), rhs(rhs), pos(pos),
+        : types(types), lhs(lhs), rhs(rhs), pos(pos),
           builder(builder) {
         unsigned_int_extender = [&](llvm::Value *v, llvm::Type *t) {
             return get_builder().CreateSExtOrTrunc(v, t);
@@ -375,13 +745,27 @@ public:
         return ptr_ptr_op(lhs, rhs);
     }
 
+    virtual Value vector_op(const Value &, const Value &,
+                            const Type &) {
+        type_error("cannot perform \"" + get_op() + "\" between vectors");
+    }
+
+    Value operator()(const Vector<> &l, const Vector<> &r) {
+        if (!(l == r)) {
+            type_error("cannot perform \"" + get_op() + "\" between "
+                       "vectors of different types");
+        }
+        return vector_op(lhs, rhs, *l.get_element());
+    }
+
     template<typename L, typename R>
     Value operator()(const L &, const R &) {
         type_error("illegal " + get_op());
     }
 
     Value apply(void) {
-        return boost::apply_visitor(*this, lhs.get_type(), rhs.get_type());
+        return boost::apply_visitor(*this, lhs.get_type().variant(),
+                                    rhs.get_type().variant());
     }
 
 protected:
@@ -397,7 +781,7 @@ protected:
     Extender signed_int_extender;
     Extender float_extender;
 
-    llvm::Module &module;
+    LlvmTypeCache &types;
 
 private:
     [[noreturn]] void type_error(std::string msg) const {
@@ -410,11 +794,24 @@ private:
     llvm::IRBuilder<> &builder;
 };
 
+/**
+ * @brief Get the LLVM type pointed to by the given pointer-typed value.
+ */
+static llvm::Type *get_pointed_llvm_type(const Value &ptr,
+                                         LlvmTypeCache &types) {
+    auto ty = ptr.get_type();
+    auto *pointer_ty = boost::get<Pointer<> >(&ty.variant());
+
+    assert(pointer_ty);
+
+    return types.get(*pointer_ty->get_pointed());
+}
+
 /**
  * @brief Get the width of the provided integer type.
  */
-static int get_width(const Type &integral, llvm::Module &module) {
-    auto *ty = to_llvm_type(integral, module);
+static int get_width(const Type &integral, LlvmTypeCache &types) {
+    auto *ty = types.get(integral);
 
     assert(ty->isIntegerTy());
 
@@ -427,15 +824,15 @@ static int get_width(const Type &integral, llvm::Module &module) {
  * Return the wider of the two types.
  */
 static const Type &get_wider(const Value &lhs, const Value &rhs,
-                             llvm::Module &module) {
+                             LlvmTypeCache &types) {
     auto &lty = lhs.get_type();
     auto &rty = rhs.get_type();
 
     assert(lhs.is_integral());
     assert(rhs.is_integral());
 
-    int lhs_nbits = get_width(lty, module);
-    int rhs_nbits = get_width(rty, module);
+    int lhs_nbits = get_width(lty, types);
+    int rhs_nbits = get_width(rty, types);
 
     if (lhs_nbits >= rhs_nbits) {
         return lty;
@@ -448,9 +845,9 @@ class BitwiseOperator: public Operator {
 public:
     BitwiseOperator(const Value &lhs, const Value &rhs,
                     const SourcePos pos, const std::string &fname,
-                    llvm::Module &module,
+                    LlvmTypeCache &types,
                     llvm::IRBuilder<> &builder)
-        : Operator(lhs, rhs, pos, module, builder) {}
+        : Operator(lhs, rhs, pos, types, builder) {}
 
     virtual ~BitwiseOperator() override {};
 
@@ -459,17 +856,17 @@ public:
     template<typename Extender>
     Value extend_and_perform(const Value &l, const Value &r,
                              Extender extender) {
-        const auto &t = get_wider(l, r, module);
+        const auto &t = get_wider(l, r, types);
         llvm::Value *llvm_l;
         llvm::Value *llvm_r;
         if (t == l.get_type()) {
-            llvm_l = extender(l.to_llvm(), to_llvm_type(t, module));
+            llvm_l = extender(l.to_llvm(), types.get(t));
         } else {
             llvm_l = l.to_llvm();
         }
 
         if (t == r.get_type()) {
-            llvm_r = extender(r.to_llvm(), to_llvm_type(t, module));
+            llvm_r = extender(r.to_llvm(), types.get(t));
         } else {
             llvm_r = r.to_llvm();
         }
@@ -485,15 +882,21 @@ public:
     virtual Value uint_int_op(const Value &l, const Value &r) override {
         return extend_and_perform(l, r, signed_int_extender);
     }
+
+    virtual Value vector_op(const Value &l, const Value &r,
+                            const Type &element) override {
+        if (is_type<Float>(element)) return Operator::vector_op(l, r, element);
+        return Value(perform(l.to_llvm(), r.to_llvm()), l.get_type());
+    }
 };
 
 #define make_bitwise(method, classname, op)\
     struct classname: public BitwiseOperator {\
         classname(const Value &lhs, const Value &rhs,\
                   const SourcePos pos, const std::string &fname,\
-                  llvm::Module &module,\
+                  LlvmTypeCache &types,\
                   llvm::IRBuilder<> &builder)\
-            : BitwiseOperator(lhs, rhs, pos, fname, module, builder) {}\
+            : BitwiseOperator(lhs, rhs, pos, fname, types, builder) {}\
         virtual ~classname() override {}\
         virtual std::string get_op() const override { return (op); }\
         llvm::Value *perform(llvm::Value *l, llvm::Value *r) override {\
@@ -506,19 +909,20 @@ make_bitwise(CreateOr, BitwiseOr, "|");
 make_bitwise(CreateXor, BitwiseXor, "^");
 
 Value TranslatorImpl::bit_and(Value lhs, Value rhs, SourcePos pos) {
-    return BitwiseAnd(lhs, rhs, pos, fname, *module, builder).apply();
+    return BitwiseAnd(lhs, rhs, pos, fname, types, builder).apply();
 }
 
 Value TranslatorImpl::bit_or(Value lhs, Value rhs, SourcePos pos) {
-    return BitwiseOr(lhs, rhs, pos, fname, *module, builder).apply();
+    return BitwiseOr(lhs, rhs, pos, fname, types, builder).apply();
 }
 
 Value TranslatorImpl::bit_xor(Value lhs, Value rhs, SourcePos pos) {
-    return BitwiseXor(lhs, rhs, pos, fname, *module, builder).apply();
+    return BitwiseXor(lhs, rhs, pos, fname, types, builder).apply();
 }
 
 Value TranslatorImpl::bit_not(Value val, SourcePos pos) {
-    if (!val.is_integral()) {
+    const auto &element = scalar_type(val.get_type());
+    if (!is_type<SignedInt>(element) && !is_type<UnsignedInt>(element)) {
         throw Error("type error", "cannot perform bitwise operations on "
                                   "non-integral types", pos);
     }
@@ -602,8 +1006,8 @@ struct OpVisitor: boost::static_visitor<ArithmeticOpType> {
 };
 
 const Float &get_wider_float(const Type &l, const Type &r) {
-    auto *l_ty = boost::get<Float>(&l);
-    auto *r_ty = boost::get<Float>(&r);
+    auto *l_ty = boost::get<Float>(&l.variant());
+    auto *r_ty = boost::get<Float>(&r.variant());
 
     assert(l_ty);
     assert(r_ty);
@@ -618,9 +1022,9 @@ const Float &get_wider_float(const Type &l, const Type &r) {
 class ArithmeticOperator: public Operator {
 public:
     ArithmeticOperator(const Value &lhs, const Value &rhs,
-                const SourcePos pos, llvm::Module &module,
+                const SourcePos pos, LlvmTypeCache &types,
                 llvm::IRBuilder<> &builder)
-          : Operator(lhs, rhs, pos, module, builder) {
+          : Operator(lhs, rhs, pos, types, builder) {
         sint_performer = [&](llvm::Value *l, llvm::Value *r) {
             return sint_perform(l, r);
         };
@@ -636,8 +1040,8 @@ public:
 
     Value extend_and_perform_int(const Value &l, const Value &r,
                                  Extender extender, Performer performer) {
-        auto *lty = to_llvm_type(l.get_type(), module);
-        auto *rty = to_llvm_type(r.get_type(), module);
+        auto *lty = types.get(l.get_type());
+        auto *rty = types.get(r.get_type());
         int lbits = lty->getIntegerBitWidth();
         int rbits = rty->getIntegerBitWidth();
 
@@ -659,11 +1063,11 @@ public:
         llvm::Value *result;
         if (wider == l.get_type()) {
             auto *r_extended = extender(r.to_llvm(),
-                                        to_llvm_type(wider, module));
+                                        types.get(wider));
             result = performer(l.to_llvm(), r_extended);
         } else {
             auto *l_extended = extender(l.to_llvm(),
-                                        to_llvm_type(wider, module));
+                                        types.get(wider));
             result = performer(l_extended, r.to_llvm());
         }
 
@@ -685,6 +1089,21 @@ public:
                                         float_extender, float_performer);
     }
 
+    /* Both operands have the same type, so there is nothing to extend. */
+    Value vector_op(const Value &l, const Value &r,
+                    const Type &element) override {
+        llvm::Value *result;
+        if (is_type<SignedInt>(element)) {
+            result = sint_perform(l.to_llvm(), r.to_llvm());
+        } else if (is_type<UnsignedInt>(element)) {
+            result = uint_perform(l.to_llvm(), r.to_llvm());
+        } else {
+            result = float_perform(l.to_llvm(), r.to_llvm());
+        }
+
+        return Value(result, l.get_type());
+    }
+
 protected:
     virtual llvm::Value *uint_perform(llvm::Value *, llvm::Value *) = 0;
     virtual llvm::Value *sint_perform(llvm::Value *, llvm::Value *) = 0;
@@ -699,14 +1118,15 @@ private:
 class AddOperator: public ArithmeticOperator {
 public:
     AddOperator(const Value &lhs, const Value &rhs,
-                const SourcePos pos, llvm::Module &module,
-                llvm::IRBuilder<> &builder)
-          : ArithmeticOperator(lhs, rhs, pos, module, builder) {}
+                const SourcePos pos, LlvmTypeCache &types,
+                llvm::IRBuilder<> &builder, bool nsw)
+          : ArithmeticOperator(lhs, rhs, pos, types, builder), nsw(nsw) {}
 
     ~AddOperator() override {}
 
     Value ptr_int_op(const Value &l, const Value &r) override {
-        auto *result = get_builder().CreateGEP(l.to_llvm(), r.to_llvm());
+        auto *result = get_builder().CreateGEP(
+                get_pointed_llvm_type(l, types), l.to_llvm(), r.to_llvm());
         return Value(result, l.get_type());
     }
 
@@ -722,7 +1142,7 @@ protected:
 
     virtual llvm::Value *sint_perform(llvm::Value *l, llvm::Value *r)
           override {
-        return get_builder().CreateAdd(l, r);
+        return get_builder().CreateAdd(l, r, "", false, nsw);
     }
 
     virtual llvm::Value *uint_perform(llvm::Value *l, llvm::Value *r)
@@ -734,40 +1154,65 @@ protected:
           override {
         return get_builder().CreateFAdd(l, r);
     }
+
+private:
+    /** @brief Whether signed overflow is undefined. */
+    bool nsw;
 };
 
-Value TranslatorImpl::add(Value lhs, Value rhs, SourcePos pos) {
-    return AddOperator(lhs, rhs, pos, *module, builder).apply();
+/**
+ * @brief Pointer arithmetic gives a pointer based on the same `restrict`
+ *        pointer as the original.
+ */
+static Value offset_pointer(Value result, const Value &lhs, const Value &rhs) {
+    bool lhs_ptr = is_type<Pointer<> >(lhs.get_type());
+    bool rhs_ptr = is_type<Pointer<> >(rhs.get_type());
+
+    if (lhs_ptr != rhs_ptr) {
+        result.set_alias_scope(lhs_ptr ? lhs.get_alias_scope()
+                                       : rhs.get_alias_scope());
+    }
+
+    return result;
+}
+
+Value TranslatorImpl::add(Value lhs, Value rhs, SourcePos pos,
+                          bool wrapping) {
+    AddOperator op(lhs, rhs, pos, types, builder,
+                   !wrapping && !wrapping_overflow);
+    return offset_pointer(op.apply(), lhs, rhs);
 }
 
 class SubOperator: public ArithmeticOperator {
 public:
     SubOperator(const Value &lhs, const Value &rhs,
-                const SourcePos pos, llvm::Module &module,
-                llvm::IRBuilder<> &builder)
-        : ArithmeticOperator(lhs, rhs, pos, module, builder) {}
+                const SourcePos pos, LlvmTypeCache &types,
+                llvm::IRBuilder<> &builder, bool nsw)
+        : ArithmeticOperator(lhs, rhs, pos, types, builder), nsw(nsw) {}
 
     ~SubOperator() override {}
 
     Value ptr_int_op(const Value &l, const Value &r) override {
         // Construct negative `r` by subtracting it from 0.
         auto r_ty = r.get_type();
-        auto *zero = llvm::ConstantInt::get(to_llvm_type(r_ty, module), 0);
+        auto *zero = llvm::ConstantInt::get(types.get(r_ty), 0);
         auto *negative = get_builder().CreateSub(zero, r.to_llvm());
 
         assert(l.to_llvm());
 
         // Just do a regular GEP with a negative index.
-        auto *result = get_builder().CreateGEP(l.to_llvm(), negative);
+        auto *result = get_builder().CreateGEP(
+                get_pointed_llvm_type(l, types), l.to_llvm(), negative);
         return Value(result, l.get_type());
     }
 
     Value ptr_ptr_op(const Value &l, const Value &r) override {
-        if (!(l.get_type() == r.get_type())) {
+        if (unqualified(l.get_type()) != unqualified(r.get_type())) {
             throw Error("type error", "cannot subtract pointers of different "
                                       "types", get_pos());
         }
-        auto *result = get_builder().CreatePtrDiff(l.to_llvm(), r.to_llvm());
+        auto *result = get_builder().CreatePtrDiff(
+                get_pointed_llvm_type(l, types), l.to_llvm(), r.to_llvm());
         return Value(result, l.get_type());
     }
 
@@ -778,7 +1223,7 @@ public:
 protected:
     virtual llvm::Value *sint_perform(llvm::Value *l, llvm::Value *r)
           override {
-        return get_builder().CreateSub(l, r);
+        return get_builder().CreateSub(l, r, "", false, nsw);
     }
 
     virtual llvm::Value *uint_perform(llvm::Value *l, llvm::Value *r)
@@ -790,18 +1235,25 @@ protected:
           override {
         return get_builder().CreateFSub(l, r);
     }
+
+private:
+    /** @brief Whether signed overflow is undefined. */
+    bool nsw;
 };
 
-Value TranslatorImpl::sub(Value lhs, Value rhs, SourcePos pos) {
-    return SubOperator(lhs, rhs, pos, *module, builder).apply();
+Value TranslatorImpl::sub(Value lhs, Value rhs, SourcePos pos,
+                          bool wrapping) {
+    SubOperator op(lhs, rhs, pos, types, builder,
+                   !wrapping && !wrapping_overflow);
+    return offset_pointer(op.apply(), lhs, rhs);
 }
 
 class MulOperator: public ArithmeticOperator {
 public:
     MulOperator(const Value &lhs, const Value &rhs,
-                const SourcePos pos, llvm::Module &module,
-                llvm::IRBuilder<> &builder)
-        : ArithmeticOperator(lhs, rhs, pos, module, builder) {}
+                const SourcePos pos, LlvmTypeCache &types,
+                llvm::IRBuilder<> &builder, bool nsw)
+        : ArithmeticOperator(lhs, rhs, pos, types, builder), nsw(nsw) {}
 
     ~MulOperator() {}
 
@@ -812,7 +1264,7 @@ public:
 protected:
     virtual llvm::Value *sint_perform(llvm::Value *l, llvm::Value *r)
           override {
-        return get_builder().CreateMul(l, r);
+        return get_builder().CreateMul(l, r, "", false, nsw);
     }
 
     virtual llvm::Value *uint_perform(llvm::Value *l, llvm::Value *r)
@@ -824,18 +1276,24 @@ protected:
           override {
         return get_builder().CreateFMul(l, r);
     }
+
+private:
+    /** @brief Whether signed overflow is undefined. */
+    bool nsw;
 };
 
-Value TranslatorImpl::mul(Value lhs, Value rhs, SourcePos pos) {
-    return MulOperator(lhs, rhs, pos, *module, builder).apply();
+Value TranslatorImpl::mul(Value lhs, Value rhs, SourcePos pos,
+                          bool wrapping) {
+    return MulOperator(lhs, rhs, pos, types, builder,
+                       !wrapping && !wrapping_overflow).apply();
 }
 
 class DivOperator: public ArithmeticOperator {
 public:
     DivOperator(const Value &lhs, const Value &rhs,
-                const SourcePos pos, llvm::Module &module,
+                const SourcePos pos, LlvmTypeCache &types,
                 llvm::IRBuilder<> &builder)
-        : ArithmeticOperator(lhs, rhs, pos, module, builder) {}
+        : ArithmeticOperator(lhs, rhs, pos, types, builder) {}
 
     ~DivOperator() override {}
 
@@ -861,19 +1319,19 @@ protected:
 };
 
 Value TranslatorImpl::div(Value lhs, Value rhs, SourcePos pos) {
-    return DivOperator(lhs, rhs, pos, *module, builder).apply();
+    return DivOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class ComparisonOperator: public ArithmeticOperator {
 public:
     ComparisonOperator(const Value &lhs, const Value &rhs,
                 const SourcePos pos,
-                llvm::Module &module,
+                LlvmTypeCache &types,
                 llvm::IRBuilder<> &builder)
-        : ArithmeticOperator(lhs, rhs, pos, module, builder) {}
+        : ArithmeticOperator(lhs, rhs, pos, types, builder) {}
 
     virtual Value ptr_ptr_op(const Value &l, const Value &r) override {
-        if (!(l.get_type() == r.get_type())) {
+        if (unqualified(l.get_type()) != unqualified(r.get_type())) {
             throw Error("type error", "cannot compare pointers to different "
                                       "types", get_pos());
         }
@@ -883,6 +1341,15 @@ public:
         return Value(result, l.get_type());
     }
 
+    /* Comparing vectors gives a vector of booleans. */
+    virtual Value vector_op(const Value &l, const Value &r,
+                            const Type &element) override {
+        auto result = ArithmeticOperator::vector_op(l, r, element);
+        const auto &ty = boost::get<Vector<> >(l.get_type().variant());
+        return Value(result.to_llvm(),
+                     Vector<>(UnsignedInt(1), ty.get_lanes()));
+    }
+
 protected:
     virtual llvm::Value *sint_perform(llvm::Value *l, llvm::Value *r) 
          override {
@@ -907,9 +1374,9 @@ protected:
 class EqualOperator: public ComparisonOperator {
 public:
     EqualOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~EqualOperator() override {}
 
@@ -932,15 +1399,15 @@ protected:
 };
 
 Value TranslatorImpl::equal(Value lhs, Value rhs, SourcePos pos) {
-    return EqualOperator(lhs, rhs, pos, *module, builder).apply();
+    return EqualOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class LessOperator: public ComparisonOperator {
 public:
     LessOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~LessOperator() override {}
 
@@ -963,15 +1430,15 @@ protected:
 };
 
 Value TranslatorImpl::less(Value lhs, Value rhs, SourcePos pos) {
-    return LessOperator(lhs, rhs, pos, *module, builder).apply();
+    return LessOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class LessEqOperator: public ComparisonOperator {
 public:
     LessEqOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~LessEqOperator() override {}
 
@@ -994,15 +1461,15 @@ protected:
 };
 
 Value TranslatorImpl::lesseq(Value lhs, Value rhs, SourcePos pos) {
-    return LessEqOperator(lhs, rhs, pos, *module, builder).apply();
+    return LessEqOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class NequalOperator: public ComparisonOperator {
 public:
     NequalOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~NequalOperator() override {}
 
@@ -1025,15 +1492,15 @@ protected:
 };
 
 Value TranslatorImpl::nequal(Value lhs, Value rhs, SourcePos pos) {
-    return NequalOperator(lhs, rhs, pos, *module, builder).apply();
+    return NequalOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class GreaterOperator: public ComparisonOperator {
 public:
     GreaterOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~GreaterOperator() override {}
 
@@ -1056,15 +1523,15 @@ protected:
 };
 
 Value TranslatorImpl::greater(Value lhs, Value rhs, SourcePos pos) {
-    return GreaterOperator(lhs, rhs, pos, *module, builder).apply();
+    return GreaterOperator(lhs, rhs, pos, types, builder).apply();
 }
 
 class GreaterEqOperator: public ComparisonOperator {
 public:
     GreaterEqOperator(const Value &lhs, const Value &rhs,
-                  const SourcePos pos, llvm::Module &module,
+                  const SourcePos pos, LlvmTypeCache &types,
                   llvm::IRBuilder<> &builder)
-        : ComparisonOperator(lhs, rhs, pos, module, builder) {}
+        : ComparisonOperator(lhs, rhs, pos, types, builder) {}
 
     ~GreaterEqOperator() override {}
 
@@ -1087,11 +1554,11 @@ protected:
 };
 
 Value TranslatorImpl::greatereq(Value lhs, Value rhs, SourcePos pos) {
-    return GreaterEqOperator(lhs, rhs, pos, *module, builder).apply();
+    return GreaterEqOperator(lhs, rhs, pos, types, builder).apply();
 }
 static inline bool is_u1(Value v) {
     auto ty = v.get_type();
-    auto *lt = boost::get<UnsignedInt>(&ty);
+    auto *lt = boost::get<UnsignedInt>(&ty.variant());
     if (!lt) {
         return false;
     }
@@ -1131,9 +1598,9 @@ Value TranslatorImpl::bool_not(Value val, SourcePos pos) {
     return Value(inst, val.get_type());
 }
 
-inline std::pair<unsigned, Type *>
+inline std::pair<unsigned, const Type *>
 TranslatorImpl::get_field_idx(Type _t, std::string field, SourcePos pos) {
-    auto t = boost::get<Struct<> >(&_t);
+    auto t = boost::get<Struct<> >(&_t.variant());
 
     if (!t) {
         throw Error("type error", "cannot access field of non-struct value",
@@ -1161,7 +1628,8 @@ Value TranslatorImpl::field_access(Value lhs, std::string field,
 
     std::vector<unsigned> idxs;
 
-    idxs.push_back(pair.first);
+    idxs.push_back(types.get_field_index(boost::get<Struct<> >(_t.variant()),
+                                         pair.first));
 
     auto *instr = builder.CreateExtractValue(lhs.to_llvm(), idxs);
 
@@ -1171,7 +1639,7 @@ Value TranslatorImpl::field_access(Value lhs, std::string field,
 Value TranslatorImpl::field_address(Value ptr, std::string field,
                                     SourcePos pos) {
     auto _ptr_t = ptr.get_type();
-    auto ptr_t = boost::get<Pointer<> >(&_ptr_t);
+    auto ptr_t = boost::get<Pointer<> >(&_ptr_t.variant());
 
     if (!ptr_t) {
         throw Error("type error",
@@ -1179,33 +1647,114 @@ Value TranslatorImpl::field_address(Value ptr, std::string field,
                     pos);
     }
 
-    auto pair = get_field_idx(*ptr_t->get_pointed(), field, pos);
+    auto &str_t = *ptr_t->get_pointed();
+    auto pair = get_field_idx(str_t, field, pos);
+    auto idx = types.get_field_index(boost::get<Struct<> >(str_t.variant()),
+                                     pair.first);
 
-    auto *gep_type = to_llvm_type(*ptr_t->get_pointed(), *module);
+    auto *gep_type = static_cast<llvm::StructType *>(types.get(str_t));
 
-    auto *instr = builder.CreateStructGEP(gep_type, ptr.to_llvm(),
-                                          pair.first);
+    auto *instr = builder.CreateStructGEP(gep_type, ptr.to_llvm(), idx);
 
-    auto result_ptr = Pointer<>(std::make_shared<Type>(*pair.second));
+    auto result_ptr = Pointer<>(*pair.second);
 
-    return Value(instr, result_ptr);
+    /* In a packed struct, the field may be less aligned than its type. */
+    auto offset = module->getDataLayout().getStructLayout(gep_type)
+                                         ->getElementOffset(idx);
+    auto align = llvm::commonAlignment(llvm::Align(pointee_align(ptr)),
+                                       offset).value();
+    Value result = align < types.get_alignment(*pair.second)
+                 ? Value(instr, result_ptr, align)
+                 : Value(instr, result_ptr);
+    result.set_alias_scope(ptr.get_alias_scope());
+
+    return result;
 }
 
-Value TranslatorImpl::call(std::string func, std::vector<Value> &args,
-                           SourcePos pos) {
-    std::vector<llvm::Value *>llvm_args;
+/**
+ * @brief Check that an array index is an integer, and in range if it is
+ *        constant.
+ */
+static void check_index(const Array<> &ty, const Value &index,
+                        SourcePos pos) {
+    if (!index.is_integral()) {
+        throw Error("type error", "array indices must be integers", pos);
+    }
+
+    auto *constant = llvm::dyn_cast<llvm::ConstantInt>(index.to_llvm());
+    if (constant && constant->getValue().uge(ty.get_length())) {
+        throw Error("type error", "array index out of range", pos);
+    }
+}
+
+llvm::Value *TranslatorImpl::gep_index(Value index) {
+    auto *int_t = module->getDataLayout().getIntPtrType(context);
+    return is_type<SignedInt>(index.get_type())
+         ? builder.CreateSExtOrTrunc(index.to_llvm(), int_t)
+         : builder.CreateZExtOrTrunc(index.to_llvm(), int_t);
+}
+
+Value TranslatorImpl::element_access(Value array, Value index,
+                                     SourcePos pos) {
+    auto *ty = boost::get<Array<> >(&array.get_type().variant());
+    if (!ty) {
+        throw Error("type error", "cannot index non-array value", pos);
+    }
+    check_index(*ty, index, pos);
 
-    for (auto &arg: args) {
-        llvm_args.push_back(arg.to_llvm());
+    if (auto *constant = llvm::dyn_cast<llvm::ConstantInt>(index.to_llvm())) {
+        auto *inst = builder.CreateExtractValue(
+                array.to_llvm(), { (unsigned)constant->getZExtValue() });
+        return Value(inst, *ty->get_element());
     }
 
+    /* A variable element can only be picked out in memory. */
+    auto *tmp = entry_alloca(array.get_type(), "array");
+    builder.CreateAlignedStore(array.to_llvm(), tmp, tmp->getAlign());
+
+    return add_load(element_address(Value(tmp, Pointer<>(array.get_type())),
+                                    index, pos), pos);
+}
+
+Value TranslatorImpl::element_address(Value ptr, Value index,
+                                      SourcePos pos) {
+    auto *ptr_t = boost::get<Pointer<> >(&ptr.get_type().variant());
+    auto *ty = ptr_t ? boost::get<Array<> >(&ptr_t->get_pointed()->variant())
+                     : nullptr;
+    if (!ty) {
+        throw Error("type error", "cannot index non-array value", pos);
+    }
+    check_index(*ty, index, pos);
+
+    auto *array_t = types.get(*ptr_t->get_pointed());
+    auto *zero = llvm::ConstantInt::get(
+            module->getDataLayout().getIntPtrType(context), 0);
+    auto *instr = builder.CreateInBoundsGEP(array_t, ptr.to_llvm(),
+                                            { zero, gep_index(index) });
+
+    const auto &element = *ty->get_element();
+    auto result_ptr = Pointer<>(element);
+
+    /* An array in a packed struct may be less aligned than its elements. */
+    auto align = pointee_align(ptr);
+    Value result = align < types.get_alignment(element)
+                 ? Value(instr, result_ptr, align)
+                 : Value(instr, result_ptr);
+    result.set_alias_scope(ptr.get_alias_scope());
+
+    return result;
+}
+
+Value TranslatorImpl::call(Symbol func, std::vector<Value> &args,
+                           SourcePos pos) {
     if (!env.bound(func)) {
-        throw Error("error", "function \"" + func + "\" not defined", pos);
+        throw Error("error", "function \"" + func.str() + "\" not defined",
+                    pos);
     }
 
     auto fbinding = env.lookup_identifier(func, pos);
     auto ty = fbinding.get_type();
-    auto *ftype = boost::get<Function<> >(&ty);
+    auto *ftype = boost::get<Function<> >(&ty.variant());
 
     if (!ftype) {
         throw Error("type error", "cannot call non-function value", pos);
@@ -1213,219 +1762,1794 @@ Value TranslatorImpl::call(std::string func, std::vector<Value> &args,
 
     for (unsigned i = 0; i < args.size(); ++i) {
         auto lhs_ty = args[i].get_type();
-        auto rhs_ty = *ftype->get_args()[i];
-        if (!(lhs_ty == rhs_ty)) {
+        auto rhs_ty = ftype->get_args()[i];
+        if (unqualified(lhs_ty) != unqualified(rhs_ty)) {
             throw Error("type error", "argument does not match function type",
                         pos);
         }
     }
 
-    auto *inst = builder.CreateCall(fbinding.get_val().to_llvm(), llvm_args);
-    return Value(inst, *ftype->get_rettype());
+    auto *callee = llvm::cast<llvm::Function>(fbinding.get_val().to_llvm());
+    return call_function(callee, *ftype, args);
 }
 
-Value TranslatorImpl::call(std::string func, std::vector<Type> &templ_args,
-                           std::vector<Value> &v_args, SourcePos pos) {
-
-    // Use the mangled name to find the function if it has been implemented.
-    auto name = mangle_name(func, templ_args);
-
-    auto tv = env.lookup_template_func(func, pos);
-
-
-    auto specialized_type = tv.ty.specialize(templ_args);
-
-    // Try to just find the specialized function.
-    auto *fbinding = module->getFunction(name);
-
-    // If it isn't there, make it, and note that we need to fill it out later.
-    if (!fbinding) {
-        auto *ll_ty = to_llvm_type(specialized_type, *module);
-
-        auto *f_ty = static_cast<llvm::FunctionType *>(ll_ty);
-        fbinding = llvm::Function::Create(f_ty,
-                                          llvm::Function::ExternalLinkage,
-                                          name,
-                                          module.get());
-
-        std::pair<std::vector<Type>, const TemplateValue &>specialization
-            (templ_args, tv);
-
-        specializations.push_back(specialization);
-    }
-
-    std::vector<llvm::Value *>llvm_args;
-
-    for (const auto &arg: v_args) {
-        llvm_args.push_back(arg.to_llvm());
-    }
-
-    auto *inst = builder.CreateCall(fbinding, llvm_args);
-    return Value(inst, *specialized_type.get_rettype());
-
+static const IntegerArg *integer_literal(const Type &arg) {
+    return boost::get<IntegerArg>(&arg.variant());
 }
 
-Value TranslatorImpl::string_literal(const std::string &str) {
-    auto *result = builder.CreateGlobalStringPtr(str);
-    return Value(result, Pointer<Type>(UnsignedInt(8)));
+static const IntegerArg *integer_literal(const TemplateType &arg) {
+    return boost::get<IntegerArg>(&arg);
 }
 
-Variable TranslatorImpl::declare(const std::string &varname, const Type &t) {
-    auto *alloca = builder.CreateAlloca(to_llvm_type(t, *module),
-                                        nullptr, varname);
-    return env.add_identifier(varname, Value(alloca, Pointer<>(t)));
+static bool is_integer(const Type &arg) {
+    return integer_literal(arg);
 }
 
-void TranslatorImpl::assign(const std::string &varname, Value val,
-                            SourcePos pos) {
-    auto var = env.lookup_identifier(varname, pos);
+static bool is_integer(const TemplateType &arg) {
+    return integer_literal(arg) || boost::get<IntegerParameter>(&arg);
+}
 
-    if (!(val.get_type() == var.get_type())) {
+/**
+ * @brief Check that a template is given an argument for each of its
+ *        parameters, and integers for just its integer parameters.
+ *
+ * @tparam Arg Either a `Type` or a `TemplateType`.
+ */
+template<typename Arg>
+static void check_template_args(Symbol name,
+                                const std::vector<Symbol> &parameters,
+                                const std::vector<Arg> &args, SourcePos pos) {
+    if (args.size() != parameters.size()) {
         throw Error("type error",
-                    "cannot assign to variable of different type",
+                    "\"" + name.str() + "\" takes "
+                  + std::to_string(parameters.size())
+                  + " template arguments, not " + std::to_string(args.size()),
                     pos);
     }
 
-    // Get the address of the variable on the stack.
-    auto *load = var.get_val().to_llvm();
-
-    // Actually store the new value into that address.
-    builder.CreateStore(val.to_llvm(), load);
-}
+    for (size_t i = 0; i < args.size(); ++i) {
+        bool integer = is_integer_parameter(parameters[i]);
 
-void TranslatorImpl::create_function_prototype(Function<> f, std::string name)
-{
-    auto *ll_f = static_cast<llvm::FunctionType *>(to_llvm_type(f, *module));
-    auto *result = llvm::Function::Create(ll_f,
-                                          llvm::Function::ExternalLinkage,
-                                          name, module.get());
+        if (is_integer(args[i]) != integer) {
+            throw Error("type error",
+                        "template argument \"" + parameters[i].str()
+                      + "\" of \"" + name.str() + "\" must be "
+                      + (integer ? "an integer" : "a type"), pos);
+        }
 
-    env.add_identifier(name, Value(result, f));
+        // Integer parameters are array lengths, which can't be zero.
+        auto *literal = integer_literal(args[i]);
+        if (literal && !literal->get_value()) {
+            throw Error("type error",
+                        "integer template arguments must be positive", pos);
+        }
+    }
 }
 
-void TranslatorImpl::create_and_start_function(Function<> f,
-                                               std::vector<std::string> args,
-                                               std::string name) {
-    auto *ll_f = static_cast<llvm::FunctionType *>(to_llvm_type(f, *module));
+Value TranslatorImpl::call(Symbol func, std::vector<Type> &templ_args,
+                           std::vector<Value> &v_args, SourcePos pos) {
 
-    // Try to find the function already in the module.
-    auto *result = module->getFunction(name);
+    InstanceKey key(func, templ_args);
+    auto found = function_instances.find(key);
+
+    // If this is the first use of the instantiation, make it, and note that we
+    // need to fill it out later.
+    if (found == function_instances.end()) {
+        const auto &tv = env.lookup_template_func(func, pos);
+        check_template_args(func, tv.arg_names, templ_args, pos);
+        auto specialized_type = tv.ty.specialize(templ_args);
+        auto name = mangle_name(func.str(), templ_args);
+
+        auto *f_ty = abi.get(specialized_type).type;
+        auto *fbinding = llvm::Function::Create(
+                f_ty, llvm::Function::ExternalLinkage, name, module.get());
+        set_param_attributes(fbinding, specialized_type);
+
+        if (!external_instances || !external_instances(name)) {
+            specializations.push_back(
+                    std::pair<std::vector<Type>, TemplateValue>(templ_args,
+                                                                tv));
+        }
 
-    // If it's not there,
-    if (!result) {
-        // generate it.
-        result = llvm::Function::Create(ll_f,
-                                        llvm::Function::ExternalLinkage,
-                                        name, module.get());
+        FunctionInstance instance { specialized_type, fbinding };
+        found = function_instances.emplace(std::move(key), instance).first;
     }
 
-    env.add_identifier(name, Value(result, f));
+    const auto &instance = found->second;
+    return call_function(instance.function, instance.type, v_args);
+}
 
-    // Create the first block in the function.
-    point(Block(result, "entry"));
+Value TranslatorImpl::call_function(llvm::Function *callee,
+                                    const Function<> &type,
+                                    const std::vector<Value> &args) {
+    const auto &lowered = abi.get(type);
+    const auto &rettype = *type.get_rettype();
 
-    // Push a new namespace for the function.
-    env.push();
+    std::vector<llvm::Value *> llvm_args;
 
-    unsigned i = 0;
-    
-    for (auto &arg: result->args()) {
-        auto &ty = f.get_args()[i];
-        auto arg_addr = builder.CreateAlloca(to_llvm_type(*ty, *module));
-        builder.CreateStore(&arg, arg_addr);
-        env.add_identifier(args[i++], Value(arg_addr, Pointer<>(ty)));
+    llvm::AllocaInst *result_addr = nullptr;
+    if (lowered.result.kind == AbiValue::Indirect) {
+        result_addr = entry_alloca(rettype, "result");
+        llvm_args.push_back(result_addr);
     }
 
-    if (rettype) {
-        // TODO: Fix this code.
-        SourcePos pos(0, 0, std::make_shared<std::string>(fname));
-        throw Error("internal error", "cannot start function while inside "
-                                      "function", pos);
+    for (unsigned i = 0; i < args.size(); ++i) {
+        const auto &passed = lowered.args[i];
+
+        switch (passed.kind) {
+            case AbiValue::Direct:
+                llvm_args.push_back(args[i].to_llvm());
+                break;
+            case AbiValue::Coerced: {
+                auto parts = split_value(args[i], passed);
+                llvm_args.insert(llvm_args.end(), parts.begin(), parts.end());
+                break;
+            }
+            case AbiValue::Indirect: {
+                auto *copy = entry_alloca(args[i].get_type(), "arg");
+                store_value(args[i], copy, copy->getAlign());
+                llvm_args.push_back(copy);
+                break;
+            }
+        }
     }
 
-    rettype = f.get_rettype();
-}
-
-void TranslatorImpl::create_struct(Struct<> t) {
-    env.add_type(t.get_name(), t);
-}
-
-std::vector< std::pair< std::vector<Type>, TemplateValue> >
-TranslatorImpl::end_function(void) {
-    env.pop();
+    auto *inst = builder.CreateCall(callee, llvm_args);
+    inst->setCallingConv(callee->getCallingConv());
 
-    // Add implicit void returns.
-    if (is_type<Void>(*rettype) && !current->is_terminated()) {
-        return_(SourcePos(0, 0, std::make_shared<std::string>(fname)));
+    // The backend reads `sret` and `byval` from the call as well.
+    const auto &attrs = callee->getAttributes();
+    std::vector<llvm::AttributeSet> param_attrs;
+    for (unsigned i = 0; i < llvm_args.size(); ++i) {
+        param_attrs.push_back(attrs.getParamAttrs(i));
     }
+    inst->setAttributes(llvm::AttributeList::get(
+            context, llvm::AttributeSet(), attrs.getRetAttrs(),
+            param_attrs));
 
-    rettype = NULL;
+    if (lowered.result.kind == AbiValue::Direct) {
+        return Value(inst, rettype);
+    }
 
-    auto saved_specializations = std::move(specializations);
+    if (lowered.result.kind == AbiValue::Coerced) {
+        std::vector<llvm::Value *> parts;
+        if (lowered.result.parts.size() == 1) {
+            parts.push_back(inst);
+        } else {
+            for (unsigned i = 0; i < lowered.result.parts.size(); ++i) {
+                parts.push_back(builder.CreateExtractValue(inst, i));
+            }
+        }
 
-    specializations =
-        std::vector< std::pair< std::vector<Type>, TemplateValue > >();
+        result_addr = entry_alloca(rettype, "result");
+        store_parts(parts, lowered.result, result_addr, rettype);
+    }
 
-    return saved_specializations;
+    auto *result = builder.CreateAlignedLoad(types.get(rettype), result_addr,
+                                             result_addr->getAlign());
+    last_call = LoweredCall { result, inst };
+    return Value(result, rettype);
 }
 
-void TranslatorImpl::return_(Value val, SourcePos pos) {
-    current->return_(val);
+std::vector<llvm::Value *> TranslatorImpl::split_value(
+        const Value &val, const AbiValue &lowered) {
+    const auto &dl = module->getDataLayout();
+    auto *parts_t = llvm::StructType::get(context, lowered.parts);
+    auto *layout = dl.getStructLayout(parts_t);
+
+    auto *addr = entry_alloca(val.get_type(), "coerce");
+    builder.CreateAlignedStore(val.to_llvm(), addr, addr->getAlign());
+
+    // The last part may be wider than what is left of the value, and is
+    // then loaded from a copy with room for it.
+    llvm::AllocaInst *src = addr;
+    auto size = dl.getTypeAllocSize(addr->getAllocatedType()).getFixedSize();
+    auto last = lowered.parts.size() - 1;
+    auto end = layout->getElementOffset(last)
+             + dl.getTypeStoreSize(lowered.parts[last]).getFixedSize();
+    if (end > size) {
+        src = entry_alloca(parts_t, "coerce");
+        builder.CreateMemCpy(src, src->getAlign(), addr, addr->getAlign(),
+                             size);
+    }
+
+    auto *base = builder.CreateBitCast(src, parts_t->getPointerTo());
+    std::vector<llvm::Value *> result;
+    for (unsigned i = 0; i < lowered.parts.size(); ++i) {
+        auto *part = builder.CreateStructGEP(parts_t, base, i);
+        auto align = llvm::commonAlignment(src->getAlign(),
+                                           layout->getElementOffset(i));
+        result.push_back(builder.CreateAlignedLoad(lowered.parts[i], part,
+                                                   align));
+    }
+
+    return result;
 }
 
-void TranslatorImpl::return_(SourcePos pos) {
-    current->return_();
-}
+void TranslatorImpl::store_parts(llvm::ArrayRef<llvm::Value *> parts,
+                                 const AbiValue &lowered, llvm::Value *addr,
+                                 const Type &t) {
+    const auto &dl = module->getDataLayout();
+    auto *parts_t = llvm::StructType::get(context, lowered.parts);
+    auto *layout = dl.getStructLayout(parts_t);
 
-Value TranslatorImpl::get_identifier_addr(std::string ident, SourcePos pos) {
-    return env.lookup_identifier(ident, pos).get_val();
-}
+    llvm::Align align(types.get_alignment(t));
+    auto size = dl.getTypeAllocSize(types.get(t)).getFixedSize();
+    auto last = lowered.parts.size() - 1;
+    auto end = layout->getElementOffset(last)
+             + dl.getTypeStoreSize(lowered.parts[last]).getFixedSize();
 
-Value TranslatorImpl::get_identifier_value(std::string ident, SourcePos pos) {
-    Value addr = get_identifier_addr(ident, pos);
+    llvm::Value *dst = addr;
+    llvm::AllocaInst *tmp = nullptr;
+    if (end > size) {
+        tmp = entry_alloca(parts_t, "coerce");
+        dst = tmp;
+        align = tmp->getAlign();
+    }
 
-    assert(is_type<Pointer<> >(addr.get_type()));
+    auto *base = builder.CreateBitCast(dst, parts_t->getPointerTo());
+    for (unsigned i = 0; i < parts.size(); ++i) {
+        auto *part = builder.CreateStructGEP(parts_t, base, i);
+        builder.CreateAlignedStore(parts[i], part,
+                llvm::commonAlignment(align, layout->getElementOffset(i)));
+    }
 
-    return add_load(addr, pos);
+    if (tmp) {
+        builder.CreateMemCpy(addr, llvm::Align(types.get_alignment(t)),
+                             tmp, tmp->getAlign(), size);
+    }
 }
 
-Type TranslatorImpl::lookup_type(std::string tname, SourcePos pos) {
-    return env.lookup_type(tname, pos);
+bool TranslatorImpl::is_function(Symbol name) const {
+    return env.bound(name) || env.template_func_bound(name);
 }
 
-void TranslatorImpl::push_scope(void) { env.push(); }
-void TranslatorImpl::pop_scope(void) { env.pop(); }
-void TranslatorImpl::bind_type(std::string name, Type t) {
-    env.add_type(name, t);
+/**
+ * @brief Get the type of the given vector value, throwing an error if it is
+ *        not a vector.
+ */
+static const Vector<> &get_vector(const Value &vec, SourcePos pos) {
+    auto *ty = boost::get<Vector<> >(&vec.get_type().variant());
+    if (!ty) {
+        throw Error("type error", "expected a vector", pos);
+    }
+    return *ty;
+}
+
+/**
+ * @brief Check that `index` is a valid lane number for a vector of the given
+ *        type, throwing an error if not.
+ *
+ * Only constant indices can be checked; others out of range give an undefined
+ * result.
+ */
+static void check_lane(const Vector<> &ty, const Value &index,
+                       SourcePos pos) {
+    if (!index.is_integral()) {
+        throw Error("type error", "vector lanes must be integers", pos);
+    }
+
+    auto *constant = llvm::dyn_cast<llvm::ConstantInt>(index.to_llvm());
+    if (constant && constant->getValue().uge(ty.get_lanes())) {
+        throw Error("type error", "vector lane out of range", pos);
+    }
+}
+
+Value TranslatorImpl::splat(const Type &vec, Value val, SourcePos pos) {
+    auto *ty = boost::get<Vector<> >(&vec.variant());
+    if (!ty) {
+        throw Error("type error", "can only splat to a vector type", pos);
+    }
+
+    if (val.get_type() != *ty->get_element()) {
+        throw Error("type error", "splatted value does not match vector "
+                                  "elements", pos);
+    }
+
+    auto *inst = builder.CreateVectorSplat(ty->get_lanes(), val.to_llvm());
+    return Value(inst, vec);
+}
+
+/**
+ * @brief Check that values of a type have a size: that it is neither `Void`
+ *        nor a function.
+ */
+static void check_sized(const Type &t, SourcePos pos) {
+    if (boost::get<Void>(&t.variant())
+     || boost::get<Function<> >(&t.variant())) {
+        throw Error("type error", "void and function types have no size",
+                    pos);
+    }
+}
+
+Value TranslatorImpl::size_of(const Type &t, SourcePos pos) {
+    check_sized(t, pos);
+
+    auto size = module->getDataLayout().getTypeAllocSize(types.get(t));
+    UnsignedInt u64(64);
+    return Value(llvm::ConstantInt::get(types.get(u64), size), u64);
+}
+
+Value TranslatorImpl::align_of(const Type &t, SourcePos pos) {
+    check_sized(t, pos);
+
+    UnsignedInt u64(64);
+    return Value(llvm::ConstantInt::get(types.get(u64),
+                                        types.get_alignment(t)), u64);
+}
+
+llvm::Function *TranslatorImpl::c_allocator(const std::string &name,
+                                            llvm::FunctionType *type,
+                                            SourcePos pos) {
+    auto *f = module->getFunction(name);
+    if (f && f->getFunctionType() != type) {
+        throw Error("type error", "\"" + name + "\" is declared with a "
+                                  "different type than C's", pos);
+    }
+
+    if (!f) {
+        f = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                                   name, module.get());
+    }
+    f->addFnAttr(llvm::Attribute::NoUnwind);
+
+    return f;
+}
+
+Value TranslatorImpl::allocate(const Type &t, SourcePos pos) {
+    check_sized(t, pos);
+
+    const auto &dl = module->getDataLayout();
+    auto *size_t = dl.getIntPtrType(context);
+    auto *ptr_t = builder.getInt8PtrTy();
+
+    uint64_t size = dl.getTypeAllocSize(types.get(t)).getFixedSize();
+    uint64_t align = types.get_alignment(t);
+
+    // `malloc` aligns for any standard type: two words, on the targets
+    // LLVM supports.
+    llvm::CallInst *mem;
+    if (align <= 2 * dl.getPointerSize()) {
+        auto *malloc = c_allocator(
+                "malloc", llvm::FunctionType::get(ptr_t, { size_t }, false),
+                pos);
+        malloc->addRetAttr(llvm::Attribute::NoAlias);
+        malloc->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(
+                context, 0, llvm::None));
+        mem = builder.CreateCall(malloc,
+                                 { llvm::ConstantInt::get(size_t, size) });
+    } else {
+        auto *aligned_alloc = c_allocator(
+                "aligned_alloc",
+                llvm::FunctionType::get(ptr_t, { size_t, size_t }, false),
+                pos);
+        aligned_alloc->addRetAttr(llvm::Attribute::NoAlias);
+        aligned_alloc->addFnAttr(llvm::Attribute::getWithAllocSizeArgs(
+                context, 1, llvm::None));
+        // The size must be a multiple of the alignment.
+        mem = builder.CreateCall(aligned_alloc, {
+                llvm::ConstantInt::get(size_t, align),
+                llvm::ConstantInt::get(size_t, llvm::alignTo(size, align))
+        });
+    }
+
+    mem->addRetAttr(llvm::Attribute::getWithAlignment(context,
+                                                      llvm::Align(align)));
+
+    Pointer<> result_t(t);
+    return Value(builder.CreateBitCast(mem, types.get(result_t)), result_t);
+}
+
+Value TranslatorImpl::deallocate(const Type &t, Value pointer,
+                                 SourcePos pos) {
+    if (unqualified(pointer.get_type()) != Type(Pointer<>(t))) {
+        throw Error("type error", "can only delete a pointer to the type "
+                                  "given", pos);
+    }
+
+    auto *ptr_t = builder.getInt8PtrTy();
+    auto *free = c_allocator(
+            "free",
+            llvm::FunctionType::get(builder.getVoidTy(), { ptr_t }, false),
+            pos);
+    auto *inst = builder.CreateCall(
+            free, { builder.CreateBitCast(pointer.to_llvm(), ptr_t) });
+    return Value(inst, Void());
+}
+
+Value TranslatorImpl::extract(Value vec, Value index, SourcePos pos) {
+    const auto &ty = get_vector(vec, pos);
+    check_lane(ty, index, pos);
+
+    auto *inst = builder.CreateExtractElement(vec.to_llvm(), index.to_llvm());
+    return Value(inst, *ty.get_element());
+}
+
+Value TranslatorImpl::insert(Value vec, Value index, Value val,
+                             SourcePos pos) {
+    const auto &ty = get_vector(vec, pos);
+    check_lane(ty, index, pos);
+
+    if (val.get_type() != *ty.get_element()) {
+        throw Error("type error", "inserted value does not match vector "
+                                  "elements", pos);
+    }
+
+    auto *inst = builder.CreateInsertElement(vec.to_llvm(), val.to_llvm(),
+                                             index.to_llvm());
+    return Value(inst, vec.get_type());
+}
+
+Value TranslatorImpl::shuffle(Value lhs, Value rhs,
+                              const std::vector<Value> &indices,
+                              SourcePos pos) {
+    const auto &ty = get_vector(lhs, pos);
+    if (lhs.get_type() != rhs.get_type()) {
+        throw Error("type error", "cannot shuffle vectors of different types",
+                    pos);
+    }
+
+    if (indices.empty()) {
+        throw Error("type error", "shuffle needs at least one lane", pos);
+    }
+
+    std::vector<int> mask;
+    for (const auto &index: indices) {
+        auto *constant = llvm::dyn_cast<llvm::ConstantInt>(index.to_llvm());
+        if (!index.is_integral() || !constant) {
+            throw Error("type error",
+                        "shuffle lanes must be constant integers", pos);
+        }
+
+        if (constant->getValue().uge(2 * ty.get_lanes())) {
+            throw Error("type error", "shuffle lane out of range", pos);
+        }
+
+        mask.push_back(constant->getZExtValue());
+    }
+
+    auto *inst = builder.CreateShuffleVector(lhs.to_llvm(), rhs.to_llvm(),
+                                             mask);
+    return Value(inst, Vector<>(*ty.get_element(), mask.size()));
+}
+
+Value TranslatorImpl::reduce(Reduction op, Value vec, SourcePos pos) {
+    const auto &ty = get_vector(vec, pos);
+    const auto &element = *ty.get_element();
+    auto *v = vec.to_llvm();
+
+    llvm::Value *inst = nullptr;
+
+    if (is_type<Float>(element)) {
+        auto *elem_ty = types.get(element);
+
+        switch (op) {
+        case Reduction::Add:
+            inst = builder.CreateFAddReduce(
+                    llvm::ConstantFP::getNegativeZero(elem_ty), v);
+            break;
+        case Reduction::Mul:
+            inst = builder.CreateFMulReduce(
+                    llvm::ConstantFP::get(elem_ty, 1.0), v);
+            break;
+        case Reduction::Min:
+            inst = builder.CreateFPMinReduce(v);
+            break;
+        case Reduction::Max:
+            inst = builder.CreateFPMaxReduce(v);
+            break;
+        default:
+            throw Error("type error", "cannot perform bitwise operations on "
+                                      "vectors of floats", pos);
+        }
+
+        /* Without reassociation, LLVM must add the lanes one at a time. */
+        llvm::cast<llvm::Instruction>(inst)->setHasAllowReassoc(true);
+    } else {
+        bool is_signed = is_type<SignedInt>(element);
+
+        switch (op) {
+        case Reduction::Add:
+            inst = builder.CreateAddReduce(v);
+            break;
+        case Reduction::Mul:
+            inst = builder.CreateMulReduce(v);
+            break;
+        case Reduction::Min:
+            inst = builder.CreateIntMinReduce(v, is_signed);
+            break;
+        case Reduction::Max:
+            inst = builder.CreateIntMaxReduce(v, is_signed);
+            break;
+        case Reduction::And:
+            inst = builder.CreateAndReduce(v);
+            break;
+        case Reduction::Or:
+            inst = builder.CreateOrReduce(v);
+            break;
+        case Reduction::Xor:
+            inst = builder.CreateXorReduce(v);
+            break;
+        }
+    }
+
+    return Value(inst, element);
+}
+
+Value TranslatorImpl::intrinsic(Intrinsic op, const std::vector<Value> &args,
+                                SourcePos pos) {
+    const auto &ty = args[0].get_type();
+    const auto &element = scalar_type(ty);
+    auto *ll_ty = args[0].to_llvm()->getType();
+
+    bool on_floats = op == Intrinsic::Sqrt
+                  || op == Intrinsic::FusedMultiplyAdd;
+    bool rotate = op == Intrinsic::RotateLeft
+               || op == Intrinsic::RotateRight;
+
+    if (on_floats && !is_type<Float>(element)) {
+        throw Error("type error", "square roots and fused multiply-adds only "
+                                  "apply to floats", pos);
+    }
+
+    if (!on_floats && !is_type<SignedInt>(element)
+                   && !is_type<UnsignedInt>(element)) {
+        throw Error("type error", "bit operations only apply to integers",
+                    pos);
+    }
+
+    std::vector<llvm::Value *> operands;
+    for (unsigned i = 0; i < args.size(); ++i) {
+        auto *operand = args[i].to_llvm();
+
+        // Scalars are rotated modulo their width whatever the width of the
+        // amount, as for shifts.
+        if (rotate && i == 1 && &element == &ty
+                && args[i].is_integral()) {
+            operand = builder.CreateIntCast(operand, ll_ty, false);
+        } else if (unqualified(args[i].get_type()) != unqualified(ty)) {
+            throw Error("type error", "operands of builtin do not have the "
+                                      "same type", pos);
+        }
+
+        operands.push_back(operand);
+    }
+
+    llvm::Value *inst = nullptr;
+    switch (op) {
+    case Intrinsic::Popcount:
+        inst = builder.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop,
+                                            operands[0]);
+        break;
+    case Intrinsic::CountLeadingZeros:
+    case Intrinsic::CountTrailingZeros:
+        // Defined for 0, which gives the width; a test against 0 before a
+        // count folds into this.
+        inst = builder.CreateBinaryIntrinsic(
+                op == Intrinsic::CountLeadingZeros ? llvm::Intrinsic::ctlz
+                                                   : llvm::Intrinsic::cttz,
+                operands[0], builder.getFalse());
+        break;
+    case Intrinsic::ByteSwap:
+        if (ll_ty->getScalarSizeInBits() % 16) {
+            throw Error("type error", "can only swap the bytes of integers of "
+                                      "an even number of bytes", pos);
+        }
+        inst = builder.CreateUnaryIntrinsic(llvm::Intrinsic::bswap,
+                                            operands[0]);
+        break;
+    case Intrinsic::RotateLeft:
+    case Intrinsic::RotateRight:
+        // A funnel shift of a value with itself is a rotate.
+        inst = builder.CreateIntrinsic(
+                op == Intrinsic::RotateLeft ? llvm::Intrinsic::fshl
+                                            : llvm::Intrinsic::fshr,
+                { ll_ty }, { operands[0], operands[0], operands[1] });
+        break;
+    case Intrinsic::Sqrt:
+        inst = builder.CreateUnaryIntrinsic(llvm::Intrinsic::sqrt,
+                                            operands[0]);
+        break;
+    case Intrinsic::FusedMultiplyAdd:
+        inst = builder.CreateIntrinsic(llvm::Intrinsic::fma, { ll_ty },
+                                       operands);
+        break;
+    }
+
+    return Value(inst, ty);
+}
+
+Value TranslatorImpl::expect(Value cond, bool likely, SourcePos pos) {
+    if (!cond.to_llvm()->getType()->isIntegerTy(1)) {
+        throw Error("type error", "only booleans can be expected", pos);
+    }
+
+    auto *inst = builder.CreateIntrinsic(
+            llvm::Intrinsic::expect, { builder.getInt1Ty() },
+            { cond.to_llvm(), builder.getInt1(likely) });
+    return Value(inst, UnsignedInt(1));
+}
+
+Value TranslatorImpl::prefetch(Value pointer, bool write,
+                               boost::optional<Value> locality,
+                               SourcePos pos) {
+    if (!is_type<Pointer<> >(pointer.get_type())) {
+        throw Error("type error", "can only prefetch through a pointer", pos);
+    }
+
+    uint64_t level = 3;
+    if (locality) {
+        auto *constant = llvm::dyn_cast<llvm::ConstantInt>(
+                locality->to_llvm());
+        if (!locality->is_integral() || !constant
+         || constant->getValue().ugt(3)) {
+            throw Error("type error",
+                        "prefetch locality must be a constant from "
+                        "0 to 3", pos);
+        }
+        level = constant->getZExtValue();
+    }
+
+    auto *i8_ptr = builder.getInt8PtrTy(
+            pointer.to_llvm()->getType()->getPointerAddressSpace());
+    auto *address = builder.CreateBitCast(pointer.to_llvm(), i8_ptr);
+
+    // The last operand selects the data rather than the instruction cache.
+    auto *inst = builder.CreateIntrinsic(
+            llvm::Intrinsic::prefetch, { i8_ptr },
+            { address, builder.getInt32(write), builder.getInt32(level),
+              builder.getInt32(1) });
+
+    return Value(inst, Void());
+}
+
+static llvm::AtomicOrdering llvm_ordering(AtomicOrdering ordering) {
+    switch (ordering) {
+    case AtomicOrdering::Relaxed:
+        return llvm::AtomicOrdering::Monotonic;
+    case AtomicOrdering::Acquire:
+        return llvm::AtomicOrdering::Acquire;
+    case AtomicOrdering::Release:
+        return llvm::AtomicOrdering::Release;
+    case AtomicOrdering::AcqRel:
+        return llvm::AtomicOrdering::AcquireRelease;
+    case AtomicOrdering::SeqCst:
+        break;
+    }
+
+    return llvm::AtomicOrdering::SequentiallyConsistent;
+}
+
+const Type &TranslatorImpl::atomic_pointee(const Value &pointer,
+                                           SourcePos pos) {
+    auto *pointer_ty = boost::get<Pointer<> >(&pointer.get_type().variant());
+    if (!pointer_ty) {
+        throw Error("type error", "atomic operations need a pointer", pos);
+    }
+
+    const auto &pointed = *pointer_ty->get_pointed();
+    if (is_type<Pointer<> >(pointed)) return pointed;
+
+    int nbits = 0;
+    if (auto *t = boost::get<SignedInt>(&pointed.variant())) {
+        nbits = t->get_nbits();
+    } else if (auto *t = boost::get<UnsignedInt>(&pointed.variant())) {
+        nbits = t->get_nbits();
+    }
+
+    if (nbits != 8 && nbits != 16 && nbits != 32 && nbits != 64) {
+        throw Error("type error", "atomic operations only apply to pointers "
+                                  "and 8, 16, 32 or 64-bit integers", pos);
+    }
+
+    return pointed;
+}
+
+/**
+ * @brief Check that a value stored by an atomic operation has the type the
+ *        operation acts on.
+ */
+static void check_atomic_operand(const Value &val, const Type &t,
+                                 SourcePos pos) {
+    if (unqualified(val.get_type()) != unqualified(t)) {
+        throw Error("type error", "atomic operand does not match the type "
+                                  "pointed to", pos);
+    }
+}
+
+Value TranslatorImpl::atomic_load(Value pointer, AtomicOrdering ordering,
+                                  SourcePos pos) {
+    const auto &t = atomic_pointee(pointer, pos);
+
+    if (ordering == AtomicOrdering::Release
+     || ordering == AtomicOrdering::AcqRel) {
+        throw Error("type error", "atomic loads cannot have release ordering",
+                    pos);
+    }
+
+    llvm::Align align(pointee_align(pointer));
+    auto *inst = builder.CreateAlignedLoad(types.get(t), pointer.to_llvm(),
+                                           align);
+    inst->setAtomic(llvm_ordering(ordering));
+    note_access(inst, pointer);
+
+    return Value(inst, t);
+}
+
+Value TranslatorImpl::atomic_store(Value pointer, Value val,
+                                   AtomicOrdering ordering, SourcePos pos) {
+    const auto &t = atomic_pointee(pointer, pos);
+    check_atomic_operand(val, t, pos);
+
+    if (ordering == AtomicOrdering::Acquire
+     || ordering == AtomicOrdering::AcqRel) {
+        throw Error("type error", "atomic stores cannot have acquire ordering",
+                    pos);
+    }
+
+    if (constant_global(pointer)) {
+        throw Error("type error", "cannot assign to constant", pos);
+    }
+
+    auto *inst = builder.CreateAlignedStore(
+            val.to_llvm(), pointer.to_llvm(),
+            llvm::Align(pointee_align(pointer)));
+    inst->setAtomic(llvm_ordering(ordering));
+    note_access(inst, pointer);
+
+    return Value(inst, Void());
+}
+
+Value TranslatorImpl::atomic_rmw(AtomicOp op, Value pointer, Value val,
+                                 AtomicOrdering ordering, SourcePos pos) {
+    const auto &t = atomic_pointee(pointer, pos);
+    check_atomic_operand(val, t, pos);
+
+    bool is_pointer = is_type<Pointer<> >(t);
+    if (is_pointer && op != AtomicOp::Xchg) {
+        throw Error("type error", "atomic arithmetic only applies to "
+                                  "integers", pos);
+    }
+
+    if (constant_global(pointer)) {
+        throw Error("type error", "cannot assign to constant", pos);
+    }
+
+    llvm::AtomicRMWInst::BinOp ll_op = llvm::AtomicRMWInst::Xchg;
+    switch (op) {
+    case AtomicOp::Xchg:
+        break;
+    case AtomicOp::Add:
+        ll_op = llvm::AtomicRMWInst::Add;
+        break;
+    case AtomicOp::Sub:
+        ll_op = llvm::AtomicRMWInst::Sub;
+        break;
+    case AtomicOp::And:
+        ll_op = llvm::AtomicRMWInst::And;
+        break;
+    case AtomicOp::Or:
+        ll_op = llvm::AtomicRMWInst::Or;
+        break;
+    case AtomicOp::Xor:
+        ll_op = llvm::AtomicRMWInst::Xor;
+        break;
+    }
+
+    // LLVM only exchanges integers, so pointers go through one of their
+    // size.
+    auto *address = pointer.to_llvm();
+    auto *operand = val.to_llvm();
+    if (is_pointer) {
+        auto *int_t = module->getDataLayout().getIntPtrType(context);
+        address = builder.CreateBitCast(address, int_t->getPointerTo());
+        operand = builder.CreatePtrToInt(operand, int_t);
+    }
+
+    auto *inst = builder.CreateAtomicRMW(
+            ll_op, address, operand, llvm::Align(pointee_align(pointer)),
+            llvm_ordering(ordering));
+    note_access(inst, pointer);
+
+    llvm::Value *result = inst;
+    if (is_pointer) result = builder.CreateIntToPtr(inst, types.get(t));
+
+    return Value(result, t);
+}
+
+Value TranslatorImpl::atomic_cmpxchg(Value pointer, Value expected,
+                                     Value desired, bool weak,
+                                     AtomicOrdering ordering, SourcePos pos) {
+    const auto &t = atomic_pointee(pointer, pos);
+    check_atomic_operand(desired, t, pos);
+
+    auto *expected_ty = boost::get<Pointer<> >(&expected.get_type().variant());
+    if (!expected_ty
+     || unqualified(*expected_ty->get_pointed()) != unqualified(t)) {
+        throw Error("type error", "expected value of atomic exchange must be "
+                                  "passed by pointer", pos);
+    }
+
+    if (constant_global(pointer)) {
+        throw Error("type error", "cannot assign to constant", pos);
+    }
+
+    // A failed exchange only loads, so it can't release.
+    auto failure = ordering == AtomicOrdering::AcqRel
+                 ? AtomicOrdering::Acquire
+                 : ordering == AtomicOrdering::Release
+                 ? AtomicOrdering::Relaxed
+                 : ordering;
+
+    auto old = add_load(expected, pos);
+    auto *inst = builder.CreateAtomicCmpXchg(
+            pointer.to_llvm(), old.to_llvm(), desired.to_llvm(),
+            llvm::Align(pointee_align(pointer)), llvm_ordering(ordering),
+            llvm_ordering(failure));
+    inst->setWeak(weak);
+    note_access(inst, pointer);
+
+    auto *found = builder.CreateExtractValue(inst, 0);
+    add_store(expected, Value(found, t), pos);
+
+    auto *success = builder.CreateExtractValue(inst, 1);
+    return Value(success, UnsignedInt(1));
+}
+
+Value TranslatorImpl::atomic_fence(AtomicOrdering ordering, SourcePos pos) {
+    if (ordering == AtomicOrdering::Relaxed) {
+        throw Error("type error", "fences cannot be relaxed", pos);
+    }
+
+    return Value(builder.CreateFence(llvm_ordering(ordering)), Void());
+}
+
+Value TranslatorImpl::string_literal(const std::string &str) {
+    auto *result = builder.CreateGlobalStringPtr(str);
+    return Value(result, Pointer<Type>(UnsignedInt(8)));
+}
+
+Value TranslatorImpl::zero(const Type &t) {
+    return Value(llvm::Constant::getNullValue(types.get(t)), t);
+}
+
+Variable TranslatorImpl::declare(Symbol varname, const Type &t) {
+    auto *alloca = entry_alloca(t, varname.str());
+    add_restrict_variable(alloca, t);
+    if (debug) {
+        debug->declare_variable(varname, t, alloca, 0,
+                                builder.getCurrentDebugLocation());
+    }
+    return env.add_identifier(varname, Value(alloca, Pointer<>(t)));
+}
+
+void TranslatorImpl::assign(Symbol varname, Value val,
+                            SourcePos pos) {
+    auto var = env.lookup_identifier(varname, pos);
+
+    if (unqualified(val.get_type()) != unqualified(var.get_type())) {
+        throw Error("type error",
+                    "cannot assign to variable of different type",
+                    pos);
+    }
+
+    if (constant_global(var.get_val())) {
+        throw Error("type error", "cannot assign to constant", pos);
+    }
+
+    // Store the new value into the variable's address on the stack.
+    store_value(val, var.get_val().to_llvm(),
+                llvm::Align(types.get_alignment(val.get_type())));
+}
+
+void TranslatorImpl::raise_alignment(llvm::AllocaInst *alloca,
+                                     const Type &t) {
+    llvm::Align align(types.get_alignment(t));
+    if (align > alloca->getAlign()) alloca->setAlignment(align);
+}
+
+llvm::AllocaInst *TranslatorImpl::entry_alloca(const Type &t,
+                                               const std::string &name) {
+    // The coroutine split also relies on this, to move variables live
+    // across suspend points into the frame.
+    auto *result = entry_alloca(types.get(t), name);
+    raise_alignment(result, t);
+    return result;
+}
+
+llvm::AllocaInst *TranslatorImpl::entry_alloca(llvm::Type *t,
+                                               const std::string &name) {
+    auto &entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entry_builder(&entry, entry.begin());
+    return entry_builder.CreateAlloca(t, nullptr, name);
+}
+
+void TranslatorImpl::create_function_prototype(
+        Function<> f, std::string name, SourcePos pos,
+        const FunctionAttributes &attrs) {
+    if (attrs.async) f = async_function(name, f);
+
+    auto *ll_f = abi.get(f).type;
+
+    // Declarations may be repeated, say by a file and what it imports.
+    auto *result = module->getFunction(name);
+    bool conflicting = result && (result->getFunctionType() != ll_f
+            || (env.bound(name)
+             && env.lookup_identifier(name, pos).get_val().get_type() != f));
+    if (conflicting) {
+        throw Error("type error", "conflicting declarations of \""
+                                + name + "\"", pos);
+    }
+
+    if (!result) {
+        result = llvm::Function::Create(ll_f,
+                                        llvm::Function::ExternalLinkage,
+                                        name, module.get());
+    }
+    set_attributes(result, attrs);
+    set_param_attributes(result, f);
+    set_allocator_attributes(result, f, attrs, pos);
+
+    env.add_identifier(name, Value(result, f));
+}
+
+void TranslatorImpl::create_and_start_function(
+        Function<> f, std::vector<Symbol> args, std::string name,
+        SourcePos pos, const FunctionAttributes &attrs) {
+    auto result_type = *f.get_rettype();
+    if (attrs.async) f = async_function(name, f);
+
+    const auto &lowered = abi.get(f);
+    auto *ll_f = lowered.type;
+
+    // Try to find the function already in the module.
+    auto *result = module->getFunction(name);
+
+    if (result && !result->empty()) {
+        throw Error("name error", "redefinition of \"" + name + "\"", pos);
+    }
+    if (result && result->getFunctionType() != ll_f) {
+        throw Error("type error", "conflicting declarations of \""
+                                + name + "\"", pos);
+    }
+
+    // If it's not there,
+    if (!result) {
+        // generate it.
+        result = llvm::Function::Create(ll_f,
+                                        llvm::Function::ExternalLinkage,
+                                        name, module.get());
+    }
+
+    set_target_attributes(result, attrs);
+    set_attributes(result, attrs);
+    set_param_attributes(result, f);
+    set_allocator_attributes(result, f, attrs, pos);
+    // The versions of an instance with `@target_clones` stay internal.
+    if (is_mangled_name(name) && !result->hasLocalLinkage()) {
+        make_mergeable(result);
+    }
+
+    // The builder puts the flags on every floating-point instruction.
+    auto flags = attrs.fast_math ? *attrs.fast_math : fast_math;
+    builder.setFastMathFlags(llvm_fast_math(flags));
+    set_fast_math_attributes(result, flags);
+
+    env.add_identifier(name, Value(result, f));
+
+    // The prologue is attributed to the function itself.
+    builder.SetCurrentDebugLocation(llvm::DebugLoc());
+    if (debug) debug->start_function(result, f, pos);
+
+    // Create the first block in the function.
+    point(Block(result, "entry"));
+
+    if (attrs.async) start_coroutine(result, result_type, pos);
+
+    // Push a new namespace for the function.
+    env.push();
+
+    function_abi = &lowered;
+
+    for (unsigned i = 0; i < args.size(); ++i) {
+        const auto &ty = f.get_args()[i];
+        const auto &passed = lowered.args[i];
+        auto *param = result->getArg(lowered.params[i]);
+
+        // A copy passed in memory is the callee's own, and can be used in
+        // place; except by a coroutine, which outlives it.
+        if (passed.kind == AbiValue::Indirect && !attrs.async) {
+            param->setName(args[i].str());
+            if (debug) {
+                debug->declare_variable(args[i], ty, param, i + 1,
+                                        llvm::DebugLoc());
+            }
+            env.add_identifier(args[i], Value(param, Pointer<>(ty)));
+            continue;
+        }
+
+        auto *arg_addr = entry_alloca(ty, args[i].str());
+        add_restrict_variable(arg_addr, ty);
+        llvm::Align align(types.get_alignment(ty));
+
+        switch (passed.kind) {
+            case AbiValue::Direct:
+                builder.CreateAlignedStore(param, arg_addr, align);
+                break;
+            case AbiValue::Coerced: {
+                std::vector<llvm::Value *> parts;
+                for (unsigned j = 0; j < passed.parts.size(); ++j) {
+                    parts.push_back(result->getArg(lowered.params[i] + j));
+                }
+                store_parts(parts, passed, arg_addr, ty);
+                break;
+            }
+            case AbiValue::Indirect: {
+                const auto &dl = module->getDataLayout();
+                auto size = dl.getTypeAllocSize(types.get(ty));
+                builder.CreateMemCpy(arg_addr, align, param,
+                                     llvm::Align(passed.align),
+                                     size.getFixedSize());
+                break;
+            }
+        }
+
+        if (debug) {
+            debug->declare_variable(args[i], ty, arg_addr, i + 1,
+                                    llvm::DebugLoc());
+        }
+        env.add_identifier(args[i], Value(arg_addr, Pointer<>(ty)));
+    }
+
+    if (rettype) {
+        // TODO: Fix this code.
+        auto pos = sources.start_of(fname);
+        throw Error("internal error", "cannot start function while inside "
+                                      "function", pos);
+    }
+
+    rettype = result_type;
+}
+
+namespace {
+
+/**
+ * @brief A CPU feature which the C runtime's CPU detection records in
+ *        `__cpu_model`, as for GCC's `__builtin_cpu_supports`.
+ */
+struct CpuFeature {
+    const char *name;
+
+    /** @brief Its bit in `__cpu_model` or, from 32 on, `__cpu_features2`. */
+    unsigned bit;
+
+    /** @brief Higher for features of newer CPUs, whose versions win. */
+    unsigned priority;
+};
+
+const CpuFeature cpu_features[] = {
+#define X86_FEATURE_COMPAT(ENUM, STR, PRIORITY) \
+    { STR, llvm::X86::FEATURE_##ENUM, PRIORITY },
+#include "llvm/Support/X86TargetParser.def"
+};
+
+}
+
+/**
+ * @brief Emit a check of whether the CPU has a feature, once the runtime has
+ *        filled in what it has.
+ */
+static llvm::Value *cpu_supports(llvm::IRBuilder<> &b, llvm::Module &module,
+                                 const CpuFeature &feature) {
+    auto *i32 = b.getInt32Ty();
+
+    llvm::Value *word;
+    if (feature.bit < 32) {
+        // The vendor, type, subtype and features.
+        auto *model_t = llvm::StructType::get(i32, i32, i32,
+                                              llvm::ArrayType::get(i32, 1));
+        auto *model = module.getOrInsertGlobal("__cpu_model", model_t);
+        auto *features = b.CreateInBoundsGEP(
+                model_t, model, { b.getInt32(0), b.getInt32(3),
+                                  b.getInt32(0) });
+        word = b.CreateAlignedLoad(i32, features, llvm::Align(4));
+    } else {
+        auto *features2 = module.getOrInsertGlobal("__cpu_features2", i32);
+        word = b.CreateAlignedLoad(i32, features2, llvm::Align(4));
+    }
+
+    auto *mask = b.getInt32(1u << (feature.bit % 32));
+    return b.CreateICmpNE(b.CreateAnd(word, mask), b.getInt32(0));
+}
+
+std::vector<std::pair<std::string, FunctionAttributes> >
+TranslatorImpl::create_dispatcher(Function<> f, std::string name,
+                                  SourcePos pos,
+                                  const FunctionAttributes &attrs) {
+    if (llvm::Triple(module->getTargetTriple()).getArch()
+            != llvm::Triple::x86_64) {
+        throw Error("annotation error",
+                    "@target_clones is only supported on x86-64", pos);
+    }
+    if (attrs.async) {
+        throw Error("annotation error",
+                    "async functions cannot have @target_clones", pos);
+    }
+
+    std::vector<const CpuFeature *> features;
+    for (const auto &clone: attrs.target_clones) {
+        auto found = std::find_if(
+                std::begin(cpu_features), std::end(cpu_features),
+                [&](const CpuFeature &feature) {
+                    return clone == feature.name;
+                });
+        if (found == std::end(cpu_features)) {
+            throw Error("annotation error",
+                        "unknown CPU feature \"" + clone + "\"", pos);
+        }
+        if (std::count(features.begin(), features.end(), &*found)) {
+            throw Error("annotation error",
+                        "repeated CPU feature \"" + clone + "\"", pos);
+        }
+        features.push_back(&*found);
+    }
+
+    // Best first.
+    std::stable_sort(features.begin(), features.end(),
+                     [](const CpuFeature *l, const CpuFeature *r) {
+                         return l->priority > r->priority;
+                     });
+
+    std::vector<std::pair<std::string, FunctionAttributes> > result;
+    auto version_attrs = attrs;
+    version_attrs.target_clones.clear();
+    for (const auto *feature: features) {
+        version_attrs.target_features = std::string("+") + feature->name;
+        result.emplace_back(name + "." + feature->name, version_attrs);
+    }
+    version_attrs.target_features.clear();
+    result.emplace_back(name + ".default", version_attrs);
+
+    create_function_prototype(f, name, pos, attrs);
+    auto *dispatcher = module->getFunction(name);
+    if (!dispatcher->empty()) {
+        throw Error("name error", "redefinition of \"" + name + "\"", pos);
+    }
+    set_target_attributes(dispatcher, FunctionAttributes());
+    if (is_mangled_name(name)) make_mergeable(dispatcher);
+
+    // The versions are only called through the dispatcher.
+    const auto &lowered = abi.get(f);
+    std::vector<llvm::Function *> versions;
+    for (const auto &version: result) {
+        auto *v = llvm::Function::Create(lowered.type,
+                                         llvm::Function::InternalLinkage,
+                                         version.first, module.get());
+        set_attributes(v, version.second);
+        set_param_attributes(v, f);
+        versions.push_back(v);
+    }
+
+    // The resolver picks a version, as an ifunc resolver would, by its
+    // number counting from 1.  The runtime's CPU detection may not have run
+    // yet when it is called, but is cheap to run again.
+    auto *i32 = llvm::Type::getInt32Ty(context);
+    auto *resolver = llvm::Function::Create(
+            llvm::FunctionType::get(i32, false),
+            llvm::Function::InternalLinkage, name + ".resolver",
+            module.get());
+    resolver->addFnAttr(llvm::Attribute::Cold);
+    resolver->addFnAttr(llvm::Attribute::NoInline);
+    resolver->addFnAttr(llvm::Attribute::NoUnwind);
+
+    llvm::IRBuilder<> b(llvm::BasicBlock::Create(context, "entry", resolver));
+    auto init = module->getOrInsertFunction(
+            "__cpu_indicator_init",
+            llvm::FunctionType::get(b.getVoidTy(), false));
+    b.CreateCall(init);
+
+    llvm::Value *best = b.getInt32(versions.size());
+    for (size_t i = features.size(); i-- > 0;) {
+        best = b.CreateSelect(cpu_supports(b, *module, *features[i]),
+                              b.getInt32(i + 1), best);
+    }
+    b.CreateRet(best);
+
+    // The dispatcher remembers the choice, 0 until it is made, and calls the
+    // version directly with the arguments as they came.  (A pointer to it
+    // would need relocating at load time in position-independent code.)
+    auto *chosen = new llvm::GlobalVariable(
+            *module, i32, false, llvm::GlobalValue::InternalLinkage,
+            b.getInt32(0), name + ".chosen");
+
+    if (dispatcher->hasComdat()) {
+        chosen->setComdat(dispatcher->getComdat());
+        resolver->setComdat(dispatcher->getComdat());
+        for (auto *v: versions) v->setComdat(dispatcher->getComdat());
+    }
+
+    auto *entry = llvm::BasicBlock::Create(context, "entry", dispatcher);
+    auto *choose = llvm::BasicBlock::Create(context, "choose", dispatcher);
+    auto *dispatch = llvm::BasicBlock::Create(context, "dispatch",
+                                              dispatcher);
+
+    b.SetInsertPoint(entry);
+    auto *known = b.CreateAlignedLoad(i32, chosen, llvm::Align(4));
+    known->setAtomic(llvm::AtomicOrdering::Monotonic);
+    auto weights = llvm::MDBuilder(context).createBranchWeights(1, 2000);
+    b.CreateCondBr(b.CreateIsNull(known), choose, dispatch, weights);
+
+    b.SetInsertPoint(choose);
+    auto *picked = b.CreateCall(resolver);
+    b.CreateAlignedStore(picked, chosen, llvm::Align(4))
+     ->setAtomic(llvm::AtomicOrdering::Monotonic);
+    b.CreateBr(dispatch);
+
+    b.SetInsertPoint(dispatch);
+    auto *index = b.CreatePHI(i32, 2);
+    index->addIncoming(known, entry);
+    index->addIncoming(picked, choose);
+
+    std::vector<llvm::Value *> args;
+    for (auto &arg: dispatcher->args()) args.push_back(&arg);
+
+    const auto &fn_attrs = dispatcher->getAttributes();
+    std::vector<llvm::AttributeSet> param_attrs;
+    for (unsigned i = 0; i < args.size(); ++i) {
+        param_attrs.push_back(fn_attrs.getParamAttrs(i));
+    }
+    auto call_attrs = llvm::AttributeList::get(
+            context, llvm::AttributeSet(), fn_attrs.getRetAttrs(),
+            param_attrs);
+
+    std::vector<llvm::BasicBlock *> calls;
+    for (auto *v: versions) {
+        auto *call_b = llvm::BasicBlock::Create(context,
+                                                "call." + v->getName(),
+                                                dispatcher);
+        calls.push_back(call_b);
+
+        b.SetInsertPoint(call_b);
+        auto *call = b.CreateCall(v, args);
+        call->setCallingConv(v->getCallingConv());
+        call->setAttributes(call_attrs);
+        // Not `musttail`: LLVM 14 mishandles it forwarding `byval`
+        // arguments, and in recursive functions.  The backend makes these
+        // jumps anyway when optimizing.
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        if (call->getType()->isVoidTy()) {
+            b.CreateRetVoid();
+        } else {
+            b.CreateRet(call);
+        }
+    }
+
+    // The default version is the last.
+    b.SetInsertPoint(dispatch);
+    auto *sw = b.CreateSwitch(index, calls.back(), versions.size() - 1);
+    for (unsigned i = 0; i + 1 < versions.size(); ++i) {
+        sw->addCase(b.getInt32(i + 1), calls[i]);
+    }
+
+    return result;
+}
+
+void TranslatorImpl::create_struct(Struct<> t) {
+    env.add_type(t.get_name(), t);
+}
+
+std::vector< std::pair< std::vector<Type>, TemplateValue> >
+TranslatorImpl::end_function(void) {
+    env.pop();
+
+    // Add implicit void returns.
+    if (is_type<Void>(*rettype) && !current->is_terminated()) {
+        return_(SourcePos());
+    }
+
+    rettype = boost::none;
+    function_abi = nullptr;
+    last_call = LoweredCall { nullptr, nullptr };
+
+    if (coroutine) end_coroutine();
+
+    add_alias_metadata();
+
+    if (debug) debug->end_function();
+    builder.SetCurrentDebugLocation(llvm::DebugLoc());
+    builder.clearFastMathFlags();
+
+    auto saved_specializations = std::move(specializations);
+
+    specializations =
+        std::vector< std::pair< std::vector<Type>, TemplateValue > >();
+
+    return saved_specializations;
+}
+
+void TranslatorImpl::return_(Value val, SourcePos pos) {
+    if (!coroutine) {
+        auto kind = function_abi ? function_abi->result.kind
+                                 : AbiValue::Direct;
+        const auto &t = val.get_type();
+
+        switch (kind) {
+            case AbiValue::Direct:
+                current->return_(val);
+                break;
+            case AbiValue::Coerced: {
+                const auto &lowered = function_abi->result;
+                auto parts = split_value(val, lowered);
+                llvm::Value *ret = parts[0];
+                if (parts.size() > 1) {
+                    ret = llvm::UndefValue::get(
+                            llvm::StructType::get(context, lowered.parts));
+                    for (unsigned i = 0; i < parts.size(); ++i) {
+                        ret = builder.CreateInsertValue(ret, parts[i], i);
+                    }
+                }
+                current->return_(Value(ret, t));
+                break;
+            }
+            case AbiValue::Indirect: {
+                auto *sret = builder.GetInsertBlock()->getParent()->getArg(0);
+                store_value(val, sret,
+                            llvm::Align(function_abi->result.align));
+                current->return_();
+                break;
+            }
+        }
+        return;
+    }
+
+    // The result is left in the promise for the awaiting caller to read.
+    if (unqualified(val.get_type()) != unqualified(*rettype)) {
+        throw Error("type error", "returned value does not match the result "
+                                  "type of the async function", pos);
+    }
+
+    builder.CreateStore(val.to_llvm(), coroutine->promise)
+           ->setAlignment(coroutine->promise->getAlign());
+    current->jump_to(coroutine->final_suspend);
+}
+
+void TranslatorImpl::return_(SourcePos pos) {
+    if (!coroutine) {
+        current->return_();
+        return;
+    }
+
+    current->jump_to(coroutine->final_suspend);
+}
+
+void TranslatorImpl::tail_return(Value call, SourcePos pos) {
+    if (coroutine) {
+        throw Error("type error",
+                    "async functions cannot become another", pos);
+    }
+
+    auto ret = [&] {
+        if (is_type<Void>(call.get_type())) {
+            current->return_();
+        } else {
+            current->return_(call);
+        }
+    };
+
+    // A call folded to a constant leaves nothing to call.
+    auto *inst = llvm::dyn_cast<llvm::CallInst>(call.to_llvm());
+    bool lowered = !inst && call.to_llvm() == last_call.result;
+    if (lowered) inst = last_call.call;
+    if (!inst) {
+        ret();
+        return;
+    }
+
+    auto *caller = inst->getFunction();
+    auto *callee = inst->getCalledFunction();
+    if (!callee || callee->getFunctionType() != caller->getFunctionType()
+     || callee->getCallingConv() != caller->getCallingConv()) {
+        throw Error("type error", "can only become a function with the same "
+                                  "argument and result types and calling "
+                                  "convention", pos);
+    }
+
+    // Copies the caller makes are gone once it is.
+    for (const auto &arg: function_abi->args) {
+        if (arg.kind == AbiValue::Indirect && !arg.byval) {
+            throw Error("type error",
+                        "cannot become a function taking structs "
+                        "in memory on this target", pos);
+        }
+    }
+
+    inst->setTailCallKind(llvm::CallInst::TCK_MustTail);
+
+    if (!lowered) {
+        ret();
+        return;
+    }
+
+    // The result goes straight to our own caller, as it was passed.
+    auto *block = inst->getParent();
+    while (&block->back() != inst) block->back().eraseFromParent();
+    last_call = LoweredCall { nullptr, nullptr };
+
+    if (function_abi->result.kind == AbiValue::Indirect) {
+        inst->setArgOperand(0, caller->getArg(0));
+        current->return_();
+    } else {
+        current->return_(Value(inst, call.get_type()));
+    }
+}
+
+Function<> TranslatorImpl::async_function(const std::string &name,
+                                          const Function<> &f) {
+    async_results.erase(name);
+    async_results.emplace(name, *f.get_rettype());
+    return Function<>(Pointer<>(UnsignedInt(8)), f.get_args());
+}
+
+llvm::Function *TranslatorImpl::async_hook(Symbol name,
+                                           const Function<> &type,
+                                           const std::string &declaration,
+                                           SourcePos pos) {
+    if (!env.bound(name)) {
+        throw Error("name error", "async functions need \"" + declaration
+                                + "\" to manage their frames", pos);
+    }
+
+    auto hook = env.lookup_identifier(name, pos).get_val();
+    if (hook.get_type() != Type(type)) {
+        throw Error("type error", "\"" + name.str() + "\" must be declared "
+                                  "as \"" + declaration + "\"", pos);
+    }
+
+    return llvm::cast<llvm::Function>(hook.to_llvm());
+}
+
+void TranslatorImpl::start_coroutine(llvm::Function *f, const Type &result,
+                                     SourcePos pos) {
+    Type handle_t = Pointer<>(UnsignedInt(8));
+    auto *alloc = async_hook("async_alloc",
+                             Function<>(handle_t, { UnsignedInt(64) }),
+                             "fn async_alloc(U64 size) -> U8 *", pos);
+    auto *free = async_hook("async_free", Function<>(Void(), { handle_t }),
+                            "fn async_free(U8 *frame)", pos);
+
+    // Marks the function for the passes which split it up.
+    f->addFnAttr("coroutine.presplit", "0");
+
+    auto *i8_ptr = builder.getInt8PtrTy();
+    auto *null = llvm::ConstantPointerNull::get(i8_ptr);
+
+    llvm::AllocaInst *promise = nullptr;
+    llvm::Value *promise_addr = null;
+    if (!is_type<Void>(result)) {
+        // `await` finds the promise from the handle given its alignment, so
+        // it must be exactly that of the type.
+        promise = builder.CreateAlloca(types.get(result), nullptr,
+                                       "promise");
+        promise->setAlignment(llvm::Align(types.get_alignment(result)));
+        promise_addr = builder.CreateBitCast(promise, i8_ptr);
+    }
+
+    auto *id = builder.CreateIntrinsic(
+            llvm::Intrinsic::coro_id, {},
+            { builder.getInt32(0), promise_addr, null, null });
+
+    // The frame is only allocated if it can't be elided into the caller's.
+    Block alloc_b(f, "coro.alloc");
+    Block begin_b(f, "coro.begin");
+
+    auto *entry = builder.GetInsertBlock();
+    auto *needed = builder.CreateIntrinsic(llvm::Intrinsic::coro_alloc, {},
+                                           { id });
+    builder.CreateCondBr(needed, alloc_b.to_llvm(), begin_b.to_llvm());
+
+    point(alloc_b);
+    auto *size = builder.CreateIntrinsic(llvm::Intrinsic::coro_size,
+                                         { builder.getInt64Ty() }, {});
+    auto *allocated = builder.CreateCall(alloc, { size });
+    builder.CreateBr(begin_b.to_llvm());
+
+    point(begin_b);
+    auto *frame = builder.CreatePHI(i8_ptr, 2);
+    frame->addIncoming(null, entry);
+    frame->addIncoming(allocated, alloc_b.to_llvm());
+    auto *handle = builder.CreateIntrinsic(llvm::Intrinsic::coro_begin, {},
+                                           { id, frame });
+
+    Block final_b(f, "coro.final");
+    auto *unreachable_b = llvm::BasicBlock::Create(context, "coro.unreachable",
+                                                   f);
+    auto *cleanup_b = llvm::BasicBlock::Create(context, "coro.cleanup", f);
+    auto *free_b = llvm::BasicBlock::Create(context, "coro.free", f);
+    auto *suspended_b = llvm::BasicBlock::Create(context, "coro.suspended",
+                                                 f);
+
+    llvm::IRBuilder<> epilogue(final_b.to_llvm());
+
+    // Finished coroutines stay suspended until destroyed, so that the
+    // result can be read out of the frame.
+    auto *none = llvm::ConstantTokenNone::get(context);
+    auto *state = epilogue.CreateIntrinsic(llvm::Intrinsic::coro_suspend, {},
+                                           { none, epilogue.getTrue() });
+    auto *dispatch = epilogue.CreateSwitch(state, suspended_b, 2);
+    dispatch->addCase(epilogue.getInt8(0), unreachable_b);
+    dispatch->addCase(epilogue.getInt8(1), cleanup_b);
+
+    epilogue.SetInsertPoint(unreachable_b);
+    epilogue.CreateUnreachable();
+
+    epilogue.SetInsertPoint(cleanup_b);
+    auto *mem = epilogue.CreateIntrinsic(llvm::Intrinsic::coro_free, {},
+                                         { id, handle });
+    epilogue.CreateCondBr(epilogue.CreateIsNotNull(mem), free_b,
+                          suspended_b);
+
+    epilogue.SetInsertPoint(free_b);
+    epilogue.CreateCall(free, { mem });
+    epilogue.CreateBr(suspended_b);
+
+    epilogue.SetInsertPoint(suspended_b);
+    epilogue.CreateIntrinsic(llvm::Intrinsic::coro_end, {},
+                             { handle, epilogue.getFalse() });
+    epilogue.CreateRet(handle);
+
+    coroutine = Coroutine {
+        id, handle, promise, final_b, cleanup_b, suspended_b,
+        { final_b.to_llvm(), unreachable_b, cleanup_b, free_b, suspended_b }
+    };
+}
+
+void TranslatorImpl::end_coroutine(void) {
+    auto *f = current->get_parent();
+    for (auto *block: coroutine->epilogue) block->moveAfter(&f->back());
+
+    coroutine = boost::none;
+}
+
+llvm::Instruction *TranslatorImpl::suspend(void) {
+    Block resume_b(current->get_parent(), "coro.resume");
+
+    auto *none = llvm::ConstantTokenNone::get(context);
+    auto *state = builder.CreateIntrinsic(llvm::Intrinsic::coro_suspend, {},
+                                          { none, builder.getFalse() });
+    auto *dispatch = builder.CreateSwitch(state, coroutine->suspended, 2);
+    dispatch->addCase(builder.getInt8(0), resume_b.to_llvm());
+    dispatch->addCase(builder.getInt8(1), coroutine->cleanup);
+
+    point(resume_b);
+    return dispatch;
+}
+
+void TranslatorImpl::check_handle(const Value &handle, SourcePos pos) {
+    if (unqualified(handle.get_type()) != Pointer<>(UnsignedInt(8))) {
+        throw Error("type error", "coroutine handles must be U8 *", pos);
+    }
+}
+
+Value TranslatorImpl::await_(Symbol func, std::vector<Value> &args,
+                             SourcePos pos) {
+    auto found = async_results.find(func.str());
+    if (found == async_results.end()) {
+        throw Error("type error", "cannot await \"" + func.str()
+                                + "\": not an async function", pos);
+    }
+
+    Type result_t = found->second;
+    auto *child = call(func, args, pos).to_llvm();
+
+    auto *f = current->get_parent();
+    Block poll_b(f, "await.poll");
+    Block resume_b(f, "await.resume");
+    Block done_b(f, "await.done");
+
+    current->jump_to(poll_b);
+    point(poll_b);
+    auto *done = builder.CreateIntrinsic(llvm::Intrinsic::coro_done, {},
+                                         { child });
+    current->cond_jump(Value(done, UnsignedInt(1)), done_b, resume_b);
+
+    point(resume_b);
+    if (coroutine) suspend();
+    builder.CreateIntrinsic(llvm::Intrinsic::coro_resume, {}, { child });
+    current->jump_to(poll_b);
+
+    point(done_b);
+
+    llvm::Value *result = nullptr;
+    if (!is_type<Void>(result_t)) {
+        auto align = types.get_alignment(result_t);
+        auto *promise = builder.CreateIntrinsic(
+                llvm::Intrinsic::coro_promise, {},
+                { child, builder.getInt32(align), builder.getFalse() });
+        auto *ll_t = types.get(result_t);
+        result = builder.CreateAlignedLoad(
+                ll_t, builder.CreateBitCast(promise, ll_t->getPointerTo()),
+                llvm::Align(align));
+    }
+
+    auto *destroy = builder.CreateIntrinsic(llvm::Intrinsic::coro_destroy,
+                                            {}, { child });
+
+    return Value(result ? result : destroy, result_t);
+}
+
+Value TranslatorImpl::async_suspend(SourcePos pos) {
+    if (!coroutine) {
+        throw Error("type error",
+                    "cannot suspend outside of an async function", pos);
+    }
+
+    return Value(suspend(), Void());
+}
+
+Value TranslatorImpl::async_resume(Value handle, SourcePos pos) {
+    check_handle(handle, pos);
+    auto *inst = builder.CreateIntrinsic(llvm::Intrinsic::coro_resume, {},
+                                         { handle.to_llvm() });
+    return Value(inst, Void());
+}
+
+Value TranslatorImpl::async_done(Value handle, SourcePos pos) {
+    check_handle(handle, pos);
+    auto *inst = builder.CreateIntrinsic(llvm::Intrinsic::coro_done, {},
+                                         { handle.to_llvm() });
+    return Value(inst, UnsignedInt(1));
+}
+
+Value TranslatorImpl::async_destroy(Value handle, SourcePos pos) {
+    check_handle(handle, pos);
+    auto *inst = builder.CreateIntrinsic(llvm::Intrinsic::coro_destroy, {},
+                                         { handle.to_llvm() });
+    return Value(inst, Void());
+}
+
+Value TranslatorImpl::get_identifier_addr(Symbol ident, SourcePos pos) {
+    return env.lookup_identifier(ident, pos).get_val();
+}
+
+Value TranslatorImpl::get_identifier_value(Symbol ident, SourcePos pos) {
+    Value addr = get_identifier_addr(ident, pos);
+
+    assert(is_type<Pointer<> >(addr.get_type()));
+
+    if (constant_global(addr)) return get_constant(ident, pos);
+
+    return add_load(addr, pos);
+}
+
+void TranslatorImpl::define_constant(Symbol name, const Type &t, Value val,
+                                     SourcePos pos) {
+    if (unqualified(val.get_type()) != unqualified(t)) {
+        throw Error("type error", "constant does not match its declared type",
+                    pos);
+    }
+
+    auto *global = new llvm::GlobalVariable(
+            *module, types.get(t), true, llvm::GlobalValue::PrivateLinkage,
+            llvm::cast<llvm::Constant>(val.to_llvm()), name.str());
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(types.get_alignment(t)));
+
+    env.add_identifier(name, Value(global, Pointer<>(t)));
+}
+
+void TranslatorImpl::define_global(Symbol name, const Type &t,
+                                   boost::optional<Value> init,
+                                   bool is_thread_local, bool define,
+                                   SourcePos pos) {
+    if (init && unqualified(init->get_type()) != unqualified(t)) {
+        throw Error("type error", "global does not match its declared type",
+                    pos);
+    }
+
+    if (is_type<Void>(t)) {
+        throw Error("type error", "cannot declare global of type Void", pos);
+    }
+
+    auto *ll_t = types.get(t);
+    llvm::Constant *initializer = nullptr;
+    if (define) {
+        initializer = init ? llvm::cast<llvm::Constant>(init->to_llvm())
+                           : llvm::Constant::getNullValue(ll_t);
+    }
+
+    auto *global = new llvm::GlobalVariable(
+            *module, ll_t, false, llvm::GlobalValue::ExternalLinkage,
+            initializer, name.str());
+    global->setAlignment(llvm::Align(types.get_alignment(t)));
+
+    if (is_thread_local) {
+        // Outside position-independent code the variable is in the
+        // executable's own TLS block, at a fixed offset from the thread
+        // pointer.
+        global->setThreadLocalMode(
+                target->getRelocationModel() == llvm::Reloc::PIC_
+                    ? llvm::GlobalValue::GeneralDynamicTLSModel
+                    : llvm::GlobalValue::LocalExecTLSModel);
+    }
+
+    if (define && debug) debug->declare_global(name, t, global, pos);
+
+    env.add_identifier(name, Value(global, Pointer<>(t)));
+}
+
+Value TranslatorImpl::get_constant(Symbol ident, SourcePos pos) {
+    auto var = env.lookup_identifier(ident, pos);
+    auto *global = constant_global(var.get_val());
+
+    if (!global) {
+        throw Error("type error", "\"" + ident.str() + "\" is not a constant",
+                    pos);
+    }
+
+    return Value(global->getInitializer(), var.get_type());
+}
+
+Type TranslatorImpl::lookup_type(Symbol tname, SourcePos pos) {
+    return env.lookup_type(tname, pos);
+}
+
+void TranslatorImpl::push_scope(void) { env.push(); }
+void TranslatorImpl::pop_scope(void) { env.pop(); }
+void TranslatorImpl::bind_type(Symbol name, Type t) {
+    env.add_type(name, t);
 }
 
-Type TranslatorImpl::specialize_template(std::string template_name,
+Type TranslatorImpl::specialize_template(Symbol template_name,
                                          const std::vector<Type> &args,
                                          SourcePos pos) {
-    return env.lookup_template(template_name, pos)
-              .specialize(args);
+    InstanceKey key(template_name, args);
+    auto found = struct_instances.find(key);
+
+    if (found == struct_instances.end()) {
+        const auto &templ = env.lookup_template(template_name, pos);
+        check_template_args(template_name, templ.parameters, args, pos);
+        Type specialized = templ.specialize(args);
+        found = struct_instances.emplace(std::move(key), specialized).first;
+    }
+
+    return found->second;
 }
 
 Struct<TemplateType> TranslatorImpl::respecialize_template(
-        std::string template_name,
+        Symbol template_name,
         const std::vector<TemplateType> &args,
         SourcePos pos) {
-    return env.lookup_template(template_name, pos)
-              .respecialize(args);
+    const auto &templ = env.lookup_template(template_name, pos);
+    check_template_args(template_name, templ.parameters, args, pos);
+    return templ.respecialize(args);
 }
 
 void TranslatorImpl::register_template(
-                       std::string name,
+                       Symbol name,
                        std::shared_ptr<AST::FunctionDefinition> def,
-                       std::vector<std::string> args,
+                       std::vector<Symbol> args,
                        TemplateFunction func) {
     env.add_template_func(name, TemplateValue(def, args, func));
 }
 
-void TranslatorImpl::register_template(TemplateStruct str, std::string name) {
+void TranslatorImpl::register_template(TemplateStruct str, Symbol name) {
     env.add_template_type(name, str);
 }
 
+void TranslatorImpl::register_const_function(
+        std::shared_ptr<AST::FunctionDefinition> fd) {
+    env.add_const_func(fd->signature().name(), fd);
+}
+
+std::shared_ptr<AST::FunctionDefinition>
+TranslatorImpl::lookup_const_function(Symbol name) const {
+    return env.lookup_const_func(name);
+}
+
+void TranslatorImpl::set_resolver(std::function<bool(Symbol)> resolver) {
+    env.set_resolver(std::move(resolver));
+}
+
 IfThenElse TranslatorImpl::create_ifthenelse(Value cond, SourcePos pos) {
     auto *f = builder.GetInsertBlock()->getParent();
 
@@ -1451,7 +3575,7 @@ void TranslatorImpl::point_to_else(IfThenElse &structure) {
     env.pop();
 
     if (!current->is_terminated()) {
-        current->jump_to(pimpl->else_b);
+        current->jump_to(pimpl->merge_b);
     }
 
     // Push a namespace for "else".
@@ -1471,60 +3595,866 @@ void TranslatorImpl::end_ifthenelse(IfThenElse structure) {
     point(pimpl->merge_b);
 }
 
+Loop TranslatorImpl::create_loop(const LoopHints &hints) {
+    auto *f = builder.GetInsertBlock()->getParent();
+
+    auto result = std::make_unique<LoopImpl>(Block(f, "loop"),
+                                             Block(f, "body"),
+                                             Block(f, "exit"),
+                                             hints);
+
+    if (!current->is_terminated()) {
+        current->jump_to(result->cond_b);
+    }
+
+    point(result->cond_b);
+
+    return Loop(std::move(result));
+}
+
+void TranslatorImpl::start_loop_body(Loop &loop, Value cond, SourcePos pos) {
+    auto &pimpl = loop.pimpl;
+
+    if (!cond.to_llvm()->getType()->isIntegerTy(1)) {
+        throw Error("type error", "loop condition must be a boolean", pos);
+    }
+
+    current->cond_jump(cond, pimpl->body_b, pimpl->exit_b);
+
+    // Push a namespace for the body.
+    env.push();
+    point(pimpl->body_b);
+}
+
+void TranslatorImpl::start_loop_step(Loop &loop) {
+    auto &pimpl = loop.pimpl;
+    auto *f = builder.GetInsertBlock()->getParent();
+
+    pimpl->step_b = std::make_unique<Block>(f, "step");
+
+    // Pop the body's namespace.
+    env.pop();
+
+    if (!current->is_terminated()) {
+        current->jump_to(*pimpl->step_b);
+    }
+
+    env.push();
+    point(*pimpl->step_b);
+}
+
+/**
+ * @brief Get the `llvm.loop` metadata for the given hints, or null if there
+ *        are none.
+ */
+static llvm::MDNode *loop_metadata(llvm::LLVMContext &ctx,
+                                   const LoopHints &hints) {
+    std::vector<llvm::Metadata *> ops;
+    /* Replaced by the node itself, as LLVM requires. */
+    ops.push_back(nullptr);
+
+    auto *i1 = llvm::Type::getInt1Ty(ctx);
+    auto *i32 = llvm::Type::getInt32Ty(ctx);
+
+    auto add = [&](const char *name, llvm::Metadata *arg) {
+        std::vector<llvm::Metadata *> hint { llvm::MDString::get(ctx, name) };
+        if (arg) hint.push_back(arg);
+        ops.push_back(llvm::MDNode::get(ctx, hint));
+    };
+
+    auto constant = [](llvm::Type *ty, uint64_t n) {
+        return llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(ty, n));
+    };
+
+    if (hints.unroll == LoopHints::Disable) {
+        add("llvm.loop.unroll.disable", nullptr);
+    } else if (hints.unroll_count) {
+        add("llvm.loop.unroll.count", constant(i32, hints.unroll_count));
+    } else if (hints.unroll == LoopHints::Enable) {
+        add("llvm.loop.unroll.enable", nullptr);
+    }
+
+    if (hints.vectorize != LoopHints::Default) {
+        add("llvm.loop.vectorize.enable",
+            constant(i1, hints.vectorize == LoopHints::Enable));
+    }
+
+    if (hints.vectorize_width) {
+        add("llvm.loop.vectorize.width", constant(i32, hints.vectorize_width));
+    }
+
+    if (hints.interleave_count) {
+        add("llvm.loop.interleave.count",
+            constant(i32, hints.interleave_count));
+    }
+
+    if (ops.size() == 1) return nullptr;
+
+    auto *result = llvm::MDNode::getDistinct(ctx, ops);
+    result->replaceOperandWith(0, result);
+    return result;
+}
+
+void TranslatorImpl::end_loop(Loop loop) {
+    auto pimpl = std::move(loop.pimpl);
+    // Pop the body's (or step's) namespace.
+    env.pop();
+
+    if (!current->is_terminated()) {
+        current->jump_to(pimpl->cond_b);
+
+        auto *latch = current->to_llvm()->getTerminator();
+        if (auto *md = loop_metadata(context, pimpl->hints)) {
+            latch->setMetadata(llvm::LLVMContext::MD_loop, md);
+        }
+    }
+
+    point(pimpl->exit_b);
+}
+
+void TranslatorImpl::set_debug_level(DebugLevel level) {
+    debug_level = level;
+    if (level == DebugLevel::None) {
+        debug.reset();
+    } else {
+        debug = std::make_unique<DebugInfoGen>(*module, types, level, fname,
+                                               sources);
+    }
+}
+
+void TranslatorImpl::set_fast_math(const FastMath &flags) {
+    fast_math = flags;
+}
+
+void TranslatorImpl::set_wrapping_overflow(void) {
+    wrapping_overflow = true;
+}
+
+void TranslatorImpl::set_fast_backend(void) {
+    // Without optimization, the backend picks FastISel and the fast register
+    // allocator and leaves out its optional passes; FastISel is made
+    // explicit so that GlobalISel is never chosen instead.
+    target->setOptLevel(llvm::CodeGenOpt::None);
+    target->setFastISel(true);
+}
+
+void TranslatorImpl::set_backend_threads(unsigned n) {
+    backend_threads = std::max(n, 1u);
+}
+
+void TranslatorImpl::set_remarks(const std::string &passes) {
+    remarks_out = std::make_unique<llvm::raw_string_ostream>(remarks);
+
+    auto error = llvm::setupLLVMOptimizationRemarks(context, *remarks_out,
+                                                    passes, "yaml", false);
+    if (error) {
+        auto pos = sources.start_of(fname);
+        throw Error("error", llvm::toString(std::move(error)), pos);
+    }
+}
+
+std::string TranslatorImpl::take_remarks(void) {
+    if (!remarks_out) return "";
+
+    remarks_out->flush();
+    auto result = std::move(remarks);
+    remarks.clear();
+    return result;
+}
+
+void TranslatorImpl::set_location(SourcePos pos) {
+    if (debug) builder.SetCurrentDebugLocation(debug->location(pos));
+}
+
+void TranslatorImpl::finish_debug_info(void) {
+    if (debug) debug->finalize();
+}
+
 void TranslatorImpl::validate(std::ostream &out) {
+    finish_debug_info();
     llvm::raw_os_ostream ll_out(out);
     llvm::verifyModule(*module, &ll_out);
 }
 
-void TranslatorImpl::optimize(int opt_level) {
-    auto fpm = std::make_unique<llvm::legacy::PassManager>();
-    if (opt_level >= 1) {
-        // Iterated dominance frontier to convert most `alloca`s to SSA
-        // register accesses.
-        fpm->add(llvm::createPromoteMemoryToRegisterPass());
-        fpm->add(llvm::createInstructionCombiningPass());
-        // Reassociate expressions.
-        fpm->add(llvm::createReassociatePass());
-        // Eliminate common sub-expressions.
-        fpm->add(llvm::createGVNPass());
-        // Simplify the control flow graph.
-        fpm->add(llvm::createCFGSimplificationPass());
-        // Tail call elimination.
-        fpm->add(llvm::createTailCallEliminationPass());
+int TranslatorImpl::run(const std::string &entry,
+                        const std::vector<std::string> &args) {
+    finish_debug_info();
+    auto pos = sources.start_of(fname);
+    return run_jit(std::move(module), std::move(owned_context), target_spec,
+                   entry, args, pos);
+}
+
+ModuleCounts TranslatorImpl::counts(void) {
+    ModuleCounts result;
+
+    for (const auto &f: *module) {
+        if (f.isDeclaration()) continue;
+        ++result.functions;
+        result.instructions += f.getInstructionCount();
+    }
+
+    return result;
+}
+
+void TranslatorImpl::optimize(int opt_level, int size_level,
+                              OptPhase phase) {
+    finish_debug_info();
+    bool profiling = profile.generate || !profile.use_file.empty();
+    bool quick = opt_level == 1 && size_level == 0 && !profiling;
+
+    // LLVM's optimizing pipelines split coroutines after inlining, so that
+    // the frames of those awaited where they are called can be elided.  The
+    // rest, and pieces split up for ThinLTO, are lowered here first.
+    // Full debug information keeps variables in memory, where debuggers
+    // can always find and change them.
+    if (opt_level == 0 && phase != OptPhase::PostLink
+     && debug_level != DebugLevel::Full) {
+        promote_locals();
+    }
+
+    if (opt_level == 0 || quick || phase == OptPhase::ThinPreLink) {
+        lower_coroutines();
+    }
+
+    // Without a profile, -O0 does nothing, and -O1 just runs a few cheap
+    // function passes, so it has nothing to do after linking.  The profiling
+    // passes come with LLVM's pipelines.
+    if (opt_level == 0 && !profiling) return;
+
+    if (quick) {
+        if (phase != OptPhase::PostLink) optimize_quick();
+        return;
+    }
+
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O2;
+    if (opt_level == 0) {
+        level = llvm::OptimizationLevel::O0;
+    } else if (opt_level == 1 && size_level == 0) {
+        level = llvm::OptimizationLevel::O1;
+    } else if (size_level == 1) {
+        level = llvm::OptimizationLevel::Os;
+    } else if (size_level >= 2) {
+        level = llvm::OptimizationLevel::Oz;
+    } else if (opt_level >= 3) {
+        level = llvm::OptimizationLevel::O3;
+    }
+
+    // Vectorize as clang does: at -O2 and up, but not when minimizing size.
+    llvm::PipelineTuningOptions tuning;
+    tuning.LoopVectorization = size_level < 2;
+    tuning.SLPVectorization = size_level < 2;
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    // Time each pass if asked to (`--time-report`); the handler prints its
+    // report when it goes out of scope.
+    llvm::PassInstrumentationCallbacks callbacks;
+    llvm::TimePassesHandler pass_timing;
+    pass_timing.registerCallbacks(callbacks);
+
+    // Instrument each function once, before linking, so that it has the
+    // same counters however the module was split up.
+    llvm::Optional<llvm::PGOOptions> pgo;
+    if (profile.generate && phase != OptPhase::PostLink) {
+        pgo = llvm::PGOOptions(profile.generate_file, "", "",
+                               llvm::PGOOptions::IRInstr);
+    } else if (!profile.use_file.empty()) {
+        pgo = llvm::PGOOptions(profile.use_file, "", "",
+                               llvm::PGOOptions::IRUse);
+    }
+
+    // Giving the pass builder the target machine lets the cost models (for
+    // inlining, unrolling and vectorization) use target information.
+    llvm::PassBuilder builder(target, tuning, pgo, &callbacks);
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::ModulePassManager passes;
+
+    if (level == llvm::OptimizationLevel::O0) {
+        if (phase != OptPhase::PostLink) {
+            passes = builder.buildO0DefaultPipeline(
+                    level, phase != OptPhase::Whole);
+        }
+        passes.run(*module, mam);
+        return;
+    }
+
+    // The pipelines infer the rest (`readnone`, `nocapture` and so on).
+    mark_nounwind();
+
+    switch (phase) {
+    case OptPhase::Whole:
+        passes = builder.buildPerModuleDefaultPipeline(level);
+        break;
+    case OptPhase::PreLink:
+        passes = builder.buildLTOPreLinkDefaultPipeline(level);
+        break;
+    case OptPhase::PostLink:
+        passes = builder.buildLTODefaultPipeline(level, nullptr);
+        break;
+    case OptPhase::ThinPreLink:
+        passes = builder.buildThinLTOPreLinkDefaultPipeline(level);
+        break;
     }
 
+    passes.run(*module, mam);
+}
+
+void TranslatorImpl::optimize_quick(void) {
+    auto fpm = std::make_unique<llvm::legacy::PassManager>();
+
+    // Iterated dominance frontier to convert most `alloca`s to SSA
+    // register accesses.
+    fpm->add(llvm::createPromoteMemoryToRegisterPass());
+    fpm->add(llvm::createInstructionCombiningPass());
+    // Reassociate expressions.
+    fpm->add(llvm::createReassociatePass());
+    // Eliminate common sub-expressions.
+    fpm->add(llvm::createGVNPass());
+    // Simplify the control flow graph.
+    fpm->add(llvm::createCFGSimplificationPass());
+    // Tail call elimination.
+    fpm->add(llvm::createTailCallEliminationPass());
+
+    fpm->run(*module);
+}
+
+void TranslatorImpl::promote_locals(void) {
+    auto fpm = std::make_unique<llvm::legacy::PassManager>();
+    fpm->add(llvm::createPromoteMemoryToRegisterPass());
     fpm->run(*module);
 }
 
+void TranslatorImpl::lower_coroutines(void) {
+    auto *id = module->getFunction("llvm.coro.id");
+    if (!id || id->use_empty()) return;
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::PassBuilder builder(target);
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::ModulePassManager passes;
+    passes.addPass(llvm::createModuleToFunctionPassAdaptor(
+            llvm::CoroEarlyPass()));
+    passes.addPass(llvm::createModuleToPostOrderCGSCCPassAdaptor(
+            llvm::CoroSplitPass()));
+    passes.addPass(llvm::createModuleToFunctionPassAdaptor(
+            llvm::CoroElidePass()));
+    passes.addPass(llvm::createModuleToFunctionPassAdaptor(
+            llvm::CoroCleanupPass()));
+
+    passes.run(*module, mam);
+}
+
 void TranslatorImpl::emit_ir(std::ostream &out) {
+   finish_debug_info();
    llvm::raw_os_ostream llvm_out(out);
    module->print(llvm_out, nullptr);
 }
 
 void TranslatorImpl::emit_asm(int fd) {
     llvm::raw_fd_ostream llvm_out(fd, false);
-    llvm::legacy::PassManager pass;
-    auto ft = llvm::TargetMachine::CGFT_AssemblyFile;
+    llvm_out << run_backend(llvm::CGFT_AssemblyFile);
+}
 
-    if (target->addPassesToEmitFile(pass, llvm_out, ft)) {
-        llvm::errs() << "TargetMachine can't emit a file of this type";
+void TranslatorImpl::emit_bitcode(std::ostream &out) {
+    finish_debug_info();
+    llvm::raw_os_ostream llvm_out(out);
+    llvm::WriteBitcodeToFile(*module, llvm_out);
+}
+
+void TranslatorImpl::emit_bc(int fd) {
+    llvm::raw_fd_ostream llvm_out(fd, false);
+    write_bc(llvm_out);
+}
+
+void TranslatorImpl::write_bc(llvm::raw_ostream &out) {
+    finish_debug_info();
+    // The summary lets the thin link decide what to import into other
+    // modules without loading this one.
+    llvm::ProfileSummaryInfo profile(*module);
+    auto index = llvm::buildModuleSummaryIndex(*module, nullptr, &profile);
+    llvm::WriteBitcodeToFile(*module, out, false, &index, true);
+}
+
+void TranslatorImpl::emit(const std::vector<Artifact> &artifacts,
+                          const ArtifactSink &sink) {
+    finish_debug_info();
+    auto wants = [&](Artifact a) {
+        return std::find(artifacts.begin(), artifacts.end(), a)
+            != artifacts.end();
+    };
+
+    // The backend changes the module as it goes, so write out the IR first.
+    if (wants(Artifact::IR)) {
+        std::string ir;
+        llvm::raw_string_ostream out(ir);
+        module->print(out, nullptr);
+        out.flush();
+        sink(Artifact::IR, std::move(ir));
+    }
+    if (wants(Artifact::Bitcode)) {
+        std::string bc;
+        llvm::raw_string_ostream out(bc);
+        write_bc(out);
+        out.flush();
+        sink(Artifact::Bitcode, std::move(bc));
+    }
+
+    bool obj = wants(Artifact::Object);
+    if (!wants(Artifact::Assembly)) {
+        if (obj) sink(Artifact::Object, run_backend(llvm::CGFT_ObjectFile));
+    } else {
+        // Running the backend once for assembly and then assembling that is
+        // much cheaper than running it twice.
+        auto assembly = run_backend(llvm::CGFT_AssemblyFile);
+        if (obj) {
+            sink(Artifact::Assembly, assembly);
+            sink(Artifact::Object, assemble(assembly));
+        } else {
+            sink(Artifact::Assembly, std::move(assembly));
+        }
     }
 
-    pass.run(*module);
-    llvm_out.flush();
+    if (wants(Artifact::Remarks)) sink(Artifact::Remarks, take_remarks());
 }
 
-void TranslatorImpl::emit_obj(int fd) {
-    llvm::raw_fd_ostream llvm_out(fd, false);
+std::string TranslatorImpl::run_backend(llvm::CodeGenFileType type) {
+    finish_debug_info();
+    if (type == llvm::CGFT_ObjectFile && backend_threads > 1) {
+        return run_backend_split();
+    }
+
+    llvm::SmallVector<char, 0> result;
+    llvm::raw_svector_ostream llvm_out(result);
     llvm::legacy::PassManager pass;
-    auto ft = llvm::TargetMachine::CGFT_ObjectFile;
 
-    if (target->addPassesToEmitFile(pass, llvm_out, ft)) {
+    if (target->addPassesToEmitFile(pass, llvm_out, nullptr, type)) {
         llvm::errs() << "TargetMachine can't emit a file of this type";
     }
 
     pass.run(*module);
-    llvm_out.flush();
+    return std::string(result.begin(), result.end());
+}
+
+std::string TranslatorImpl::run_backend_split(void) {
+    auto pos = sources.start_of(fname);
+
+    // Internal symbols stay with their users, so that nothing has to be
+    // made visible outside the object to be shared between the parts.
+    std::vector<std::string> parts;
+    llvm::SplitModule(*module, backend_threads,
+                      [&](std::unique_ptr<llvm::Module> part) {
+        std::string bitcode;
+        llvm::raw_string_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*part, out);
+        out.flush();
+        parts.push_back(std::move(bitcode));
+    }, true);
+
+    // Creating target machines isn't known to be thread-safe.
+    std::vector<std::unique_ptr<llvm::TargetMachine> > machines;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        machines.emplace_back(target->getTarget().createTargetMachine(
+                target->getTargetTriple().str(), target->getTargetCPU(),
+                target->getTargetFeatureString(), target->Options,
+                target->getRelocationModel(), target->getCodeModel(),
+                target->getOptLevel()));
+    }
+
+    std::vector<std::string> objects(parts.size());
+    std::vector<std::string> errors(parts.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        workers.emplace_back([&, i] {
+            llvm::LLVMContext part_context;
+            auto part = llvm::parseBitcodeFile(
+                    llvm::MemoryBufferRef(parts[i], fname), part_context);
+            if (!part) {
+                errors[i] = llvm::toString(part.takeError());
+                return;
+            }
+
+            llvm::SmallVector<char, 0> result;
+            llvm::raw_svector_ostream out(result);
+            llvm::legacy::PassManager pass;
+            machines[i]->addPassesToEmitFile(pass, out, nullptr,
+                                             llvm::CGFT_ObjectFile);
+            pass.run(**part);
+            objects[i].assign(result.begin(), result.end());
+        });
+    }
+
+    for (auto &worker: workers) worker.join();
+
+    for (const auto &error: errors) {
+        if (!error.empty()) throw Error("internal error", error, pos);
+    }
+
+    if (objects.size() == 1) return objects[0];
+    return link_objects(objects);
+}
+
+std::string TranslatorImpl::link_objects(
+        const std::vector<std::string> &objects) {
+    auto pos = sources.start_of(fname);
+
+    auto ld = llvm::sys::findProgramByName("ld");
+    if (!ld) {
+        throw Error("error", "cannot find ld to merge the objects of a "
+                             "split backend", pos);
+    }
+
+    std::vector<llvm::SmallString<128> > paths(objects.size() + 1);
+    std::vector<std::unique_ptr<llvm::FileRemover> > removers;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        int fd;
+        if (llvm::sys::fs::createTemporaryFile("craeft", "o", fd, paths[i])) {
+            throw Error("error", "cannot create a temporary file", pos);
+        }
+        removers.push_back(std::make_unique<llvm::FileRemover>(paths[i]));
+
+        llvm::raw_fd_ostream out(fd, true);
+        if (i < objects.size()) out << objects[i];
+    }
+
+    std::vector<llvm::StringRef> args = { *ld, "-r", "-o", paths.back() };
+    for (size_t i = 0; i < objects.size(); ++i) args.push_back(paths[i]);
+
+    std::string message;
+    if (llvm::sys::ExecuteAndWait(*ld, args, llvm::None, {}, 0, 0,
+                                  &message)) {
+        throw Error("error", "could not merge the objects of a split "
+                             "backend: ld failed" + (message.empty()
+                                                     ? "" : ": " + message),
+                    pos);
+    }
+
+    auto merged = llvm::MemoryBuffer::getFile(paths.back());
+    if (!merged) {
+        throw Error("error", "cannot read the merged object: "
+                           + merged.getError().message(), pos);
+    }
+
+    return (*merged)->getBuffer().str();
+}
+
+std::string TranslatorImpl::assemble(const std::string &assembly) {
+    auto pos = sources.start_of(fname);
+
+    // Assemble as the backend would have emitted the object itself, with the
+    // target machine's view of the target.
+    const auto &mc_options = target->Options.MCOptions;
+    const auto &triple = target->getTargetTriple();
+    const auto &llvm_target = target->getTarget();
+    const auto *reg_info = target->getMCRegisterInfo();
+    const auto *asm_info = target->getMCAsmInfo();
+    const auto *instr_info = target->getMCInstrInfo();
+    const auto *subtarget = target->getMCSubtargetInfo();
+
+    llvm::SourceMgr source_mgr;
+    source_mgr.AddNewSourceBuffer(
+            llvm::MemoryBuffer::getMemBuffer(assembly, fname, false),
+            llvm::SMLoc());
+
+    llvm::MCContext mc(triple, asm_info, reg_info, subtarget, &source_mgr,
+                       &mc_options);
+    std::unique_ptr<llvm::MCObjectFileInfo> file_info(
+            llvm_target.createMCObjectFileInfo(
+                mc, target->getRelocationModel() == llvm::Reloc::PIC_));
+    mc.setObjectFileInfo(file_info.get());
+
+    llvm::SmallVector<char, 0> result;
+    llvm::raw_svector_ostream out(result);
+
+    std::unique_ptr<llvm::MCAsmBackend> backend(
+            llvm_target.createMCAsmBackend(*subtarget, *reg_info,
+                                           mc_options));
+    std::unique_ptr<llvm::MCCodeEmitter> emitter(
+            llvm_target.createMCCodeEmitter(*instr_info, *reg_info, mc));
+    auto writer = backend->createObjectWriter(out);
+    std::unique_ptr<llvm::MCStreamer> streamer(
+            llvm_target.createMCObjectStreamer(
+                triple, mc, std::move(backend), std::move(writer),
+                std::move(emitter), *subtarget, mc_options.MCRelaxAll,
+                mc_options.MCIncrementalLinkerCompatible, false));
+
+    std::unique_ptr<llvm::MCAsmParser> parser(
+            llvm::createMCAsmParser(source_mgr, mc, *streamer, *asm_info));
+    std::unique_ptr<llvm::MCTargetAsmParser> target_parser(
+            llvm_target.createMCAsmParser(*subtarget, *parser, *instr_info,
+                                          mc_options));
+    parser->setTargetParser(*target_parser);
+
+    if (parser->Run(false)) {
+        throw Error("internal error", "could not assemble generated code", pos);
+    }
+
+    return std::string(result.begin(), result.end());
+}
+
+void TranslatorImpl::link_bitcode(const std::vector<std::string> &bitcode) {
+    auto pos = sources.start_of(fname);
+
+    // Setting up a linker takes time proportional to the size of the
+    // destination, so use one for everything.  `Linker` would also walk the
+    // whole destination for each module linked in, so use the lower-level
+    // `IRMover` instead.
+    llvm::IRMover mover(*module);
+
+    for (const auto &piece: bitcode) {
+        auto parsed = llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(piece, fname), context);
+        if (!parsed) {
+            throw Error("internal error", llvm::toString(parsed.takeError()),
+                        pos);
+        }
+
+        auto other = std::move(*parsed);
+
+        // Keep the first definition of anything defined in both modules, and
+        // function declarations even if they are unused.  Private globals,
+        // and declarations of variables (which `IRMover` can't move on their
+        // own), are brought along when they are used.
+        std::vector<llvm::GlobalValue *> to_link;
+        for (auto &gv: other->global_values()) {
+            if (gv.hasLocalLinkage()) continue;
+            if (gv.isDeclaration() && llvm::isa<llvm::GlobalVariable>(gv)) {
+                continue;
+            }
+
+            auto *existing = module->getNamedValue(gv.getName());
+            if (!existing || (existing->isDeclaration()
+                                && !gv.isDeclaration())) {
+                to_link.push_back(&gv);
+            }
+        }
+
+        auto error = mover.move(std::move(other), to_link,
+                                [](llvm::GlobalValue &,
+                                   llvm::IRMover::ValueAdder) {},
+                                false);
+        if (error) {
+            throw Error("internal error", llvm::toString(std::move(error)),
+                        pos);
+        }
+    }
+
+    merge_compile_units(*module);
+}
+
+std::vector<std::string> TranslatorImpl::callees(
+        const std::string &function) {
+    std::vector<std::string> result;
+    llvm::SmallPtrSet<const llvm::Function *, 8> seen;
+
+    for (const auto &inst: llvm::instructions(*module->getFunction(function))) {
+        for (const auto *op: inst.operand_values()) {
+            auto *f = llvm::dyn_cast<llvm::Function>(op);
+            if (f && seen.insert(f).second) result.push_back(f->getName().str());
+        }
+    }
+
+    return result;
+}
+
+std::string TranslatorImpl::extract_bitcode(
+        const std::string &function, const std::vector<std::string> &declare) {
+    auto *root = module->getFunction(function);
+    if (!root || root->isDeclaration()) return "";
+
+    // Find the globals the function refers to.  Copying the whole module
+    // and deleting the rest would take time proportional to its size.
+    llvm::SetVector<const llvm::GlobalValue *> used;
+    llvm::SmallVector<const llvm::User *, 32> worklist;
+    llvm::SmallPtrSet<const llvm::User *, 32> seen;
+
+    for (const auto &inst: llvm::instructions(*root)) {
+        worklist.push_back(&inst);
+    }
+
+    for (const auto &name: declare) {
+        auto *f = module->getFunction(name);
+        if (f && f != root) used.insert(f);
+    }
+
+    while (!worklist.empty()) {
+        const auto *user = worklist.pop_back_val();
+
+        for (const auto *op: user->operand_values()) {
+            if (auto *gv = llvm::dyn_cast<llvm::GlobalVariable>(op)) {
+                // Private globals (e.g. string literals) come along, so their
+                // contents do too.
+                if (used.insert(gv) && gv->hasLocalLinkage()
+                        && gv->hasInitializer()) {
+                    worklist.push_back(gv->getInitializer());
+                }
+            } else if (auto *f = llvm::dyn_cast<llvm::Function>(op)) {
+                // Likewise local functions (e.g. the pieces of a split
+                // coroutine).
+                if (f != root && used.insert(f) && f->hasLocalLinkage()
+                        && !f->isDeclaration()) {
+                    for (const auto &inst: llvm::instructions(*f)) {
+                        worklist.push_back(&inst);
+                    }
+                }
+            } else if (auto *gv = llvm::dyn_cast<llvm::GlobalValue>(op)) {
+                if (gv != root) used.insert(gv);
+            } else if (auto *c = llvm::dyn_cast<llvm::Constant>(op)) {
+                if (seen.insert(c).second) worklist.push_back(c);
+            }
+        }
+    }
+
+    llvm::Module extracted(function, context);
+    extracted.setTargetTriple(module->getTargetTriple());
+    extracted.setDataLayout(module->getDataLayout());
+
+    llvm::ValueToValueMapTy vmap;
+
+    for (auto *gv: used) {
+        if (auto *f = llvm::dyn_cast<llvm::Function>(gv)) {
+            bool local = f->hasLocalLinkage();
+            auto *copy = llvm::Function::Create(
+                    f->getFunctionType(),
+                    local ? f->getLinkage()
+                          : llvm::GlobalValue::ExternalLinkage,
+                    f->getName(), &extracted);
+            copy->copyAttributesFrom(f);
+            vmap[f] = copy;
+        } else {
+            auto *var = llvm::cast<llvm::GlobalVariable>(gv);
+            bool local = var->hasLocalLinkage();
+            auto *copy = new llvm::GlobalVariable(
+                    extracted, var->getValueType(), var->isConstant(),
+                    local ? var->getLinkage()
+                          : llvm::GlobalValue::ExternalLinkage,
+                    nullptr, var->getName());
+            copy->copyAttributesFrom(var);
+            vmap[var] = copy;
+        }
+    }
+
+    for (auto *gv: used) {
+        auto *var = llvm::dyn_cast<llvm::GlobalVariable>(gv);
+        if (var && var->hasLocalLinkage() && var->hasInitializer()) {
+            llvm::cast<llvm::GlobalVariable>(vmap[var])->setInitializer(
+                    llvm::MapValue(var->getInitializer(), vmap));
+        }
+    }
+
+    auto *copy = llvm::Function::Create(root->getFunctionType(),
+                                        root->getLinkage(), root->getName(),
+                                        &extracted);
+    copy->copyAttributesFrom(root);
+    if (root->hasComdat()) {
+        copy->setComdat(extracted.getOrInsertComdat(root->getName()));
+    }
+    vmap[root] = copy;
+
+    auto clone_body = [&vmap](llvm::Function *to,
+                              const llvm::Function *from) {
+        auto new_arg = to->arg_begin();
+        for (const auto &arg: from->args()) {
+            vmap[&arg] = &*new_arg++;
+        }
+
+        llvm::SmallVector<llvm::ReturnInst *, 8> returns;
+        llvm::CloneFunctionInto(to, from, vmap,
+                                llvm::CloneFunctionChangeType::DifferentModule,
+                                returns);
+    };
+
+    clone_body(copy, root);
+
+    for (auto *gv: used) {
+        auto *f = llvm::dyn_cast<llvm::Function>(gv);
+        if (f && f->hasLocalLinkage() && !f->isDeclaration()) {
+            clone_body(llvm::cast<llvm::Function>(vmap[f]), f);
+        }
+    }
+
+    // Cloning into another module always adds a (here empty) list of debug
+    // compile units, which would be stripped with a warning when loaded.
+    if (auto *units = extracted.getNamedMetadata("llvm.dbg.cu")) {
+        if (units->getNumOperands() == 0) extracted.eraseNamedMetadata(units);
+    }
+
+    std::string result;
+    llvm::raw_string_ostream out(result);
+    llvm::WriteBitcodeToFile(extracted, out);
+    out.flush();
+
+    return result;
+}
+
+std::string TranslatorImpl::extract_optimized_bitcode(
+        const std::string &function, const std::vector<std::string> &declare,
+        int opt_level, int size_level, OptPhase phase) {
+    auto bitcode = extract_bitcode(function, declare);
+    if (bitcode.empty()) return bitcode;
+
+    TranslatorImpl alone(module->getName().str(), fname, sources,
+                         target_spec);
+    alone.profile = profile;
+    alone.link_bitcode({ bitcode });
+
+    // A template instantiation is unused on its own, so keep the optimizer
+    // from dropping it.
+    auto *root = alone.module->getFunction(function);
+    auto linkage = root->getLinkage();
+    if (root->isDiscardableIfUnused()) {
+        root->setLinkage(llvm::GlobalValue::WeakODRLinkage);
+    }
+
+    alone.optimize(opt_level, size_level, phase);
+
+    root = alone.module->getFunction(function);
+    if (!root || root->isDeclaration()) return "";
+    root->setLinkage(linkage);
+
+    return alone.extract_bitcode(function, declare);
+}
+
+std::vector<std::string> TranslatorImpl::undefined_functions(void) {
+    std::vector<std::string> result;
+
+    for (const auto &f: *module) {
+        if (f.isDeclaration() && !f.isIntrinsic()) {
+            result.push_back(f.getName().str());
+        }
+    }
+
+    return result;
+}
+
+void TranslatorImpl::internalize(const std::vector<std::string> &names) {
+    for (const auto &name: names) {
+        auto *f = module->getFunction(name);
+        if (f && !f->isDeclaration()) {
+            f->setLinkage(llvm::GlobalValue::InternalLinkage);
+        }
+    }
+}
+
+void TranslatorImpl::emit_obj(int fd) {
+    llvm::raw_fd_ostream llvm_out(fd, false);
+    llvm_out << run_backend(llvm::CGFT_ObjectFile);
 }
 
 void TranslatorImpl::point(Block b) {
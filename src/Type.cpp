@@ -20,8 +20,19 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <unordered_set>
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MathExtras.h"
 
 #include "Type.hh"
 
@@ -88,14 +99,232 @@ llvm::Type *Void::to_llvm(llvm::LLVMContext &ctx) const {
     return llvm::Type::getVoidTy(ctx);
 }
 
+/*****************************************************************************
+ * Getting unique names for types.
+ */
+
+struct NamingVisitor: public boost::static_visitor<std::string> {
+    std::string operator()(const SignedInt &si) const {
+        return "signed" + std::to_string(si.get_nbits());
+    }
+
+    std::string operator()(const UnsignedInt &ui) const {
+        return "unsigned" + std::to_string(ui.get_nbits());
+    }
+
+    std::string operator()(const Float &f) const {
+        if (f.get_precision() == SinglePrecision) {
+            return "float";
+        } else {
+            return "double";
+        }
+    }
+
+    std::string operator()(const Void &) const {
+        return std::string("void");
+    }
+
+    std::string operator()(const Pointer<Type> &ptr) const {
+        return "$" + ptr.get_pointed()->get_name() + "$"
+             + (ptr.is_restrict() ? "r" : "");
+    }
+
+    std::string operator()(const Function<Type> &func) const {
+        std::string result = "$.";
+
+        for (const auto &arg: func.get_args()) {
+            result += arg.get_name();
+            result += ".";
+        }
+
+        result += func.get_rettype()->get_name();
+
+        result += ".$";
+
+        return result;
+    }
+
+    std::string operator()(const Struct<Type> &str) const {
+        return str.get_name();
+    }
+
+    std::string operator()(const Vector<Type> &vec) const {
+        return "vector" + std::to_string(vec.get_lanes())
+             + "$" + vec.get_element()->get_name() + "$";
+    }
+
+    std::string operator()(const Array<Type> &arr) const {
+        return "array" + std::to_string(arr.get_length())
+             + "$" + arr.get_element()->get_name() + "$";
+    }
+
+    /* No type's name starts with a digit. */
+    std::string operator()(const IntegerArg &i) const {
+        return std::to_string(i.get_value());
+    }
+};
+
+/*****************************************************************************
+ * Interning types.
+ */
+
+/* Hash the structure of a type.  Components are already canonical, so this
+ * only has to look one level deep. */
+struct HashVisitor: public boost::static_visitor<llvm::hash_code> {
+    llvm::hash_code operator()(const SignedInt &si) const {
+        return llvm::hash_value(si.get_nbits());
+    }
+
+    llvm::hash_code operator()(const UnsignedInt &ui) const {
+        return llvm::hash_value(ui.get_nbits());
+    }
+
+    llvm::hash_code operator()(const Float &f) const {
+        return llvm::hash_value((int)f.get_precision());
+    }
+
+    llvm::hash_code operator()(const Void &) const {
+        return llvm::hash_code(0);
+    }
+
+    llvm::hash_code operator()(const Pointer<Type> &ptr) const {
+        return llvm::hash_combine(ptr.get_pointed()->hash(),
+                                  ptr.is_restrict());
+    }
+
+    llvm::hash_code operator()(const Function<Type> &func) const {
+        auto result = llvm::hash_value(func.get_rettype()->hash());
+
+        for (const auto &arg: func.get_args()) {
+            result = llvm::hash_combine(result, arg.hash());
+        }
+
+        return result;
+    }
+
+    llvm::hash_code operator()(const Struct<Type> &str) const {
+        auto result = llvm::hash_value(str.get_name());
+
+        for (const auto &field: str.get_fields()) {
+            result = llvm::hash_combine(result, field.first,
+                                        field.second.hash());
+        }
+
+        const auto &layout = str.get_layout();
+        return llvm::hash_combine(
+                result, layout.align, layout.packed, layout.reorder,
+                llvm::hash_combine_range(layout.field_aligns.begin(),
+                                         layout.field_aligns.end()));
+    }
+
+    llvm::hash_code operator()(const Vector<Type> &vec) const {
+        return llvm::hash_combine(vec.get_lanes(),
+                                  vec.get_element()->hash());
+    }
+
+    llvm::hash_code operator()(const Array<Type> &arr) const {
+        return llvm::hash_combine(arr.get_length(),
+                                  arr.get_element()->hash());
+    }
+
+    llvm::hash_code operator()(const IntegerArg &i) const {
+        return llvm::hash_value(i.get_value());
+    }
+};
+
+/**
+ * @brief The canonical representative of a type.
+ */
+struct TypeNode {
+    TypeNode(const _Type &structure)
+        : structure(structure),
+          hash(llvm::hash_combine(structure.which(),
+                                  boost::apply_visitor(HashVisitor(),
+                                                       structure))) {}
+
+    _Type structure;
+
+    size_t hash;
+
+    /**
+     * @brief Filled in when the node is added to the table.
+     */
+    std::string name;
+};
+
+namespace {
+
+struct NodeHash {
+    size_t operator()(const TypeNode *node) const { return node->hash; }
+};
+
+struct NodeEq {
+    bool operator()(const TypeNode *l, const TypeNode *r) const {
+        return l->hash == r->hash && l->structure == r->structure;
+    }
+};
+
+/* The table of every type built so far.  Nodes are never freed, so handles
+ * stay valid for the life of the program. */
+struct TypeTable {
+    std::mutex lock;
+    std::unordered_set<const TypeNode *, NodeHash, NodeEq> index;
+    std::deque<TypeNode> nodes;
+};
+
+TypeTable &type_table(void) {
+    static TypeTable table;
+    return table;
+}
+
+}
+
+const TypeNode *Type::intern(const _Type &structure) {
+    TypeNode key(structure);
+    auto &table = type_table();
+
+    std::lock_guard<std::mutex> guard(table.lock);
+
+    auto found = table.index.find(&key);
+    if (found != table.index.end()) {
+        return *found;
+    }
+
+    table.nodes.push_back(std::move(key));
+    auto *node = &table.nodes.back();
+    node->name = boost::apply_visitor(NamingVisitor(), node->structure);
+    table.index.insert(node);
+
+    return node;
+}
+
+const _Type &Type::variant(void) const {
+    return node->structure;
+}
+
+const std::string &Type::get_name(void) const {
+    return node->name;
+}
+
+const std::string &get_name(const Type &t) {
+    return t.get_name();
+}
+
+Type unqualified(const Type &t) {
+    if (auto *ptr = boost::get<Pointer<> >(&t.variant())) {
+        return Pointer<>(*ptr->get_pointed());
+    }
+    return t;
+}
+
 /*****************************************************************************
  * Conversion to LLVM.
  */
 
 /* Visitor for converting Craeft types to LLVM types. */
 struct ToLlvmVisitor: public boost::static_visitor<llvm::Type *> {
-    ToLlvmVisitor(llvm::Module &mod): ctx(mod.getContext()),
-                                      mod(mod) {}
+    ToLlvmVisitor(llvm::Module &mod, LlvmTypeCache &cache)
+        : ctx(mod.getContext()), cache(cache) {}
 
     template<typename T>
     llvm::Type *operator()(const T &t) const {
@@ -106,114 +335,243 @@ struct ToLlvmVisitor: public boost::static_visitor<llvm::Type *> {
         std::vector<llvm::Type *> arg_types;
 
         for (const auto &t: func.get_args()) {
-            arg_types.push_back(to_llvm_type(*t, mod));
+            arg_types.push_back(cache.get(t));
         }
 
-        auto *ret = to_llvm_type(*func.get_rettype(), mod);
+        auto *ret = cache.get(*func.get_rettype());
 
         return llvm::FunctionType::get(ret, arg_types, false);
     }
 
     llvm::Type *operator()(const Pointer<Type> &ptr) const {
-        return llvm::PointerType::getUnqual(to_llvm_type(*ptr.get_pointed(),
-                                            mod));
+        return llvm::PointerType::getUnqual(cache.get(*ptr.get_pointed()));
     }
 
-    llvm::Type *operator()(const Struct<Type> &str) const {
-        auto *result = mod.getTypeByName(str.get_name());
-        if (result) {
-            return result;
-        }
-
-        std::vector<llvm::Type *> arg_types;
+    llvm::Type *operator()(const Vector<Type> &vec) const {
+        return llvm::FixedVectorType::get(cache.get(*vec.get_element()),
+                                          vec.get_lanes());
+    }
 
-        for (const auto &field: str.get_fields()) {
-            arg_types.push_back(to_llvm_type(*field.second, mod));
-        }
+    llvm::Type *operator()(const Array<Type> &arr) const {
+        return llvm::ArrayType::get(cache.get(*arr.get_element()),
+                                    arr.get_length());
+    }
 
-        result = llvm::StructType::create(arg_types, str.get_name());
+    llvm::Type *operator()(const Struct<Type> &str) const {
+        return cache.lay_out(str);
+    }
 
-        return result;
+    llvm::Type *operator()(const IntegerArg &) const {
+        // Template arguments are checked, so no value has one as its type.
+        assert(false);
+        return nullptr;
     }
 
 private:
     llvm::LLVMContext &ctx;
-    llvm::Module &mod;
+    LlvmTypeCache &cache;
 };
 
-llvm::Type *to_llvm_type(const Type &t, llvm::Module &mod) {
-    return boost::apply_visitor(ToLlvmVisitor(mod), t);
-}
+LlvmTypeCache::LlvmTypeCache(llvm::Module &module): module(module) {}
 
-/*****************************************************************************
- * Getting unique names for functions.
- */
-
-struct NamingVisitor: public boost::static_visitor<std::string> {
-    std::string operator()(const SignedInt &si) const {
-        std::stringstream result;
-
-        result << "signed";
-        result << si.get_nbits();
-
-        return result.str();
+llvm::Type *LlvmTypeCache::get(const Type &t) {
+    auto found = cache.find(t);
+    if (found != cache.end()) {
+        return found->second;
     }
 
-    std::string operator()(const UnsignedInt &ui) const {
-        std::stringstream result;
+    auto *result = boost::apply_visitor(ToLlvmVisitor(module, *this),
+                                        t.variant());
+    cache.emplace(t, result);
 
-        result << "unsigned";
-        result << ui.get_nbits();
+    return result;
+}
 
-        return result.str();
+unsigned LlvmTypeCache::get_alignment(const Type &t) {
+    auto found = alignments.find(t);
+    if (found != alignments.end()) {
+        return found->second;
     }
 
-    std::string operator()(const Float &f) const {
-        if (f.get_precision() == SinglePrecision) {
-            return "float";
-        } else {
-            return "double";
-        }
+    auto *ll_type = get(t);
+    unsigned result;
+
+    if (auto *str = boost::get<Struct<Type> >(&t.variant())) {
+        result = get_placement(*str).align;
+    } else if (auto *arr = boost::get<Array<Type> >(&t.variant())) {
+        result = get_alignment(*arr->get_element());
+    } else if (ll_type->isSized()) {
+        result = module.getDataLayout().getABITypeAlign(ll_type).value();
+    } else {
+        result = 1;
     }
 
-    std::string operator()(const Void &) const {
-        return std::string("void");
-    }
+    alignments.emplace(t, result);
 
-    std::string operator()(const Pointer<Type> &ptr) const {
-        return std::string("$") + get_name(*ptr.get_pointed()) + "$";
+    return result;
+}
+
+unsigned LlvmTypeCache::get_field_index(const Struct<Type> &str,
+                                        unsigned field) {
+    return get_placement(str).indices[field];
+}
+
+const LlvmTypeCache::FieldPlacement &LlvmTypeCache::get_placement(
+        const Struct<Type> &str) {
+    auto found = placements.find(str.get_name());
+    if (found == placements.end()) {
+        lay_out(str);
+        found = placements.find(str.get_name());
     }
 
-    std::string operator()(const Function<Type> &func) const {
-        std::stringstream result;
+    return found->second;
+}
 
-        result << "$.";
+/*
+ * Structs with the default layout, and no fields more aligned than LLVM would
+ * place them, are plain LLVM structs.  Others are packed LLVM structs with
+ * explicit padding, so their LLVM alignment is meaningless and their real
+ * one is kept in the placement.
+ */
+llvm::StructType *LlvmTypeCache::lay_out(const Struct<Type> &str) {
+    const auto &dl = module.getDataLayout();
+    auto &ctx = module.getContext();
+    const auto &layout = str.get_layout();
+    const auto &fields = str.get_fields();
+
+    std::vector<llvm::Type *> field_types;
+    std::vector<unsigned> natural;
+    bool custom = !layout.is_default();
+
+    for (const auto &field: fields) {
+        auto *ll_type = get(field.second);
+        field_types.push_back(ll_type);
+        natural.push_back(get_alignment(field.second));
+        custom = custom
+              || natural.back() != dl.getABITypeAlign(ll_type).value();
+    }
 
-        for (auto &arg: func.get_args()) {
-            result << get_name(*arg);
-            result << ".";
+    FieldPlacement placement;
+    std::vector<llvm::Type *> elements;
+
+    if (!custom) {
+        placement.indices.resize(fields.size());
+        std::iota(placement.indices.begin(), placement.indices.end(), 0);
+        elements = field_types;
+    } else {
+        auto field_align = [&](unsigned i) {
+            unsigned result = layout.packed ? 1 : natural[i];
+            if (i < layout.field_aligns.size()) {
+                result = std::max(result, layout.field_aligns[i]);
+            }
+            return result;
+        };
+
+        auto size = [&](unsigned i) {
+            return dl.getTypeAllocSize(field_types[i]).getFixedSize();
+        };
+
+        std::vector<unsigned> order(fields.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        if (layout.reorder) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&](unsigned l, unsigned r) {
+                if (field_align(l) != field_align(r)) {
+                    return field_align(l) > field_align(r);
+                }
+                return size(l) > size(r);
+            });
         }
 
-        result << func.get_rettype();
-
-        result << ".$";
+        uint64_t offset = 0;
+        auto pad_to = [&](uint64_t target) {
+            if (target > offset) {
+                elements.push_back(llvm::ArrayType::get(
+                        llvm::Type::getInt8Ty(ctx), target - offset));
+                offset = target;
+            }
+        };
+
+        placement.indices.resize(fields.size());
+        placement.align = std::max(layout.align, 1u);
+
+        for (auto i: order) {
+            auto align = field_align(i);
+            pad_to(llvm::alignTo(offset, align));
+            placement.indices[i] = elements.size();
+            elements.push_back(field_types[i]);
+            offset += size(i);
+            placement.align = std::max(placement.align, align);
+        }
 
-        return result.str();
+        pad_to(llvm::alignTo(offset, placement.align));
     }
 
-    std::string operator()(const Struct<Type> &str) const {
-        return str.get_name();
+    auto *result = llvm::StructType::getTypeByName(ctx, str.get_name());
+    if (!result) {
+        result = llvm::StructType::create(ctx, elements, str.get_name(),
+                                          custom);
     }
-};
 
-std::string get_name(Type t) {
-    return boost::apply_visitor(NamingVisitor(), t);
+    if (!custom) placement.align = dl.getABITypeAlign(result).value();
+
+    placements[str.get_name()] = std::move(placement);
+
+    return result;
 }
 
 /*****************************************************************************
  * Specializing template types.
  */
 
+/**
+ * @brief Finds whether a template type uses any of the template's
+ *        parameters.
+ */
+struct DependenceVisitor: public boost::static_visitor<bool> {
+    template<typename T>
+    bool operator()(const T &simple) const {
+        return false;
+    }
+
+    bool operator()(const Pointer<TemplateType> &ptr) const {
+        return boost::apply_visitor(*this, *ptr.get_pointed());
+    }
+
+    bool operator()(const Vector<TemplateType> &vec) const {
+        return boost::apply_visitor(*this, *vec.get_element());
+    }
+
+    bool operator()(const Array<TemplateType> &arr) const {
+        return arr.get_length_parameter() >= 0
+            || boost::apply_visitor(*this, *arr.get_element());
+    }
+
+    bool operator()(const Struct<TemplateType> &str) const {
+        for (const auto &field: str.get_fields()) {
+            if (boost::apply_visitor(*this, *field.second)) return true;
+        }
+        return false;
+    }
+
+    bool operator()(const int &i) const {
+        return true;
+    }
+
+    bool operator()(const IntegerParameter &) const {
+        return true;
+    }
+
+    bool operator()(const Function<TemplateType> &fn) const {
+        if (boost::apply_visitor(*this, *fn.get_rettype())) return true;
+        for (const auto &arg: fn.get_args()) {
+            if (boost::apply_visitor(*this, *arg)) return true;
+        }
+        return false;
+    }
+};
+
 struct SpecializerTypeVisitor: public boost::static_visitor<Type> {
     SpecializerTypeVisitor(const std::vector<Type> &template_args)
         : args(template_args) {}
@@ -224,44 +582,63 @@ struct SpecializerTypeVisitor: public boost::static_visitor<Type> {
     }
 
     Type operator()(const Pointer<TemplateType> &ptr) const {
-        return Pointer<Type>(specialize(*ptr.get_pointed(), args));
+        return Pointer<Type>(specialize(*ptr.get_pointed(), args),
+                             ptr.is_restrict());
+    }
+
+    Type operator()(const Vector<TemplateType> &vec) const {
+        return Vector<Type>(specialize(*vec.get_element(), args),
+                            vec.get_lanes());
+    }
+
+    Type operator()(const Array<TemplateType> &arr) const {
+        auto length = arr.get_length();
+        if (arr.get_length_parameter() >= 0) {
+            const auto &arg = args[arr.get_length_parameter()].variant();
+            length = boost::get<IntegerArg>(arg).get_value();
+        }
+
+        return Array<Type>(specialize(*arr.get_element(), args), length);
     }
 
     Struct<Type> operator()(const Struct<TemplateType> &str) const {
-        std::vector<std::pair<std::string,
-                              std::shared_ptr<Type> > >fields;
+        std::vector<std::pair<std::string, Type> >fields;
 
         for (const auto &t_field: str.get_fields()) {
-            fields.push_back(std::pair<std::string, std::shared_ptr<Type> >
+            fields.push_back(std::pair<std::string, Type>
                                       (t_field.first,
-                                       std::make_shared<Type>(
-                                         specialize(*t_field.second, args))));
+                                       specialize(*t_field.second, args)));
         }
 
-        std::stringstream namestream;
+        // An ordinary struct used in a template is left as it is.
+        if (!DependenceVisitor()(str)) {
+            return Struct<Type>(fields, str.get_name(), str.get_layout());
+        }
 
-        namestream << "tmpl." << str.get_name();
+        std::string name = "tmpl." + str.get_name();
 
         for (auto &arg: args) {
-            namestream << "." << get_name(arg);
+            name += "." + arg.get_name();
         }
 
-        return Struct<Type>(fields, namestream.str());
+        return Struct<Type>(fields, name, str.get_layout());
     }
 
     Type operator()(const int &i) const {
         return args[i];
     }
 
+    Type operator()(const IntegerParameter &p) const {
+        return args[p.index];
+    }
+
     Function<Type> operator()(const Function<TemplateType> &fn) const {
-        auto rettype = std::make_shared<Type>
-                                       (specialize(*fn.get_rettype(), args));
+        auto rettype = specialize(*fn.get_rettype(), args);
 
-        std::vector<std::shared_ptr<Type> >fn_args;
+        std::vector<Type> fn_args;
 
         for (const auto &arg: fn.get_args()) {
-            fn_args.push_back(std::make_shared<Type>
-                                              (specialize(*arg, args)));
+            fn_args.push_back(specialize(*arg, args));
         }
 
         return Function<Type>(rettype, fn_args);
@@ -285,8 +662,30 @@ struct RespecializerTypeVisitor: public boost::static_visitor<TemplateType> {
     }
 
     TemplateType operator()(const Pointer<TemplateType> &ptr) const {
-        auto pointed = boost::apply_visitor(*this, *ptr.get_pointed());
-        return Pointer<TemplateType>(std::make_shared<TemplateType>(pointed));
+        return Pointer<TemplateType>(
+                boost::apply_visitor(*this, *ptr.get_pointed()),
+                ptr.is_restrict());
+    }
+
+    TemplateType operator()(const Vector<TemplateType> &vec) const {
+        return Vector<TemplateType>(
+                boost::apply_visitor(*this, *vec.get_element()),
+                vec.get_lanes());
+    }
+
+    TemplateType operator()(const Array<TemplateType> &arr) const {
+        auto element = boost::apply_visitor(*this, *arr.get_element());
+        if (arr.get_length_parameter() < 0) {
+            return Array<TemplateType>(element, arr.get_length());
+        }
+
+        // The length is now a literal, or another template's parameter.
+        const auto &arg = args[arr.get_length_parameter()];
+        if (auto *param = boost::get<IntegerParameter>(&arg)) {
+            return Array<TemplateType>(element, 0, param->index);
+        }
+        return Array<TemplateType>(element,
+                                   boost::get<IntegerArg>(arg).get_value());
     }
 
     Struct<TemplateType> operator()(const Struct<TemplateType> &str) const {
@@ -302,13 +701,17 @@ struct RespecializerTypeVisitor: public boost::static_visitor<TemplateType> {
                                            field)));
         }
 
-        return Struct<TemplateType>(fields, str.get_name());
+        return Struct<TemplateType>(fields, str.get_name(), str.get_layout());
     }
 
     TemplateType operator()(const int &i) const {
         return args[i];
     }
 
+    TemplateType operator()(const IntegerParameter &p) const {
+        return args[p.index];
+    }
+
     TemplateType operator()(const Function<TemplateType> &fn) const {
         auto r = boost::apply_visitor(*this, *fn.get_rettype());
         auto rettype = std::make_shared<TemplateType>(r);
@@ -333,15 +736,17 @@ Type specialize(const TemplateType &temp, const std::vector<Type> &args) {
 
 std::string mangle_name(std::string fname,
                         const std::vector<Type> &args) {
-    std::stringstream namestream;
-
-    namestream << "FnTmpl." << fname;
+    std::string result = "FnTmpl." + fname;
 
     for (auto &arg: args) {
-        namestream << "." << get_name(arg);
+        result += "." + arg.get_name();
     }
 
-    return namestream.str();
+    return result;
+}
+
+bool is_mangled_name(const std::string &name) {
+    return llvm::StringRef(name).startswith("FnTmpl.");
 }
 
 /*****************************************************************************
@@ -360,7 +765,7 @@ public:
                 fields;
 
         for (const auto &field: t.get_fields()) {
-            auto t = boost::apply_visitor(*this, *field.second);
+            auto t = boost::apply_visitor(*this, field.second.variant());
             auto p = std::make_shared<TemplateType>(t);
 
             fields.push_back(
@@ -368,25 +773,36 @@ public:
                         field.first, p));
         }
 
-        return Struct<TemplateType>(fields, t.get_name());
+        return Struct<TemplateType>(fields, t.get_name(), t.get_layout());
     }
 
     TemplateType operator()(const Pointer<Type> &p) const {
-        auto pointed = boost::apply_visitor(*this, *p.get_pointed());
+        return Pointer<TemplateType>(
+                boost::apply_visitor(*this, p.get_pointed()->variant()),
+                p.is_restrict());
+    }
 
-        auto ptr = std::make_shared<TemplateType>(pointed);
+    TemplateType operator()(const Vector<Type> &v) const {
+        return Vector<TemplateType>(
+                boost::apply_visitor(*this, v.get_element()->variant()),
+                v.get_lanes());
+    }
 
-        return Pointer<TemplateType>(ptr);
+    TemplateType operator()(const Array<Type> &a) const {
+        return Array<TemplateType>(
+                boost::apply_visitor(*this, a.get_element()->variant()),
+                a.get_length());
     }
 
     Function<TemplateType> operator()(const Function<Type> &f) const {
-        auto rettype = boost::apply_visitor(*this, *f.get_rettype());
+        auto rettype = boost::apply_visitor(*this,
+                                            f.get_rettype()->variant());
         auto ptr = std::make_shared<TemplateType>(rettype);
 
         std::vector<std::shared_ptr<TemplateType> >args;
 
         for (const auto &arg: f.get_args()) {
-            auto a = boost::apply_visitor(*this, *arg);
+            auto a = boost::apply_visitor(*this, arg.variant());
             args.push_back(std::make_shared<TemplateType>(a));
         }
 
@@ -396,15 +812,22 @@ public:
 };
 
 TemplateType to_template(const Type &t) {
-    return boost::apply_visitor(TemplatizerVisitor(), t);
+    return boost::apply_visitor(TemplatizerVisitor(), t.variant());
 }
 
 /*****************************************************************************
  * Template types.
  */
 
-TemplateStruct::TemplateStruct(Struct<TemplateType> inner, int n_parameters)
-    : n_parameters(n_parameters), inner(inner) {}
+bool is_integer_parameter(Symbol name) {
+    // Type names start with a capital; anything else is named like a value.
+    return !isupper(static_cast<unsigned char>(name.str()[0]));
+}
+
+TemplateStruct::TemplateStruct(Struct<TemplateType> inner,
+                               std::vector<Symbol> parameters)
+    : n_parameters(parameters.size()), parameters(std::move(parameters)),
+      inner(inner) {}
 
 int TemplateStruct::get_nparameters(void) const {
     return n_parameters;
@@ -425,7 +848,7 @@ Struct<TemplateType> TemplateStruct::respecialize(
 }
 
 TemplateFunction::TemplateFunction(Function<TemplateType> inner,
-                                   std::vector<std::string> args)
+                                   std::vector<Symbol> args)
     : n_parameters(args.size()),
       inner(inner) {}
 
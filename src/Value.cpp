@@ -25,10 +25,15 @@
 
 namespace Craeft {
 
-Value::Value(llvm::Value *inst, Type ty): inst(inst), ty(ty) {
+Value::Value(llvm::Value *inst, Type ty): inst(inst), ty(ty),
+                                          pointee_align(0),
+                                          alias_scope(nullptr) {
     //assert(inst->getType() == to_llvm_type(ty));
 }
 
+Value::Value(llvm::Value *inst, Type ty, unsigned pointee_align):
+    inst(inst), ty(ty), pointee_align(pointee_align), alias_scope(nullptr) {}
+
 bool Value::is_integral(void) const {
     return is_type<SignedInt>(ty) || is_type<UnsignedInt>(ty);
 }
@@ -1,52 +1,203 @@
 #include <cassert>
-#include <fcntl.h>
-#include <fstream>
 #include <iostream>
-#include <unistd.h>
+#include <map>
+#include <vector>
 
 #include <boost/program_options.hpp>
 #include <boost/variant.hpp>
 
-#include "Parser.hh"
-#include "Codegen/Module.hh"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Driver.hh"
+#include "Server.hh"
+#include "TimeReport.hh"
 
 namespace opt = boost::program_options;
 
-/* Actually the privileges most compilers create object files with. */
-static const int OBJFILE_MODE_BLAZEIT = 420;
+/**
+ * @brief Where to write an output for `in_file`.
+ *
+ * @param arg The argument given for this output.
+ * @param to_dir Whether `arg` names a directory to write the output into,
+ *               rather than the output itself.
+ * @param ext The output's extension.
+ */
+std::string output_path(const std::string &arg, const std::string &in_file,
+                        bool to_dir, const char *ext) {
+    if (!to_dir) return arg;
+
+    llvm::SmallString<128> result(arg);
+    llvm::sys::path::append(result, llvm::sys::path::stem(in_file));
+    result += ext;
+    return result.str().str();
+}
 
 /**
- * @brief Pull a single AST out of the parser, and have the code generator
- *        visit it.
+ * @brief Whether an output argument names a directory: it ends in a slash or
+ *        is an existing directory.
  */
-bool handle_input(Craeft::Parser &p, Craeft::Codegen::ModuleGen &c) {
-    try {
-        auto e = p.parse_toplevel();
-        c.codegen(*e);
+bool names_dir(const std::string &arg) {
+    return (!arg.empty() && llvm::sys::path::is_separator(arg.back()))
+        || llvm::sys::fs::is_directory(arg);
+}
+
+/**
+ * @brief Identify this build of the compiler, by the size and modification
+ *        time of its executable.
+ */
+std::string compiler_id(const char *argv0) {
+    auto exe = llvm::sys::fs::getMainExecutable(
+            argv0, (void *)&compiler_id);
+
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(exe, status)) return exe;
+
+    std::string result;
+    llvm::raw_string_ostream out(result);
+    out << exe << ':' << status.getSize() << ':'
+        << status.getLastModificationTime().time_since_epoch().count();
+
+    return out.str();
+}
+
+/**
+ * @brief Parse the argument to `-O`: a level from 0 to 3, or "s" or "z" to
+ *        optimize for size.
+ *
+ * @return Whether the argument was valid.
+ */
+bool parse_opt_level(const std::string &arg, int &opt_level, int &size_level) {
+    size_level = 0;
+
+    if (arg == "s" || arg == "z") {
+        opt_level = 2;
+        size_level = arg == "s" ? 1 : 2;
         return true;
-    } catch (Craeft::Error e) {
-        e.emit(std::cerr);
-        return false;
     }
+
+    if (arg.size() != 1 || arg[0] < '0' || arg[0] > '3') return false;
+
+    opt_level = arg[0] - '0';
+    return true;
 }
 
 /**
- * @brief Entry point.
+ * @brief Parse the argument to `--fast-math`: empty for every flag, or the
+ *        names of flags separated by commas.
+ *
+ * @return Whether the argument was valid.
  */
-int main(int argc, char **argv) {
+bool parse_fast_math(const std::string &arg, Craeft::FastMath &flags) {
+    if (arg.empty()) {
+        flags = Craeft::FastMath::all();
+        return true;
+    }
+
+    llvm::SmallVector<llvm::StringRef, 8> names;
+    llvm::StringRef(arg).split(names, ',');
+    for (auto name: names) {
+        if (!flags.set(name.str(), true)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Run the compiler on the command line, as `main`, or as a child of
+ *        the server would on a client's.
+ */
+int run_command(int argc, const char *const *argv) {
     /* Boost command-line option stuff... */
     opt::options_description desc("Craeft Compiler Options");
     desc.add_options()
         ("help", "print usage information")
         ("obj,c", opt::value<std::string>(),
-            "select output file to emit object code")
+            "select output file to emit object code (or, with several input "
+            "files, the directory to emit it into)")
         ("ll", opt::value<std::string>(),
-            "select output file to emit LLVM IR")
+            "select output file (or directory) to emit LLVM IR")
         ("asm,s", opt::value<std::string>(),
-            "select output file to emit target-specific assembly")
-        ("opt,O", opt::value<int>()->default_value(0),
-            "select optimization level (default 0)")
-        ("in", opt::value<std::string>(), "select input file");
+            "select output file (or directory) to emit target-specific "
+            "assembly")
+        ("bc", opt::value<std::string>(),
+            "select output file (or directory) to emit LLVM bitcode with a "
+            "ThinLTO summary, for linking with -flto=thin or --thin-lto")
+        ("remarks", opt::value<std::string>(),
+            "select output file (or directory) to write LLVM's optimization "
+            "remarks to, as YAML: which transformations passes made or "
+            "missed, and why, located in the source")
+        ("interface", opt::value<std::string>(),
+            "select output file (or directory) to write the declarations of "
+            "the module to, for other files to import without parsing them")
+        ("remarks-filter", opt::value<std::string>(),
+            "only record remarks from passes whose names match this regular "
+            "expression (e.g. \"inline|loop-vectorize\")")
+        ("thin-lto", "optimize bitcode input files from --bc together, "
+            "importing functions across them, and write an object file for "
+            "each with -c")
+        ("run", "run the program in-process, passing it any arguments after "
+            "the input file")
+        ("entry", opt::value<std::string>()->default_value("main"),
+            "select the function --run calls (default main)")
+        ("opt,O", opt::value<std::string>()->default_value("0"),
+            "select optimization level: 0-3, or s or z for size (default 0)")
+        ("debug,g", opt::value<std::string>()->implicit_value(""),
+            "generate DWARF debug information: -g for full, "
+            "-gline-tables-only for just line tables (enough for profilers "
+            "and backtraces), or -g0 for none")
+        ("march", opt::value<std::string>(),
+            "select the target architecture (default: that of the host)")
+        ("mcpu", opt::value<std::string>()->default_value("generic"),
+            "select the target CPU, or \"native\" for the host's")
+        ("mattr", opt::value<std::string>()->default_value(""),
+            "enable (+feature) or disable (-feature) target features, "
+            "separated by commas")
+        ("fast-math", opt::value<std::string>()->implicit_value(""),
+            "let floating-point arithmetic break IEEE rules for speed: all "
+            "of them, or those given, separated by commas, out of reassoc, "
+            "contract, nnan, ninf, nsz, arcp and afn (functions may choose "
+            "for themselves with @fastmath and @nofastmath)")
+        ("fwrapv", "make signed integer arithmetic wrap around on "
+            "overflow, rather than assuming it doesn't overflow")
+        ("fast-compile", "compile as quickly as possible, for edit-compile-"
+            "test loops: skip verifying the IR and use the fastest "
+            "instruction selector, register allocator and backend "
+            "pipeline (only at -O0)")
+        ("split-codegen", "also generate object code on -j threads, each "
+            "given part of the module, and merge the parts with ld -r")
+        ("jobs,j", opt::value<int>()->default_value(1),
+            "generate and optimize code on this many threads, or compile "
+            "this many input files at once (default 1)")
+        ("cache-dir", opt::value<std::string>(),
+            "reuse the code for unchanged functions from, and save new "
+            "code to, this directory")
+        ("profile-generate", opt::value<std::string>()->implicit_value(""),
+            "instrument the program to write a profile of its runs, into "
+            "the given directory if any (link with the LLVM profiling "
+            "runtime, as clang -fprofile-generate does)")
+        ("profile-use", opt::value<std::string>(),
+            "optimize using a profile merged by llvm-profdata from runs of "
+            "a --profile-generate build")
+        ("time-report", opt::value<std::string>()->implicit_value("text"),
+            "print the time and memory each phase of compilation took to "
+            "stderr, as \"text\" (the default, along with LLVM's per-pass "
+            "timings) or \"json\"")
+        ("import-dir,I", opt::value<std::vector<std::string> >(),
+            "look for imported files in this directory, after that of the "
+            "importing file (may be given several times)")
+        ("server", opt::value<std::string>(),
+            "serve compile requests from craeftc-client on this Unix "
+            "socket, starting each from an already loaded compiler")
+        ("in", opt::value<std::vector<std::string> >(),
+            "select input files (with --run, the input file followed by the "
+            "program's arguments)");
     opt::positional_options_description pos;
     pos.add("in", -1);
 
@@ -59,64 +210,233 @@ int main(int argc, char **argv) {
                       .positional(pos)
                       .run(),
                    opt_map);
-    } catch (opt::error) {
+    } catch (opt::error &) {
         std::cerr << desc << std::endl;
         return 1;
     }
     opt::notify(opt_map);
 
-    int opt_level = opt_map["opt"].as<int>();
-
-    /* If the user did good, */
-    if (!opt_map.count("help")
-      && (opt_map.count("obj") || opt_map.count("ll") || opt_map.count("asm"))
-      && opt_map.count("in")) {
-        auto in_file = opt_map["in"].as<std::string>();
-        /* Get a code generator. */
-        Craeft::Codegen::ModuleGen codegen("Craeft module", in_file);
-        /* Construct a parser on that file. */
-        Craeft::Parser parser(in_file);
-        bool successful = true;
-        /* Pull ASTs out of the parser */
-        while (successful) {
-            /* until we hit EOF. */
-            if (parser.at_eof()) break;
-            if (!handle_input(parser, codegen)) successful = false;
+    int opt_level, size_level;
+    if (!parse_opt_level(opt_map["opt"].as<std::string>(),
+                         opt_level, size_level)) {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    auto debug_level = Craeft::DebugLevel::None;
+    if (opt_map.count("debug")) {
+        auto arg = opt_map["debug"].as<std::string>();
+        if (arg.empty()) {
+            debug_level = Craeft::DebugLevel::Full;
+        } else if (arg == "line-tables-only") {
+            debug_level = Craeft::DebugLevel::LineTables;
+        } else if (arg != "0") {
+            std::cerr << desc << std::endl;
+            return 1;
+        }
+    }
+
+    Craeft::TargetSpec target;
+    if (opt_map.count("march")) {
+        target.arch = opt_map["march"].as<std::string>();
+    }
+    target.cpu = opt_map["mcpu"].as<std::string>();
+    target.features = opt_map["mattr"].as<std::string>();
+
+    Craeft::FastMath fast_math;
+    if (opt_map.count("fast-math")
+     && !parse_fast_math(opt_map["fast-math"].as<std::string>(), fast_math)) {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    std::string time_report;
+    if (opt_map.count("time-report")) {
+        time_report = opt_map["time-report"].as<std::string>();
+        if (time_report != "text" && time_report != "json") {
+            std::cerr << desc << std::endl;
+            return 1;
+        }
+    }
+
+    std::string target_error;
+    if (!target.resolve(target_error)) {
+        std::cerr << "craeftc: " << target_error << std::endl;
+        return 1;
+    }
+
+    if (opt_map.count("server")) {
+        std::string argv0 = argv[0];
+        return Craeft::serve(opt_map["server"].as<std::string>(),
+                             [argv0](const std::vector<std::string> &args) {
+            std::vector<const char *> client_argv = { argv0.c_str() };
+            for (const auto &arg: args) client_argv.push_back(arg.c_str());
+            return run_command(client_argv.size(), client_argv.data());
+        });
+    }
+
+    int exit_status = 0;
+
+    Craeft::TimeReport report;
+    if (!time_report.empty()) report.activate();
+
+    bool run = opt_map.count("run");
+    bool thin_lto = opt_map.count("thin-lto");
+
+    /* Print usage information if the user did bad. */
+    if (opt_map.count("help")
+     || !(opt_map.count("obj") || opt_map.count("ll") || opt_map.count("asm")
+          || opt_map.count("bc") || opt_map.count("remarks")
+          || opt_map.count("interface") || run)
+     || !opt_map.count("in")
+     || (thin_lto && (!opt_map.count("obj") || opt_map.count("ll")
+                      || opt_map.count("asm") || opt_map.count("bc")
+                      || opt_map.count("remarks")
+                      || opt_map.count("interface") || run))
+     || (opt_map.count("profile-generate") && opt_map.count("profile-use"))) {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    if (opt_map.count("fast-compile") && (opt_level || size_level)) {
+        std::cerr << "craeftc: --fast-compile only applies at -O0"
+                  << std::endl;
+        return 1;
+    }
+
+    auto in_files = opt_map["in"].as<std::vector<std::string> >();
+    /* Pass the program its name and arguments, as C does. */
+    std::vector<std::string> args;
+    if (run) {
+        args = in_files;
+        in_files.resize(1);
+    }
+
+    Craeft::DriverOptions options;
+    options.target = target;
+    options.opt_level = opt_level;
+    options.size_level = size_level;
+    options.jobs = opt_map["jobs"].as<int>();
+    options.debug_level = debug_level;
+    options.fast_math = fast_math;
+    options.wrapping_overflow = opt_map.count("fwrapv");
+    options.fast_compile = opt_map.count("fast-compile");
+    options.split_codegen = opt_map.count("split-codegen");
+    options.remarks = opt_map.count("remarks");
+    options.interface = opt_map.count("interface");
+    if (opt_map.count("remarks-filter")) {
+        options.remarks_passes = opt_map["remarks-filter"].as<std::string>();
+
+        std::string regex_error;
+        if (!llvm::Regex(options.remarks_passes).isValid(regex_error)) {
+            std::cerr << "craeftc: invalid remarks filter: " << regex_error
+                      << std::endl;
+            return 1;
         }
+    }
+    if (opt_map.count("import-dir")) {
+        options.import_dirs =
+            opt_map["import-dir"].as<std::vector<std::string> >();
+    }
+    /* Leave the optimizations ThinLTO repeats to link time. */
+    options.thin_lto = opt_map.count("bc");
+    if (opt_map.count("cache-dir")) {
+        options.cache_dir = opt_map["cache-dir"].as<std::string>();
+        options.compiler_id = compiler_id(argv[0]);
+    }
 
-        if (!successful) return 2;
-
-        /* Validate the module. */
-        codegen.validate(std::cerr);
-        /* Optimize the module to the chosen level. */
-        codegen.optimize(opt_level);
-
-        if (opt_map.count("obj")) {
-            /* Open the output file (LLVM's stream formats are weird, so we
-             * can't use regular STL stream classes). */
-            int fd = open(opt_map["obj"].as<std::string>().c_str(),
-                          O_RDWR | O_CREAT,
-                          OBJFILE_MODE_BLAZEIT);
-            /* Emit the object code. */
-            codegen.emit_obj(fd);
-            close(fd);
+    if (opt_map.count("profile-generate")) {
+        options.profile.generate = true;
+        auto dir = opt_map["profile-generate"].as<std::string>();
+        if (!dir.empty()) {
+            /* As clang names them, one per binary. */
+            llvm::SmallString<128> file(dir);
+            llvm::sys::path::append(file, "default_%m.profraw");
+            options.profile.generate_file = file.str().str();
         }
-        if (opt_map.count("asm")) {
-            int fd = open(opt_map["asm"].as<std::string>().c_str(),
-                          O_RDWR | O_CREAT,
-                          OBJFILE_MODE_BLAZEIT);
-            /* Emit the assembly code. */
-            codegen.emit_asm(fd);
-            close(fd);
+    }
+    if (opt_map.count("profile-use")) {
+        options.profile.use_file = opt_map["profile-use"].as<std::string>();
+        if (!llvm::sys::fs::exists(options.profile.use_file)) {
+            std::cerr << "craeftc: cannot read profile "
+                      << options.profile.use_file << std::endl;
+            return 1;
         }
-        if (opt_map.count("ll")) {
-            std::ofstream file(opt_map["ll"].as<std::string>());
-            codegen.emit_ir(file);
+    }
+
+    /* LLVM's pass timers aren't thread-safe. */
+    if (time_report == "text" && options.jobs == 1) {
+        llvm::TimePassesIsEnabled = true;
+    }
+
+    /* Work out where each file's outputs go. */
+    std::vector<Craeft::Outputs> outputs(in_files.size());
+    std::map<std::string, std::string> written;
+    auto add_output = [&](const char *option, const char *ext,
+                          std::string Craeft::Outputs::*field) {
+        if (!opt_map.count(option)) return true;
+
+        auto arg = opt_map[option].as<std::string>();
+        bool to_dir = in_files.size() > 1 || names_dir(arg);
+        if (to_dir) llvm::sys::fs::create_directories(arg);
+        for (size_t i = 0; i < in_files.size(); ++i) {
+            auto path = output_path(arg, in_files[i], to_dir, ext);
+            auto inserted = written.insert(std::make_pair(path, in_files[i]));
+            if (!inserted.second) {
+                std::cerr << "craeftc: " << inserted.first->second << " and "
+                          << in_files[i] << " would both be written to "
+                          << path << std::endl;
+                return false;
+            }
+            outputs[i].*field = path;
         }
-    } else {
-        /* Print usage information if the user did bad. */
-        std::cerr << desc << std::endl;
+        return true;
+    };
+    if (!add_output("obj", ".o", &Craeft::Outputs::obj)
+     || !add_output("asm", ".s", &Craeft::Outputs::assembly)
+     || !add_output("ll", ".ll", &Craeft::Outputs::ir)
+     || !add_output("bc", ".bc", &Craeft::Outputs::bc)
+     || !add_output("remarks", ".opt.yaml", &Craeft::Outputs::remarks)
+     || !add_output("interface", ".cri", &Craeft::Outputs::interface)) {
         return 1;
     }
 
+    Craeft::Driver driver(options);
+
+    if (run) {
+        Craeft::SourceManager sources;
+        auto codegen = driver.compile(in_files[0], sources, options.jobs,
+                                      std::cerr);
+        if (!codegen) return 2;
+        if (!driver.emit(*codegen, sources, outputs[0], std::cerr)) return 2;
+
+        try {
+            exit_status = codegen->run(opt_map["entry"].as<std::string>(),
+                                       args);
+        } catch (Craeft::Error e) {
+            e.emit(std::cerr, sources);
+            return 2;
+        }
+    } else if (thin_lto) {
+        if (!driver.link_all(in_files, outputs, std::cerr)) return 2;
+    } else if (!driver.compile_all(in_files, outputs, std::cerr)) {
+        return 2;
+    }
+
+    if (time_report == "text") {
+        /* LLVM's timers for the legacy pass managers, e.g. the backend. */
+        llvm::reportAndResetTimings();
+        report.print_text(std::cerr);
+    } else if (time_report == "json") {
+        report.print_json(std::cerr);
+    }
+
+    return exit_status;
+}
+
+/**
+ * @brief Entry point.
+ */
+int main(int argc, char **argv) {
+    return run_command(argc, argv);
 }
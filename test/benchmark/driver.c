@@ -0,0 +1,58 @@
+/* Times a Craeft kernel against its C equivalent.
+ *
+ * Usage: driver N REPS
+ *
+ * Runs each of `craeft_kernel(N)` and `c_kernel(N)` REPS times, and prints
+ * the best time of each in nanoseconds, as JSON.  Fails if the two disagree.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t craeft_kernel(uint64_t n);
+uint64_t c_kernel(uint64_t n);
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double best_ns(uint64_t (*kernel)(uint64_t), uint64_t n, int reps,
+                      uint64_t *result) {
+    double best = -1;
+    for (int i = 0; i < reps; ++i) {
+        double start = now_ns();
+        *result = kernel(n);
+        double elapsed = now_ns() - start;
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s N REPS\n", argv[0]);
+        return 2;
+    }
+
+    uint64_t n = strtoull(argv[1], NULL, 10);
+    int reps = atoi(argv[2]);
+    uint64_t craeft_result, c_result;
+
+    double craeft_ns = best_ns(craeft_kernel, n, reps, &craeft_result);
+    double c_ns = best_ns(c_kernel, n, reps, &c_result);
+
+    if (craeft_result != c_result) {
+        fprintf(stderr, "results differ: craeft %" PRIu64 ", c %" PRIu64 "\n",
+                craeft_result, c_result);
+        return 1;
+    }
+
+    printf("{\"craeft_ns\": %.0f, \"c_ns\": %.0f, \"result\": %" PRIu64 "}\n",
+           craeft_ns, c_ns, craeft_result);
+    return 0;
+}
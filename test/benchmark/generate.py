@@ -0,0 +1,126 @@
+"""Generator for large synthetic Craeft modules, for benchmarking `craeftc`.
+
+Each workload stresses one part of the compiler, and scales linearly with
+`size`:
+
+- `functions`: many small functions calling each other.
+- `expressions`: a few functions with very deep arithmetic expressions.
+- `templates`: many instantiations of template functions and structs.
+- `structs`: big structs, with functions reading and writing every field.
+"""
+
+import argparse
+import random
+import sys
+
+WORKLOADS = ["functions", "expressions", "templates", "structs"]
+
+OPS = ["+", "-", "*", "^", "&", "|"]
+
+def expression(rng, depth, leaves):
+    """A random expression tree of the given depth over `leaves`."""
+    if depth == 0:
+        if rng.random() < 0.25:
+            return str(rng.randint(1, 1000))
+        return rng.choice(leaves)
+    return "({} {} {})".format(expression(rng, depth - 1, leaves),
+                               rng.choice(OPS),
+                               expression(rng, depth - 1, leaves))
+
+def functions(rng, size):
+    out = []
+    for i in range(size):
+        out.append("fn f{}(U64 x, U64 y) -> U64 {{".format(i))
+        out.append("    U64 a = {};".format(expression(rng, 3, ["x", "y"])))
+        out.append("    if a < y {")
+        out.append("        a = a + {};".format(expression(rng, 2, ["x", "a"])))
+        out.append("    }")
+        if i > 0:
+            out.append("    return f{}(a, x);".format(rng.randrange(i)))
+        else:
+            out.append("    return a;")
+        out.append("}")
+        out.append("")
+    return out
+
+def expressions(rng, size):
+    out = []
+    for i in range(max(1, size // 64)):
+        out.append("fn e{}(U64 x, U64 y, U64 z) -> U64 {{".format(i))
+        for j in range(8):
+            out.append("    U64 v{} = {};".format(
+                j, expression(rng, 8, ["x", "y", "z"])))
+        out.append("    return v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7;")
+        out.append("}")
+        out.append("")
+    return out
+
+def templates(rng, size):
+    out = [
+        "struct<:T:> Box {",
+        "    T value;",
+        "    U64 tag;",
+        "}",
+        "",
+        "fn<:T:> get(Box<:T:> *b) -> T {",
+        "    return b->value;",
+        "}",
+        "",
+        "fn<:T:> set(Box<:T:> *b, T value) {",
+        "    b->value = value;",
+        "    b->tag = b->tag + 1;",
+        "}",
+        "",
+        "fn<:T:> swap(Box<:T:> *a, Box<:T:> *b) {",
+        "    T tmp = get<:T:>(a);",
+        "    set<:T:>(a, get<:T:>(b));",
+        "    set<:T:>(b, tmp);",
+        "}",
+        "",
+    ]
+    # Each distinct struct is another set of instantiations.
+    for i in range(max(1, size // 4)):
+        out.append("struct T{} {{".format(i))
+        out.append("    U64 a;")
+        out.append("    Double b;")
+        out.append("}")
+        out.append("")
+        out.append("fn use{0}(Box<:T{0}:> *x, Box<:T{0}:> *y) {{".format(i))
+        out.append("    swap<:T{}:>(x, y);".format(i))
+        out.append("}")
+        out.append("")
+    return out
+
+def structs(rng, size):
+    out = []
+    nfields = 64
+    for i in range(max(1, size // 32)):
+        out.append("struct S{} {{".format(i))
+        for j in range(nfields):
+            out.append("    {} f{};".format(rng.choice(["U64", "Double",
+                                                         "U32", "I16"]), j))
+        out.append("}")
+        out.append("")
+        out.append("fn copy{0}(S{0} *dst, S{0} *src) {{".format(i))
+        for j in range(nfields):
+            out.append("    dst->f{0} = src->f{0};".format(j))
+        out.append("}")
+        out.append("")
+    return out
+
+def generate(workload, size, seed=0):
+    """Return the text of a module of the given workload and size."""
+    rng = random.Random(seed)
+    lines = globals()[workload](rng, size)
+    return "\n".join(lines) + "\n"
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("workload", choices=WORKLOADS)
+    parser.add_argument("size", type=int)
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+    sys.stdout.write(generate(args.workload, args.size, args.seed))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,16 @@
+#include <stdint.h>
+
+static uint64_t fact(uint64_t n) {
+    if (n == 0) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+
+uint64_t c_kernel(uint64_t n) {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        total = total + fact(i & 15);
+    }
+    return total;
+}
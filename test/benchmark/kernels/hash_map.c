@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+enum { EMPTY, FULL, REMOVED };
+
+struct Slot {
+    uint64_t key;
+    uint64_t value;
+};
+
+struct HashMap {
+    struct Slot *slots;
+    uint8_t *states;
+    uint64_t mask;
+    uint64_t shift;
+    uint64_t len;
+    uint64_t used;
+};
+
+static void map_alloc(struct HashMap *m, uint64_t cap, uint64_t shift) {
+    m->slots = malloc(cap * sizeof(struct Slot));
+    m->states = calloc(cap, 1);
+    m->mask = cap - 1;
+    m->shift = shift;
+    m->len = 0;
+    m->used = 0;
+}
+
+static uint64_t map_slot(const struct HashMap *m, uint64_t key) {
+    uint64_t i = (key * 11400714819323198485ull) >> m->shift;
+
+    while (m->states[i] != EMPTY) {
+        if (m->states[i] == FULL && m->slots[i].key == key) return i;
+        i = (i + 1) & m->mask;
+    }
+
+    return i;
+}
+
+static void map_rehash(struct HashMap *m) {
+    struct Slot *slots = m->slots;
+    uint8_t *states = m->states;
+    uint64_t cap = m->mask + 1;
+
+    if (m->len * 2 >= cap) {
+        map_alloc(m, cap * 2, m->shift - 1);
+    } else {
+        map_alloc(m, cap, m->shift);
+    }
+
+    for (uint64_t i = 0; i < cap; ++i) {
+        if (states[i] == FULL) {
+            uint64_t j = map_slot(m, slots[i].key);
+            m->states[j] = FULL;
+            m->slots[j] = slots[i];
+            m->len++;
+            m->used++;
+        }
+    }
+
+    free(slots);
+    free(states);
+}
+
+static void map_insert(struct HashMap *m, uint64_t key, uint64_t value) {
+    if ((m->used + 1) * 4 > (m->mask + 1) * 3) map_rehash(m);
+
+    uint64_t i = map_slot(m, key);
+    if (m->states[i] == FULL) {
+        m->slots[i].value = value;
+        return;
+    }
+
+    m->states[i] = FULL;
+    m->slots[i].key = key;
+    m->slots[i].value = value;
+    m->len++;
+    m->used++;
+}
+
+uint64_t c_kernel(uint64_t n) {
+    struct HashMap m;
+    map_alloc(&m, 8, 61);
+
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        map_insert(&m, i * 3, i);
+    }
+
+    for (uint64_t i = 0; i < n; i = i + 2) {
+        uint64_t j = map_slot(&m, i * 3);
+        if (m.states[j] == FULL) {
+            m.states[j] = REMOVED;
+            m.len--;
+        }
+    }
+
+    uint64_t total = m.len;
+    for (uint64_t i = 0; i < n * 3; i = i + 1) {
+        uint64_t j = map_slot(&m, i);
+        if (m.states[j] == FULL) total = total * 31 + m.slots[j].value;
+    }
+
+    free(m.slots);
+    free(m.states);
+    return total;
+}
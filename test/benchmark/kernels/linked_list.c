@@ -0,0 +1,28 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+struct ListNode {
+    uint64_t contents;
+    struct ListNode *next;
+};
+
+uint64_t c_kernel(uint64_t n) {
+    struct ListNode *tos = NULL;
+
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        struct ListNode *new = malloc(sizeof(struct ListNode));
+        new->contents = i;
+        new->next = tos;
+        tos = new;
+    }
+
+    uint64_t total = 0;
+    while (tos != NULL) {
+        struct ListNode *old = tos;
+        total = total * 31 + old->contents;
+        tos = old->next;
+        free(old);
+    }
+
+    return total;
+}
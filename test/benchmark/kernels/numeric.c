@@ -0,0 +1,27 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+uint64_t c_kernel(uint64_t n) {
+    double *x = malloc(n * 8);
+    double *y = malloc(n * 8);
+
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        x[i] = (double)i;
+        y[i] = (double)(n - i);
+    }
+
+    for (uint64_t pass = 0; pass < 16; pass = pass + 1) {
+        for (uint64_t i = 0; i < n; i = i + 1) {
+            y[i] = y[i] * 0.5 + x[i];
+        }
+    }
+
+    double total = 0.0;
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        total = total + x[i] * y[i];
+    }
+
+    free(x);
+    free(y);
+    return (uint64_t)total;
+}
@@ -0,0 +1,57 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+struct Ring {
+    uint64_t *data;
+    uint64_t mask;
+    uint64_t head;
+    uint64_t len;
+};
+
+static void ring_push(struct Ring *r, uint64_t x) {
+    if (r->len == r->mask + 1) {
+        uint64_t cap = (r->mask + 1) * 2;
+        uint64_t *data = malloc(cap * sizeof(uint64_t));
+        for (uint64_t i = 0; i < r->len; ++i) {
+            data[i] = r->data[(r->head + i) & r->mask];
+        }
+        free(r->data);
+        r->data = data;
+        r->mask = cap - 1;
+        r->head = 0;
+    }
+
+    r->data[(r->head + r->len) & r->mask] = x;
+    r->len++;
+}
+
+static int ring_pop(struct Ring *r, uint64_t *out) {
+    if (r->len == 0) return 0;
+
+    *out = r->data[r->head];
+    r->head = (r->head + 1) & r->mask;
+    r->len--;
+    return 1;
+}
+
+uint64_t c_kernel(uint64_t n) {
+    struct Ring r = { malloc(8 * sizeof(uint64_t)), 7, 0, 0 };
+
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        ring_push(&r, i);
+        if (r.len > 100) {
+            uint64_t x;
+            ring_pop(&r, &x);
+            total = total * 31 + x;
+        }
+    }
+
+    uint64_t x;
+    while (ring_pop(&r, &x)) {
+        total = total + x;
+    }
+
+    free(r.data);
+    return total;
+}
@@ -0,0 +1,39 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+struct Vec {
+    uint64_t *data;
+    uint64_t len;
+    uint64_t cap;
+};
+
+static void vec_push(struct Vec *v, uint64_t x) {
+    if (v->len == v->cap) {
+        v->cap = v->cap < 4 ? 4 : v->cap * 2;
+        v->data = realloc(v->data, v->cap * sizeof(uint64_t));
+    }
+
+    v->data[v->len++] = x;
+}
+
+uint64_t c_kernel(uint64_t n) {
+    struct Vec v = { NULL, 0, 0 };
+
+    for (uint64_t i = 0; i < n; i = i + 1) {
+        vec_push(&v, i * 7);
+    }
+
+    uint64_t total = 0;
+    for (uint64_t pass = 0; pass < 4; pass = pass + 1) {
+        for (uint64_t i = 0; i < v.len; i = i + 1) {
+            total = total * 31 + v.data[i];
+        }
+    }
+
+    while (v.len > 0) {
+        total = total + v.data[--v.len];
+    }
+
+    free(v.data);
+    return total;
+}
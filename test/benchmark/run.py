@@ -0,0 +1,154 @@
+"""Script for benchmarking `craeftc` and the code it generates.
+
+There are two parts:
+
+- Compiler throughput: synthetic modules from `generate.py` are compiled at
+  -O0 (with and without `--fast-compile`) and -O2 with `--time-report=json`,
+  recording lines per second, and the time and peak memory of each phase.
+- Generated code: each kernel in `kernels/` is a Craeft file defining
+  `craeft_kernel` and a C file defining an equivalent `c_kernel`.  Both are
+  compiled at -O2, linked with `driver.c`, and timed against each other.
+
+Results are written as one JSON document, so that runs can be compared.
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+import generate
+
+DIR = os.path.dirname(os.path.abspath(__file__))
+CRAEFT_PATH = os.path.join(DIR, '../../build/craeftc')
+CC = "cc"
+CFLAGS = ["-O2"]
+
+# (kernel, N, repetitions)
+KERNELS = [
+    ("factorial", 10000000, 5),
+    ("linked_list", 1000000, 5),
+    ("numeric", 1000000, 5),
+    ("vec", 10000000, 5),
+    ("hash_map", 1000000, 5),
+    ("ring", 10000000, 5),
+]
+
+# (optimization level, whether to pass --fast-compile)
+COMPILE_MODES = [("0", False), ("0", True), ("2", False)]
+
+def run_child(args):
+    """Run a command, returning its stderr, wall time and peak RSS in KiB."""
+    start = time.monotonic()
+    child = subprocess.Popen(args, stdout=subprocess.DEVNULL,
+                             stderr=subprocess.PIPE)
+    stderr = child.stderr.read()
+    _, status, usage = os.wait4(child.pid, 0)
+    wall = time.monotonic() - start
+    assert os.waitstatus_to_exitcode(status) == 0, \
+           "{} failed: {}".format(args[0], stderr.decode(errors="replace"))
+    # ru_maxrss is in KiB on Linux, but bytes on macOS.
+    rss = usage.ru_maxrss
+    if sys.platform == "darwin":
+        rss //= 1024
+    return stderr, wall, rss
+
+def bench_compiler(craeftc, scale, tmp):
+    results = []
+    for workload in generate.WORKLOADS:
+        code = os.path.join(tmp, workload + ".cr")
+        with open(code, "w") as f:
+            f.write(generate.generate(workload, scale))
+        with open(code, "r") as f:
+            lines = sum(1 for _ in f)
+
+        for (opt, fast) in COMPILE_MODES:
+            args = [craeftc, code, "-O", opt, "--obj", code + ".o",
+                    "--time-report=json"]
+            if fast:
+                args.append("--fast-compile")
+            stderr, wall, rss = run_child(args)
+            report = json.loads(stderr.decode().strip().splitlines()[-1])
+            results.append({
+                "workload": workload,
+                "opt": opt,
+                "fast_compile": fast,
+                "lines": lines,
+                "wall": wall,
+                "lines_per_sec": lines / wall,
+                "peak_rss_kib": rss,
+                "phases": report["phases"],
+                "counts": report["counts"],
+            })
+            print("compile {} -O{}{}: {} lines in {:.3f}s ({:.0f} lines/s), "
+                  "{} KiB".format(workload, opt,
+                                  " --fast-compile" if fast else "", lines,
+                                  wall, lines / wall, rss), file=sys.stderr)
+    return results
+
+def bench_kernels(craeftc, cc, tmp):
+    results = []
+    driver = os.path.join(DIR, "driver.c")
+    for (name, n, reps) in KERNELS:
+        base = os.path.join(DIR, "kernels", name)
+        craeft_obj = os.path.join(tmp, name + ".cr.o")
+        exc = os.path.join(tmp, name)
+
+        run_child([craeftc, base + ".cr", "-O", "2", "--obj", craeft_obj])
+        run_child([cc] + CFLAGS + [driver, base + ".c", craeft_obj,
+                                   "-o", exc])
+
+        out = subprocess.check_output([exc, str(n), str(reps)])
+        result = json.loads(out.decode())
+        result.update({"kernel": name, "n": n, "reps": reps,
+                       "ratio": result["craeft_ns"] / result["c_ns"]})
+        results.append(result)
+        print("kernel {}: craeft {:.3f}ms, c {:.3f}ms ({:.2f}x)".format(
+                  name, result["craeft_ns"] / 1e6, result["c_ns"] / 1e6,
+                  result["ratio"]), file=sys.stderr)
+    return results
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--craeftc", default=CRAEFT_PATH,
+                        help="the compiler to benchmark")
+    parser.add_argument("--cc", default=CC,
+                        help="the C compiler for the kernels' equivalents")
+    parser.add_argument("--scale", type=int, default=2000,
+                        help="the size of the synthetic modules")
+    parser.add_argument("--output", "-o",
+                        help="write the results here instead of stdout")
+    parser.add_argument("--no-compiler", action="store_true",
+                        help="skip the compiler throughput benchmarks")
+    parser.add_argument("--no-kernels", action="store_true",
+                        help="skip the generated code benchmarks")
+    args = parser.parse_args()
+
+    results = {
+        "time": time.time(),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "scale": args.scale,
+    }
+
+    with tempfile.TemporaryDirectory() as tmp:
+        if not args.no_compiler:
+            results["compiler"] = bench_compiler(args.craeftc, args.scale,
+                                                 tmp)
+        if not args.no_kernels:
+            results["kernels"] = bench_kernels(args.craeftc, args.cc, tmp)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+    else:
+        json.dump(results, sys.stdout, indent=2)
+        print()
+
+if __name__ == "__main__":
+    main()
@@ -2,9 +2,18 @@
 
 A craeftc integration test consists of three parts: a YAML configuration file, a
 file containing Craeft code, a C harness, and a file containing expected output.
+A test without a harness defines `main` itself and is run with `craeftc --run`.
+
+A test may instead give `files`, a map from names to contents, and `commands`,
+a list of shell commands run one after another in a temporary directory
+holding those files, with `craeftc` on the `PATH`.  Each command is a map with
+`run`, the command, and optionally `output`, its expected standard output,
+`stderr`, a regular expression its standard error must match, and `error`, a
+string its standard error must contain, in which case it must also fail.
 """
 
 import os
+import shutil
 import subprocess
 import tempfile
 import traceback
@@ -56,7 +65,9 @@ class IntegrationTest(object):
                     f.write(parsed[field + "_text"])
 
         try_file("code")
-        try_file("harness")
+        self.jit = "harness" not in parsed and "harness_text" not in parsed
+        if not self.jit:
+            try_file("harness")
 
         try:
             with open(abs_of_conf_path(parsed["output"]), "r") as f:
@@ -103,12 +114,88 @@ class IntegrationTest(object):
                                                                found)
         assert found == self.expected, msg
 
+    def run_jit(self):
+        child = subprocess.Popen([CRAEFT_PATH, self.code, "--run", "first",
+                                  "second"],
+                                 stdout=subprocess.PIPE)
+        found = child.stdout.read()
+        assert child.wait() == 0, "craeftc --run failed"
+        msg = "output incorrect: expected {}; found {}".format(self.expected,
+                                                               found)
+        assert found == self.expected, msg
+
     def run(self):
+        if self.jit:
+            self.run_jit()
+            return
         self.compile_craeft()
         self.compile_harness()
         self.link()
         self.run_exc()
 
+class CommandTest(object):
+
+    def __init__(self, parsed):
+        """Set up the test described by `parsed`, which has `commands`."""
+        self.name = parsed["name"]
+        self.files = parsed.get("files", {})
+        self.commands = parsed["commands"]
+        self.dir = tempfile.mkdtemp()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        shutil.rmtree(self.dir, ignore_errors=True)
+
+    def run_command(self, command):
+        env = dict(os.environ)
+        craeft_dir = os.path.dirname(os.path.abspath(CRAEFT_PATH))
+        env["PATH"] = craeft_dir + os.pathsep + env.get("PATH", "")
+        child = subprocess.Popen(command["run"], shell=True, cwd=self.dir,
+                                 env=env, stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE)
+        (out, err) = child.communicate()
+        out = out.decode('utf-8', 'replace')
+        err = err.decode('utf-8', 'replace')
+
+        if "error" in command:
+            assert child.returncode != 0, \
+                "`{}` succeeded; expected it to fail".format(command["run"])
+            msg = "`{}` failed with {!r}; expected {!r}".format(
+                    command["run"], err, command["error"])
+            assert command["error"] in err, msg
+        else:
+            msg = "`{}` failed: {}".format(command["run"], err)
+            assert child.returncode == 0, msg
+
+        if "stderr" in command:
+            msg = "`{}` printed {!r} to stderr; expected a match of {!r}" \
+                      .format(command["run"], err, command["stderr"])
+            assert re.search(command["stderr"], err, re.MULTILINE), msg
+
+        if "output" in command:
+            msg = "output of `{}` incorrect: expected {!r}; found {!r}" \
+                      .format(command["run"], command["output"], out)
+            assert out == command["output"], msg
+
+    def run(self):
+        for (name, contents) in self.files.items():
+            path = os.path.join(self.dir, name)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, 'w') as f:
+                f.write(contents)
+        for command in self.commands:
+            self.run_command(command)
+
+def load_test(fname):
+    """Parse the file named by `fname` into a test."""
+    with open(fname, "r") as f:
+        parsed = yaml.load(f)
+    if "commands" in parsed:
+        return CommandTest(parsed)
+    return IntegrationTest(fname)
+
 def main():
     contents = os.listdir(os.path.join(DIR, "tests"))
     confs = list(filter(re.compile(".*\.yaml$").match, contents))
@@ -116,7 +203,7 @@ def main():
     print("Running tests...")
     for (i, conf) in enumerate(confs):
         fname = os.path.join(DIR, "tests", conf)
-        with IntegrationTest(fname) as test:
+        with load_test(fname) as test:
             prefix = "test {}/{} ({}) ".format(i + 1, len(confs), test.name)
             try:
                 test.run()